@@ -19,6 +19,8 @@ LOCAL_SRC_FILES += \
     LocAdapterBase.cpp \
     ContextBase.cpp \
     LocDualContext.cpp \
+    LocPositionReport.cpp \
+    LocEventTrace.cpp \
     loc_core_log.cpp
 
 LOCAL_CFLAGS += \
@@ -26,6 +28,17 @@ LOCAL_CFLAGS += \
      -D_ANDROID_ \
      -Wno-unused-parameter
 
+ifeq ($(TARGET_BUILD_VARIANT),user)
+   LOCAL_CFLAGS += -DTARGET_BUILD_VARIANT_USER
+endif
+
+## Logs above this DEBUG_LEVEL are compiled out, see log_util.h;
+## GPS_LOG_MAX_LEVEL_<module> overrides GPS_LOG_MAX_LEVEL for one module
+LOC_LOG_MAX_LEVEL := $(firstword $(GPS_LOG_MAX_LEVEL_$(LOCAL_MODULE)) $(GPS_LOG_MAX_LEVEL))
+ifneq ($(LOC_LOG_MAX_LEVEL),)
+   LOCAL_CFLAGS += -DLOC_LOG_MAX_LEVEL=$(LOC_LOG_MAX_LEVEL)
+endif
+
 LOCAL_C_INCLUDES:= \
     $(TARGET_OUT_HEADERS)/gps.utils \
     $(TARGET_OUT_HEADERS)/libflp
@@ -36,6 +36,7 @@
 #include <LBSProxyBase.h>
 
 #define MAX_XTRA_SERVER_URL_LENGTH 256
+#define MAX_EVENT_TRACE_PATH_LENGTH 256
 
 /* GPS.conf support */
 /* NOTE: the implementaiton of the parser casts number
@@ -59,6 +60,26 @@ typedef struct loc_gps_cfg_s
     uint32_t       GPS_LOCK;
     uint32_t       A_GLONASS_POS_PROTOCOL_SELECT;
     uint32_t       AGPS_CERT_WRITABLE_MASK;
+    uint32_t       NMEA_SENTENCE_MASK;
+    uint32_t       NMEA_GGA_INTERVAL;
+    uint32_t       NMEA_RMC_INTERVAL;
+    uint32_t       NMEA_GSA_INTERVAL;
+    uint32_t       NMEA_VTG_INTERVAL;
+    uint32_t       NMEA_GSV_INTERVAL;
+    uint32_t       WORKER_THREAD_CPU_MASK;
+    int32_t        WORKER_THREAD_NICE;
+    uint32_t       WORKER_THREAD_FIFO_PRIORITY;
+    uint32_t       HAL_THREAD_CPU_MASK;
+    int32_t        HAL_THREAD_NICE;
+    uint32_t       HAL_THREAD_FIFO_PRIORITY;
+    uint32_t       FIX_LATENCY_REPORT_INTERVAL;
+    uint32_t       MSG_TASK_TRACE;
+    uint32_t       MSG_TASK_RING_CAPACITY;
+    uint32_t       MSG_TASK_BATCH_SIZE;
+    uint32_t       FIX_BATCH_SIZE;
+    uint32_t       FIX_BATCH_TIMEOUT;
+    char           MODEM_EVENT_TRACE_FILE[MAX_EVENT_TRACE_PATH_LENGTH];
+    uint32_t       GEOFENCE_FALLBACK;
 } loc_gps_cfg_s_type;
 
 /* NOTE: the implementaiton of the parser casts number
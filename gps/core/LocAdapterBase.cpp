@@ -79,6 +79,15 @@ void LocAdapterBase::
     }
 }
 
+void LocAdapterBase::
+    reportPositionReport(LocPositionReport* report) {
+    reportPosition(report->mLocation,
+                   report->mLocationExtended,
+                   report->mLocationExt,
+                   report->mStatus,
+                   report->mTechMask);
+}
+
 void LocAdapterBase::
     reportSv(HaxxSvStatus &svStatus,
              GpsLocationExtended &locationExtended,
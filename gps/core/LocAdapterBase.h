@@ -32,6 +32,7 @@
 #include <gps_extended.h>
 #include <UlpProxyBase.h>
 #include <ContextBase.h>
+#include <LocPositionReport.h>
 
 namespace loc_core {
 
@@ -98,6 +99,10 @@ public:
                                 void* locationExt,
                                 enum loc_sess_status status,
                                 LocPosTechMask loc_technology_mask);
+    // LocApiBase delivers fixes here. Adapters that hand the fix on to a
+    // MsgTask override this and keep a share() of the report rather than
+    // copying it; the default reports the fields with the above.
+    virtual void reportPositionReport(LocPositionReport* report);
     virtual void reportSv(HaxxSvStatus &svStatus,
                           GpsLocationExtended &locationExtended,
                           void* svExt);
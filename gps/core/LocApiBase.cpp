@@ -31,6 +31,8 @@
 
 #include <dlfcn.h>
 #include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 #include <LocApiBase.h>
 #include <LocAdapterBase.h>
 #include <log_util.h>
@@ -38,8 +40,48 @@
 
 namespace loc_core {
 
-#define TO_ALL_LOCADAPTERS(call) TO_ALL_ADAPTERS(mLocAdapters, (call))
-#define TO_1ST_HANDLING_LOCADAPTERS(call) TO_1ST_HANDLING_ADAPTER(mLocAdapters, (call))
+// the calls see adapters, the snapshot of mLocAdapters, which stays valid
+// to the end of the block even if adapters are added / removed meanwhile
+#define TO_ALL_LOCADAPTERS(call)                                          \
+    {                                                                     \
+        LocRcuReader reader(mAdaptersRcu);                                \
+        const LocAdapterSet* adapters =                                   \
+            __atomic_load_n(&mLocAdapters, __ATOMIC_ACQUIRE);             \
+        TO_ALL_ADAPTERS(adapters, (call));                                \
+    }
+#define TO_1ST_HANDLING_LOCADAPTERS(call)                                 \
+    {                                                                     \
+        LocRcuReader reader(mAdaptersRcu);                                \
+        const LocAdapterSet* adapters =                                   \
+            __atomic_load_n(&mLocAdapters, __ATOMIC_ACQUIRE);             \
+        TO_1ST_HANDLING_ADAPTER(adapters, (call));                        \
+    }
+// the calls see subscribers, the adapters of the snapshot that subscribe
+// to event, in the order of mLocAdapters
+#define TO_SUBSCRIBED_LOCADAPTERS(event, call)                            \
+    {                                                                     \
+        LocRcuReader reader(mAdaptersRcu);                                \
+        const LocAdapterSet* adapters =                                   \
+            __atomic_load_n(&mLocAdapters, __ATOMIC_ACQUIRE);             \
+        LocAdapterBase* const* subscribers = adapters->mSubscribers[event]; \
+        for (int i = 0; i < adapters->mSubscribed[event]; i++) {          \
+            call;                                                         \
+        }                                                                 \
+    }
+
+// the mask bits an adapter subscribes to each LocAdapterEvent with
+static const LOC_API_ADAPTER_EVENT_MASK_T sEventMasks[LOC_ADAPTER_EVENT_MAX] = {
+    // LOC_ADAPTER_EVENT_POSITION
+    LOC_API_ADAPTER_BIT_PARSED_POSITION_REPORT,
+    // LOC_ADAPTER_EVENT_SV
+    LOC_API_ADAPTER_BIT_SATELLITE_REPORT,
+    // LOC_ADAPTER_EVENT_STATUS
+    LOC_API_ADAPTER_BIT_STATUS_REPORT,
+    // LOC_ADAPTER_EVENT_NMEA
+    LOC_API_ADAPTER_BIT_NMEA_1HZ_REPORT | LOC_API_ADAPTER_BIT_NMEA_POSITION_REPORT,
+    // LOC_ADAPTER_EVENT_MEASUREMENT
+    LOC_API_ADAPTER_BIT_GNSS_MEASUREMENT
+};
 
 int hexcode(char *hexstring, int string_size,
             const char *data, int data_size)
@@ -123,20 +165,69 @@ struct LocOpenMsg : public LocMsg {
     }
 };
 
+// room for count adapters, and for each event, as many subscribers
+static LocAdapterSet* newAdapterSet(int count)
+{
+    LocAdapterSet* adapters = (LocAdapterSet*)
+        malloc(sizeof(LocAdapterSet) + ((count > 1 ? count - 1 : 0) +
+                                        LOC_ADAPTER_EVENT_MAX * count) *
+               sizeof(LocAdapterBase*));
+    if (NULL != adapters) {
+        adapters->mCount = count;
+        for (int e = 0; e < LOC_ADAPTER_EVENT_MAX; e++) {
+            adapters->mSubscribed[e] = 0;
+            adapters->mSubscribers[e] = adapters->mAdapters + count * (e + 1);
+        }
+    }
+    return adapters;
+}
+
+// lists the subscribers of each event, once mAdapters is filled in
+static void subscribeAdapters(LocAdapterSet* adapters)
+{
+    for (int e = 0; e < LOC_ADAPTER_EVENT_MAX; e++) {
+        int subscribed = 0;
+        for (int i = 0; i < adapters->mCount; i++) {
+            if (adapters->mAdapters[i]->checkMask(sEventMasks[e])) {
+                adapters->mSubscribers[e][subscribed++] = adapters->mAdapters[i];
+            }
+        }
+        adapters->mSubscribed[e] = subscribed;
+    }
+}
+
+static bool sameSubscribers(const LocAdapterSet* a, const LocAdapterSet* b)
+{
+    for (int e = 0; e < LOC_ADAPTER_EVENT_MAX; e++) {
+        if (a->mSubscribed[e] != b->mSubscribed[e] ||
+            memcmp(a->mSubscribers[e], b->mSubscribers[e],
+                   a->mSubscribed[e] * sizeof(LocAdapterBase*))) {
+            return false;
+        }
+    }
+    return true;
+}
+
 LocApiBase::LocApiBase(const MsgTask* msgTask,
                        LOC_API_ADAPTER_EVENT_MASK_T excludedMask,
                        ContextBase* context) :
     mExcludedMask(excludedMask), mMsgTask(msgTask),
-    mMask(0), mSupportedMsg(0), mContext(context)
+    mMask(0), mSupportedMsg(0), mContext(context),
+    mLocAdapters(newAdapterSet(0))
 {
-    memset(mLocAdapters, 0, sizeof(mLocAdapters));
+}
+
+LocApiBase::~LocApiBase()
+{
+    close();
+    free(mLocAdapters);
 }
 
 LOC_API_ADAPTER_EVENT_MASK_T LocApiBase::getEvtMask()
 {
     LOC_API_ADAPTER_EVENT_MASK_T mask = 0;
 
-    TO_ALL_LOCADAPTERS(mask |= mLocAdapters[i]->getEvtMask());
+    TO_ALL_LOCADAPTERS(mask |= adapters->mAdapters[i]->getEvtMask());
 
     return mask & ~mExcludedMask;
 }
@@ -145,64 +236,110 @@ bool LocApiBase::isInSession()
 {
     bool inSession = false;
 
-    for (int i = 0;
-         !inSession && i < MAX_ADAPTERS && NULL != mLocAdapters[i];
-         i++) {
-        inSession = mLocAdapters[i]->isInSession();
-    }
+    TO_1ST_HANDLING_LOCADAPTERS(inSession = adapters->mAdapters[i]->isInSession());
 
     return inSession;
 }
 
+void LocApiBase::publishAdapters(LocAdapterSet* adapters)
+{
+    LocAdapterSet* old = mLocAdapters;
+    __atomic_store_n(&mLocAdapters, adapters, __ATOMIC_RELEASE);
+    // frees the old snapshot only once no report can be walking it,
+    // which also means none is calling into an adapter just removed.
+    mAdaptersRcu.retire(old);
+}
+
 void LocApiBase::addAdapter(LocAdapterBase* adapter)
 {
-    for (int i = 0; i < MAX_ADAPTERS && mLocAdapters[i] != adapter; i++) {
-        if (mLocAdapters[i] == NULL) {
-            mLocAdapters[i] = adapter;
-            mMsgTask->sendMsg(new LocOpenMsg(this));
-            break;
+    mAdaptersRcu.writeLock();
+    const LocAdapterSet* old = mLocAdapters;
+    int i = 0;
+    while (i < old->mCount && old->mAdapters[i] != adapter) {
+        i++;
+    }
+    LocAdapterSet* adapters = NULL;
+    if (i == old->mCount) {
+        adapters = newAdapterSet(old->mCount + 1);
+        if (NULL == adapters) {
+            LOC_LOGE("%s: out of memory adding adapter %p", __func__, adapter);
+        } else {
+            memcpy(adapters->mAdapters, old->mAdapters,
+                   old->mCount * sizeof(LocAdapterBase*));
+            adapters->mAdapters[old->mCount] = adapter;
+            subscribeAdapters(adapters);
+            publishAdapters(adapters);
         }
     }
+    mAdaptersRcu.writeUnlock();
+
+    if (adapters) {
+        mMsgTask->sendMsg(new LocOpenMsg(this));
+    }
 }
 
 void LocApiBase::removeAdapter(LocAdapterBase* adapter)
 {
-    for (int i = 0;
-         i < MAX_ADAPTERS && NULL != mLocAdapters[i];
-         i++) {
-        if (mLocAdapters[i] == adapter) {
-            mLocAdapters[i] = NULL;
-
-            // shift the rest of the adapters up so that the pointers
-            // in the array do not have holes.  This should be more
-            // performant, because the array maintenance is much much
-            // less frequent than event handlings, which need to linear
-            // search all the adapters
-            int j = i;
-            while (++i < MAX_ADAPTERS && mLocAdapters[i] != NULL);
-
-            // i would be MAX_ADAPTERS or point to a NULL
-            i--;
-            // i now should point to a none NULL adapter within valid
-            // range although i could be equal to j, but it won't hurt.
-            // No need to check it, as it gains nothing.
-            mLocAdapters[j] = mLocAdapters[i];
-            // this makes sure that we exit the for loop
-            mLocAdapters[i] = NULL;
-
-            // if we have an empty list of adapters
-            if (0 == i) {
-                close();
-            } else {
-                // else we need to remove the bit
-                mMsgTask->sendMsg(new LocOpenMsg(this));
-            }
+    mAdaptersRcu.writeLock();
+    const LocAdapterSet* old = mLocAdapters;
+    int i = 0;
+    while (i < old->mCount && old->mAdapters[i] != adapter) {
+        i++;
+    }
+    // remaining number of adapters; -1 if adapter is not removed
+    int remaining = -1;
+    if (i < old->mCount) {
+        LocAdapterSet* adapters = newAdapterSet(old->mCount - 1);
+        if (NULL == adapters) {
+            LOC_LOGE("%s: out of memory removing adapter %p", __func__, adapter);
+        } else {
+            // keep the order, the first handling adapter matters
+            memcpy(adapters->mAdapters, old->mAdapters, i * sizeof(LocAdapterBase*));
+            memcpy(adapters->mAdapters + i, old->mAdapters + i + 1,
+                   (old->mCount - i - 1) * sizeof(LocAdapterBase*));
+            subscribeAdapters(adapters);
+            remaining = adapters->mCount;
+            publishAdapters(adapters);
+        }
+    }
+    mAdaptersRcu.writeUnlock();
+
+    if (remaining >= 0) {
+        // if we have an empty list of adapters
+        if (0 == remaining) {
+            close();
+        } else {
+            // else we need to remove the bit
+            mMsgTask->sendMsg(new LocOpenMsg(this));
         }
     }
 }
 
+void LocApiBase::updateEvtSubscribers()
+{
+    mAdaptersRcu.writeLock();
+    const LocAdapterSet* old = mLocAdapters;
+    LocAdapterSet* adapters = newAdapterSet(old->mCount);
+    if (NULL == adapters) {
+        LOC_LOGE("%s: out of memory, event subscribers not updated", __func__);
+    } else {
+        memcpy(adapters->mAdapters, old->mAdapters,
+               old->mCount * sizeof(LocAdapterBase*));
+        subscribeAdapters(adapters);
+        if (sameSubscribers(adapters, old)) {
+            free(adapters);
+        } else {
+            publishAdapters(adapters);
+        }
+    }
+    mAdaptersRcu.writeUnlock();
+}
+
 void LocApiBase::updateEvtMask()
 {
+    // the adapter whose mask changed gets the events it now subscribes to
+    // right away, and stops getting the others, ahead of the modem
+    updateEvtSubscribers();
     mMsgTask->sendMsg(new LocOpenMsg(this));
 }
 
@@ -214,13 +351,13 @@ void LocApiBase::handleEngineUpEvent()
     LocDualContext::injectFeatureConfig(mContext);
 
     // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(mLocAdapters[i]->handleEngineUpEvent());
+    TO_ALL_LOCADAPTERS(adapters->mAdapters[i]->handleEngineUpEvent());
 }
 
 void LocApiBase::handleEngineDownEvent()
 {
     // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(mLocAdapters[i]->handleEngineDownEvent());
+    TO_ALL_LOCADAPTERS(adapters->mAdapters[i]->handleEngineDownEvent());
 }
 
 void LocApiBase::reportPosition(UlpLocation &location,
@@ -229,6 +366,22 @@ void LocApiBase::reportPosition(UlpLocation &location,
                                 enum loc_sess_status status,
                                 LocPosTechMask loc_technology_mask)
 {
+    LocPositionReport* report =
+        LocPositionReport::create(location, locationExtended, locationExt,
+                                  status, loc_technology_mask);
+    if (NULL != report) {
+        reportPosition(report);
+        report->drop();
+    }
+}
+
+void LocApiBase::reportPosition(LocPositionReport* report)
+{
+    UlpLocation& location = report->mLocation;
+
+    // as the modem reported it
+    mRecorder.recordPosition(report);
+
     // print the location info before delivering
     LOC_LOGV("flags: %d\n  source: %d\n  latitude: %f\n  longitude: %f\n  "
              "altitude: %f\n  speed: %f\n  bearing: %f\n  accuracy: %f\n  "
@@ -239,20 +392,16 @@ void LocApiBase::reportPosition(UlpLocation &location,
              location.gpsLocation.altitude, location.gpsLocation.speed,
              location.gpsLocation.bearing, location.gpsLocation.accuracy,
              location.gpsLocation.timestamp, location.rawDataSize,
-             location.rawData, status, loc_technology_mask);
+             location.rawData, report->mStatus, report->mTechMask);
 
     if (location.gpsLocation.timestamp > 0 && location.gpsLocation.timestamp < 1580000000000) {
        location.gpsLocation.timestamp += 619315200000; /* 1024 * 7 * 24 * 60 * 60 * 1000 */
        LOC_LOGV("week rollover fixed, timestamp: %lld.", location.gpsLocation.timestamp);
     }
 
-    // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(
-        mLocAdapters[i]->reportPosition(location,
-                                        locationExtended,
-                                        locationExt,
-                                        status,
-                                        loc_technology_mask)
+    // loop through adapters, and deliver to all subscribed adapters.
+    TO_SUBSCRIBED_LOCADAPTERS(LOC_ADAPTER_EVENT_POSITION,
+        subscribers[i]->reportPositionReport(report)
     );
 }
 
@@ -260,6 +409,8 @@ void LocApiBase::reportSv(HaxxSvStatus &svStatus,
                   GpsLocationExtended &locationExtended,
                   void* svExt)
 {
+    mRecorder.recordSv(svStatus, locationExtended);
+
     // print the SV info before delivering
     LOC_LOGV("num sv: %d\n  ephemeris mask: %dxn  almanac mask: %x\n  gps/glo/bds in use"
              " mask: %x/%x/%x\n      sv: prn         snr       elevation      azimuth",
@@ -274,86 +425,90 @@ void LocApiBase::reportSv(HaxxSvStatus &svStatus,
                  svStatus.sv_list[i].elevation,
                  svStatus.sv_list[i].azimuth);
     }
-    // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(
-        mLocAdapters[i]->reportSv(svStatus,
-                                     locationExtended,
-                                     svExt)
+    // loop through adapters, and deliver to all subscribed adapters.
+    TO_SUBSCRIBED_LOCADAPTERS(LOC_ADAPTER_EVENT_SV,
+        subscribers[i]->reportSv(svStatus,
+                                 locationExtended,
+                                 svExt)
     );
 }
 
 void LocApiBase::reportStatus(GpsStatusValue status)
 {
-    // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(mLocAdapters[i]->reportStatus(status));
+    mRecorder.recordStatus(status);
+    // loop through adapters, and deliver to all subscribed adapters.
+    TO_SUBSCRIBED_LOCADAPTERS(LOC_ADAPTER_EVENT_STATUS,
+                              subscribers[i]->reportStatus(status));
 }
 
 void LocApiBase::reportNmea(const char* nmea, int length)
 {
-    // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(mLocAdapters[i]->reportNmea(nmea, length));
+    mRecorder.recordNmea(nmea, length);
+    // loop through adapters, and deliver to all subscribed adapters.
+    TO_SUBSCRIBED_LOCADAPTERS(LOC_ADAPTER_EVENT_NMEA,
+                              subscribers[i]->reportNmea(nmea, length));
 }
 
 void LocApiBase::reportXtraServer(const char* url1, const char* url2,
                                   const char* url3, const int maxlength)
 {
     // loop through adapters, and deliver to the first handling adapter.
-    TO_1ST_HANDLING_LOCADAPTERS(mLocAdapters[i]->reportXtraServer(url1, url2, url3, maxlength));
+    TO_1ST_HANDLING_LOCADAPTERS(adapters->mAdapters[i]->reportXtraServer(url1, url2, url3, maxlength));
 
 }
 
 void LocApiBase::requestXtraData()
 {
     // loop through adapters, and deliver to the first handling adapter.
-    TO_1ST_HANDLING_LOCADAPTERS(mLocAdapters[i]->requestXtraData());
+    TO_1ST_HANDLING_LOCADAPTERS(adapters->mAdapters[i]->requestXtraData());
 }
 
 void LocApiBase::requestTime()
 {
     // loop through adapters, and deliver to the first handling adapter.
-    TO_1ST_HANDLING_LOCADAPTERS(mLocAdapters[i]->requestTime());
+    TO_1ST_HANDLING_LOCADAPTERS(adapters->mAdapters[i]->requestTime());
 }
 
 void LocApiBase::requestLocation()
 {
     // loop through adapters, and deliver to the first handling adapter.
-    TO_1ST_HANDLING_LOCADAPTERS(mLocAdapters[i]->requestLocation());
+    TO_1ST_HANDLING_LOCADAPTERS(adapters->mAdapters[i]->requestLocation());
 }
 
 void LocApiBase::requestATL(int connHandle, AGpsType agps_type)
 {
     // loop through adapters, and deliver to the first handling adapter.
-    TO_1ST_HANDLING_LOCADAPTERS(mLocAdapters[i]->requestATL(connHandle, agps_type));
+    TO_1ST_HANDLING_LOCADAPTERS(adapters->mAdapters[i]->requestATL(connHandle, agps_type));
 }
 
 void LocApiBase::releaseATL(int connHandle)
 {
     // loop through adapters, and deliver to the first handling adapter.
-    TO_1ST_HANDLING_LOCADAPTERS(mLocAdapters[i]->releaseATL(connHandle));
+    TO_1ST_HANDLING_LOCADAPTERS(adapters->mAdapters[i]->releaseATL(connHandle));
 }
 
 void LocApiBase::requestSuplES(int connHandle)
 {
     // loop through adapters, and deliver to the first handling adapter.
-    TO_1ST_HANDLING_LOCADAPTERS(mLocAdapters[i]->requestSuplES(connHandle));
+    TO_1ST_HANDLING_LOCADAPTERS(adapters->mAdapters[i]->requestSuplES(connHandle));
 }
 
 void LocApiBase::reportDataCallOpened()
 {
     // loop through adapters, and deliver to the first handling adapter.
-    TO_1ST_HANDLING_LOCADAPTERS(mLocAdapters[i]->reportDataCallOpened());
+    TO_1ST_HANDLING_LOCADAPTERS(adapters->mAdapters[i]->reportDataCallOpened());
 }
 
 void LocApiBase::reportDataCallClosed()
 {
     // loop through adapters, and deliver to the first handling adapter.
-    TO_1ST_HANDLING_LOCADAPTERS(mLocAdapters[i]->reportDataCallClosed());
+    TO_1ST_HANDLING_LOCADAPTERS(adapters->mAdapters[i]->reportDataCallClosed());
 }
 
 void LocApiBase::requestNiNotify(GpsNiNotification &notify, const void* data)
 {
     // loop through adapters, and deliver to the first handling adapter.
-    TO_1ST_HANDLING_LOCADAPTERS(mLocAdapters[i]->requestNiNotify(notify, data));
+    TO_1ST_HANDLING_LOCADAPTERS(adapters->mAdapters[i]->requestNiNotify(notify, data));
 }
 
 void LocApiBase::saveSupportedMsgList(uint64_t supportedMsgList)
@@ -369,8 +524,10 @@ LocApiProxyBase* LocApiBase :: getLocApiProxy()
 
 void LocApiBase::reportGpsMeasurementData(GpsData &gpsMeasurementData)
 {
-    // loop through adapters, and deliver to all adapters.
-    TO_ALL_LOCADAPTERS(mLocAdapters[i]->reportGpsMeasurementData(gpsMeasurementData));
+    mRecorder.recordMeasurement(gpsMeasurementData);
+    // loop through adapters, and deliver to all subscribed adapters.
+    TO_SUBSCRIBED_LOCADAPTERS(LOC_ADAPTER_EVENT_MEASUREMENT,
+        subscribers[i]->reportGpsMeasurementData(gpsMeasurementData));
 }
 
 enum loc_api_adapter_err LocApiBase::
@@ -554,3 +711,129 @@ bool LocApiBase::
 DEFAULT_IMPL(false)
 
 } // namespace loc_core
+
+#ifdef __LOC_API_BASE_DEBUG__
+
+#include <stdio.h>
+#include <time.h>
+
+using namespace loc_core;
+
+// counts the events it gets, and those it got without having subscribed
+class LocFanoutAdapter : public LocAdapterBase {
+public:
+    int mEvents;
+    int mStray;
+    inline LocFanoutAdapter(const MsgTask* msgTask, LocApiBase* locApi,
+                            LOC_API_ADAPTER_EVENT_MASK_T mask) :
+        LocAdapterBase(msgTask), mEvents(0), mStray(0) {
+        mEvtMask = mask;
+        mLocApi = locApi;
+        mLocApi->addAdapter(this);
+    }
+    // the adapters used to have to filter out what they did not ask for
+    inline void count(LOC_API_ADAPTER_EVENT_MASK_T bits) {
+        if (checkMask(bits)) {
+            mEvents++;
+        } else {
+            mStray++;
+        }
+    }
+    virtual void reportPosition(UlpLocation&, GpsLocationExtended&, void*,
+                                enum loc_sess_status, LocPosTechMask) {
+        count(LOC_API_ADAPTER_BIT_PARSED_POSITION_REPORT);
+    }
+    virtual void reportSv(HaxxSvStatus&, GpsLocationExtended&, void*) {
+        count(LOC_API_ADAPTER_BIT_SATELLITE_REPORT);
+    }
+    virtual void reportNmea(const char*, int) {
+        count(LOC_API_ADAPTER_BIT_NMEA_1HZ_REPORT);
+    }
+    virtual void reportStatus(GpsStatusValue) {
+        count(LOC_API_ADAPTER_BIT_STATUS_REPORT);
+    }
+};
+
+class LocFanoutApi : public LocApiBase {
+public:
+    inline LocFanoutApi(const MsgTask* msgTask) : LocApiBase(msgTask, 0) {}
+};
+
+static double nsSince(const struct timespec& from) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - from.tv_sec) * 1e9 + (now.tv_nsec - from.tv_nsec);
+}
+
+// For Linux command line testing:
+// compile: g++ -D__LOC_HOST_DEBUG__ -D__LOC_API_BASE_DEBUG__ -O2 -I. -I../utils -I../utils/platform_lib_abstractions -I../../../../system/core/include LocApiBase.cpp LocPositionReport.cpp LocEventTrace.cpp LocAdapterBase.cpp LocDualContext.cpp ContextBase.cpp ../utils/*.cpp ../utils/*.c -lpthread -ldl
+int main(int argc, char** argv) {
+    const int rounds = 1000000;
+    const LOC_API_ADAPTER_EVENT_MASK_T masks[] = {
+        LOC_API_ADAPTER_BIT_PARSED_POSITION_REPORT,
+        LOC_API_ADAPTER_BIT_PARSED_POSITION_REPORT | LOC_API_ADAPTER_BIT_STATUS_REPORT,
+        LOC_API_ADAPTER_BIT_SATELLITE_REPORT,
+        LOC_API_ADAPTER_BIT_NMEA_1HZ_REPORT,
+        LOC_API_ADAPTER_BIT_GNSS_MEASUREMENT,
+        LOC_API_ADAPTER_BIT_GEOFENCE_GEN_ALERT,
+        LOC_API_ADAPTER_BIT_REQUEST_WIFI,
+        LOC_API_ADAPTER_BIT_BATCH_FULL
+    };
+    const int count = sizeof(masks) / sizeof(masks[0]);
+    MsgTask* msgTask = new MsgTask("LocFanoutTask", false);
+    LocFanoutApi* locApi = new LocFanoutApi(msgTask);
+    LocFanoutAdapter* adapters[count];
+    for (int i = 0; i < count; i++) {
+        adapters[i] = new LocFanoutAdapter(msgTask, locApi, masks[i]);
+    }
+
+    UlpLocation location;
+    GpsLocationExtended locationExtended;
+    HaxxSvStatus svStatus;
+    memset(&location, 0, sizeof(location));
+    memset(&locationExtended, 0, sizeof(locationExtended));
+    memset(&svStatus, 0, sizeof(svStatus));
+    const char nmea[] = "$GPGGA,,,,,,0,,,,,,,,*66";
+    struct timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < rounds; r++) {
+        locApi->reportPosition(location, locationExtended, NULL, LOC_SESS_SUCCESS);
+    }
+    printf("reportPosition: %.1f ns\n", nsSince(start) / rounds);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < rounds; r++) {
+        locApi->reportSv(svStatus, locationExtended, NULL);
+    }
+    printf("reportSv: %.1f ns\n", nsSince(start) / rounds);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int r = 0; r < rounds; r++) {
+        locApi->reportNmea(nmea, sizeof(nmea) - 1);
+    }
+    printf("reportNmea: %.1f ns\n", nsSince(start) / rounds);
+
+    // a mask changed at run time takes effect on the very next event
+    adapters[2]->updateEvtMask(LOC_API_ADAPTER_BIT_NMEA_1HZ_REPORT,
+                               LOC_REGISTRATION_MASK_ENABLED);
+    locApi->reportNmea(nmea, sizeof(nmea) - 1);
+    adapters[2]->updateEvtMask(LOC_API_ADAPTER_BIT_NMEA_1HZ_REPORT,
+                               LOC_REGISTRATION_MASK_DISABLED);
+    locApi->reportNmea(nmea, sizeof(nmea) - 1);
+
+    int events = 0, stray = 0;
+    for (int i = 0; i < count; i++) {
+        events += adapters[i]->mEvents;
+        stray += adapters[i]->mStray;
+    }
+    printf("%d adapters, %d events delivered (expect %d), %d not subscribed to\n",
+           count, events, 4 * rounds + 3, stray);
+
+    for (int i = 0; i < count; i++) {
+        delete adapters[i];
+    }
+    delete locApi;
+    msgTask->destroy();
+    return 0;
+}
+
+#endif /* __LOC_API_BASE_DEBUG__ */
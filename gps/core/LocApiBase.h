@@ -33,6 +33,8 @@
 #include <ctype.h>
 #include <gps_extended.h>
 #include <MsgTask.h>
+#include <LocRcu.h>
+#include <LocEventTrace.h>
 #include <log_util.h>
 
 namespace loc_core {
@@ -43,15 +45,13 @@ int hexcode(char *hexstring, int string_size,
 int decodeAddress(char *addr_string, int string_size,
                   const char *data, int data_size);
 
-#define MAX_ADAPTERS          10
-
 #define TO_ALL_ADAPTERS(adapters, call)                                \
-    for (int i = 0; i < MAX_ADAPTERS && NULL != (adapters)[i]; i++) {  \
+    for (int i = 0; i < (adapters)->mCount; i++) {                     \
         call;                                                          \
     }
 
 #define TO_1ST_HANDLING_ADAPTER(adapters, call)                              \
-    for (int i = 0; i <MAX_ADAPTERS && NULL != (adapters)[i] && !(call); i++);
+    for (int i = 0; i < (adapters)->mCount && !(call); i++);
 
 enum xtra_version_check {
     DISABLED,
@@ -61,7 +61,31 @@ enum xtra_version_check {
 };
 
 class LocAdapterBase;
+class LocPositionReport;
 struct LocSsrMsg;
+
+// events reported to every adapter that subscribes to them in its event
+// mask; see the masks of each in LocApiBase.cpp
+enum LocAdapterEvent {
+    LOC_ADAPTER_EVENT_POSITION = 0,
+    LOC_ADAPTER_EVENT_SV,
+    LOC_ADAPTER_EVENT_STATUS,
+    LOC_ADAPTER_EVENT_NMEA,
+    LOC_ADAPTER_EVENT_MEASUREMENT,
+    LOC_ADAPTER_EVENT_MAX
+};
+
+// Immutable snapshot of the adapters of a LocApiBase. add / removeAdapter
+// and updateEvtMask replace it as a whole, so events are reported to a
+// consistent set of adapters without taking any lock. Each event also
+// has the list of the adapters subscribed to it, in the same order, so
+// that an event only visits those; the lists share the allocation.
+struct LocAdapterSet {
+    int mCount;
+    int mSubscribed[LOC_ADAPTER_EVENT_MAX];
+    LocAdapterBase** mSubscribers[LOC_ADAPTER_EVENT_MAX];
+    LocAdapterBase* mAdapters[1];
+};
 struct LocOpenMsg;
 
 class LocApiProxyBase {
@@ -79,8 +103,14 @@ class LocApiBase {
     friend class ContextBase;
     const MsgTask* mMsgTask;
     ContextBase *mContext;
-    LocAdapterBase* mLocAdapters[MAX_ADAPTERS];
+    // current snapshot, read under mAdaptersRcu
+    LocAdapterSet* mLocAdapters;
+    LocRcu mAdaptersRcu;
     uint64_t mSupportedMsg;
+    // what is reported to the adapters, when on
+    LocEventRecorder mRecorder;
+    // replaces the snapshot of adapters with adapters; writeLock held
+    void publishAdapters(LocAdapterSet* adapters);
 
 protected:
     virtual enum loc_api_adapter_err
@@ -92,7 +122,7 @@ protected:
     LocApiBase(const MsgTask* msgTask,
                LOC_API_ADAPTER_EVENT_MASK_T excludedMask,
                ContextBase* context = NULL);
-    inline virtual ~LocApiBase() { close(); }
+    virtual ~LocApiBase();
     bool isInSession();
     const LOC_API_ADAPTER_EVENT_MASK_T mExcludedMask;
 
@@ -104,6 +134,12 @@ public:
     void addAdapter(LocAdapterBase* adapter);
     void removeAdapter(LocAdapterBase* adapter);
 
+    // records the reported events into a trace at path, for a
+    // LocEventReplayer; NULL or "" stops recording
+    inline bool recordEvents(const char* path) {
+        return mRecorder.open(path);
+    }
+
     // upward calls
     void handleEngineUpEvent();
     void handleEngineDownEvent();
@@ -113,6 +149,10 @@ public:
                         enum loc_sess_status status,
                         LocPosTechMask loc_technology_mask =
                                   LOC_POS_TECH_MASK_DEFAULT);
+    // delivers a fix without copying it; the caller keeps its reference
+    // to report and drops it when done. The fix is copied into a report
+    // by the above.
+    void reportPosition(LocPositionReport* report);
     void reportSv(HaxxSvStatus &svStatus,
                   GpsLocationExtended &locationExtended,
                   void* svExt);
@@ -229,7 +269,13 @@ public:
             return (messageChecker & mSupportedMsg) == messageChecker;
         }
     }
+    // an adapter changed its event mask; recomputes the subscribers of
+    // each event, and reopens with the new mask
     void updateEvtMask();
+    // only recomputes the subscribers of each event, for an adapter that
+    // has registered the events it changed in its mask already. Publishes
+    // a new snapshot of adapters unless no subscriber list changed.
+    void updateEvtSubscribers();
 
     /*Values for lock
       1 = Do not lock any position sessions
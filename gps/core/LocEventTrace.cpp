@@ -0,0 +1,356 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_LocEventTrace"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <LocEventTrace.h>
+#include <LocApiBase.h>
+#include <LocPositionReport.h>
+#include <log_util.h>
+
+namespace loc_core {
+
+// the buffer of the trace file; events are written out as it fills, and
+// as sessions change status
+#define LOC_EVENT_TRACE_BUFFER (64 * 1024)
+
+struct LocEventPositionTail {
+    int32_t status;
+    uint32_t techMask;
+};
+
+static inline uint64_t nowNs(clockid_t clock) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+LocEventRecorder::LocEventRecorder() : mFile(NULL), mLastNs(0)
+{
+    pthread_mutex_init(&mMutex, NULL);
+}
+
+LocEventRecorder::~LocEventRecorder()
+{
+    open(NULL);
+    pthread_mutex_destroy(&mMutex);
+}
+
+void LocEventRecorder::closeLocked()
+{
+    if (NULL != mFile) {
+        FILE* file = mFile;
+        __atomic_store_n(&mFile, (FILE*)NULL, __ATOMIC_RELEASE);
+        fclose(file);
+    }
+}
+
+bool LocEventRecorder::open(const char* path)
+{
+    bool ret = true;
+    pthread_mutex_lock(&mMutex);
+    closeLocked();
+    if (NULL != path && '\0' != path[0]) {
+        FILE* file = fopen(path, "wb");
+        LocEventTraceHeader header;
+        memset(&header, 0, sizeof(header));
+        strlcpy(header.magic, LOC_EVENT_TRACE_MAGIC, sizeof(header.magic));
+        header.version = LOC_EVENT_TRACE_VERSION;
+        header.ulpLocationSize = sizeof(UlpLocation);
+        header.locationExtendedSize = sizeof(GpsLocationExtended);
+        header.svStatusSize = sizeof(HaxxSvStatus);
+        header.gpsDataSize = sizeof(GpsData);
+        header.startTime = nowNs(CLOCK_REALTIME) / 1000000;
+        if (NULL == file ||
+            0 != setvbuf(file, NULL, _IOFBF, LOC_EVENT_TRACE_BUFFER) ||
+            1 != fwrite(&header, sizeof(header), 1, file)) {
+            LOC_LOGE("%s: can not write %s: %s", __func__, path, strerror(errno));
+            if (NULL != file) {
+                fclose(file);
+            }
+            ret = false;
+        } else {
+            LOC_LOGI("%s: recording modem events to %s", __func__, path);
+            mLastNs = nowNs(CLOCK_MONOTONIC);
+            __atomic_store_n(&mFile, file, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&mMutex);
+    return ret;
+}
+
+void LocEventRecorder::write(uint8_t type, const void* data1, size_t length1,
+                             const void* data2, size_t length2,
+                             const void* data3, size_t length3,
+                             const void* data4, size_t length4)
+{
+    pthread_mutex_lock(&mMutex);
+    if (NULL != mFile) {
+        uint64_t now = nowNs(CLOCK_MONOTONIC);
+        uint64_t delay = (now - mLastNs) / 1000;
+        LocEventRecord record;
+        memset(&record, 0, sizeof(record));
+        record.type = type;
+        record.length = length1 + length2 + length3 + length4;
+        record.delay = delay > UINT32_MAX ? UINT32_MAX : (uint32_t)delay;
+        mLastNs = now;
+        bool ok = 1 == fwrite(&record, sizeof(record), 1, mFile) &&
+            length1 == fwrite(data1, 1, length1, mFile) &&
+            length2 == fwrite(data2, 1, length2, mFile) &&
+            length3 == fwrite(data3, 1, length3, mFile) &&
+            length4 == fwrite(data4, 1, length4, mFile);
+        // session boundaries make it to the file as they happen
+        if (ok && LOC_EVENT_STATUS == type) {
+            ok = 0 == fflush(mFile);
+        }
+        if (!ok) {
+            LOC_LOGE("%s: recording stopped: %s", __func__, strerror(errno));
+            closeLocked();
+        }
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+void LocEventRecorder::recordPosition(const LocPositionReport* report)
+{
+    if (isOn()) {
+        const UlpLocation& location = report->mLocation;
+        LocEventPositionTail tail = { report->mStatus, report->mTechMask };
+        size_t rawDataSize = NULL == location.rawData || location.rawDataSize < 0 ?
+            0 : location.rawDataSize;
+        write(LOC_EVENT_POSITION, &location, sizeof(location),
+              &report->mLocationExtended, sizeof(report->mLocationExtended),
+              &tail, sizeof(tail), location.rawData, rawDataSize);
+    }
+}
+
+void LocEventRecorder::recordSv(const HaxxSvStatus& svStatus,
+                                const GpsLocationExtended& locationExtended)
+{
+    if (isOn()) {
+        const size_t head = offsetof(HaxxSvStatus, sv_list);
+        const size_t tail = offsetof(HaxxSvStatus, ephemeris_mask);
+        int svs = svStatus.num_svs < 0 ? 0 :
+            svStatus.num_svs > GPS_MAX_SVS ? GPS_MAX_SVS : svStatus.num_svs;
+        write(LOC_EVENT_SV, &svStatus, head,
+              svStatus.sv_list, svs * sizeof(GpsSvInfo),
+              (const char*)&svStatus + tail, sizeof(svStatus) - tail,
+              &locationExtended, sizeof(locationExtended));
+    }
+}
+
+void LocEventRecorder::recordStatus(GpsStatusValue status)
+{
+    if (isOn()) {
+        int32_t value = status;
+        write(LOC_EVENT_STATUS, &value, sizeof(value));
+    }
+}
+
+void LocEventRecorder::recordNmea(const char* nmea, int length)
+{
+    if (isOn() && length >= 0) {
+        write(LOC_EVENT_NMEA, nmea, length);
+    }
+}
+
+void LocEventRecorder::recordMeasurement(const GpsData& gpsData)
+{
+    if (isOn()) {
+        const size_t head = offsetof(GpsData, measurements);
+        const size_t tail = offsetof(GpsData, clock);
+        size_t count = gpsData.measurement_count > GPS_MAX_MEASUREMENT ?
+            GPS_MAX_MEASUREMENT : gpsData.measurement_count;
+        write(LOC_EVENT_MEASUREMENT, &gpsData, head,
+              gpsData.measurements, count * sizeof(GpsMeasurement),
+              (const char*)&gpsData + tail, sizeof(gpsData) - tail);
+    }
+}
+
+bool LocEventReplayer::dispatch(const LocEventRecord& record)
+{
+    const char* payload = mBuffer;
+    const uint32_t length = record.length;
+
+    switch (record.type) {
+    case LOC_EVENT_POSITION: {
+        const size_t fixed = sizeof(UlpLocation) + sizeof(GpsLocationExtended) +
+            sizeof(LocEventPositionTail);
+        if (length < fixed) {
+            return false;
+        }
+        // the raw data goes inline, the adapters are given no heap buffer
+        LocPositionReport* report = LocPositionReport::create(length - fixed);
+        if (NULL == report) {
+            return false;
+        }
+        void* rawData = report->mLocation.rawData;
+        LocEventPositionTail tail;
+        memcpy(&report->mLocation, payload, sizeof(UlpLocation));
+        memcpy(&report->mLocationExtended, payload + sizeof(UlpLocation),
+               sizeof(GpsLocationExtended));
+        memcpy(&tail, payload + sizeof(UlpLocation) + sizeof(GpsLocationExtended),
+               sizeof(tail));
+        memcpy(rawData, payload + fixed, length - fixed);
+        report->mLocation.rawData = rawData;
+        report->mLocation.rawDataSize = length - fixed;
+        report->mStatus = (enum loc_sess_status)tail.status;
+        report->mTechMask = tail.techMask;
+        mLocApi->reportPosition(report);
+        report->drop();
+        break;
+    }
+    case LOC_EVENT_SV: {
+        const size_t head = offsetof(HaxxSvStatus, sv_list);
+        const size_t tail = sizeof(HaxxSvStatus) - offsetof(HaxxSvStatus, ephemeris_mask);
+        HaxxSvStatus svStatus;
+        GpsLocationExtended locationExtended;
+        memset(&svStatus, 0, sizeof(svStatus));
+        if (length < head + tail + sizeof(locationExtended)) {
+            return false;
+        }
+        size_t list = length - head - tail - sizeof(locationExtended);
+        if (list > sizeof(svStatus.sv_list)) {
+            return false;
+        }
+        memcpy(&svStatus, payload, head);
+        memcpy(svStatus.sv_list, payload + head, list);
+        memcpy((char*)&svStatus + sizeof(svStatus) - tail, payload + head + list, tail);
+        memcpy(&locationExtended, payload + head + list + tail, sizeof(locationExtended));
+        mLocApi->reportSv(svStatus, locationExtended, NULL);
+        break;
+    }
+    case LOC_EVENT_STATUS: {
+        int32_t status;
+        if (length != sizeof(status)) {
+            return false;
+        }
+        memcpy(&status, payload, sizeof(status));
+        mLocApi->reportStatus((GpsStatusValue)status);
+        break;
+    }
+    case LOC_EVENT_NMEA:
+        mLocApi->reportNmea(payload, length);
+        break;
+    case LOC_EVENT_MEASUREMENT: {
+        const size_t head = offsetof(GpsData, measurements);
+        const size_t tail = sizeof(GpsData) - offsetof(GpsData, clock);
+        // too large for the stack of a modem thread
+        GpsData* gpsData = (GpsData*)calloc(1, sizeof(GpsData));
+        if (NULL == gpsData || length < head + tail ||
+            length - head - tail > sizeof(gpsData->measurements)) {
+            free(gpsData);
+            return false;
+        }
+        size_t list = length - head - tail;
+        memcpy(gpsData, payload, head);
+        memcpy(gpsData->measurements, payload + head, list);
+        memcpy((char*)gpsData + sizeof(GpsData) - tail, payload + head + list, tail);
+        mLocApi->reportGpsMeasurementData(*gpsData);
+        free(gpsData);
+        break;
+    }
+    default:
+        // from a later version; skipped
+        LOC_LOGW("%s: unknown event type %d", __func__, record.type);
+        break;
+    }
+    return true;
+}
+
+int LocEventReplayer::replay(const char* path, double speed)
+{
+    FILE* file = fopen(path, "rb");
+    if (NULL == file) {
+        LOC_LOGE("%s: can not read %s: %s", __func__, path, strerror(errno));
+        return -1;
+    }
+
+    LocEventTraceHeader header;
+    if (1 != fread(&header, sizeof(header), 1, file) ||
+        0 != strncmp(header.magic, LOC_EVENT_TRACE_MAGIC, sizeof(header.magic)) ||
+        LOC_EVENT_TRACE_VERSION != header.version ||
+        sizeof(UlpLocation) != header.ulpLocationSize ||
+        sizeof(GpsLocationExtended) != header.locationExtendedSize ||
+        sizeof(HaxxSvStatus) != header.svStatusSize ||
+        sizeof(GpsData) != header.gpsDataSize) {
+        LOC_LOGE("%s: %s is not a trace of this build", __func__, path);
+        fclose(file);
+        return -1;
+    }
+
+    int events = 0;
+    uint64_t start = nowNs(CLOCK_MONOTONIC);
+    double due = 0;
+    LocEventRecord record;
+    while (1 == fread(&record, sizeof(record), 1, file)) {
+        if (record.length > mBufferSize) {
+            char* buffer = (char*)realloc(mBuffer, record.length);
+            if (NULL == buffer) {
+                LOC_LOGE("%s: no memory for an event of %u bytes",
+                         __func__, record.length);
+                break;
+            }
+            mBuffer = buffer;
+            mBufferSize = record.length;
+        }
+        if (record.length != fread(mBuffer, 1, record.length, file)) {
+            LOC_LOGE("%s: %s is truncated", __func__, path);
+            break;
+        }
+        if (speed > 0) {
+            due += record.delay * 1000.0 / speed;
+            uint64_t at = start + (uint64_t)due;
+            uint64_t now = nowNs(CLOCK_MONOTONIC);
+            if (at > now) {
+                struct timespec delay;
+                delay.tv_sec = (at - now) / 1000000000;
+                delay.tv_nsec = (at - now) % 1000000000;
+                while (0 != nanosleep(&delay, &delay) && EINTR == errno);
+            }
+        }
+        if (!dispatch(record)) {
+            LOC_LOGE("%s: bad event of type %d, %u bytes",
+                     __func__, record.type, record.length);
+            break;
+        }
+        events++;
+        if (NULL != mStepCb) {
+            mStepCb(mStepData);
+        }
+    }
+    fclose(file);
+    LOC_LOGI("%s: %d events replayed from %s", __func__, events, path);
+    return events;
+}
+
+} // namespace loc_core
@@ -0,0 +1,139 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef LOC_EVENT_TRACE_H
+#define LOC_EVENT_TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <gps_extended.h>
+
+namespace loc_core {
+
+class LocApiBase;
+class LocPositionReport;
+
+// A trace is a LocEventTraceHeader followed by LocEventRecords, each
+// followed by its length bytes of payload. Payloads are the structs as
+// the modem reported them, with the unused tails of their SV and
+// measurement arrays left out, so a trace only replays on a build with
+// the same struct sizes, which the header carries.
+#define LOC_EVENT_TRACE_MAGIC "LOCEVT1"
+#define LOC_EVENT_TRACE_VERSION 1
+
+struct LocEventTraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t ulpLocationSize;
+    uint32_t locationExtendedSize;
+    uint32_t svStatusSize;
+    uint32_t gpsDataSize;
+    // CLOCK_REALTIME of the start of the recording, in ms
+    uint64_t startTime;
+};
+
+enum LocEventType {
+    LOC_EVENT_POSITION = 1,
+    LOC_EVENT_SV,
+    LOC_EVENT_STATUS,
+    LOC_EVENT_NMEA,
+    LOC_EVENT_MEASUREMENT
+};
+
+struct LocEventRecord {
+    uint8_t type;
+    uint8_t reserved[3];
+    uint32_t length;
+    // since the previous record, in us
+    uint32_t delay;
+};
+
+// Records the events LocApiBase reports to its adapters into a trace
+// file. Off, the record calls cost an atomic load; on, they serialize
+// on a mutex and a buffered write. The opaque locationExt and svExt are
+// not recorded.
+class LocEventRecorder {
+    pthread_mutex_t mMutex;
+    FILE* volatile mFile;
+    uint64_t mLastNs;
+    void write(uint8_t type, const void* data1, size_t length1,
+               const void* data2 = NULL, size_t length2 = 0,
+               const void* data3 = NULL, size_t length3 = 0,
+               const void* data4 = NULL, size_t length4 = 0);
+    void closeLocked();
+public:
+    LocEventRecorder();
+    ~LocEventRecorder();
+
+    // starts a new trace at path, ending the current one if any; NULL
+    // or "" only ends it. Returns false if path cannot be written.
+    bool open(const char* path);
+    inline bool isOn() const {
+        return NULL != __atomic_load_n(&mFile, __ATOMIC_ACQUIRE);
+    }
+
+    void recordPosition(const LocPositionReport* report);
+    void recordSv(const HaxxSvStatus& svStatus,
+                  const GpsLocationExtended& locationExtended);
+    void recordStatus(GpsStatusValue status);
+    void recordNmea(const char* nmea, int length);
+    void recordMeasurement(const GpsData& gpsData);
+};
+
+// Feeds a trace back to the adapters of a LocApiBase, as if its modem
+// reported it, on the calling thread. speed scales the delays between
+// the events: 1 replays in real time, 10 ten times faster, 0 with no
+// delay at all.
+class LocEventReplayer {
+public:
+    // called after each event is reported; e.g. to wait for the adapters
+    // to be done with it, for a replay in lockstep
+    typedef void (*StepCb)(void* data);
+private:
+    LocApiBase* const mLocApi;
+    const StepCb mStepCb;
+    void* const mStepData;
+    char* mBuffer;
+    uint32_t mBufferSize;
+    bool dispatch(const LocEventRecord& record);
+public:
+    inline LocEventReplayer(LocApiBase* locApi, StepCb stepCb = NULL,
+                            void* stepData = NULL) :
+        mLocApi(locApi), mStepCb(stepCb), mStepData(stepData),
+        mBuffer(NULL), mBufferSize(0) {}
+    inline ~LocEventReplayer() { free(mBuffer); }
+
+    // returns the number of events replayed, -1 if path is not a trace
+    // of this build
+    int replay(const char* path, double speed);
+};
+
+} // namespace loc_core
+
+#endif //LOC_EVENT_TRACE_H
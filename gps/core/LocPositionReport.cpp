@@ -0,0 +1,280 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_LocPositionReport"
+
+#include <new>
+#include <string.h>
+#include <LocPositionReport.h>
+#include <LocMsgPool.h>
+#include <log_util.h>
+
+namespace loc_core {
+
+// the raw data follows the report, aligned for any type
+static inline size_t rawDataOffset() {
+    const size_t align = sizeof(long double);
+    return (sizeof(LocPositionReport) + align - 1) & ~(align - 1);
+}
+
+LocPositionReport* LocPositionReport::create(size_t rawDataSize)
+{
+    const size_t offset = rawDataOffset();
+    char* block = (char*)LocMsgPool::allocate(offset + rawDataSize);
+    if (NULL == block) {
+        LOC_LOGE("%s: no memory for a report of %zu raw bytes",
+                 __func__, rawDataSize);
+        return NULL;
+    }
+    LocPositionReport* report = new (block) LocPositionReport();
+    memset(&report->mLocation, 0, sizeof(report->mLocation));
+    memset(&report->mLocationExtended, 0, sizeof(report->mLocationExtended));
+    report->mLocation.size = sizeof(report->mLocation);
+    report->mLocationExtended.size = sizeof(report->mLocationExtended);
+    report->mLocationExt = NULL;
+    report->mStatus = LOC_SESS_SUCCESS;
+    report->mTechMask = LOC_POS_TECH_MASK_DEFAULT;
+    if (rawDataSize > 0) {
+        report->mInlineRawData = true;
+        report->mLocation.rawData = block + offset;
+        report->mLocation.rawDataSize = (int)rawDataSize;
+    }
+    return report;
+}
+
+LocPositionReport* LocPositionReport::create(const UlpLocation& location,
+                                             const GpsLocationExtended& locationExtended,
+                                             void* locationExt,
+                                             enum loc_sess_status status,
+                                             LocPosTechMask techMask)
+{
+    void* block = LocMsgPool::allocate(sizeof(LocPositionReport));
+    if (NULL == block) {
+        LOC_LOGE("%s: no memory for a report", __func__);
+        return NULL;
+    }
+    LocPositionReport* report = new (block) LocPositionReport();
+    report->mLocation = location;
+    report->mLocationExtended = locationExtended;
+    report->mLocationExt = locationExt;
+    report->mStatus = status;
+    report->mTechMask = techMask;
+    return report;
+}
+
+// a heap raw data buffer handed over with the fix goes with the report;
+// inline raw data goes with its block
+LocPositionReport::~LocPositionReport()
+{
+    if (!mInlineRawData && NULL != mLocation.rawData) {
+        delete (char*)mLocation.rawData;
+    }
+}
+
+void LocPositionReport::drop()
+{
+    if (0 == __atomic_sub_fetch(&mRefs, 1, __ATOMIC_ACQ_REL)) {
+        this->~LocPositionReport();
+        LocMsgPool::release(this);
+    }
+}
+
+} // namespace loc_core
+
+#ifdef __LOC_POSITION_REPORT_DEBUG__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <LocApiBase.h>
+#include <LocAdapterBase.h>
+
+using namespace loc_core;
+
+static volatile uint64_t sHeapAllocs = 0;
+static volatile uint64_t sBytesCopied = 0;
+static volatile int sDelivered = 0;
+
+void* operator new(size_t size) {
+    __atomic_add_fetch(&sHeapAllocs, 1, __ATOMIC_RELAXED);
+    void* p = malloc(size);
+    if (NULL == p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+void operator delete(void* p) noexcept {
+    free(p);
+}
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+// what location_cb and NMEA generation look at
+static void deliver(const UlpLocation& location,
+                    const GpsLocationExtended& locationExtended) {
+    static volatile double sink;
+    sink = location.gpsLocation.latitude + locationExtended.hdop;
+    __atomic_add_fetch(&sDelivered, 1, __ATOMIC_RELEASE);
+}
+
+// stands in for LocEngReportPosition, holding a share across the hop
+struct LocShareMsg : public LocMsg {
+    LocPositionReport* const mReport;
+    inline LocShareMsg(LocPositionReport* report) :
+        mReport(report->share()) {}
+    inline virtual ~LocShareMsg() { mReport->drop(); }
+    virtual void proc() const {
+        deliver(mReport->mLocation, mReport->mLocationExtended);
+    }
+};
+
+// hands each fix on to its MsgTask, like LocInternalAdapter
+class LocHopAdapter : public LocAdapterBase {
+public:
+    inline LocHopAdapter(const MsgTask* msgTask, LocApiBase* locApi) :
+        LocAdapterBase(msgTask) {
+        mEvtMask = LOC_API_ADAPTER_BIT_PARSED_POSITION_REPORT;
+        mLocApi = locApi;
+        mLocApi->addAdapter(this);
+    }
+    virtual void reportPositionReport(LocPositionReport* report) {
+        sendMsg(new LocShareMsg(report));
+    }
+};
+
+class LocHopApi : public LocApiBase {
+public:
+    inline LocHopApi(const MsgTask* msgTask) : LocApiBase(msgTask, 0) {}
+};
+
+static uint64_t poolBlocks() {
+    uint64_t blocks = 0;
+    LocMsgPool::Stats stats;
+    for (int i = 0; i < LocMsgPool::NUM_CLASSES; i++) {
+        if (LocMsgPool::getStats(i, stats)) {
+            blocks += stats.hits + stats.misses;
+        }
+    }
+    return blocks;
+}
+
+static const int RAW_DATA_SIZE = 64;
+
+// fixes reported the way LocApis do today: a fix on the stack, raw
+// data on the heap, copied into a report by LocApiBase
+static void reportLegacy(LocApiBase* locApi, int i) {
+    UlpLocation location;
+    GpsLocationExtended locationExtended;
+    memset(&location, 0, sizeof(location));
+    memset(&locationExtended, 0, sizeof(locationExtended));
+    location.gpsLocation.latitude = i;
+    location.rawData = new char[RAW_DATA_SIZE];
+    location.rawDataSize = RAW_DATA_SIZE;
+    // the one copy, into the report
+    __atomic_add_fetch(&sBytesCopied,
+                       sizeof(location) + sizeof(locationExtended),
+                       __ATOMIC_RELAXED);
+    locApi->reportPosition(location, locationExtended, NULL, LOC_SESS_SUCCESS);
+}
+
+// fixes filled in in place, raw data included
+static void reportInPlace(LocApiBase* locApi, int i) {
+    LocPositionReport* report = LocPositionReport::create(RAW_DATA_SIZE);
+    report->mLocation.gpsLocation.latitude = i;
+    locApi->reportPosition(report);
+    report->drop();
+}
+
+static void run(const char* name, MsgTask* msgTask, int adapters,
+                bool inPlace) {
+    const int rounds = 100000;
+    LocHopApi* locApi = new LocHopApi(msgTask);
+    LocHopAdapter* hops[2];
+    for (int i = 0; i < adapters; i++) {
+        hops[i] = new LocHopAdapter(msgTask, locApi);
+    }
+    // warm up the pool, then measure
+    for (int pass = 0; pass < 2; pass++) {
+        sDelivered = 0;
+        sBytesCopied = 0;
+        uint64_t heap = sHeapAllocs;
+        uint64_t pool = poolBlocks();
+        for (int r = 0; r < rounds; r++) {
+            if (inPlace) {
+                reportInPlace(locApi, r);
+            } else {
+                reportLegacy(locApi, r);
+            }
+            // fixes trickle in; let the MsgTask keep up, or the pool
+            // runs dry and falls back to the heap
+            if (0 == (r + 1) % 16) {
+                while (__atomic_load_n(&sDelivered, __ATOMIC_ACQUIRE) <
+                       (r + 1) * adapters) {
+                    usleep(10);
+                }
+            }
+        }
+        while (__atomic_load_n(&sDelivered, __ATOMIC_ACQUIRE) <
+               rounds * adapters) {
+            usleep(100);
+        }
+        if (pass > 0) {
+            printf("%-24s %d adapter(s): %5.1f bytes copied, %4.2f heap allocs, "
+                   "%4.2f pool blocks per fix\n", name, adapters,
+                   (double)sBytesCopied / rounds,
+                   (double)(sHeapAllocs - heap) / rounds,
+                   (double)(poolBlocks() - pool) / rounds);
+        }
+    }
+    for (int i = 0; i < adapters; i++) {
+        delete hops[i];
+    }
+    delete locApi;
+}
+
+// For Linux command line testing:
+// compile: g++ -D__LOC_HOST_DEBUG__ -D__LOC_POSITION_REPORT_DEBUG__ -O2 -I. -I../utils -I../utils/platform_lib_abstractions -I../../../../system/core/include LocPositionReport.cpp LocEventTrace.cpp LocApiBase.cpp LocAdapterBase.cpp LocDualContext.cpp ContextBase.cpp ../utils/*.cpp ../utils/*.c -lpthread -ldl
+int main(int argc, char** argv) {
+    MsgTask* msgTask = new MsgTask("LocReportTask", false);
+    printf("sizeof UlpLocation %zu, GpsLocationExtended %zu, "
+           "LocPositionReport %zu\n", sizeof(UlpLocation),
+           sizeof(GpsLocationExtended), sizeof(LocPositionReport));
+    for (int adapters = 1; adapters <= 2; adapters++) {
+        run("copied in by LocApiBase", msgTask, adapters, false);
+        run("filled in place", msgTask, adapters, true);
+    }
+    msgTask->destroy();
+    return 0;
+}
+
+#endif // __LOC_POSITION_REPORT_DEBUG__
@@ -0,0 +1,78 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef LOC_POSITION_REPORT_H
+#define LOC_POSITION_REPORT_H
+
+#include <stddef.h>
+#include <gps_extended.h>
+
+namespace loc_core {
+
+// One position fix, as it travels from LocApiBase::reportPosition through
+// the adapters and their MsgTask hops to location_cb and NMEA generation.
+// The report lives in a LocMsgPool block and is refcounted, so everyone
+// on the way holds the same copy: a hop takes a reference with share()
+// and gives it back with drop(); the last drop() returns the block.
+// Once handed to LocApiBase::reportPosition a report is read only.
+class LocPositionReport {
+    volatile int32_t mRefs;
+    // rawData points into this block, after the report
+    bool mInlineRawData;
+    inline LocPositionReport() : mRefs(1), mInlineRawData(false) {}
+    ~LocPositionReport();
+public:
+    UlpLocation mLocation;
+    GpsLocationExtended mLocationExtended;
+    void* mLocationExt;
+    enum loc_sess_status mStatus;
+    LocPosTechMask mTechMask;
+
+    // a zeroed report with rawDataSize bytes of raw data storage in the
+    // same block; for LocApis that fill in their fixes in place. The
+    // caller holds the only reference.
+    static LocPositionReport* create(size_t rawDataSize = 0);
+    // a report copied from a fix kept by the caller. location.rawData,
+    // if any, is not copied; the report takes over the heap buffer and
+    // frees it with the last drop().
+    static LocPositionReport* create(const UlpLocation& location,
+                                     const GpsLocationExtended& locationExtended,
+                                     void* locationExt,
+                                     enum loc_sess_status status,
+                                     LocPosTechMask techMask);
+
+    inline LocPositionReport* share() {
+        __atomic_add_fetch(&mRefs, 1, __ATOMIC_RELAXED);
+        return this;
+    }
+    void drop();
+};
+
+} // namespace loc_core
+
+#endif //LOC_POSITION_REPORT_H
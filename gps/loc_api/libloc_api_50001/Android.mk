@@ -22,6 +22,7 @@ LOCAL_SRC_FILES += \
     loc_eng_ni.cpp \
     loc_eng_log.cpp \
     loc_eng_nmea.cpp \
+    loc_eng_geofence.cpp \
     LocEngAdapter.cpp
 
 LOCAL_SRC_FILES += \
@@ -36,6 +37,17 @@ LOCAL_CFLAGS += \
      -D_ANDROID_ \
      -Wno-unused-parameter
 
+ifeq ($(TARGET_BUILD_VARIANT),user)
+   LOCAL_CFLAGS += -DTARGET_BUILD_VARIANT_USER
+endif
+
+## Logs above this DEBUG_LEVEL are compiled out, see log_util.h;
+## GPS_LOG_MAX_LEVEL_<module> overrides GPS_LOG_MAX_LEVEL for one module
+LOC_LOG_MAX_LEVEL := $(firstword $(GPS_LOG_MAX_LEVEL_$(LOCAL_MODULE)) $(GPS_LOG_MAX_LEVEL))
+ifneq ($(LOC_LOG_MAX_LEVEL),)
+   LOCAL_CFLAGS += -DLOC_LOG_MAX_LEVEL=$(LOC_LOG_MAX_LEVEL)
+endif
+
 LOCAL_C_INCLUDES:= \
     $(TARGET_OUT_HEADERS)/gps.utils \
     $(TARGET_OUT_HEADERS)/libloc_core \
@@ -77,6 +89,17 @@ LOCAL_CFLAGS += \
      -D_ANDROID_ \
      -Wno-unused-parameter
 
+ifeq ($(TARGET_BUILD_VARIANT),user)
+   LOCAL_CFLAGS += -DTARGET_BUILD_VARIANT_USER
+endif
+
+## Logs above this DEBUG_LEVEL are compiled out, see log_util.h;
+## GPS_LOG_MAX_LEVEL_<module> overrides GPS_LOG_MAX_LEVEL for one module
+LOC_LOG_MAX_LEVEL := $(firstword $(GPS_LOG_MAX_LEVEL_$(LOCAL_MODULE)) $(GPS_LOG_MAX_LEVEL))
+ifneq ($(LOC_LOG_MAX_LEVEL),)
+   LOCAL_CFLAGS += -DLOC_LOG_MAX_LEVEL=$(LOC_LOG_MAX_LEVEL)
+endif
+
 ## Includes
 LOCAL_C_INCLUDES:= \
     $(TARGET_OUT_HEADERS)/gps.utils \
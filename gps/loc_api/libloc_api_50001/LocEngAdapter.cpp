@@ -349,12 +349,18 @@ void LocInternalAdapter::reportPosition(UlpLocation &location,
                                         enum loc_sess_status status,
                                         LocPosTechMask loc_technology_mask)
 {
-    sendMsg(new LocEngReportPosition(mLocEngAdapter,
-                                     location,
-                                     locationExtended,
-                                     locationExt,
-                                     status,
-                                     loc_technology_mask));
+    LocPositionReport* report =
+        LocPositionReport::create(location, locationExtended, locationExt,
+                                  status, loc_technology_mask);
+    if (NULL != report) {
+        reportPositionReport(report);
+        report->drop();
+    }
+}
+
+void LocInternalAdapter::reportPositionReport(LocPositionReport* report)
+{
+    sendMsg(new LocEngReportPosition(mLocEngAdapter, report));
 }
 
 
@@ -377,6 +383,17 @@ void LocEngAdapter::reportPosition(UlpLocation &location,
     }
 }
 
+void LocEngAdapter::reportPositionReport(LocPositionReport* report)
+{
+    if (! mUlp->reportPosition(report->mLocation,
+                               report->mLocationExtended,
+                               report->mLocationExt,
+                               report->mStatus,
+                               report->mTechMask)) {
+        mInternalAdapter->reportPositionReport(report);
+    }
+}
+
 void LocInternalAdapter::reportSv(HaxxSvStatus &svStatus,
                                   GpsLocationExtended &locationExtended,
                                   void* svExt){
@@ -590,6 +607,12 @@ void LocEngAdapter::updateRegistrationMask(LOC_API_ADAPTER_EVENT_MASK_T event,
     result = mLocApi->updateRegistrationMask(event, isEnabled);
     if (result == LOC_API_ADAPTER_ERR_SUCCESS) {
         LOC_LOGD("%s] update registration mask succeed.", __func__);
+        // the events are dispatched per the event mask of the adapter, so
+        // keep it in line with what is registered; a later open() then
+        // also registers them again
+        mEvtMask = (isEnabled == LOC_REGISTRATION_MASK_ENABLED) ?
+            (mEvtMask | event) : (mEvtMask & ~event);
+        mLocApi->updateEvtSubscribers();
     } else {
         LOC_LOGE("%s] update registration mask failed.", __func__);
     }
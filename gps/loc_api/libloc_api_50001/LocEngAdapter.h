@@ -55,6 +55,7 @@ public:
                                 void* locationExt,
                                 enum loc_sess_status status,
                                 LocPosTechMask loc_technology_mask);
+    virtual void reportPositionReport(LocPositionReport* report);
     virtual void reportSv(HaxxSvStatus &svStatus,
                           GpsLocationExtended &locationExtended,
                           void* svExt);
@@ -107,6 +108,9 @@ public:
         return mContext->hasCPIExtendedCapabilities();
     }
     inline const MsgTask* getMsgTask() { return mMsgTask; }
+    inline bool recordEvents(const char* path) {
+        return mLocApi->recordEvents(path);
+    }
 
     inline enum loc_api_adapter_err
         startFix()
@@ -270,6 +274,7 @@ public:
                                 void* locationExt,
                                 enum loc_sess_status status,
                                 LocPosTechMask loc_technology_mask);
+    virtual void reportPositionReport(LocPositionReport* report);
     virtual void reportSv(HaxxSvStatus &svStatus,
                           GpsLocationExtended &locationExtended,
                           void* svExt);
@@ -178,6 +178,26 @@ static const GnssConfigurationInterface sLocEngConfigInterface =
     loc_configuration_update
 };
 
+static void loc_geofence_init(GpsGeofenceCallbacks* callbacks);
+static void loc_geofence_add(int32_t geofence_id, double latitude,
+                             double longitude, double radius_meters,
+                             int last_transition, int monitor_transitions,
+                             int notification_responsiveness_ms,
+                             int unknown_timer_ms);
+static void loc_geofence_pause(int32_t geofence_id);
+static void loc_geofence_resume(int32_t geofence_id, int monitor_transitions);
+static void loc_geofence_remove(int32_t geofence_id);
+
+static const GpsGeofencingInterface sLocEngGeofenceInterface =
+{
+    sizeof(GpsGeofencingInterface),
+    loc_geofence_init,
+    loc_geofence_add,
+    loc_geofence_pause,
+    loc_geofence_resume,
+    loc_geofence_remove
+};
+
 static loc_eng_data_s_type loc_afw_data;
 static int gss_fd = -1;
 static int sGnssType = GNSS_UNKNOWN;
@@ -579,9 +599,73 @@ const GpsGeofencingInterface* get_geofence_interface(void)
     geofence_interface = get_gps_geofence_interface();
 
 exit:
+    if (NULL == geofence_interface && gps_conf.GEOFENCE_FALLBACK) {
+        // fall back to the fences of loc_eng, if asked for; they are
+        // only checked while a session runs
+        geofence_interface = &sLocEngGeofenceInterface;
+    }
     EXIT_LOG(%d, geofence_interface == NULL);
     return geofence_interface;
 }
+
+/*===========================================================================
+FUNCTION    loc_geofence_init / add / pause / resume / remove
+
+DESCRIPTION
+   GpsGeofencingInterface of loc_eng, for when there is no libgeofence
+   and GEOFENCE_FALLBACK is set in gps.conf. The fences are evaluated
+   against the fixes of the tracking sessions only, none are started for
+   them; notification_responsiveness_ms and unknown_timer_ms are not used.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None; the results come with the callbacks
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_geofence_init(GpsGeofenceCallbacks* callbacks)
+{
+    ENTRY_LOG();
+    loc_eng_geofence_init(loc_afw_data, callbacks);
+    EXIT_LOG(%s, VOID_RET);
+}
+
+static void loc_geofence_add(int32_t geofence_id, double latitude,
+                             double longitude, double radius_meters,
+                             int last_transition, int monitor_transitions,
+                             int notification_responsiveness_ms,
+                             int unknown_timer_ms)
+{
+    ENTRY_LOG();
+    loc_eng_geofence_add(loc_afw_data, geofence_id, latitude, longitude,
+                         radius_meters, last_transition, monitor_transitions);
+    EXIT_LOG(%s, VOID_RET);
+}
+
+static void loc_geofence_pause(int32_t geofence_id)
+{
+    ENTRY_LOG();
+    loc_eng_geofence_pause(loc_afw_data, geofence_id);
+    EXIT_LOG(%s, VOID_RET);
+}
+
+static void loc_geofence_resume(int32_t geofence_id, int monitor_transitions)
+{
+    ENTRY_LOG();
+    loc_eng_geofence_resume(loc_afw_data, geofence_id, monitor_transitions);
+    EXIT_LOG(%s, VOID_RET);
+}
+
+static void loc_geofence_remove(int32_t geofence_id)
+{
+    ENTRY_LOG();
+    loc_eng_geofence_remove(loc_afw_data, geofence_id);
+    EXIT_LOG(%s, VOID_RET);
+}
 /*===========================================================================
 FUNCTION    loc_get_extension
 
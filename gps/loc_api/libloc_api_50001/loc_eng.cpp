@@ -67,6 +67,9 @@
 #include <loc_eng_msg.h>
 #include <loc_eng_nmea.h>
 #include <msg_q.h>
+#include <LocExecutor.h>
+#include <LocMsgTrace.h>
+#include <LocTimer.h>
 #include <loc.h>
 #include "log_util.h"
 #include "platform_lib_includes.h"
@@ -110,6 +113,26 @@ static const loc_param_s_type gps_conf_table[] =
   {"XTRA_SERVER_2",                  &gps_conf.XTRA_SERVER_2,                  NULL, 's'},
   {"XTRA_SERVER_3",                  &gps_conf.XTRA_SERVER_3,                  NULL, 's'},
   {"USE_EMERGENCY_PDN_FOR_EMERGENCY_SUPL",  &gps_conf.USE_EMERGENCY_PDN_FOR_EMERGENCY_SUPL,          NULL, 'n'},
+  {"NMEA_SENTENCE_MASK",             &gps_conf.NMEA_SENTENCE_MASK,             NULL, 'n'},
+  {"NMEA_GGA_INTERVAL",              &gps_conf.NMEA_GGA_INTERVAL,              NULL, 'n'},
+  {"NMEA_RMC_INTERVAL",              &gps_conf.NMEA_RMC_INTERVAL,              NULL, 'n'},
+  {"NMEA_GSA_INTERVAL",              &gps_conf.NMEA_GSA_INTERVAL,              NULL, 'n'},
+  {"NMEA_VTG_INTERVAL",              &gps_conf.NMEA_VTG_INTERVAL,              NULL, 'n'},
+  {"NMEA_GSV_INTERVAL",              &gps_conf.NMEA_GSV_INTERVAL,              NULL, 'n'},
+  {"WORKER_THREAD_CPU_MASK",         &gps_conf.WORKER_THREAD_CPU_MASK,         NULL, 'n'},
+  {"WORKER_THREAD_NICE",             &gps_conf.WORKER_THREAD_NICE,             NULL, 'n'},
+  {"WORKER_THREAD_FIFO_PRIORITY",    &gps_conf.WORKER_THREAD_FIFO_PRIORITY,    NULL, 'n'},
+  {"HAL_THREAD_CPU_MASK",            &gps_conf.HAL_THREAD_CPU_MASK,            NULL, 'n'},
+  {"HAL_THREAD_NICE",                &gps_conf.HAL_THREAD_NICE,                NULL, 'n'},
+  {"HAL_THREAD_FIFO_PRIORITY",       &gps_conf.HAL_THREAD_FIFO_PRIORITY,       NULL, 'n'},
+  {"FIX_LATENCY_REPORT_INTERVAL",    &gps_conf.FIX_LATENCY_REPORT_INTERVAL,    NULL, 'n'},
+  {"MSG_TASK_TRACE",                 &gps_conf.MSG_TASK_TRACE,                 NULL, 'n'},
+  {"MSG_TASK_RING_CAPACITY",         &gps_conf.MSG_TASK_RING_CAPACITY,         NULL, 'n'},
+  {"MSG_TASK_BATCH_SIZE",            &gps_conf.MSG_TASK_BATCH_SIZE,            NULL, 'n'},
+  {"FIX_BATCH_SIZE",                 &gps_conf.FIX_BATCH_SIZE,                 NULL, 'n'},
+  {"FIX_BATCH_TIMEOUT",              &gps_conf.FIX_BATCH_TIMEOUT,              NULL, 'n'},
+  {"MODEM_EVENT_TRACE_FILE",         &gps_conf.MODEM_EVENT_TRACE_FILE,         NULL, 's'},
+  {"GEOFENCE_FALLBACK",              &gps_conf.GEOFENCE_FALLBACK,              NULL, 'n'},
 };
 
 static const loc_param_s_type sap_conf_table[] =
@@ -133,12 +156,44 @@ static const loc_param_s_type sap_conf_table[] =
   {"SENSOR_PROVIDER",                &sap_conf.SENSOR_PROVIDER,                NULL, 'n'}
 };
 
+/* The values gps.conf and sap.conf had when last read; a reload compares
+   with these rather than with gps_conf and sap_conf, which the HAL changes
+   in memory, e.g. CAPABILITIES */
+static loc_gps_cfg_s_type gps_conf_file;
+static loc_sap_cfg_s_type sap_conf_file;
+
 static void loc_default_parameters(void)
 {
    /*Defaults for gps.conf*/
    gps_conf.INTERMEDIATE_POS = 0;
    gps_conf.ACCURACY_THRES = 0;
    gps_conf.NMEA_PROVIDER = 0;
+   /*All NMEA sentences, each with every report*/
+   gps_conf.NMEA_SENTENCE_MASK = LOC_NMEA_MASK_ALL;
+   gps_conf.NMEA_GGA_INTERVAL = 0;
+   gps_conf.NMEA_RMC_INTERVAL = 0;
+   gps_conf.NMEA_GSA_INTERVAL = 0;
+   gps_conf.NMEA_VTG_INTERVAL = 0;
+   gps_conf.NMEA_GSV_INTERVAL = 0;
+   /*Location threads keep the scheduling they are created with*/
+   gps_conf.WORKER_THREAD_CPU_MASK = 0;
+   gps_conf.WORKER_THREAD_NICE = 0;
+   gps_conf.WORKER_THREAD_FIFO_PRIORITY = 0;
+   gps_conf.HAL_THREAD_CPU_MASK = 0;
+   gps_conf.HAL_THREAD_NICE = 0;
+   gps_conf.HAL_THREAD_FIFO_PRIORITY = 0;
+   gps_conf.FIX_LATENCY_REPORT_INTERVAL = 0;
+   gps_conf.MSG_TASK_TRACE = 0;
+   /*Message queues are locked lists*/
+   gps_conf.MSG_TASK_RING_CAPACITY = 0;
+   gps_conf.MSG_TASK_BATCH_SIZE = MSG_TASK_DEFAULT_BATCH;
+   /*Fixes are delivered as they come*/
+   gps_conf.FIX_BATCH_SIZE = 1;
+   gps_conf.FIX_BATCH_TIMEOUT = 1000;
+   /*Modem events are not recorded*/
+   gps_conf.MODEM_EVENT_TRACE_FILE[0] = '\0';
+   /*No geofences of the HAL without libgeofence*/
+   gps_conf.GEOFENCE_FALLBACK = 0;
    gps_conf.GPS_LOCK = 0;
    gps_conf.SUPL_VER = 0x10000;
    gps_conf.SUPL_MODE = 0x3;
@@ -184,10 +239,29 @@ static void loc_default_parameters(void)
    gps_conf.AGPS_CERT_WRITABLE_MASK = 0;
 }
 
+/* Hands the thread scheduling from gps.conf to LocThread, which
+   applies it to the threads as they start */
+static void loc_set_thread_sched(void)
+{
+   LocThreadSched sched;
+
+   sched.mCpuMask = gps_conf.WORKER_THREAD_CPU_MASK;
+   sched.mNice = gps_conf.WORKER_THREAD_NICE;
+   sched.mFifoPriority = gps_conf.WORKER_THREAD_FIFO_PRIORITY;
+   LocThread::setSched(LOC_EXECUTOR_DEFAULT_NAME, sched);
+
+   sched.mCpuMask = gps_conf.HAL_THREAD_CPU_MASK;
+   sched.mNice = gps_conf.HAL_THREAD_NICE;
+   sched.mFifoPriority = gps_conf.HAL_THREAD_FIFO_PRIORITY;
+   LocThread::setSched(LocDualContext::mLocationHalName, sched);
+}
+
 // 2nd half of init(), singled out for
 // modem restart to use.
 static int loc_eng_reinit(loc_eng_data_s_type &loc_eng_data);
 static void loc_eng_agps_reinit(loc_eng_data_s_type &loc_eng_data);
+// to apply changes of the conf files while running
+static void loc_eng_watch_conf(loc_eng_data_s_type &loc_eng_data);
 
 static int loc_eng_set_server(loc_eng_data_s_type &loc_eng_data,
                               LocServerType type, const char *hostname, int port);
@@ -722,30 +796,242 @@ struct LocEngExtPowerConfig : public LocMsg {
     }
 };
 
+/* Latency of fixes, from the modem report to location_cb, over the
+   last FIX_LATENCY_REPORT_INTERVAL fixes. Only updated as fixes are
+   delivered, which happens on the one MsgTask */
+struct loc_fix_latency_s {
+    uint32_t count;
+    uint64_t sumUs;
+    uint64_t sumSqUs;
+    uint64_t minUs;
+    uint64_t maxUs;
+};
+static loc_fix_latency_s fix_latency;
+
+static void loc_eng_fix_latency_update(uint64_t sendTimeNs)
+{
+    if (0 == gps_conf.FIX_LATENCY_REPORT_INTERVAL || 0 == sendTimeNs) {
+        return;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t nowNs = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    uint64_t latencyUs = (nowNs - sendTimeNs) / 1000;
+
+    if (0 == fix_latency.count || latencyUs < fix_latency.minUs) {
+        fix_latency.minUs = latencyUs;
+    }
+    if (latencyUs > fix_latency.maxUs) {
+        fix_latency.maxUs = latencyUs;
+    }
+    fix_latency.sumUs += latencyUs;
+    fix_latency.sumSqUs += latencyUs * latencyUs;
+
+    if (++fix_latency.count >= gps_conf.FIX_LATENCY_REPORT_INTERVAL) {
+        double mean = (double)fix_latency.sumUs / fix_latency.count;
+        double var = (double)fix_latency.sumSqUs / fix_latency.count - mean * mean;
+        LOC_LOGI("fix latency over %u fixes: mean %.0f us, min %llu us, "
+                 "max %llu us, jitter %.0f us", fix_latency.count, mean,
+                 (unsigned long long)fix_latency.minUs,
+                 (unsigned long long)fix_latency.maxUs,
+                 var > 0 ? sqrt(var) : 0);
+        memset(&fix_latency, 0, sizeof(fix_latency));
+    }
+}
+
+/* Delivers a fix to location_cb */
+static void loc_eng_deliver_fix(loc_eng_data_s_type &loc_eng_data,
+                                LocPositionReport* report,
+                                void* location_ext, uint64_t send_time)
+{
+    loc_eng_fix_latency_update(send_time);
+    loc_eng_data.location_cb(&report->mLocation, location_ext);
+}
+
+/* Whether the fixes of the current session are batched. Not with a
+   location_ext_parser: what it makes of a fix is only good during the
+   report, and would be gone by the time the batch is delivered. */
+static bool loc_eng_batching(loc_eng_data_s_type &loc_eng_data)
+{
+    return gps_conf.FIX_BATCH_SIZE > 1 &&
+        noProc == loc_eng_data.location_ext_parser &&
+        GPS_POSITION_RECURRENCE_SINGLE !=
+        loc_eng_data.adapter->getPositionMode().recurrence;
+}
+
+static void loc_eng_flush_fixes(loc_eng_data_s_type &loc_eng_data);
+
+//        case LOC_ENG_MSG_FLUSH_FIXES:
+struct LocEngFlushFixes : public LocMsg {
+    loc_eng_data_s_type* mLocEng;
+    const uint32_t mGeneration;
+    inline LocEngFlushFixes(loc_eng_data_s_type* locEng,
+                            uint32_t generation) :
+        LocMsg(), mLocEng(locEng), mGeneration(generation)
+    {
+        locallog();
+    }
+    inline virtual void proc() const {
+        // the batch timed out, unless it was flushed since
+        if (mGeneration == mLocEng->fix_batch.generation) {
+            loc_eng_flush_fixes(*mLocEng);
+        }
+    }
+    inline virtual LocMsgPriority priority() const {
+        return LOC_MSG_PRIORITY_HIGH;
+    }
+    inline void locallog() const {
+        LOC_LOGV("LocEngFlushFixes - generation: %u", mGeneration);
+    }
+    inline virtual void log() const {
+        locallog();
+    }
+};
+
+// times out the oldest fix of a batch
+class LocEngFixBatchTimer : public LocTimer {
+    loc_eng_data_s_type* mLocEng;
+    volatile uint32_t mGeneration;
+public:
+    inline LocEngFixBatchTimer(loc_eng_data_s_type* locEng) :
+        LocTimer(), mLocEng(locEng), mGeneration(0) {}
+    inline bool start(uint32_t generation, uint32_t timeOutInMs) {
+        mGeneration = generation;
+        return LocTimer::start(timeOutInMs, false);
+    }
+    inline virtual void timeOutCallback() {
+        mLocEng->adapter->sendMsg(new LocEngFlushFixes(mLocEng, mGeneration));
+    }
+};
+
+/*===========================================================================
+FUNCTION    loc_eng_flush_fixes
+
+DESCRIPTION
+   Delivers the fixes held back in the batch to location_cb, oldest first,
+   and gives them back to the pool.
+
+DEPENDENCIES
+   Runs on the adapter's MsgTask
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_flush_fixes(loc_eng_data_s_type &loc_eng_data)
+{
+    loc_eng_fix_batch_s_type &batch = loc_eng_data.fix_batch;
+    if (0 == batch.count) {
+        return;
+    }
+
+    batch.generation++;
+    if (NULL != batch.timer) {
+        batch.timer->stop();
+    }
+    batch.flushes++;
+    while (batch.count > 0) {
+        loc_eng_batched_fix_s_type &fix = batch.fixes[batch.head];
+        if (NULL != loc_eng_data.location_cb) {
+            loc_eng_deliver_fix(loc_eng_data, fix.report, NULL, fix.send_time);
+        }
+        batch.batched++;
+        fix.report->drop();
+        fix.report = NULL;
+        batch.head = (batch.head + 1) % LOC_FIX_BATCH_MAX;
+        batch.count--;
+    }
+}
+
+/* Delivers what is left of the batch as the session ends, and logs how
+   many fixes the session batched in how many go's */
+static void loc_eng_fix_batch_session_end(loc_eng_data_s_type &loc_eng_data)
+{
+    loc_eng_fix_batch_s_type &batch = loc_eng_data.fix_batch;
+    loc_eng_flush_fixes(loc_eng_data);
+    if (batch.flushes > 0) {
+        LOC_LOGD("%s: %u fixes delivered in %u batches",
+                 __func__, batch.batched, batch.flushes);
+    }
+    batch.batched = 0;
+    batch.flushes = 0;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_batch_fix
+
+DESCRIPTION
+   Holds a fix back in the batch, and delivers the batch if it is full.
+   The batch keeps a share of report.
+
+DEPENDENCIES
+   Runs on the adapter's MsgTask
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_batch_fix(loc_eng_data_s_type &loc_eng_data,
+                              LocPositionReport* report, uint64_t send_time)
+{
+    loc_eng_fix_batch_s_type &batch = loc_eng_data.fix_batch;
+    uint32_t size = gps_conf.FIX_BATCH_SIZE < LOC_FIX_BATCH_MAX ?
+        gps_conf.FIX_BATCH_SIZE : LOC_FIX_BATCH_MAX;
+
+    loc_eng_batched_fix_s_type &fix =
+        batch.fixes[(batch.head + batch.count) % LOC_FIX_BATCH_MAX];
+    fix.report = report->share();
+    fix.send_time = send_time;
+    batch.count++;
+
+    if (batch.count >= size) {
+        loc_eng_flush_fixes(loc_eng_data);
+    } else if (1 == batch.count && NULL != batch.timer &&
+               gps_conf.FIX_BATCH_TIMEOUT > 0) {
+        batch.timer->start(batch.generation, gps_conf.FIX_BATCH_TIMEOUT);
+    }
+}
+
 //        case LOC_ENG_MSG_REPORT_POSITION:
 LocEngReportPosition::LocEngReportPosition(LocAdapterBase* adapter,
-                                           UlpLocation &loc,
-                                           GpsLocationExtended &locExtended,
-                                           void* locExt,
-                                           enum loc_sess_status st,
-                                           LocPosTechMask technology) :
-    LocMsg(), mAdapter(adapter), mLocation(loc),
-    mLocationExtended(locExtended),
+                                           LocPositionReport* report) :
+    LocMsg(), mAdapter(adapter), mReport(report->share()),
+    mLocation(report->mLocation),
+    mLocationExtended(report->mLocationExtended),
+    // locationExt is only good for the duration of the report call
     mLocationExt(((loc_eng_data_s_type*)
                   ((LocEngAdapter*)
-                   (mAdapter))->getOwner())->location_ext_parser(locExt)),
-    mStatus(st), mTechMask(technology)
+                   (mAdapter))->getOwner())->location_ext_parser(
+                                                report->mLocationExt)),
+    mStatus(report->mStatus), mTechMask(report->mTechMask)
 {
     locallog();
 }
+LocEngReportPosition::~LocEngReportPosition() {
+    mReport->drop();
+}
 void LocEngReportPosition::proc() const {
     LocEngAdapter* adapter = (LocEngAdapter*)mAdapter;
     loc_eng_data_s_type* locEng = (loc_eng_data_s_type*)adapter->getOwner();
 
+    // fences are evaluated whether or not the session is muted
+    if (LOC_SESS_FAILURE != mStatus) {
+        loc_eng_geofence_report(*locEng, mLocation);
+    }
+
     if (locEng->mute_session_state != LOC_MUTE_SESS_IN_SESSION) {
         bool reported = false;
         if (locEng->location_cb != NULL) {
             if (LOC_SESS_FAILURE == mStatus) {
+                // what was batched goes before the failure
+                loc_eng_flush_fixes(*locEng);
                 // in case we want to handle the failure case
                 locEng->location_cb(NULL, NULL);
                 reported = true;
@@ -771,8 +1057,14 @@ void LocEngReportPosition::proc() const {
                         (gps_conf.ACCURACY_THRES != 0) &&
                         (mLocation.gpsLocation.accuracy >
                          gps_conf.ACCURACY_THRES)))) {
-                locEng->location_cb((UlpLocation*)&(mLocation),
-                                    (void*)mLocationExt);
+                if (loc_eng_batching(*locEng)) {
+                    loc_eng_batch_fix(*locEng, mReport, mSendTime);
+                } else {
+                    // in order, after what may be left of a batch
+                    loc_eng_flush_fixes(*locEng);
+                    loc_eng_deliver_fix(*locEng, mReport,
+                                        (void*)mLocationExt, mSendTime);
+                }
                 reported = true;
             }
         }
@@ -804,15 +1096,6 @@ void LocEngReportPosition::proc() const {
             loc_eng_nmea_generate_pos(locEng, mLocation, mLocationExtended,
                                       generate_nmea);
         }
-
-        // Free the allocated memory for rawData
-        UlpLocation* gp = (UlpLocation*)&(mLocation);
-        if (gp != NULL && gp->rawData != NULL)
-        {
-            delete (char*)gp->rawData;
-            gp->rawData = NULL;
-            gp->rawDataSize = 0;
-        }
     }
 }
 void LocEngReportPosition::locallog() const {
@@ -1387,6 +1670,10 @@ struct LocEngInit : public LocMsg {
     inline virtual void proc() const {
         loc_eng_reinit(*mLocEng);
         mLocEng->adapter->setGpsLock(1);
+        mLocEng->adapter->getMsgTask()->setMaxBatch(gps_conf.MSG_TASK_BATCH_SIZE);
+        if ('\0' != gps_conf.MODEM_EVENT_TRACE_FILE[0]) {
+            mLocEng->adapter->recordEvents(gps_conf.MODEM_EVENT_TRACE_FILE);
+        }
         // set the capabilities
         mLocEng->adapter->sendMsg(new LocEngSetCapabilities(mLocEng));
     }
@@ -1755,25 +2042,16 @@ int loc_eng_init(loc_eng_data_s_type &loc_eng_data, LocCallbacks* callbacks,
 
     LOC_LOGD("loc_eng_init created client, id = %p\n",
              loc_eng_data.adapter);
+    loc_eng_data.fix_batch.timer = new LocEngFixBatchTimer(&loc_eng_data);
     loc_eng_data.adapter->sendMsg(new LocEngInit(&loc_eng_data));
+    loc_eng_watch_conf(loc_eng_data);
 
     EXIT_LOG(%d, ret_val);
     return ret_val;
 }
 
-static int loc_eng_reinit(loc_eng_data_s_type &loc_eng_data)
+static void loc_eng_send_sensor_properties(LocEngAdapter* adapter)
 {
-    ENTRY_LOG();
-    int ret_val = LOC_API_ADAPTER_ERR_SUCCESS;
-    LocEngAdapter* adapter = loc_eng_data.adapter;
-
-    adapter->sendMsg(new LocEngGnssConstellationConfig(adapter));
-    adapter->sendMsg(new LocEngSuplVer(adapter, gps_conf.SUPL_VER));
-    adapter->sendMsg(new LocEngLppConfig(adapter, gps_conf.LPP_PROFILE));
-    adapter->sendMsg(new LocEngSensorControlConfig(adapter, sap_conf.SENSOR_USAGE,
-                                                   sap_conf.SENSOR_PROVIDER));
-    adapter->sendMsg(new LocEngAGlonassProtocol(adapter, gps_conf.A_GLONASS_POS_PROTOCOL_SELECT));
-
     /* Make sure at least one of the sensor property is specified by the user in the gps.conf file. */
     if( sap_conf.GYRO_BIAS_RANDOM_WALK_VALID ||
         sap_conf.ACCEL_RANDOM_WALK_SPECTRAL_DENSITY_VALID ||
@@ -1792,7 +2070,10 @@ static int loc_eng_reinit(loc_eng_data_s_type &loc_eng_data)
                                                     sap_conf.VELOCITY_RANDOM_WALK_SPECTRAL_DENSITY_VALID,
                                                     sap_conf.VELOCITY_RANDOM_WALK_SPECTRAL_DENSITY));
     }
+}
 
+static void loc_eng_send_sensor_perf_config(LocEngAdapter* adapter)
+{
     adapter->sendMsg(new LocEngSensorPerfControlConfig(adapter,
                                                        sap_conf.SENSOR_CONTROL_MODE,
                                                        sap_conf.SENSOR_ACCEL_SAMPLES_PER_BATCH,
@@ -1804,6 +2085,23 @@ static int loc_eng_reinit(loc_eng_data_s_type &loc_eng_data)
                                                        sap_conf.SENSOR_GYRO_SAMPLES_PER_BATCH_HIGH,
                                                        sap_conf.SENSOR_GYRO_BATCHES_PER_SEC_HIGH,
                                                        sap_conf.SENSOR_ALGORITHM_CONFIG_MASK));
+}
+
+static int loc_eng_reinit(loc_eng_data_s_type &loc_eng_data)
+{
+    ENTRY_LOG();
+    int ret_val = LOC_API_ADAPTER_ERR_SUCCESS;
+    LocEngAdapter* adapter = loc_eng_data.adapter;
+
+    adapter->sendMsg(new LocEngGnssConstellationConfig(adapter));
+    adapter->sendMsg(new LocEngSuplVer(adapter, gps_conf.SUPL_VER));
+    adapter->sendMsg(new LocEngLppConfig(adapter, gps_conf.LPP_PROFILE));
+    adapter->sendMsg(new LocEngSensorControlConfig(adapter, sap_conf.SENSOR_USAGE,
+                                                   sap_conf.SENSOR_PROVIDER));
+    adapter->sendMsg(new LocEngAGlonassProtocol(adapter, gps_conf.A_GLONASS_POS_PROTOCOL_SELECT));
+
+    loc_eng_send_sensor_properties(adapter);
+    loc_eng_send_sensor_perf_config(adapter);
 
     adapter->sendMsg(new LocEngEnableData(adapter, NULL, 0, (agpsStatus ? 1:0)));
 
@@ -1837,6 +2135,11 @@ void loc_eng_cleanup(loc_eng_data_s_type &loc_eng_data)
 
     // XTRA has no state, so we are fine with it.
 
+    if (NULL != loc_eng_data.conf_watcher) {
+        loc_eng_data.conf_watcher->destroy();
+        loc_eng_data.conf_watcher = NULL;
+    }
+
     // we need to check and clear NI
 #if 0
     // we need to check and clear ATL
@@ -1956,6 +2259,8 @@ static int loc_eng_stop_handler(loc_eng_data_s_type &loc_eng_data)
    ENTRY_LOG();
    int ret_val = LOC_API_ADAPTER_ERR_SUCCESS;
 
+   // the fixes held back still go out, ahead of the session end
+   loc_eng_fix_batch_session_end(loc_eng_data);
    if (loc_eng_data.adapter->isInSession()) {
        ret_val = loc_eng_data.adapter->stopFix();
        loc_eng_data.adapter->setInSession(FALSE);
@@ -2687,6 +2992,25 @@ int loc_eng_agps_install_certificates(loc_eng_data_s_type &loc_eng_data,
     return ret_val;
 }
 
+/* Sends the engine the gps.conf parameters that differ from old_conf */
+static void loc_eng_send_gps_conf_changes(LocEngAdapter* adapter,
+                                          const loc_gps_cfg_s_type &old_conf)
+{
+    if (old_conf.SUPL_VER != gps_conf.SUPL_VER) {
+        adapter->sendMsg(new LocEngSuplVer(adapter, gps_conf.SUPL_VER));
+    }
+    if (old_conf.LPP_PROFILE != gps_conf.LPP_PROFILE) {
+        adapter->sendMsg(new LocEngLppConfig(adapter, gps_conf.LPP_PROFILE));
+    }
+    if (old_conf.A_GLONASS_POS_PROTOCOL_SELECT != gps_conf.A_GLONASS_POS_PROTOCOL_SELECT) {
+        adapter->sendMsg(new LocEngAGlonassProtocol(adapter,
+                                                    gps_conf.A_GLONASS_POS_PROTOCOL_SELECT));
+    }
+    if (old_conf.SUPL_MODE != gps_conf.SUPL_MODE) {
+        adapter->sendMsg(new LocEngSuplMode(adapter->getUlpProxy()));
+    }
+}
+
 void loc_eng_configuration_update (loc_eng_data_s_type &loc_eng_data,
                                    const char* config_data, int32_t length)
 {
@@ -2699,19 +3023,7 @@ void loc_eng_configuration_update (loc_eng_data_s_type &loc_eng_data,
 
         // it is possible that HAL is not init'ed at this time
         if (adapter) {
-            if (gps_conf_tmp.SUPL_VER != gps_conf.SUPL_VER) {
-                adapter->sendMsg(new LocEngSuplVer(adapter, gps_conf.SUPL_VER));
-            }
-            if (gps_conf_tmp.LPP_PROFILE != gps_conf.LPP_PROFILE) {
-                adapter->sendMsg(new LocEngLppConfig(adapter, gps_conf.LPP_PROFILE));
-            }
-            if (gps_conf_tmp.A_GLONASS_POS_PROTOCOL_SELECT != gps_conf.A_GLONASS_POS_PROTOCOL_SELECT) {
-                adapter->sendMsg(new LocEngAGlonassProtocol(adapter,
-                                                            gps_conf.A_GLONASS_POS_PROTOCOL_SELECT));
-            }
-            if (gps_conf_tmp.SUPL_MODE != gps_conf.SUPL_MODE) {
-                adapter->sendMsg(new LocEngSuplMode(adapter->getUlpProxy()));
-            }
+            loc_eng_send_gps_conf_changes(adapter, gps_conf_tmp);
         }
 
         gps_conf_tmp.SUPL_VER = gps_conf.SUPL_VER;
@@ -2726,6 +3038,294 @@ void loc_eng_configuration_update (loc_eng_data_s_type &loc_eng_data,
     EXIT_LOG(%s, VOID_RET);
 }
 
+/* gps.conf parameters that take effect as they change in the file, either
+   sent to the engine or read by the HAL as it goes. The others are only
+   read at start, and keep their values until the HAL restarts. */
+static const char* const gps_conf_live_params[] =
+{
+  "SUPL_VER", "LPP_PROFILE", "A_GLONASS_POS_PROTOCOL_SELECT", "SUPL_MODE",
+  "SUPL_ES", "GPS_LOCK", "INTERMEDIATE_POS", "ACCURACY_THRES",
+  "NMEA_SENTENCE_MASK", "NMEA_GGA_INTERVAL", "NMEA_RMC_INTERVAL",
+  "NMEA_GSA_INTERVAL", "NMEA_VTG_INTERVAL", "NMEA_GSV_INTERVAL",
+  "FIX_LATENCY_REPORT_INTERVAL", "MSG_TASK_TRACE", "MSG_TASK_BATCH_SIZE",
+  "FIX_BATCH_SIZE", "FIX_BATCH_TIMEOUT", "MODEM_EVENT_TRACE_FILE"
+};
+
+/* Whether a param of a conf table, which points into conf, differs from its
+   value in old_conf, a copy of conf from before */
+static bool loc_eng_conf_param_changed(const loc_param_s_type &param,
+                                       const void* conf, const void* old_conf)
+{
+    const char* now = (const char*)param.param_ptr;
+    const char* before = (const char*)old_conf + (now - (const char*)conf);
+    switch (param.param_type) {
+    case 's':
+        return strcmp(now, before) != 0;
+    case 'f':
+        return memcmp(now, before, sizeof(double)) != 0;
+    default:
+        return memcmp(now, before, sizeof(uint32_t)) != 0;
+    }
+}
+
+/* Sets a param of a conf table, which points into conf, to its value in
+   from, a struct of the same type */
+static void loc_eng_conf_param_copy(const loc_param_s_type &param,
+                                    const void* conf, const void* from)
+{
+    char* now = (char*)param.param_ptr;
+    const char* value = (const char*)from + (now - (const char*)conf);
+    switch (param.param_type) {
+    case 's':
+        memcpy(now, value, strlen(value) + 1);
+        break;
+    case 'f':
+        memcpy(now, value, sizeof(double));
+        break;
+    default:
+        memcpy(now, value, sizeof(uint32_t));
+    }
+}
+
+/* Copies a conf table, which points into conf, to scratch_table, pointed
+   at scratch, a struct of the same type, so that a file can be read into
+   scratch without touching conf */
+static void loc_eng_conf_table_rebase(const loc_param_s_type* table, uint32_t length,
+                                      const void* conf, void* scratch,
+                                      loc_param_s_type* scratch_table)
+{
+    for (uint32_t i = 0; i < length; i++) {
+        scratch_table[i] = table[i];
+        scratch_table[i].param_ptr =
+            (char*)scratch + ((const char*)table[i].param_ptr - (const char*)conf);
+        if (NULL != table[i].param_set) {
+            scratch_table[i].param_set =
+                (uint8_t*)scratch + (table[i].param_set - (const uint8_t*)conf);
+        }
+    }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_reload_gps_conf
+
+DESCRIPTION
+   Re-reads gps.conf after it changed, and applies only the parameters
+   that changed: those the engine takes are sent to it, those the HAL reads
+   as it goes take effect from now on. The others keep their old values.
+   Parameters removed from the file keep their current values.
+   The file is read into a scratch copy, and only the live parameters are
+   copied from it into gps_conf, which other threads read meanwhile.
+
+DEPENDENCIES
+   Runs on the adapter's MsgTask
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_reload_gps_conf(loc_eng_data_s_type &loc_eng_data)
+{
+    ENTRY_LOG();
+    const uint32_t count = sizeof(gps_conf_table) / sizeof(gps_conf_table[0]);
+    loc_param_s_type file_table[count];
+    loc_gps_cfg_s_type file_conf = gps_conf_file;
+    loc_gps_cfg_s_type old_conf = gps_conf;
+
+    loc_eng_conf_table_rebase(gps_conf_table, count, &gps_conf, &file_conf, file_table);
+    UTIL_RELOAD_CONF(GPS_CONF_FILE, file_table);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const loc_param_s_type &param = file_table[i];
+        if (!loc_eng_conf_param_changed(param, &file_conf, &gps_conf_file)) {
+            continue;
+        }
+
+        bool live = false;
+        for (uint32_t j = 0;
+             !live && j < sizeof(gps_conf_live_params) / sizeof(gps_conf_live_params[0]);
+             j++) {
+            live = (0 == strcmp(param.param_name, gps_conf_live_params[j]));
+        }
+        if (live) {
+            LOC_LOGI("%s: %s changed", __func__, param.param_name);
+            loc_eng_conf_param_copy(gps_conf_table[i], &gps_conf, &file_conf);
+        } else {
+            LOC_LOGW("%s: %s changed, takes effect after restart",
+                     __func__, param.param_name);
+        }
+    }
+    gps_conf_file = file_conf;
+
+    loc_eng_send_gps_conf_changes(loc_eng_data.adapter, old_conf);
+    if (old_conf.INTERMEDIATE_POS != gps_conf.INTERMEDIATE_POS) {
+        loc_eng_data.intermediateFix = gps_conf.INTERMEDIATE_POS;
+    }
+    /* what is batched was batched by the old thresholds */
+    if (old_conf.FIX_BATCH_SIZE != gps_conf.FIX_BATCH_SIZE ||
+        old_conf.FIX_BATCH_TIMEOUT != gps_conf.FIX_BATCH_TIMEOUT) {
+        loc_eng_flush_fixes(loc_eng_data);
+    }
+    /* any write of gps.conf dumps what was traced up to now, so a touch
+       of the file dumps on demand */
+    if (old_conf.MSG_TASK_TRACE) {
+        LocMsgTrace::dump();
+    }
+    LocMsgTrace::enable(gps_conf.MSG_TASK_TRACE);
+    if (old_conf.MSG_TASK_BATCH_SIZE != gps_conf.MSG_TASK_BATCH_SIZE) {
+        loc_eng_data.adapter->getMsgTask()->setMaxBatch(gps_conf.MSG_TASK_BATCH_SIZE);
+    }
+    /* a new trace each time the file name changes */
+    if (0 != strcmp(old_conf.MODEM_EVENT_TRACE_FILE, gps_conf.MODEM_EVENT_TRACE_FILE)) {
+        loc_eng_data.adapter->recordEvents(gps_conf.MODEM_EVENT_TRACE_FILE);
+    }
+    EXIT_LOG(%s, VOID_RET);
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_reload_sap_conf
+
+DESCRIPTION
+   Re-reads sap.conf after it changed, and sends the engine only the
+   sensor configurations whose parameters changed. The file is read into a
+   scratch copy, and only what changed is copied from it into sap_conf.
+
+DEPENDENCIES
+   Runs on the adapter's MsgTask
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_reload_sap_conf(loc_eng_data_s_type &loc_eng_data)
+{
+    ENTRY_LOG();
+    const uint32_t count = sizeof(sap_conf_table) / sizeof(sap_conf_table[0]);
+    loc_param_s_type file_table[count];
+    loc_sap_cfg_s_type file_conf = sap_conf_file;
+    LocEngAdapter* adapter = loc_eng_data.adapter;
+    bool control = false, properties = false, perf = false;
+
+    loc_eng_conf_table_rebase(sap_conf_table, count, &sap_conf, &file_conf, file_table);
+    UTIL_RELOAD_CONF(SAP_CONF_FILE, file_table);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const loc_param_s_type &param = sap_conf_table[i];
+        const uint8_t* set = (NULL == param.param_set) ? NULL :
+            (const uint8_t*)&file_conf + (param.param_set - (uint8_t*)&sap_conf);
+        const uint8_t* was_set = (NULL == param.param_set) ? NULL :
+            (const uint8_t*)&sap_conf_file + (param.param_set - (uint8_t*)&sap_conf);
+        bool changed = loc_eng_conf_param_changed(file_table[i], &file_conf, &sap_conf_file) ||
+            (NULL != set && *set != *was_set);
+        if (!changed) {
+            continue;
+        }
+
+        LOC_LOGI("%s: %s changed", __func__, param.param_name);
+        loc_eng_conf_param_copy(param, &sap_conf, &file_conf);
+        if (NULL != set) {
+            *param.param_set = *set;
+        }
+        if (param.param_ptr == &sap_conf.SENSOR_USAGE ||
+            param.param_ptr == &sap_conf.SENSOR_PROVIDER) {
+            control = true;
+        } else if (NULL != param.param_set) {
+            // only the random walk parameters have a valid flag
+            properties = true;
+        } else {
+            perf = true;
+        }
+    }
+    sap_conf_file = file_conf;
+
+    if (control) {
+        adapter->sendMsg(new LocEngSensorControlConfig(adapter, sap_conf.SENSOR_USAGE,
+                                                       sap_conf.SENSOR_PROVIDER));
+    }
+    if (properties) {
+        loc_eng_send_sensor_properties(adapter);
+    }
+    if (perf) {
+        loc_eng_send_sensor_perf_config(adapter);
+    }
+    EXIT_LOG(%s, VOID_RET);
+}
+
+// order in which the conf files are watched, see loc_eng_watch_conf()
+enum loc_eng_conf_file_e_type {
+    LOC_ENG_CONF_GPS = 0,
+    LOC_ENG_CONF_SAP
+};
+
+struct LocEngReloadConf : public LocMsg {
+    loc_eng_data_s_type* mLocEng;
+    const int mConfFile;
+    inline LocEngReloadConf(loc_eng_data_s_type* locEng, int confFile) :
+        LocMsg(), mLocEng(locEng), mConfFile(confFile)
+    {
+        locallog();
+    }
+    inline virtual void proc() const {
+        if (LOC_ENG_CONF_GPS == mConfFile) {
+            loc_eng_reload_gps_conf(*mLocEng);
+        } else if (LOC_ENG_CONF_SAP == mConfFile) {
+            loc_eng_reload_sap_conf(*mLocEng);
+        }
+    }
+    inline void locallog() const {
+        LOC_LOGV("LocEngReloadConf - conf file: %d", mConfFile);
+    }
+    inline virtual void log() const {
+        locallog();
+    }
+};
+
+// runs in a worker of the shared executor, hands the reload to the adapter
+static void loc_eng_conf_changed(const char* conf_file, int index, void* data)
+{
+    loc_eng_data_s_type* loc_eng_data = (loc_eng_data_s_type*)data;
+    loc_eng_data->adapter->sendMsg(new LocEngReloadConf(loc_eng_data, index));
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_watch_conf
+
+DESCRIPTION
+   Starts watching gps.conf and sap.conf, so that their changes are
+   applied without a restart of the HAL.
+
+DEPENDENCIES
+   loc_eng_data.adapter is created
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_watch_conf(loc_eng_data_s_type &loc_eng_data)
+{
+    LocExecutor* executor = LocExecutor::getDefault();
+    if (NULL == executor) {
+        LOC_LOGW("%s: no executor, conf files are not watched", __func__);
+        return;
+    }
+
+    loc_eng_data.conf_watcher =
+        LocConfWatcher::create(*executor, loc_eng_conf_changed, &loc_eng_data);
+    if (NULL != loc_eng_data.conf_watcher) {
+        // in the order of loc_eng_conf_file_e_type
+        loc_eng_data.conf_watcher->watch(GPS_CONF_FILE);
+        loc_eng_data.conf_watcher->watch(SAP_CONF_FILE);
+    }
+}
+
 /*===========================================================================
 FUNCTION    loc_eng_report_status
 
@@ -2745,6 +3345,11 @@ SIDE EFFECTS
 static void loc_eng_report_status (loc_eng_data_s_type &loc_eng_data, GpsStatusValue status)
 {
     ENTRY_LOG();
+    // the fixes held back go out ahead of the end of their session
+    if (status == GPS_STATUS_SESSION_END || status == GPS_STATUS_ENGINE_OFF)
+    {
+        loc_eng_fix_batch_session_end(loc_eng_data);
+    }
     // Switch from WAIT to MUTE, for "engine on" or "session begin" event
     if (status == GPS_STATUS_SESSION_BEGIN || status == GPS_STATUS_ENGINE_ON)
     {
@@ -2896,6 +3501,11 @@ int loc_eng_read_config(void)
       // In fact one day the conf file should go into context.
       UTIL_READ_CONF(GPS_CONF_FILE, gps_conf_table);
       UTIL_READ_CONF(SAP_CONF_FILE, sap_conf_table);
+      gps_conf_file = gps_conf;
+      sap_conf_file = sap_conf;
+      loc_set_thread_sched();
+      LocMsgTrace::enable(gps_conf.MSG_TASK_TRACE);
+      MsgTask::setRingCapacity(gps_conf.MSG_TASK_RING_CAPACITY);
       configAlreadyRead = true;
     } else {
       LOC_LOGV("GPS Config file has already been read\n");
@@ -2981,3 +3591,193 @@ void loc_eng_gps_measurement_close(loc_eng_data_s_type &loc_eng_data)
     loc_eng_data.gps_measurement_cb = NULL;
     EXIT_LOG(%d, 0);
 }
+
+#ifdef __LOC_EVENT_REPLAY_DEBUG__
+
+#include <LocEventTrace.h>
+
+static loc_eng_data_s_type sLocEngData;
+static volatile int sLocations = 0;
+static volatile int sSvs = 0;
+static volatile int sNmeas = 0;
+static volatile uint32_t sNmeaHash = 0;
+
+static void replayLocationCb(UlpLocation* location, void* locExt) {
+    if (NULL != location) {
+        sLocations++;
+    }
+}
+static void replaySvCb(GpsSvStatus* svStatus, void* svExt) {
+    sSvs++;
+}
+// sum of the FNV-1a of the sentences, in whichever order they come
+static void replayNmeaCb(GpsUtcTime timestamp, const char* nmea, int length) {
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ (uint8_t)nmea[i]) * 16777619u;
+    }
+    sNmeaHash += hash;
+    sNmeas++;
+}
+static void replayStatusCb(GpsStatus* status) {}
+static void replayCapabilitiesCb(uint32_t capabilities) {}
+static void replayWakelockCb() {}
+static void replayUtcTimeCb() {}
+
+// the MsgTask is done with what was sent to it before this, in the
+// last lane to be served
+struct LocEngReplayMarker : public LocMsg {
+    volatile bool* const mDone;
+    inline LocEngReplayMarker(volatile bool* done) : LocMsg(), mDone(done) {}
+    inline virtual LocMsgPriority priority() const {
+        return LOC_MSG_PRIORITY_LOW;
+    }
+    inline virtual void proc() const {
+        __atomic_store_n(mDone, true, __ATOMIC_RELEASE);
+    }
+};
+
+static void replayDrain(void* data = NULL) {
+    volatile bool done = false;
+    sLocEngData.adapter->sendMsg(new LocEngReplayMarker(&done));
+    while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+        usleep(100);
+    }
+}
+
+static double replayNowMs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e3 + now.tv_nsec / 1e6;
+}
+
+// a 1 Hz session, 1000 times faster: the SVs, fix and a modem NMEA
+// sentence of each second. The HAL generates its own NMEA, so the modem
+// NMEA is recorded but not delivered.
+static void recordSession(LocApiBase* locApi, const char* path, int fixes) {
+    locApi->recordEvents(path);
+    locApi->reportStatus(GPS_STATUS_SESSION_BEGIN);
+    for (int i = 0; i < fixes; i++) {
+        HaxxSvStatus svStatus;
+        GpsLocationExtended locationExtended;
+        memset(&svStatus, 0, sizeof(svStatus));
+        memset(&locationExtended, 0, sizeof(locationExtended));
+        locationExtended.size = sizeof(locationExtended);
+        svStatus.size = sizeof(svStatus);
+        svStatus.num_svs = 12;
+        for (int s = 0; s < svStatus.num_svs; s++) {
+            svStatus.sv_list[s].size = sizeof(GpsSvInfo);
+            svStatus.sv_list[s].prn = s + 1;
+            svStatus.sv_list[s].snr = 20 + (i + s) % 25;
+            svStatus.sv_list[s].elevation = 10 + s * 6;
+            svStatus.sv_list[s].azimuth = s * 30;
+        }
+        svStatus.gps_used_in_fix_mask = 0x3ff;
+        locApi->reportSv(svStatus, locationExtended, NULL);
+
+        // filled in place, raw data included
+        LocPositionReport* report = LocPositionReport::create(32);
+        UlpLocation& location = report->mLocation;
+        location.gpsLocation.size = sizeof(GpsLocation);
+        location.gpsLocation.flags = GPS_LOCATION_HAS_LAT_LONG |
+            GPS_LOCATION_HAS_ALTITUDE | GPS_LOCATION_HAS_SPEED |
+            GPS_LOCATION_HAS_BEARING | GPS_LOCATION_HAS_ACCURACY;
+        location.gpsLocation.latitude = 37.4219983 + i * 1e-5;
+        location.gpsLocation.longitude = -122.084 + i * 1e-5;
+        location.gpsLocation.altitude = 32.5;
+        location.gpsLocation.speed = 1.5;
+        location.gpsLocation.bearing = 45;
+        location.gpsLocation.accuracy = 5;
+        location.gpsLocation.timestamp = 1600000000000LL + i * 1000LL;
+        location.position_source = ULP_LOCATION_IS_FROM_GNSS;
+        memset(location.rawData, i, location.rawDataSize);
+        report->mLocationExtended.flags = GPS_LOCATION_EXTENDED_HAS_DOP;
+        report->mLocationExtended.pdop = 1.5;
+        report->mLocationExtended.hdop = 0.9;
+        report->mLocationExtended.vdop = 1.2;
+        report->mTechMask = LOC_POS_TECH_MASK_SATELLITE;
+        locApi->reportPosition(report);
+        report->drop();
+
+        const char nmea[] = "$PQXFI,221320.0,3725.319898,N,12205.040000,W,32.5,5.0,4.0,0.2*5A\r\n";
+        locApi->reportNmea(nmea, sizeof(nmea) - 1);
+        usleep(1000);
+    }
+    locApi->reportStatus(GPS_STATUS_SESSION_END);
+    locApi->recordEvents(NULL);
+}
+
+static uint32_t replay(LocApiBase* locApi, const char* path, double speed,
+                       bool lockstep) {
+    sLocations = sSvs = sNmeas = 0;
+    sNmeaHash = 0;
+    LocEventReplayer replayer(locApi, lockstep ? replayDrain : NULL);
+    double start = replayNowMs();
+    int events = replayer.replay(path, speed);
+    double fed = replayNowMs() - start;
+    replayDrain();
+    double done = replayNowMs() - start;
+    printf("speed %4.1f%-9s: %6d events fed in %7.1f ms, done in %7.1f ms "
+           "(%6.2f us/event); %d fixes, %d sv reports, %d nmea, hash %08x\n",
+           speed, lockstep ? " lockstep" : "", events, fed, done,
+           events > 0 ? done * 1e3 / events : 0,
+           sLocations, sSvs, sNmeas, sNmeaHash);
+    return sNmeaHash;
+}
+
+// For Linux command line testing, the HAL with no modem: events come from
+// the trace, through LocApiBase, LocEngAdapter and the MsgTask, to the
+// callbacks; NMEA is generated by the HAL.
+// compile: g++ -D__LOC_HOST_DEBUG__ -D__LOC_EVENT_REPLAY_DEBUG__ -O2 -I. -I../../core -I../../utils -I../../utils/platform_lib_abstractions -I../../../../system/core/include loc_eng*.cpp loc_eng_dmn_conn*.c LocEngAdapter.cpp ../../core/*.cpp ../../utils/*.cpp ../../utils/*.c -lpthread -ldl
+// run: ./a.out [trace [speed]]; with no trace, a recorded synthetic one
+int main(int argc, char** argv) {
+    const char* path = argc > 1 ? argv[1] : "/tmp/loc_events.trc";
+    LocCallbacks callbacks;
+    memset(&callbacks, 0, sizeof(callbacks));
+    callbacks.location_cb = replayLocationCb;
+    callbacks.status_cb = replayStatusCb;
+    callbacks.sv_status_cb = replaySvCb;
+    callbacks.nmea_cb = replayNmeaCb;
+    callbacks.set_capabilities_cb = replayCapabilitiesCb;
+    callbacks.acquire_wakelock_cb = replayWakelockCb;
+    callbacks.release_wakelock_cb = replayWakelockCb;
+    callbacks.request_utc_time_cb = replayUtcTimeCb;
+
+    loc_eng_read_config();
+    if (0 != loc_eng_init(sLocEngData, &callbacks,
+                          LOC_API_ADAPTER_BIT_PARSED_POSITION_REPORT |
+                          LOC_API_ADAPTER_BIT_SATELLITE_REPORT |
+                          LOC_API_ADAPTER_BIT_STATUS_REPORT |
+                          LOC_API_ADAPTER_BIT_NMEA_1HZ_REPORT, NULL)) {
+        printf("loc_eng_init failed\n");
+        return 1;
+    }
+    LocApiBase* locApi = sLocEngData.adapter->getContext()->getLocApi();
+    LocPosMode mode;
+    loc_eng_set_position_mode(sLocEngData, mode);
+    loc_eng_start(sLocEngData);
+    replayDrain();
+
+    int ret = 0;
+    if (argc > 1) {
+        replay(locApi, path, argc > 2 ? atof(argv[2]) : 1, false);
+    } else {
+        recordSession(locApi, path, 3600);
+        replayDrain();
+        // SV reports and fixes share a lane, so however fast the events
+        // come, the sentences are those of a replay in lockstep
+        uint32_t hash = replay(locApi, path, 0, true);
+        static const double speeds[] = { 0, 1, 4 };
+        for (uint32_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+            if (replay(locApi, path, speeds[i], false) != hash) {
+                printf("FAILED: replay differs from the one in lockstep\n");
+                ret = 1;
+            }
+        }
+    }
+    loc_eng_stop(sLocEngData);
+    replayDrain();
+    return ret;
+}
+
+#endif // __LOC_EVENT_REPLAY_DEBUG__
@@ -56,7 +56,10 @@ typedef unsigned char boolean;
 #include <loc_log.h>
 #include <log_util.h>
 #include <loc_eng_agps.h>
+#include <loc_eng_nmea.h>
+#include <loc_eng_geofence.h>
 #include <LocEngAdapter.h>
+#include <LocConfWatcher.h>
 
 // The data connection minimal open time
 #define DATA_OPEN_MIN_TIME        1  /* sec */
@@ -81,6 +84,34 @@ enum loc_mute_session_e_type {
    LOC_MUTE_SESS_IN_SESSION
 };
 
+// capacity of the ring fixes are batched in, the upper bound of
+// FIX_BATCH_SIZE in gps.conf
+#define LOC_FIX_BATCH_MAX 32
+
+class LocEngFixBatchTimer;
+
+// a fix held back for location_cb, with what it is to be delivered with
+typedef struct {
+    LocPositionReport*             report;
+    uint64_t                       send_time;
+} loc_eng_batched_fix_s_type;
+
+// Fixes of a tracking session batched for location_cb, which gets them in
+// one go once FIX_BATCH_SIZE of them are in, once the oldest has waited
+// FIX_BATCH_TIMEOUT ms, or as the session ends. Only used on the MsgTask.
+typedef struct {
+    loc_eng_batched_fix_s_type     fixes[LOC_FIX_BATCH_MAX];
+    uint32_t                       head;
+    uint32_t                       count;
+    // bumped by each flush, so that a timeout of a flushed batch is
+    // not taken for one of the next
+    uint32_t                       generation;
+    LocEngFixBatchTimer*           timer;
+    // of the session so far, logged as it ends
+    uint32_t                       batched;
+    uint32_t                       flushes;
+} loc_eng_fix_batch_s_type;
+
 // Module data
 typedef struct loc_eng_data_s
 {
@@ -125,6 +156,9 @@ typedef struct loc_eng_data_s
     float hdop;
     float pdop;
     float vdop;
+    // when each sentence was last sent, ms of CLOCK_BOOTTIME,
+    // indexed by loc_eng_nmea_sentence_e_type
+    int64_t nmea_last_sent[LOC_NMEA_NUM_SENTENCES];
 
     // Address buffers, for addressing setting before init
     int    supl_host_set;
@@ -139,6 +173,16 @@ typedef struct loc_eng_data_s
 
     loc_ext_parser location_ext_parser;
     loc_ext_parser sv_ext_parser;
+
+    // watches gps.conf and sap.conf, to apply their changes as they come
+    LocConfWatcher* conf_watcher;
+
+    // fixes held back for location_cb, see FIX_BATCH_SIZE
+    loc_eng_fix_batch_s_type fix_batch;
+
+    // fences evaluated against the fixes, when there is no libgeofence
+    LocEngGeofence* geofence;
+    GpsGeofenceCallbacks geofence_cbs;
 } loc_eng_data_s_type;
 
 //loc_eng functions
@@ -42,30 +42,25 @@
 // C callbacks
 //======================================================================
 
-// This is given to linked_list_add as the dealloc callback
-// data -- an instance of Subscriber
-static void deleteObj(void* data)
-{
-    delete (Subscriber*)data;
-}
-
-// This is given to linked_list_search() as the comparison callback
-// when the state manchine needs to process for particular subscriber
+// This is given to linked_list_intrusive_find() and _search() as the
+// comparison callback when the state manchine needs to process for
+// particular subscriber
 // fromCaller -- caller provides this obj
-// fromList -- linked_list_search() function take this one from list
-static bool hasSubscriber(void* fromCaller, void* fromList)
+// fromList -- the node of a Subscriber in the list
+static bool hasSubscriber(void* fromCaller, linked_list_node* fromList)
 {
     Notification* notification = (Notification*)fromCaller;
-    Subscriber* s1 = (Subscriber*)fromList;
+    Subscriber* s1 = static_cast<Subscriber*>(fromList);
 
     return s1->forMe(*notification);
 }
 
-// This is gvien to linked_list_search() to notify subscriber objs
+// This is used to notify subscriber objs
 // when the state machine needs to inform all subscribers of resource
 // status changes, e.g. when resource is GRANTED.
 // fromCaller -- caller provides this ptr to a Notification obj.
-// fromList -- linked_list_search() function take this one from list
+// fromList -- a Subscriber, from the list or not
+// returns true if the subscriber is to be deleted
 static bool notifySubscriber(void* fromCaller, void* fromList)
 {
     Notification* notification = (Notification*)fromCaller;
@@ -631,7 +626,7 @@ AgpsStateMachine::AgpsStateMachine(servicerType servType,
     mEnforceSingleSubscriber(enforceSingleSubscriber),
     mServicer(Servicer :: getServicer(servType, (void *)cb_func))
 {
-    linked_list_init(&mSubscribers);
+    linked_list_intrusive_init(&mSubscribers, AGPS_SUBSCRIBER_INDEX_BUCKETS);
 
     // setting up mReleasedState
     mStatePtr->mPendingState = new AgpsPendingState(this);
@@ -671,7 +666,7 @@ AgpsStateMachine::~AgpsStateMachine()
     delete pendindState;
     delete releasingState;
     delete mServicer;
-    linked_list_destroy(&mSubscribers);
+    linked_list_intrusive_destroy(&mSubscribers);
 
     if (NULL != mAPN) {
         delete[] mAPN;
@@ -714,45 +709,52 @@ void AgpsStateMachine::onRsrcEvent(AgpsRsrcStatus event)
 
 void AgpsStateMachine::notifySubscribers(Notification& notification) const
 {
-    if (notification.postNotifyDelete) {
-        // just any non NULL value to get started
-        Subscriber* s = (Subscriber*)~0;
-        while (NULL != s) {
-            s = NULL;
-            // if the last param sets to true, _search will delete
-            // the node from the list for us.  But the problem is
-            // once that is done, _search returns, leaving the
-            // rest of the list unprocessed.  So we need a loop.
-            linked_list_search(mSubscribers, (void**)&s, notifySubscriber,
-                               (void*)&notification, true);
-            delete s;
+    linked_list_node* node = linked_list_intrusive_first(&mSubscribers);
+    while (NULL != node) {
+        // read ahead, node may be gone next
+        linked_list_node* next = linked_list_intrusive_next(&mSubscribers, node);
+        if (notifySubscriber((void*)&notification, static_cast<Subscriber*>(node))) {
+            linked_list_intrusive_remove(&mSubscribers, node);
+            delete static_cast<Subscriber*>(node);
         }
-    } else {
-        // no loop needed if it the last param sets to false, which
-        // mean nothing gets deleted from the list.
-        linked_list_search(mSubscribers, NULL, notifySubscriber,
-                           (void*)&notification, false);
+        node = next;
+    }
+}
+
+Subscriber* AgpsStateMachine::findSubscriber(Notification& notification) const
+{
+    linked_list_node* node = (NULL != notification.rcver) ?
+        // only a subscriber with the same ID can be equal to rcver
+        linked_list_intrusive_find(&mSubscribers, notification.rcver->ID,
+                                   hasSubscriber, (void*)&notification) :
+        linked_list_intrusive_search(&mSubscribers, hasSubscriber,
+                                     (void*)&notification);
+    return static_cast<Subscriber*>(node);
+}
+
+void AgpsStateMachine::dropAllSubscribers() const
+{
+    linked_list_node* node;
+    while (NULL != (node = linked_list_intrusive_first(&mSubscribers))) {
+        linked_list_intrusive_remove(&mSubscribers, node);
+        delete static_cast<Subscriber*>(node);
     }
 }
 
 void AgpsStateMachine::addSubscriber(Subscriber* subscriber) const
 {
-    Subscriber* s = NULL;
     Notification notification((const Subscriber*)subscriber);
-    linked_list_search(mSubscribers, (void**)&s,
-                       hasSubscriber, (void*)&notification, false);
 
-    if (NULL == s) {
-        linked_list_add(mSubscribers, subscriber->clone(), deleteObj);
+    if (NULL == findSubscriber(notification)) {
+        Subscriber* s = subscriber->clone();
+        linked_list_intrusive_add(&mSubscribers, s, s->ID);
     }
 }
 
 int AgpsStateMachine::sendRsrcRequest(AGpsStatusValue action) const
 {
-    Subscriber* s = NULL;
     Notification notification(Notification::BROADCAST_ACTIVE);
-    linked_list_search(mSubscribers, (void**)&s, hasSubscriber,
-                       (void*)&notification, false);
+    Subscriber* s = findSubscriber(notification);
 
     if ((NULL == s) == (GPS_RELEASE_AGPS_DATA_CONN == action)) {
         AGpsExtStatus nifRequest;
@@ -788,10 +790,8 @@ void AgpsStateMachine::subscribeRsrc(Subscriber *subscriber)
 
 bool AgpsStateMachine::unsubscribeRsrc(Subscriber *subscriber)
 {
-    Subscriber* s = NULL;
     Notification notification((const Subscriber*)subscriber);
-    linked_list_search(mSubscribers, (void**)&s,
-                       hasSubscriber, (void*)&notification, false);
+    Subscriber* s = findSubscriber(notification);
 
     if (NULL != s) {
         mStatePtr = mStatePtr->onRsrcEvent(RSRC_UNSUBSCRIBE, (void*)s);
@@ -802,11 +802,8 @@ bool AgpsStateMachine::unsubscribeRsrc(Subscriber *subscriber)
 
 bool AgpsStateMachine::hasActiveSubscribers() const
 {
-    Subscriber* s = NULL;
     Notification notification(Notification::BROADCAST_ACTIVE);
-    linked_list_search(mSubscribers, (void**)&s,
-                       hasSubscriber, (void*)&notification, false);
-    return NULL != s;
+    return NULL != findSubscriber(notification);
 }
 
 //======================================================================
@@ -837,10 +834,8 @@ DSStateMachine :: DSStateMachine(servicerType type, void *cb_func,
 
 void DSStateMachine :: retryCallback(void)
 {
-    DSSubscriber *subscriber = NULL;
     Notification notification(Notification::BROADCAST_ACTIVE);
-    linked_list_search(mSubscribers, (void**)&subscriber, hasSubscriber,
-                       (void*)&notification, false);
+    DSSubscriber *subscriber = (DSSubscriber*)findSubscriber(notification);
     if(subscriber)
         mLocAdapter->requestSuplES(subscriber->ID);
     else
@@ -851,14 +846,12 @@ void DSStateMachine :: retryCallback(void)
 
 int DSStateMachine :: sendRsrcRequest(AGpsStatusValue action) const
 {
-    DSSubscriber* s = NULL;
     dsCbData cbData;
     int ret=-1;
     int connHandle=-1;
     LOC_LOGD("Enter DSStateMachine :: sendRsrcRequest\n");
     Notification notification(Notification::BROADCAST_ACTIVE);
-    linked_list_search(mSubscribers, (void**)&s, hasSubscriber,
-                       (void*)&notification, false);
+    DSSubscriber* s = (DSSubscriber*)findSubscriber(notification);
     if(s) {
         connHandle = s->ID;
         LOC_LOGD("DSStateMachine :: sendRsrcRequest - subscriber found\n");
@@ -882,7 +875,8 @@ int DSStateMachine :: sendRsrcRequest(AGpsStatusValue action) const
             informStatus(RSRC_DENIED, connHandle);
         }
         else {
-            if(loc_timer_start(DATA_CALL_RETRY_DELAY_MSEC, delay_callback, (void *)this)) {
+            if(loc_timer_start(DATA_CALL_RETRY_DELAY_MSEC, delay_callback, (void *)this,
+                               false, true)) {
                 LOC_LOGE("Error: Could not start delay thread\n");
                 ret = -1;
                 goto err;
@@ -968,3 +962,215 @@ void DSStateMachine :: informStatus(AgpsRsrcStatus status, int ID) const
     }
     return;
 }
+
+#ifdef __LOC_AGPS_DEBUG__
+
+// Walks an AgpsStateMachine through the notifications that go to one,
+// some or all of its subscribers, and remove some or all of them from
+// the list as notifySubscribers() goes through it. After each step it
+// checks who was notified of what, who is left on the list, in order,
+// that each of them is still found through the ID index, and that no
+// subscriber was leaked or deleted twice. IDs 1, 9 and 17 share a bucket
+// of the index.
+static int sLive = 0;
+static int sRequests = 0;
+static AgpsRsrcStatus sNotified[32];
+
+static void testRequest(void)
+{
+    sRequests++;
+}
+
+struct TestSubscriber : public Subscriber {
+    const bool mWaitForClose;
+    bool mIsInactive;
+
+    inline TestSubscriber(const AgpsStateMachine* stateMachine, int id,
+                          bool waitForClose) :
+        Subscriber(id, stateMachine), mWaitForClose(waitForClose),
+        mIsInactive(false)
+    { sLive++; }
+    inline virtual ~TestSubscriber() { sLive--; }
+
+    virtual bool notifyRsrcStatus(Notification &notification)
+    {
+        bool notify = forMe(notification);
+        if (notify) {
+            sNotified[ID] = notification.rsrcStatus;
+        }
+        return notify;
+    }
+
+    inline virtual void setIPAddresses(uint32_t &v4, char* v6)
+    { v4 = ID; v6[0] = 0; }
+    inline virtual void setIPAddresses(struct sockaddr_storage& addr)
+    { addr.ss_family = AF_INET; }
+    inline virtual bool waitForCloseComplete() { return mWaitForClose; }
+    inline virtual void setInactive() { mIsInactive = true; }
+    inline virtual bool isInactive() { return mIsInactive; }
+
+    virtual Subscriber* clone()
+    {
+        return new TestSubscriber(mStateMachine, ID, mWaitForClose);
+    }
+};
+
+struct TestStateMachine : public AgpsStateMachine {
+    inline TestStateMachine() :
+        AgpsStateMachine(servicerTypeNoCbParam, (void*)testRequest,
+                         AGPS_TYPE_SUPL, false) {}
+
+    inline const char* state() { return mStatePtr->whoami(); }
+
+    // the IDs on the list, in order, e.g. "13 5"; false if one of them
+    // is not found through the index
+    bool list(char* ids, size_t size)
+    {
+        bool indexed = true;
+        ids[0] = 0;
+        for (linked_list_node* node = linked_list_intrusive_first(&mSubscribers);
+             NULL != node; node = linked_list_intrusive_next(&mSubscribers, node)) {
+            Subscriber* s = static_cast<Subscriber*>(node);
+            Notification notification((const Subscriber*)s);
+            indexed = indexed && s == findSubscriber(notification);
+            snprintf(ids + strlen(ids), size - strlen(ids), "%s%u",
+                     ids[0] ? " " : "", s->ID);
+        }
+        return indexed;
+    }
+};
+
+static void testSubscribe(TestStateMachine& sm, int id, bool waitForClose)
+{
+    TestSubscriber subscriber(&sm, id, waitForClose);
+    sm.subscribeRsrc(&subscriber);
+}
+
+static void testUnsubscribe(TestStateMachine& sm, int id)
+{
+    TestSubscriber subscriber(&sm, id, false);
+    sm.unsubscribeRsrc(&subscriber);
+}
+
+static const char* const sStatusNames = "SUGRD";
+
+// notified: what each notified subscriber got since the last check, e.g.
+// "9U 1U"; left: the IDs on the list, in order
+static bool testCheck(const char* step, TestStateMachine& sm, const char* state,
+                      const char* notified, const char* left, int requests)
+{
+    char gotNotified[128] = "", gotLeft[128];
+    bool indexed = sm.list(gotLeft, sizeof(gotLeft));
+    for (int id = 31; id >= 0; id--) {
+        if (RSRC_STATUS_MAX != sNotified[id]) {
+            snprintf(gotNotified + strlen(gotNotified),
+                     sizeof(gotNotified) - strlen(gotNotified), "%s%d%c",
+                     gotNotified[0] ? " " : "", id, sStatusNames[sNotified[id]]);
+            sNotified[id] = RSRC_STATUS_MAX;
+        }
+    }
+
+    // each subscriber on the list is a clone, the others are gone
+    int numLeft = (0 == left[0]) ? 0 : 1;
+    for (const char* c = left; *c; c++) {
+        numLeft += (' ' == *c);
+    }
+    bool ok = indexed && 0 == strcmp(state, sm.state()) &&
+        0 == strcmp(notified, gotNotified) && 0 == strcmp(left, gotLeft) &&
+        requests == sRequests && numLeft == sLive;
+    printf("%-34s %-18s notified [%s] left [%s] requests %d%s\n",
+           step, sm.state(), gotNotified, gotLeft, sRequests,
+           ok ? "" : indexed ? "  FAILED" : "  FAILED, not indexed");
+    return ok;
+}
+
+// For Linux command line testing:
+// compile: g++ -D__LOC_HOST_DEBUG__ -D__LOC_AGPS_DEBUG__ -O2 -I. -I../../core -I../../utils -I../../utils/platform_lib_abstractions -I../../../../system/core/include loc_eng*.cpp loc_eng_dmn_conn*.c LocEngAdapter.cpp ../../core/*.cpp ../../utils/*.cpp ../../utils/*.c -lpthread -ldl
+int main(int argc, char** argv) {
+    bool ok = true;
+    for (int id = 0; id < 32; id++) {
+        sNotified[id] = RSRC_STATUS_MAX;
+    }
+
+    TestStateMachine* sm = new TestStateMachine();
+    testSubscribe(*sm, 1, false);
+    testSubscribe(*sm, 9, false);
+    testSubscribe(*sm, 17, false);
+    testSubscribe(*sm, 2, false);
+    testSubscribe(*sm, 3, false);
+    ok = testCheck("subscribe 1 9 17 2 3", *sm, "AgpsPendingState",
+                   "", "3 2 17 9 1", 1) && ok;
+
+    // to all, none removed
+    sm->onRsrcEvent(RSRC_GRANTED);
+    ok = testCheck("granted", *sm, "AgpsAcquiredState",
+                   "17G 9G 3G 2G 1G", "3 2 17 9 1", 1) && ok;
+
+    // to one, removed from the middle, the head and the tail
+    testUnsubscribe(*sm, 9);
+    ok = testCheck("unsubscribe 9", *sm, "AgpsAcquiredState",
+                   "9U", "3 2 17 1", 1) && ok;
+    testUnsubscribe(*sm, 3);
+    ok = testCheck("unsubscribe 3", *sm, "AgpsAcquiredState",
+                   "3U", "2 17 1", 1) && ok;
+    testUnsubscribe(*sm, 1);
+    ok = testCheck("unsubscribe 1", *sm, "AgpsAcquiredState",
+                   "1U", "2 17", 1) && ok;
+    // not subscribed, nothing happens
+    testUnsubscribe(*sm, 9);
+    ok = testCheck("unsubscribe 9 again", *sm, "AgpsAcquiredState",
+                   "", "2 17", 1) && ok;
+
+    // granted as they come; 4 and 12 then wait for their close
+    testSubscribe(*sm, 4, true);
+    testSubscribe(*sm, 12, true);
+    ok = testCheck("subscribe 4 12", *sm, "AgpsAcquiredState",
+                   "12G 4G", "12 4 2 17", 1) && ok;
+    testUnsubscribe(*sm, 4);
+    testUnsubscribe(*sm, 17);
+    testUnsubscribe(*sm, 2);
+    ok = testCheck("unsubscribe 4 17 2", *sm, "AgpsAcquiredState",
+                   "17U 2U", "12 4", 1) && ok;
+    testUnsubscribe(*sm, 12);
+    ok = testCheck("unsubscribe 12", *sm, "AgpsReleasingState",
+                   "", "12 4", 2) && ok;
+
+    // to the inactive ones only, which are removed, the others stay
+    testSubscribe(*sm, 5, false);
+    testSubscribe(*sm, 13, false);
+    ok = testCheck("subscribe 5 13", *sm, "AgpsReleasingState",
+                   "", "13 5 12 4", 2) && ok;
+    sm->onRsrcEvent(RSRC_RELEASED);
+    ok = testCheck("released", *sm, "AgpsPendingState",
+                   "12R 4R", "13 5", 3) && ok;
+
+    // to all, all removed
+    sm->onRsrcEvent(RSRC_DENIED);
+    ok = testCheck("denied", *sm, "AgpsReleasedState",
+                   "13D 5D", "", 3) && ok;
+
+    // and again from the acquired state, with a whole bucket on the list
+    testSubscribe(*sm, 1, false);
+    testSubscribe(*sm, 9, false);
+    testSubscribe(*sm, 17, false);
+    sm->onRsrcEvent(RSRC_GRANTED);
+    ok = testCheck("subscribe 1 9 17, granted", *sm, "AgpsAcquiredState",
+                   "17G 9G 1G", "17 9 1", 4) && ok;
+    sm->onRsrcEvent(RSRC_RELEASED);
+    ok = testCheck("released", *sm, "AgpsReleasedState",
+                   "17R 9R 1R", "", 4) && ok;
+
+    // the subscribers left go with the state machine
+    testSubscribe(*sm, 6, false);
+    testSubscribe(*sm, 14, true);
+    delete sm;
+    if (0 != sLive) {
+        printf("FAILED: %d subscribers left after the state machine\n", sLive);
+        ok = false;
+    }
+
+    printf(ok ? "passed\n" : "FAILED\n");
+    return ok ? 0 : 1;
+}
+
+#endif // __LOC_AGPS_DEBUG__
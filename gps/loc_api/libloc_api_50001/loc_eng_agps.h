@@ -177,10 +177,14 @@ public:
     inline virtual char *whoami() {return (char*)"AGpsServicer";}
 };
 
+// buckets of the subscriber index by ID, see AgpsStateMachine
+#define AGPS_SUBSCRIBER_INDEX_BUCKETS 8
+
 class AgpsStateMachine {
 protected:
-    // a linked list of subscribers.
-    void* mSubscribers;
+    // subscribers, most recent first, indexed by ID; they are
+    // Subscribers, which embed their list node
+    mutable linked_list_intrusive mSubscribers;
     //handle to whoever provides the service
     Servicer *mServicer;
     // allows AgpsState to access private data
@@ -204,6 +208,10 @@ private:
     // ipv4 address for routing
     bool mEnforceSingleSubscriber;
 
+protected:
+    // the most recent subscriber the notification is for, NULL if none
+    Subscriber* findSubscriber(Notification& notification) const;
+
 public:
     AgpsStateMachine(servicerType servType, void *cb_func,
                      AGpsExtType type, bool enforceSingleSubscriber);
@@ -230,17 +238,12 @@ public:
     // put the data together and send the FW
     virtual int sendRsrcRequest(AGpsStatusValue action) const;
 
-    //if list is empty, linked_list_empty returns 1
-    //else if list is not empty, returns 0
-    //so hasSubscribers() returns 1 if list is not empty
-    //and returns 0 if list is empty
     inline bool hasSubscribers() const
-    { return !linked_list_empty(mSubscribers); }
+    { return !linked_list_intrusive_empty(&mSubscribers); }
 
     bool hasActiveSubscribers() const;
 
-    inline void dropAllSubscribers() const
-    { linked_list_flush(mSubscribers); }
+    void dropAllSubscribers() const;
 
     // private. Only a state gets to call this.
     void notifySubscribers(Notification& notification) const;
@@ -267,12 +270,13 @@ public:
 // each subscriber is a AGPS client.  In the case of ATL, there could be
 // multiple clients from modem.  In the case of BIT, there is only one
 // cilent from BIT daemon.
-struct Subscriber {
+// The node is the subscriber's place in AgpsStateMachine::mSubscribers.
+struct Subscriber : public linked_list_node {
     const uint32_t ID;
     const AgpsStateMachine* mStateMachine;
     inline Subscriber(const int id,
                       const AgpsStateMachine* stateMachine) :
-        ID(id), mStateMachine(stateMachine) {}
+        linked_list_node(), ID(id), mStateMachine(stateMachine) {}
     inline virtual ~Subscriber() {}
 
     virtual void setIPAddresses(uint32_t &v4, char* v6) = 0;
@@ -0,0 +1,762 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_eng_geofence"
+
+#include <stdlib.h>
+#include <math.h>
+#include <loc_eng.h>
+#include <loc_eng_geofence.h>
+#include "log_util.h"
+
+// meters per degree of latitude, and of longitude on the equator
+#define LOC_GEOFENCE_M_PER_DEG 111194.93
+#define LOC_GEOFENCE_DEG_TO_RAD (M_PI / 180.0)
+// beyond this latitude fences are not in the grid, as its cells
+// get too narrow
+#define LOC_GEOFENCE_MAX_GRID_LAT 80.0
+
+struct LocGeofenceFence {
+    // in mFences, keyed by id
+    linked_list_node node;
+    // in mAlways, while always is true
+    linked_list_node alwaysNode;
+    int32_t id;
+    double latitude;
+    double longitude;
+    double radius;
+    uint32_t monitor;
+    uint32_t dwellMs;
+    // the last transition, LOC_GEOFENCE_ENTERED, _EXITED or _UNCERTAIN
+    uint32_t state;
+    // GpsUtcTime of the entry, 0 if not known yet
+    int64_t enteredAt;
+    uint32_t seq;
+    bool dwelt;
+    bool paused;
+    bool always;
+    // in the cells cellX0..cellX1 by cellY0..cellY1
+    bool gridded;
+    int32_t cellX0;
+    int32_t cellX1;
+    int32_t cellY0;
+    int32_t cellY1;
+};
+
+struct LocGeofenceCell {
+    // in mCells, keyed by cellKey()
+    linked_list_node node;
+    uint32_t count;
+    uint32_t capacity;
+    LocGeofenceFence** fences;
+};
+
+static inline int32_t cellOf(double degrees) {
+    return (int32_t)floor(degrees / LOC_GEOFENCE_CELL_DEG);
+}
+
+// cells are +/-18000 by +/-9000, 16 bits each is enough
+static inline uintptr_t cellKey(int32_t x, int32_t y) {
+    return ((uintptr_t)(uint16_t)x << 16) | (uint16_t)y;
+}
+
+LocEngGeofence::LocEngGeofence(loc_geofence_transition_cb transitionCb,
+                               void* data, uint32_t maxFences,
+                               int32_t maxCellSpan) :
+    mTransitionCb(transitionCb), mData(data), mMaxFences(maxFences),
+    mMaxCellSpan(maxCellSpan), mSeq(0), mTested(0)
+{
+    linked_list_intrusive_init(&mFences, maxFences);
+    linked_list_intrusive_init(&mCells, maxFences);
+    linked_list_intrusive_init(&mAlways, 0);
+}
+
+LocEngGeofence::~LocEngGeofence()
+{
+    linked_list_node* node;
+    while (NULL != (node = linked_list_intrusive_first(&mFences))) {
+        remove(LINKED_LIST_CONTAINER_OF(node, LocGeofenceFence, node)->id);
+    }
+    linked_list_intrusive_destroy(&mFences);
+    linked_list_intrusive_destroy(&mCells);
+    linked_list_intrusive_destroy(&mAlways);
+}
+
+LocGeofenceFence* LocEngGeofence::find(int32_t id) const
+{
+    linked_list_node* node =
+        linked_list_intrusive_find(&mFences, (uintptr_t)(uint32_t)id, NULL, NULL);
+    return NULL == node ? NULL :
+        LINKED_LIST_CONTAINER_OF(node, LocGeofenceFence, node);
+}
+
+LocGeofenceCell* LocEngGeofence::getCell(uintptr_t key, bool create)
+{
+    linked_list_node* node = linked_list_intrusive_find(&mCells, key, NULL, NULL);
+    if (NULL != node) {
+        return LINKED_LIST_CONTAINER_OF(node, LocGeofenceCell, node);
+    }
+    if (!create) {
+        return NULL;
+    }
+    LocGeofenceCell* cell = new LocGeofenceCell();
+    linked_list_intrusive_add(&mCells, &cell->node, key);
+    return cell;
+}
+
+// puts the fence in the cells its bounding box overlaps, unless it is
+// too large for that or too close to a pole or to the antimeridian, or
+// a cell cannot grow to take it; a fence left out is tested every fix
+void LocEngGeofence::addToGrid(LocGeofenceFence* fence)
+{
+    double dLat = fence->radius / LOC_GEOFENCE_M_PER_DEG;
+    double edgeLat = fabs(fence->latitude) + dLat;
+    if (0 == mMaxCellSpan || edgeLat > LOC_GEOFENCE_MAX_GRID_LAT) {
+        return;
+    }
+    // as wide as the fence gets on its poleward edge
+    double dLon = dLat / cos(edgeLat * LOC_GEOFENCE_DEG_TO_RAD);
+    if (fence->longitude - dLon < -180.0 || fence->longitude + dLon >= 180.0) {
+        return;
+    }
+    int32_t x0 = cellOf(fence->longitude - dLon);
+    int32_t x1 = cellOf(fence->longitude + dLon);
+    int32_t y0 = cellOf(fence->latitude - dLat);
+    int32_t y1 = cellOf(fence->latitude + dLat);
+    if (x1 - x0 >= mMaxCellSpan || y1 - y0 >= mMaxCellSpan) {
+        return;
+    }
+
+    fence->gridded = true;
+    fence->cellX0 = x0;
+    fence->cellX1 = x1;
+    fence->cellY0 = y0;
+    fence->cellY1 = y1;
+    for (int32_t x = x0; x <= x1; x++) {
+        for (int32_t y = y0; y <= y1; y++) {
+            LocGeofenceCell* cell = getCell(cellKey(x, y), true);
+            if (cell->count == cell->capacity) {
+                uint32_t capacity = cell->capacity ? cell->capacity * 2 : 4;
+                LocGeofenceFence** fences = (LocGeofenceFence**)
+                    realloc(cell->fences, capacity * sizeof(LocGeofenceFence*));
+                if (NULL == fences) {
+                    LOC_LOGE("%s: fence %d left out of the grid", __func__, fence->id);
+                    // takes it out of the cells it got in, and drops
+                    // this one if it was just created
+                    removeFromGrid(fence);
+                    return;
+                }
+                cell->fences = fences;
+                cell->capacity = capacity;
+            }
+            cell->fences[cell->count++] = fence;
+        }
+    }
+}
+
+void LocEngGeofence::removeFromGrid(LocGeofenceFence* fence)
+{
+    if (!fence->gridded) {
+        return;
+    }
+    for (int32_t x = fence->cellX0; x <= fence->cellX1; x++) {
+        for (int32_t y = fence->cellY0; y <= fence->cellY1; y++) {
+            LocGeofenceCell* cell = getCell(cellKey(x, y), false);
+            if (NULL == cell) {
+                continue;
+            }
+            for (uint32_t i = 0; i < cell->count; i++) {
+                if (cell->fences[i] == fence) {
+                    cell->fences[i] = cell->fences[--cell->count];
+                    break;
+                }
+            }
+            if (0 == cell->count) {
+                linked_list_intrusive_remove(&mCells, &cell->node);
+                free(cell->fences);
+                delete cell;
+            }
+        }
+    }
+    fence->gridded = false;
+}
+
+// A fix only finds the fences of its own cell, which is enough to enter
+// them. Those not in the grid, and those that may still have to be
+// exited or are not known to be out of, are tested on every fix.
+void LocEngGeofence::updateAlways(LocGeofenceFence* fence)
+{
+    bool always = !fence->paused &&
+        (!fence->gridded || LOC_GEOFENCE_EXITED != fence->state);
+    if (always && !fence->always) {
+        linked_list_intrusive_add(&mAlways, &fence->alwaysNode, 0);
+    } else if (!always && fence->always) {
+        linked_list_intrusive_remove(&mAlways, &fence->alwaysNode);
+    }
+    fence->always = always;
+}
+
+loc_geofence_status_e_type LocEngGeofence::add(int32_t id, double latitude,
+                                               double longitude, double radiusM,
+                                               uint32_t lastTransition,
+                                               uint32_t monitor, uint32_t dwellMs)
+{
+    if ((monitor & ~LOC_GEOFENCE_ALL_TRANSITIONS) ||
+        (LOC_GEOFENCE_ENTERED != lastTransition &&
+         LOC_GEOFENCE_EXITED != lastTransition &&
+         LOC_GEOFENCE_UNCERTAIN != lastTransition)) {
+        return LOC_GEOFENCE_ERROR_INVALID_TRANSITION;
+    }
+    if (!(radiusM > 0) || fabs(latitude) > 90.0 || fabs(longitude) > 180.0) {
+        return LOC_GEOFENCE_ERROR_GENERIC;
+    }
+    if (NULL != find(id)) {
+        return LOC_GEOFENCE_ERROR_ID_EXISTS;
+    }
+    if (mFences.count >= mMaxFences) {
+        return LOC_GEOFENCE_ERROR_TOO_MANY;
+    }
+
+    LocGeofenceFence* fence = new LocGeofenceFence();
+    fence->id = id;
+    fence->latitude = latitude;
+    fence->longitude = longitude;
+    fence->radius = radiusM;
+    fence->monitor = monitor;
+    fence->dwellMs = dwellMs;
+    fence->state = lastTransition;
+    fence->seq = mSeq;
+    linked_list_intrusive_add(&mFences, &fence->node, (uintptr_t)(uint32_t)id);
+    addToGrid(fence);
+    updateAlways(fence);
+    return LOC_GEOFENCE_SUCCESS;
+}
+
+loc_geofence_status_e_type LocEngGeofence::remove(int32_t id)
+{
+    LocGeofenceFence* fence = find(id);
+    if (NULL == fence) {
+        return LOC_GEOFENCE_ERROR_ID_UNKNOWN;
+    }
+    removeFromGrid(fence);
+    if (fence->always) {
+        linked_list_intrusive_remove(&mAlways, &fence->alwaysNode);
+    }
+    linked_list_intrusive_remove(&mFences, &fence->node);
+    delete fence;
+    return LOC_GEOFENCE_SUCCESS;
+}
+
+loc_geofence_status_e_type LocEngGeofence::pause(int32_t id)
+{
+    LocGeofenceFence* fence = find(id);
+    if (NULL == fence) {
+        return LOC_GEOFENCE_ERROR_ID_UNKNOWN;
+    }
+    fence->paused = true;
+    updateAlways(fence);
+    return LOC_GEOFENCE_SUCCESS;
+}
+
+loc_geofence_status_e_type LocEngGeofence::resume(int32_t id, uint32_t monitor)
+{
+    if (monitor & ~LOC_GEOFENCE_ALL_TRANSITIONS) {
+        return LOC_GEOFENCE_ERROR_INVALID_TRANSITION;
+    }
+    LocGeofenceFence* fence = find(id);
+    if (NULL == fence) {
+        return LOC_GEOFENCE_ERROR_ID_UNKNOWN;
+    }
+    fence->paused = false;
+    fence->monitor = monitor;
+    updateAlways(fence);
+    return LOC_GEOFENCE_SUCCESS;
+}
+
+void LocEngGeofence::report(LocGeofenceFence* fence, uint32_t transition,
+                            const GpsLocation& location)
+{
+    if ((fence->monitor & transition) && NULL != mTransitionCb) {
+        mTransitionCb(fence->id, transition, location, mData);
+    }
+}
+
+// distances are those of an equirectangular projection at the latitude
+// of the fix, well within the hysteresis for fences up to tens of km
+void LocEngGeofence::test(LocGeofenceFence* fence, const GpsLocation& location,
+                          double cosLat, double hysteresis)
+{
+    if (fence->seq == mSeq || fence->paused) {
+        return;
+    }
+    fence->seq = mSeq;
+    mTested++;
+
+    double dy = location.latitude - fence->latitude;
+    double dx = location.longitude - fence->longitude;
+    if (dx > 180.0) {
+        dx -= 360.0;
+    } else if (dx < -180.0) {
+        dx += 360.0;
+    }
+    dx *= cosLat;
+    double d2 = (dx * dx + dy * dy) * LOC_GEOFENCE_M_PER_DEG * LOC_GEOFENCE_M_PER_DEG;
+    // no wider than half the radius, or a fence no larger than the
+    // accuracy of the fixes could never be entered
+    if (hysteresis > fence->radius / 2) {
+        hysteresis = fence->radius / 2;
+    }
+    double inner = fence->radius - hysteresis;
+    double outer = fence->radius + hysteresis;
+
+    if (d2 <= inner * inner) {
+        if (LOC_GEOFENCE_ENTERED != fence->state) {
+            fence->state = LOC_GEOFENCE_ENTERED;
+            fence->enteredAt = location.timestamp;
+            fence->dwelt = false;
+            updateAlways(fence);
+            report(fence, LOC_GEOFENCE_ENTERED, location);
+        } else if (0 == fence->enteredAt) {
+            // known to be in since it was added
+            fence->enteredAt = location.timestamp;
+        }
+    } else if (d2 >= outer * outer) {
+        if (LOC_GEOFENCE_EXITED != fence->state) {
+            fence->state = LOC_GEOFENCE_EXITED;
+            updateAlways(fence);
+            report(fence, LOC_GEOFENCE_EXITED, location);
+        }
+    }
+
+    if (LOC_GEOFENCE_ENTERED == fence->state && !fence->dwelt &&
+        0 != fence->enteredAt &&
+        location.timestamp - fence->enteredAt >= (int64_t)fence->dwellMs) {
+        fence->dwelt = true;
+        report(fence, LOC_GEOFENCE_DWELL, location);
+    }
+}
+
+void LocEngGeofence::evaluate(const GpsLocation& location)
+{
+    mTested = 0;
+    if (!(location.flags & GPS_LOCATION_HAS_LAT_LONG)) {
+        return;
+    }
+    mSeq++;
+    double cosLat = cos(location.latitude * LOC_GEOFENCE_DEG_TO_RAD);
+    double hysteresis = LOC_GEOFENCE_HYSTERESIS_M;
+    if ((location.flags & GPS_LOCATION_HAS_ACCURACY) &&
+        location.accuracy > hysteresis) {
+        hysteresis = location.accuracy;
+    }
+
+    LocGeofenceCell* cell =
+        getCell(cellKey(cellOf(location.longitude), cellOf(location.latitude)),
+                false);
+    if (NULL != cell) {
+        for (uint32_t i = 0; i < cell->count; i++) {
+            test(cell->fences[i], location, cosLat, hysteresis);
+        }
+    }
+
+    linked_list_node* node = linked_list_intrusive_first(&mAlways);
+    while (NULL != node) {
+        // test() may take the fence out of the list
+        linked_list_node* next = linked_list_intrusive_next(&mAlways, node);
+        test(LINKED_LIST_CONTAINER_OF(node, LocGeofenceFence, alwaysNode),
+             location, cosLat, hysteresis);
+        node = next;
+    }
+}
+
+/*********************************************************************
+ * GpsGeofencingInterface of loc_eng
+ *********************************************************************/
+static int32_t loc_eng_geofence_gps_status(loc_geofence_status_e_type status)
+{
+    switch (status) {
+    case LOC_GEOFENCE_SUCCESS:
+        return GPS_GEOFENCE_OPERATION_SUCCESS;
+    case LOC_GEOFENCE_ERROR_TOO_MANY:
+        return GPS_GEOFENCE_ERROR_TOO_MANY_GEOFENCES;
+    case LOC_GEOFENCE_ERROR_ID_EXISTS:
+        return GPS_GEOFENCE_ERROR_ID_EXISTS;
+    case LOC_GEOFENCE_ERROR_ID_UNKNOWN:
+        return GPS_GEOFENCE_ERROR_ID_UNKNOWN;
+    case LOC_GEOFENCE_ERROR_INVALID_TRANSITION:
+        return GPS_GEOFENCE_ERROR_INVALID_TRANSITION;
+    default:
+        return GPS_GEOFENCE_ERROR_GENERIC;
+    }
+}
+
+// gps.h has no dwell transition, the framework is not told of those
+static void loc_eng_geofence_transition(int32_t id, uint32_t transition,
+                                        const GpsLocation& location, void* data)
+{
+    loc_eng_data_s_type* locEng = (loc_eng_data_s_type*)data;
+    if (LOC_GEOFENCE_DWELL != transition &&
+        NULL != locEng->geofence_cbs.geofence_transition_callback) {
+        locEng->geofence_cbs.geofence_transition_callback(
+            id, (GpsLocation*)&location, (int32_t)transition, location.timestamp);
+    }
+}
+
+struct LocEngGeofenceInit : public LocMsg {
+    loc_eng_data_s_type* mLocEng;
+    const GpsGeofenceCallbacks mCallbacks;
+    inline LocEngGeofenceInit(loc_eng_data_s_type* locEng,
+                              const GpsGeofenceCallbacks& callbacks) :
+        LocMsg(), mLocEng(locEng), mCallbacks(callbacks)
+    {
+        locallog();
+    }
+    inline virtual void proc() const {
+        mLocEng->geofence_cbs = mCallbacks;
+        if (NULL == mLocEng->geofence) {
+            mLocEng->geofence =
+                new LocEngGeofence(loc_eng_geofence_transition, mLocEng);
+        }
+    }
+    inline void locallog() const {
+        LOC_LOGV("LocEngGeofenceInit");
+    }
+    inline virtual void log() const {
+        locallog();
+    }
+};
+
+struct LocEngGeofenceRequest : public LocMsg {
+    enum Op { ADD, REMOVE, PAUSE, RESUME };
+    loc_eng_data_s_type* mLocEng;
+    const Op mOp;
+    const int32_t mId;
+    const double mLatitude;
+    const double mLongitude;
+    const double mRadius;
+    const uint32_t mLastTransition;
+    const uint32_t mMonitor;
+    inline LocEngGeofenceRequest(loc_eng_data_s_type* locEng, Op op,
+                                 int32_t id, double latitude = 0,
+                                 double longitude = 0, double radius = 0,
+                                 uint32_t lastTransition = 0,
+                                 uint32_t monitor = 0) :
+        LocMsg(), mLocEng(locEng), mOp(op), mId(id), mLatitude(latitude),
+        mLongitude(longitude), mRadius(radius),
+        mLastTransition(lastTransition), mMonitor(monitor)
+    {
+        locallog();
+    }
+    inline virtual void proc() const {
+        LocEngGeofence* geofence = mLocEng->geofence;
+        const GpsGeofenceCallbacks& cbs = mLocEng->geofence_cbs;
+        loc_geofence_status_e_type status = LOC_GEOFENCE_ERROR_GENERIC;
+        switch (mOp) {
+        case ADD:
+            if (NULL != geofence) {
+                status = geofence->add(mId, mLatitude, mLongitude, mRadius,
+                                       mLastTransition, mMonitor);
+            }
+            if (NULL != cbs.geofence_add_callback) {
+                cbs.geofence_add_callback(mId, loc_eng_geofence_gps_status(status));
+            }
+            break;
+        case REMOVE:
+            if (NULL != geofence) {
+                status = geofence->remove(mId);
+            }
+            if (NULL != cbs.geofence_remove_callback) {
+                cbs.geofence_remove_callback(mId, loc_eng_geofence_gps_status(status));
+            }
+            break;
+        case PAUSE:
+            if (NULL != geofence) {
+                status = geofence->pause(mId);
+            }
+            if (NULL != cbs.geofence_pause_callback) {
+                cbs.geofence_pause_callback(mId, loc_eng_geofence_gps_status(status));
+            }
+            break;
+        case RESUME:
+            if (NULL != geofence) {
+                status = geofence->resume(mId, mMonitor);
+            }
+            if (NULL != cbs.geofence_resume_callback) {
+                cbs.geofence_resume_callback(mId, loc_eng_geofence_gps_status(status));
+            }
+            break;
+        }
+    }
+    inline void locallog() const {
+        LOC_LOGV("LocEngGeofenceRequest - op: %d, id: %d", mOp, mId);
+    }
+    inline virtual void log() const {
+        locallog();
+    }
+};
+
+/*===========================================================================
+FUNCTION    loc_eng_geofence_init
+
+DESCRIPTION
+   Sets up the geofence evaluator of loc_eng, with the callbacks of the
+   framework.
+
+DEPENDENCIES
+   loc_eng_init() is done
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+void loc_eng_geofence_init(loc_eng_data_s_type &loc_eng_data,
+                           GpsGeofenceCallbacks* callbacks)
+{
+    ENTRY_LOG();
+    if (NULL == callbacks) {
+        LOC_LOGE("%s: failed, cb is NULL", __func__);
+    } else if (NULL == loc_eng_data.adapter) {
+        LOC_LOGE("%s: instance not initialized", __func__);
+    } else {
+        loc_eng_data.adapter->sendMsg(new LocEngGeofenceInit(&loc_eng_data,
+                                                             *callbacks));
+    }
+    EXIT_LOG(%s, VOID_RET);
+}
+
+void loc_eng_geofence_add(loc_eng_data_s_type &loc_eng_data, int32_t id,
+                          double latitude, double longitude,
+                          double radius_meters, int last_transition,
+                          int monitor_transitions)
+{
+    ENTRY_LOG();
+    if (NULL == loc_eng_data.adapter) {
+        LOC_LOGE("%s: instance not initialized", __func__);
+        return;
+    }
+    loc_eng_data.adapter->sendMsg(
+        new LocEngGeofenceRequest(&loc_eng_data, LocEngGeofenceRequest::ADD,
+                                  id, latitude, longitude, radius_meters,
+                                  last_transition, monitor_transitions));
+    EXIT_LOG(%s, VOID_RET);
+}
+
+void loc_eng_geofence_remove(loc_eng_data_s_type &loc_eng_data, int32_t id)
+{
+    ENTRY_LOG();
+    if (NULL == loc_eng_data.adapter) {
+        LOC_LOGE("%s: instance not initialized", __func__);
+        return;
+    }
+    loc_eng_data.adapter->sendMsg(
+        new LocEngGeofenceRequest(&loc_eng_data, LocEngGeofenceRequest::REMOVE, id));
+    EXIT_LOG(%s, VOID_RET);
+}
+
+void loc_eng_geofence_pause(loc_eng_data_s_type &loc_eng_data, int32_t id)
+{
+    ENTRY_LOG();
+    if (NULL == loc_eng_data.adapter) {
+        LOC_LOGE("%s: instance not initialized", __func__);
+        return;
+    }
+    loc_eng_data.adapter->sendMsg(
+        new LocEngGeofenceRequest(&loc_eng_data, LocEngGeofenceRequest::PAUSE, id));
+    EXIT_LOG(%s, VOID_RET);
+}
+
+void loc_eng_geofence_resume(loc_eng_data_s_type &loc_eng_data, int32_t id,
+                             int monitor_transitions)
+{
+    ENTRY_LOG();
+    if (NULL == loc_eng_data.adapter) {
+        LOC_LOGE("%s: instance not initialized", __func__);
+        return;
+    }
+    loc_eng_data.adapter->sendMsg(
+        new LocEngGeofenceRequest(&loc_eng_data, LocEngGeofenceRequest::RESUME,
+                                  id, 0, 0, 0, 0, monitor_transitions));
+    EXIT_LOG(%s, VOID_RET);
+}
+
+void loc_eng_geofence_report(loc_eng_data_s_type &loc_eng_data,
+                             const UlpLocation &location)
+{
+    if (NULL != loc_eng_data.geofence && loc_eng_data.geofence->getCount() > 0) {
+        loc_eng_data.geofence->evaluate(location.gpsLocation);
+    }
+}
+
+#ifdef __LOC_DEBUG__
+
+#include <stdio.h>
+#include <time.h>
+
+struct BenchCounts {
+    uint64_t transitions[4];
+    uint64_t checksum;
+};
+
+static uint32_t sFix = 0;
+
+static void benchTransition(int32_t id, uint32_t transition,
+                            const GpsLocation& location, void* data) {
+    BenchCounts* counts = (BenchCounts*)data;
+    for (int i = 0; i < 4; i++) {
+        if (transition == (1u << i)) {
+            counts->transitions[i]++;
+        }
+    }
+    // order free, the engines need not report a fix's transitions alike
+    counts->checksum += ((uint64_t)id * 2654435761u) ^
+                        ((uint64_t)sFix << 8 | transition);
+}
+
+static uint32_t sRand = 12345;
+static double benchRand() {
+    sRand = sRand * 1103515245 + 12345;
+    return (sRand >> 8) / (double)(1 << 24);
+}
+
+static const double BENCH_LAT = 37.4;
+static const double BENCH_LON = -122.1;
+// half the side of the area, in degrees
+static const double BENCH_SPAN = 0.1;
+
+static void addFences(LocEngGeofence& geofence, int fences) {
+    sRand = 12345;
+    for (int i = 0; i < fences; i++) {
+        double latitude = BENCH_LAT + (benchRand() * 2 - 1) * BENCH_SPAN;
+        double longitude = BENCH_LON + (benchRand() * 2 - 1) * BENCH_SPAN;
+        // a few fences too large for the grid
+        double radius = 0 == i % 500 ? 2000 + benchRand() * 3000 :
+                                       50 + benchRand() * 450;
+        geofence.add(i, latitude, longitude, radius, LOC_GEOFENCE_UNCERTAIN,
+                     LOC_GEOFENCE_ALL_TRANSITIONS, 0 == i % 4 ? 30000 : 0);
+    }
+}
+
+// a drive at 15 m/s, turning now and then, within the area; fixes at
+// 1 Hz with 3 to 30 m of accuracy, and as much noise
+static void makeRoute(GpsLocation* route, int fixes) {
+    double latitude = BENCH_LAT;
+    double longitude = BENCH_LON;
+    double heading = 0.5;
+    double cosLat = cos(BENCH_LAT * LOC_GEOFENCE_DEG_TO_RAD);
+    sRand = 777;
+    for (int i = 0; i < fixes; i++) {
+        if (benchRand() < 0.05) {
+            heading += (benchRand() * 2 - 1) * M_PI / 2;
+        }
+        latitude += 15 * cos(heading) / LOC_GEOFENCE_M_PER_DEG;
+        longitude += 15 * sin(heading) / LOC_GEOFENCE_M_PER_DEG / cosLat;
+        if (fabs(latitude - BENCH_LAT) > BENCH_SPAN ||
+            fabs(longitude - BENCH_LON) > BENCH_SPAN) {
+            heading += M_PI;
+        }
+        double accuracy = 3 + benchRand() * 27;
+        memset(&route[i], 0, sizeof(route[i]));
+        route[i].size = sizeof(route[i]);
+        route[i].flags = GPS_LOCATION_HAS_LAT_LONG | GPS_LOCATION_HAS_ACCURACY;
+        route[i].latitude = latitude +
+            (benchRand() * 2 - 1) * accuracy / LOC_GEOFENCE_M_PER_DEG;
+        route[i].longitude = longitude +
+            (benchRand() * 2 - 1) * accuracy / LOC_GEOFENCE_M_PER_DEG / cosLat;
+        route[i].accuracy = accuracy;
+        route[i].timestamp = 1400000000000LL + i * 1000LL;
+    }
+}
+
+static void run(const char* name, int32_t maxCellSpan, const GpsLocation* route,
+                int fixes, int fences, BenchCounts& counts) {
+    memset(&counts, 0, sizeof(counts));
+    LocEngGeofence geofence(benchTransition, &counts, fences, maxCellSpan);
+    addFences(geofence, fences);
+    uint64_t tested = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (sFix = 0; sFix < (uint32_t)fixes; sFix++) {
+        geofence.evaluate(route[sFix]);
+        tested += geofence.getTested();
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("%-12s %7.0f ns/fix, %8.1f fences tested/fix, "
+           "entered %llu exited %llu dwelt %llu\n",
+           name, ns / fixes, (double)tested / fixes,
+           (unsigned long long)counts.transitions[0],
+           (unsigned long long)counts.transitions[1],
+           (unsigned long long)counts.transitions[3]);
+}
+
+// For Linux command line testing:
+// compilation: g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -O2 -I. -I../../core -I../../utils -I../../utils/platform_lib_abstractions -I../../../../system/core/include loc_eng_geofence.cpp ../../utils/linked_list.c ../../utils/loc_log.cpp -lpthread
+// run: ./a.out <number of fences> <number of fixes>
+int main(int argc, char** argv) {
+    int fences = argc > 1 ? atoi(argv[1]) : 10000;
+    int fixes = argc > 2 ? atoi(argv[2]) : 100000;
+    GpsLocation* route = new GpsLocation[fixes];
+    makeRoute(route, fixes);
+
+    BenchCounts grid, brute;
+    run("grid", LOC_GEOFENCE_MAX_CELL_SPAN, route, fixes, fences, grid);
+    run("brute force", 0, route, fixes, fences, brute);
+    delete[] route;
+
+    if (0 != memcmp(&grid, &brute, sizeof(grid))) {
+        printf("FAILED: the grid and brute force transitions differ\n");
+        return 1;
+    }
+    printf("the grid and brute force transitions match\n");
+
+    // a fence smaller than the accuracy of the fixes at its center
+    BenchCounts small;
+    memset(&small, 0, sizeof(small));
+    LocEngGeofence geofence(benchTransition, &small, 1, LOC_GEOFENCE_MAX_CELL_SPAN);
+    geofence.add(0, BENCH_LAT, BENCH_LON, 20, LOC_GEOFENCE_UNCERTAIN,
+                 LOC_GEOFENCE_ALL_TRANSITIONS, 0);
+    GpsLocation center;
+    memset(&center, 0, sizeof(center));
+    center.size = sizeof(center);
+    center.flags = GPS_LOCATION_HAS_LAT_LONG | GPS_LOCATION_HAS_ACCURACY;
+    center.latitude = BENCH_LAT;
+    center.longitude = BENCH_LON;
+    center.accuracy = 30;
+    geofence.evaluate(center);
+    if (1 != small.transitions[0]) {
+        printf("FAILED: a 20 m fence is not entered with 30 m accuracy\n");
+        return 1;
+    }
+    return 0;
+}
+
+#endif // __LOC_DEBUG__
@@ -0,0 +1,156 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef LOC_ENG_GEOFENCE_H
+#define LOC_ENG_GEOFENCE_H
+
+#include <stdint.h>
+#include <hardware/gps.h>
+#include <gps_extended.h>
+#include <linked_list.h>
+
+// transitions; the first three are those of GPS_GEOFENCE_ENTERED etc.
+#define LOC_GEOFENCE_ENTERED   (1 << 0)
+#define LOC_GEOFENCE_EXITED    (1 << 1)
+#define LOC_GEOFENCE_UNCERTAIN (1 << 2)
+#define LOC_GEOFENCE_DWELL     (1 << 3)
+#define LOC_GEOFENCE_ALL_TRANSITIONS \
+    (LOC_GEOFENCE_ENTERED | LOC_GEOFENCE_EXITED | \
+     LOC_GEOFENCE_UNCERTAIN | LOC_GEOFENCE_DWELL)
+
+// upper bound of the fences of a LocEngGeofence
+#define LOC_GEOFENCE_MAX 10000
+// side of a grid cell, in degrees of latitude and of longitude
+#define LOC_GEOFENCE_CELL_DEG 0.01
+// fences spanning more cells than this on either axis, or close to a
+// pole or to the antimeridian, are not in the grid but tested every fix
+#define LOC_GEOFENCE_MAX_CELL_SPAN 8
+// least width of the band around the boundary in which a fence keeps
+// its state; fixes less accurate than this widen it to their accuracy
+#define LOC_GEOFENCE_HYSTERESIS_M 10.0
+
+typedef enum {
+    LOC_GEOFENCE_SUCCESS = 0,
+    LOC_GEOFENCE_ERROR_TOO_MANY,
+    LOC_GEOFENCE_ERROR_ID_EXISTS,
+    LOC_GEOFENCE_ERROR_ID_UNKNOWN,
+    LOC_GEOFENCE_ERROR_INVALID_TRANSITION,
+    LOC_GEOFENCE_ERROR_GENERIC
+} loc_geofence_status_e_type;
+
+typedef void (*loc_geofence_transition_cb)(int32_t id, uint32_t transition,
+                                           const GpsLocation& location,
+                                           void* data);
+
+struct LocGeofenceFence;
+struct LocGeofenceCell;
+
+// Evaluates circular geofences against fixes. Fences are kept in a
+// uniform grid of LOC_GEOFENCE_CELL_DEG cells, so that a fix is only
+// tested against the fences of its cell, plus those it is in or not
+// known to be out of. A fence is entered once the fix is LOC_GEOFENCE_
+// HYSTERESIS_M, or its accuracy, inside of the boundary, and exited
+// once it is as much outside; in between it keeps its state. A fence
+// dwelt in dwellMs after its entry reports LOC_GEOFENCE_DWELL once.
+// Not thread safe; loc_eng uses it on its MsgTask only. transitionCb
+// must not call back into the LocEngGeofence.
+class LocEngGeofence {
+    const loc_geofence_transition_cb mTransitionCb;
+    void* const mData;
+    const uint32_t mMaxFences;
+    const int32_t mMaxCellSpan;
+    // all fences, by id
+    linked_list_intrusive mFences;
+    // non empty cells, by cell key
+    linked_list_intrusive mCells;
+    // fences tested every fix, see updateAlways()
+    linked_list_intrusive mAlways;
+    // to test a fence once per fix
+    uint32_t mSeq;
+    uint32_t mTested;
+
+    LocGeofenceFence* find(int32_t id) const;
+    LocGeofenceCell* getCell(uintptr_t key, bool create);
+    void addToGrid(LocGeofenceFence* fence);
+    void removeFromGrid(LocGeofenceFence* fence);
+    void updateAlways(LocGeofenceFence* fence);
+    void test(LocGeofenceFence* fence, const GpsLocation& location,
+              double cosLat, double hysteresis);
+    void report(LocGeofenceFence* fence, uint32_t transition,
+                const GpsLocation& location);
+public:
+    // maxCellSpan: see LOC_GEOFENCE_MAX_CELL_SPAN; 0 tests every
+    //              fence every fix
+    LocEngGeofence(loc_geofence_transition_cb transitionCb, void* data,
+                   uint32_t maxFences = LOC_GEOFENCE_MAX,
+                   int32_t maxCellSpan = LOC_GEOFENCE_MAX_CELL_SPAN);
+    ~LocEngGeofence();
+
+    // lastTransition: what the fence is known as, LOC_GEOFENCE_ENTERED,
+    //                 _EXITED or _UNCERTAIN; transitions are reported as
+    //                 it changes from that
+    // monitor:        OR'ed transitions to report
+    // dwellMs:        for LOC_GEOFENCE_DWELL
+    loc_geofence_status_e_type add(int32_t id, double latitude,
+                                   double longitude, double radiusM,
+                                   uint32_t lastTransition, uint32_t monitor,
+                                   uint32_t dwellMs = 0);
+    loc_geofence_status_e_type remove(int32_t id);
+    // a paused fence is not evaluated, and keeps its state until resumed
+    loc_geofence_status_e_type pause(int32_t id);
+    loc_geofence_status_e_type resume(int32_t id, uint32_t monitor);
+
+    // evaluates the fences against a fix, with GPS_LOCATION_HAS_LAT_LONG,
+    // and reports their transitions to transitionCb
+    void evaluate(const GpsLocation& location);
+
+    inline uint32_t getCount() const { return mFences.count; }
+    // fences tested by the last evaluate()
+    inline uint32_t getTested() const { return mTested; }
+};
+
+typedef struct loc_eng_data_s loc_eng_data_s_type;
+
+// GpsGeofencingInterface of loc_eng, used when there is no libgeofence.
+// The calls are handed to the MsgTask, which makes the callbacks.
+void loc_eng_geofence_init(loc_eng_data_s_type &loc_eng_data,
+                           GpsGeofenceCallbacks* callbacks);
+void loc_eng_geofence_add(loc_eng_data_s_type &loc_eng_data, int32_t id,
+                          double latitude, double longitude,
+                          double radius_meters, int last_transition,
+                          int monitor_transitions);
+void loc_eng_geofence_remove(loc_eng_data_s_type &loc_eng_data, int32_t id);
+void loc_eng_geofence_pause(loc_eng_data_s_type &loc_eng_data, int32_t id);
+void loc_eng_geofence_resume(loc_eng_data_s_type &loc_eng_data, int32_t id,
+                             int monitor_transitions);
+// evaluates the fences against a fix; on the MsgTask
+void loc_eng_geofence_report(loc_eng_data_s_type &loc_eng_data,
+                             const UlpLocation &location);
+
+#endif // LOC_ENG_GEOFENCE_H
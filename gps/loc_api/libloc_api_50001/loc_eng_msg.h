@@ -86,20 +86,22 @@ struct LocEngStopFix : public LocMsg {
 
 struct LocEngReportPosition : public LocMsg {
     LocAdapterBase* mAdapter;
-    const UlpLocation mLocation;
-    const GpsLocationExtended mLocationExtended;
+    // the fix is not copied; the msg holds a share() of the report
+    LocPositionReport* const mReport;
+    const UlpLocation& mLocation;
+    const GpsLocationExtended& mLocationExtended;
     const void* mLocationExt;
     const enum loc_sess_status mStatus;
     const LocPosTechMask mTechMask;
     LocEngReportPosition(LocAdapterBase* adapter,
-                         UlpLocation &loc,
-                         GpsLocationExtended &locExtended,
-                         void* locExt,
-                         enum loc_sess_status st,
-                         LocPosTechMask technology);
+                         LocPositionReport* report);
+    virtual ~LocEngReportPosition();
     virtual void proc() const;
     void locallog() const;
     virtual void log() const;
+    inline virtual LocMsgPriority priority() const {
+        return LOC_MSG_PRIORITY_HIGH;
+    }
     void send() const;
 };
 
@@ -115,6 +117,10 @@ struct LocEngReportSv : public LocMsg {
     virtual void proc() const;
     void locallog() const;
     virtual void log() const;
+    // in the lane of the fixes: the NMEA of a fix needs the SVs used in it
+    inline virtual LocMsgPriority priority() const {
+        return LOC_MSG_PRIORITY_HIGH;
+    }
     void send() const;
 };
 
@@ -126,6 +132,9 @@ struct LocEngReportStatus : public LocMsg {
     virtual void proc() const;
     void locallog() const;
     virtual void log() const;
+    inline virtual LocMsgPriority priority() const {
+        return LOC_MSG_PRIORITY_HIGH;
+    }
 };
 
 struct LocEngReportNmea : public LocMsg {
@@ -141,6 +150,10 @@ struct LocEngReportNmea : public LocMsg {
     virtual void proc() const;
     void locallog() const;
     virtual void log() const;
+    // in the lane of the fixes, to stay in order with the HAL's own NMEA
+    inline virtual LocMsgPriority priority() const {
+        return LOC_MSG_PRIORITY_HIGH;
+    }
 };
 
 struct LocEngReportXtraServer : public LocMsg {
@@ -157,6 +170,9 @@ struct LocEngReportXtraServer : public LocMsg {
     virtual void proc() const;
     void locallog() const;
     virtual void log() const;
+    inline virtual LocMsgPriority priority() const {
+        return LOC_MSG_PRIORITY_LOW;
+    }
 };
 
 struct LocEngSuplEsOpened : public LocMsg {
@@ -242,6 +258,9 @@ struct LocEngRequestXtra : public LocMsg {
     virtual void proc() const;
     void locallog() const;
     virtual void log() const;
+    inline virtual LocMsgPriority priority() const {
+        return LOC_MSG_PRIORITY_LOW;
+    }
 };
 
 struct LocEngRequestTime : public LocMsg {
@@ -297,6 +316,9 @@ struct LocEngReportGpsMeasurement : public LocMsg {
     virtual void proc() const;
     void locallog() const;
     virtual void log() const;
+    inline virtual LocMsgPriority priority() const {
+        return LOC_MSG_PRIORITY_LOW;
+    }
 };
 
 #ifdef __cplusplus
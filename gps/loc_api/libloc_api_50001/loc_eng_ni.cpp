@@ -40,6 +40,7 @@
 #include <unistd.h>
 #include <time.h>
 #include <MsgTask.h>
+#include <loc_timer.h>
 
 #include <loc_eng.h>
 
@@ -54,12 +55,20 @@ using namespace loc_core;
  *
  *============================================================================*/
 
+/* NI request a response timer is running for */
+typedef struct {
+    loc_eng_ni_session_s_type* pSession;
+    int reqID;
+} loc_eng_ni_timeout_s_type;
+
 /*=============================================================================
  *
  *                             FUNCTION DECLARATIONS
  *
  *============================================================================*/
-static void* ni_thread_proc(void *args);
+static void ni_session_respond(loc_eng_ni_session_s_type* pSession, int reqID,
+                               GpsUserResponseType resp);
+static void ni_timeout_cb(void *user_data, int32_t result);
 
 struct LocEngInformNiResponse : public LocMsg {
     LocEngAdapter* mAdapter;
@@ -149,9 +158,11 @@ void loc_eng_ni_request_handler(loc_eng_data_s_type &loc_eng_data,
 
     if (pSession) {
         /* Save request */
+        pthread_mutex_lock(&pSession->tLock);
         pSession->rawRequest = (void*)passThrough;
         pSession->reqID = ++loc_eng_ni_data_p->reqIDCounter;
         pSession->adapter = loc_eng_data.adapter;
+        pthread_mutex_unlock(&pSession->tLock);
 
         /* Fill in notification */
         ((GpsNiNotification*)notif)->notification_id = pSession->reqID;
@@ -170,22 +181,26 @@ void loc_eng_ni_request_handler(loc_eng_data_s_type &loc_eng_data,
             LOC_LOGI("              extras: %s", notif->extras);
         }
 
-        /* For robustness, spawn a thread at this point to timeout to clear up the notification status, even though
-         * the OEM layer in java does not do so.
+        /* For robustness, start a timer at this point to timeout to clear up the notification status, even though
+         * the OEM layer in java does not do so. A timer that outlives its request finds
+         * the reqID of the session changed, and does nothing.
          **/
         pSession->respTimeLeft = 5 + (notif->timeout != 0 ? notif->timeout : LOC_NI_NO_RESPONSE_TIME);
         LOC_LOGI("Automatically sends 'no response' in %d seconds (to clear status)\n", pSession->respTimeLeft);
 
-        int rc = 0;
-        rc = pthread_create(&pSession->thread, NULL, ni_thread_proc, pSession);
-        if (rc)
+        loc_eng_ni_timeout_s_type* timeout =
+            (loc_eng_ni_timeout_s_type*)malloc(sizeof(loc_eng_ni_timeout_s_type));
+        if (NULL != timeout)
         {
-            LOC_LOGE("Loc NI thread is not created.\n");
+            timeout->pSession = pSession;
+            timeout->reqID = pSession->reqID;
         }
-        rc = pthread_detach(pSession->thread);
-        if (rc)
+        if (NULL == timeout ||
+            NULL == loc_timer_start(pSession->respTimeLeft * 1000, ni_timeout_cb, timeout,
+                                    false, true))
         {
-            LOC_LOGE("Loc NI thread is not detached.\n");
+            LOC_LOGE("Loc NI timer is not started.\n");
+            free(timeout);
         }
 
         CALLBACK_LOG_CALLFLOW("ni_notify_cb - id", %d, notif->notification_id);
@@ -196,76 +211,71 @@ void loc_eng_ni_request_handler(loc_eng_data_s_type &loc_eng_data,
 
 /*===========================================================================
 
-FUNCTION ni_thread_proc
+FUNCTION ni_session_respond
+
+DESCRIPTION
+   Sends the response to the NI request of the session, and ends the session.
+   Does nothing if the session no longer is on request reqID, i.e. it has
+   been responded to already, or cleared upon modem restart.
+
+RETURN VALUE
+   none
 
 ===========================================================================*/
-static void* ni_thread_proc(void *args)
+static void ni_session_respond(loc_eng_ni_session_s_type* pSession, int reqID,
+                               GpsUserResponseType resp)
 {
     ENTRY_LOG();
 
-    loc_eng_ni_session_s_type* pSession = (loc_eng_ni_session_s_type*)args;
-    int rc = 0;          /* return code from pthread calls */
-
-    struct timeval present_time;
-    struct timespec expire_time;
-
-    LOC_LOGD("Starting Loc NI thread...\n");
-    pthread_mutex_lock(&pSession->tLock);
-    /* Calculate absolute expire time */
-    gettimeofday(&present_time, NULL);
-    expire_time.tv_sec  = present_time.tv_sec + pSession->respTimeLeft;
-    expire_time.tv_nsec = present_time.tv_usec * 1000;
-    LOC_LOGD("ni_thread_proc-Time out set for abs time %ld with delay %d sec\n",
-             (long) expire_time.tv_sec, pSession->respTimeLeft );
-
-    while (!pSession->respRecvd)
-    {
-        rc = pthread_cond_timedwait(&pSession->tCond,
-                                    &pSession->tLock,
-                                    &expire_time);
-        if (rc == ETIMEDOUT)
-        {
-            pSession->resp = GPS_NI_RESPONSE_NORESP;
-            LOC_LOGD("ni_thread_proc-Thread time out after valting for specified time. Ret Val %d\n",rc );
-            break;
-        }
-    }
-    LOC_LOGD("ni_thread_proc-Java layer has sent us a user response and return value from "
-             "pthread_cond_timedwait = %d\n",rc );
-    pSession->respRecvd = FALSE; /* Reset the user response flag for the next session*/
-
-    LOC_LOGD("pSession->resp is %d\n",pSession->resp);
-
-    // adding this check to support modem restart, in which case, we need the thread
-    // to exit without calling sending data. We made sure that rawRequest is NULL in
-    // loc_eng_ni_reset_on_engine_restart()
-    LocEngAdapter* adapter = pSession->adapter;
+    LocEngAdapter* adapter = NULL;
     LocEngInformNiResponse *msg = NULL;
 
-    if (NULL != pSession->rawRequest) {
-        if (pSession->resp != GPS_NI_RESPONSE_IGNORE) {
-            LOC_LOGD("pSession->resp != GPS_NI_RESPONSE_IGNORE \n");
+    pthread_mutex_lock(&pSession->tLock);
+    if (NULL != pSession->rawRequest && reqID == pSession->reqID) {
+        LOC_LOGD("ni_session_respond: resp is %d for request %d\n", resp, reqID);
+        adapter = pSession->adapter;
+        if (resp != GPS_NI_RESPONSE_IGNORE) {
+            LOC_LOGD("resp != GPS_NI_RESPONSE_IGNORE \n");
             msg = new LocEngInformNiResponse(adapter,
-                                             pSession->resp,
+                                             resp,
                                              pSession->rawRequest);
         } else {
             LOC_LOGD("this is the ignore reply for SUPL ES\n");
             free(pSession->rawRequest);
         }
         pSession->rawRequest = NULL;
+        pSession->respTimeLeft = 0;
+        pSession->reqID = 0;
     }
     pthread_mutex_unlock(&pSession->tLock);
 
-    pSession->respTimeLeft = 0;
-    pSession->reqID = 0;
-
     if (NULL != msg) {
-        LOC_LOGD("ni_thread_proc: adapter->sendMsg(msg)\n");
+        LOC_LOGD("ni_session_respond: adapter->sendMsg(msg)\n");
         adapter->sendMsg(msg);
     }
 
     EXIT_LOG(%s, VOID_RET);
-    return NULL;
+}
+
+/*===========================================================================
+
+FUNCTION ni_timeout_cb
+
+DESCRIPTION
+   Sends 'no response' to the NI request the timer was started for, if the
+   user has not responded to it yet.
+
+RETURN VALUE
+   none
+
+===========================================================================*/
+static void ni_timeout_cb(void *user_data, int32_t result)
+{
+    loc_eng_ni_timeout_s_type* timeout = (loc_eng_ni_timeout_s_type*)user_data;
+
+    LOC_LOGD("ni_timeout_cb: request %d timed out, result %d\n", timeout->reqID, result);
+    ni_session_respond(timeout->pSession, timeout->reqID, GPS_NI_RESPONSE_NORESP);
+    free(timeout);
 }
 
 void loc_eng_ni_reset_on_engine_restart(loc_eng_data_s_type &loc_eng_data)
@@ -279,27 +289,22 @@ void loc_eng_ni_reset_on_engine_restart(loc_eng_data_s_type &loc_eng_data)
     }
 
     // only if modem has requested but then died.
+    // the timers still running find no request, and send nothing.
     if (NULL != loc_eng_ni_data_p->sessionEs.rawRequest) {
+        pthread_mutex_lock(&loc_eng_ni_data_p->sessionEs.tLock);
         free(loc_eng_ni_data_p->sessionEs.rawRequest);
         loc_eng_ni_data_p->sessionEs.rawRequest = NULL;
-
-        pthread_mutex_lock(&loc_eng_ni_data_p->sessionEs.tLock);
-        // the goal is to wake up ni_thread_proc
-        // and let it exit.
-        loc_eng_ni_data_p->sessionEs.respRecvd = TRUE;
-        pthread_cond_signal(&loc_eng_ni_data_p->sessionEs.tCond);
+        loc_eng_ni_data_p->sessionEs.respTimeLeft = 0;
+        loc_eng_ni_data_p->sessionEs.reqID = 0;
         pthread_mutex_unlock(&loc_eng_ni_data_p->sessionEs.tLock);
     }
 
     if (NULL != loc_eng_ni_data_p->session.rawRequest) {
+        pthread_mutex_lock(&loc_eng_ni_data_p->session.tLock);
         free(loc_eng_ni_data_p->session.rawRequest);
         loc_eng_ni_data_p->session.rawRequest = NULL;
-
-        pthread_mutex_lock(&loc_eng_ni_data_p->session.tLock);
-        // the goal is to wake up ni_thread_proc
-        // and let it exit.
-        loc_eng_ni_data_p->session.respRecvd = TRUE;
-        pthread_cond_signal(&loc_eng_ni_data_p->session.tCond);
+        loc_eng_ni_data_p->session.respTimeLeft = 0;
+        loc_eng_ni_data_p->session.reqID = 0;
         pthread_mutex_unlock(&loc_eng_ni_data_p->session.tLock);
     }
 
@@ -335,17 +340,13 @@ void loc_eng_ni_init(loc_eng_data_s_type &loc_eng_data, GpsNiExtCallbacks *callb
     } else {
         loc_eng_ni_data_s_type* loc_eng_ni_data_p = &loc_eng_data.loc_eng_ni_data;
         loc_eng_ni_data_p->sessionEs.respTimeLeft = 0;
-        loc_eng_ni_data_p->sessionEs.respRecvd = FALSE;
         loc_eng_ni_data_p->sessionEs.rawRequest = NULL;
         loc_eng_ni_data_p->sessionEs.reqID = 0;
-        pthread_cond_init(&loc_eng_ni_data_p->sessionEs.tCond, NULL);
         pthread_mutex_init(&loc_eng_ni_data_p->sessionEs.tLock, NULL);
 
         loc_eng_ni_data_p->session.respTimeLeft = 0;
-        loc_eng_ni_data_p->session.respRecvd = FALSE;
         loc_eng_ni_data_p->session.rawRequest = NULL;
         loc_eng_ni_data_p->session.reqID = 0;
-        pthread_cond_init(&loc_eng_ni_data_p->session.tCond, NULL);
         pthread_mutex_init(&loc_eng_ni_data_p->session.tLock, NULL);
 
         loc_eng_data.ni_notify_cb = callbacks->notify_cb;
@@ -387,11 +388,9 @@ void loc_eng_ni_respond(loc_eng_data_s_type &loc_eng_data,
         // ignore any SUPL NI non-Es session if a SUPL NI ES is accepted
         if (user_response == GPS_NI_RESPONSE_ACCEPT &&
             NULL != loc_eng_ni_data_p->session.rawRequest) {
-                pthread_mutex_lock(&loc_eng_ni_data_p->session.tLock);
-                loc_eng_ni_data_p->session.resp = GPS_NI_RESPONSE_IGNORE;
-                loc_eng_ni_data_p->session.respRecvd = TRUE;
-                pthread_cond_signal(&loc_eng_ni_data_p->session.tCond);
-                pthread_mutex_unlock(&loc_eng_ni_data_p->session.tLock);
+                ni_session_respond(&loc_eng_ni_data_p->session,
+                                   loc_eng_ni_data_p->session.reqID,
+                                   GPS_NI_RESPONSE_IGNORE);
         }
     } else if (notif_id == loc_eng_ni_data_p->session.reqID &&
         NULL != loc_eng_ni_data_p->session.rawRequest) {
@@ -400,11 +399,7 @@ void loc_eng_ni_respond(loc_eng_data_s_type &loc_eng_data,
 
     if (pSession) {
         LOC_LOGI("loc_eng_ni_respond: send user response %d for notif %d", user_response, notif_id);
-        pthread_mutex_lock(&pSession->tLock);
-        pSession->resp = user_response;
-        pSession->respRecvd = TRUE;
-        pthread_cond_signal(&pSession->tCond);
-        pthread_mutex_unlock(&pSession->tLock);
+        ni_session_respond(pSession, notif_id, user_response);
     }
     else {
         LOC_LOGE("loc_eng_ni_respond: notif_id %d not an active session", notif_id);
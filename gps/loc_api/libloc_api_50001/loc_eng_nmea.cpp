@@ -38,6 +38,127 @@
 #include <math.h>
 #include "log_util.h"
 
+// Formats one NMEA sentence straight into the caller's buffer, with the
+// checksum accumulated as the bytes are written. The emitters produce the
+// same characters as the printf conversions noted on each of them, without
+// going through the printf machinery. Writing beyond the buffer is dropped,
+// and reported by finish().
+class NmeaWriter {
+    char* mBuf;
+    int mSize;
+    int mLength;
+    uint8_t mChecksum;
+    bool mOverflow;
+
+    // emits the lowest digits digits of value, most significant first
+    inline void putDigits(uint64_t value, int digits) {
+        if (mLength + digits < mSize) {
+            for (int i = mLength + digits - 1; i >= mLength; i--) {
+                char c = '0' + (char)(value % 10);
+                mBuf[i] = c;
+                mChecksum ^= c;
+                value /= 10;
+            }
+            mLength += digits;
+        } else {
+            mOverflow = true;
+        }
+    }
+    static inline int countDigits(uint64_t value) {
+        int digits = 1;
+        while (value >= 10) {
+            value /= 10;
+            digits++;
+        }
+        return digits;
+    }
+public:
+    // sentences start with '$', which is not covered by the checksum;
+    // starting the checksum with '$' cancels it out.
+    inline NmeaWriter(char* buf, int size) :
+        mBuf(buf), mSize(size), mLength(0), mChecksum('$'), mOverflow(false) {}
+
+    inline void putChar(char c) {
+        if (mLength + 1 < mSize) {
+            mBuf[mLength++] = c;
+            mChecksum ^= c;
+        } else {
+            mOverflow = true;
+        }
+    }
+
+    inline void putStr(const char* str) {
+        while (*str) {
+            putChar(*str++);
+        }
+    }
+
+    // "%0<width>d"
+    inline void putInt(int value, int width) {
+        uint64_t magnitude = value;
+        if (value < 0) {
+            putChar('-');
+            magnitude = -(int64_t)value;
+            width--;
+        }
+        int digits = countDigits(magnitude);
+        putDigits(magnitude, digits > width ? digits : width);
+    }
+
+    // "%0<width>.<decimals>f", for decimals up to 6. A value that is too large,
+    // or too close to half way between two outputs for the double arithmetic
+    // to round it the way printf does, is handed to snprintf.
+    void putFixed(double value, int decimals, int width) {
+        static const double sScales[] = { 1, 10, 100, 1e3, 1e4, 1e5, 1e6 };
+        double scaled = fabs(value) * sScales[decimals];
+        if (scaled < 1e9) {
+            uint64_t rounded = (uint64_t)scaled;
+            double fraction = scaled - (double)rounded;
+            if (fabs(fraction - 0.5) > 1e-6) {
+                if (fraction > 0.5) {
+                    rounded++;
+                }
+                uint64_t unit = (uint64_t)sScales[decimals];
+                uint64_t integer = rounded / unit;
+                if (signbit(value)) {
+                    putChar('-');
+                    width--;
+                }
+                int digits = countDigits(integer);
+                width -= decimals + 1;
+                putDigits(integer, digits > width ? digits : width);
+                putChar('.');
+                putDigits(rounded % unit, decimals);
+                return;
+            }
+        }
+        char str[64];
+        snprintf(str, sizeof(str), "%0*.*f", width, decimals, value);
+        putStr(str);
+    }
+
+    // "%.1f"
+    inline void putFixed1(double value) { putFixed(value, 1, 0); }
+
+    // appends "*<checksum>\r\n" and the terminating null.
+    // returns the length of the sentence, or -1 if it did not fit.
+    int finish() {
+        static const char sHex[] = "0123456789ABCDEF";
+        uint8_t checksum = mChecksum;
+        if (mLength + 5 < mSize && !mOverflow) {
+            mBuf[mLength++] = '*';
+            mBuf[mLength++] = sHex[checksum >> 4];
+            mBuf[mLength++] = sHex[checksum & 0xf];
+            mBuf[mLength++] = '\r';
+            mBuf[mLength++] = '\n';
+            mBuf[mLength] = '\0';
+            return mLength;
+        }
+        mBuf[mSize - 1] = '\0';
+        return -1;
+    }
+};
+
 /*===========================================================================
 FUNCTION    loc_eng_nmea_send
 
@@ -103,6 +224,214 @@ int loc_eng_nmea_put_checksum(char *pNmea, int maxSize)
     return (length + checksumLength + 1);
 }
 
+/*===========================================================================
+FUNCTION    loc_eng_nmea_is_due
+
+DESCRIPTION
+   Check if a sentence is to be generated for the report at hand, i.e. it
+   is selected by NMEA_SENTENCE_MASK, and its NMEA_<sentence>_INTERVAL has
+   elapsed since it was last sent. Marks the sentence as sent if so.
+   A report may arrive a little early for the interval; the slack keeps
+   e.g. a 1000 ms interval at 1 Hz with 10 Hz fixes, rather than 1.1 s.
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   true if the sentence is to be generated and sent
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+#define LOC_NMEA_INTERVAL_SLACK_MS 50
+
+static bool loc_eng_nmea_is_due(loc_eng_data_s_type *loc_eng_data_p,
+                                loc_eng_nmea_sentence_e_type sentence,
+                                int64_t nowMs)
+{
+    if (!(gps_conf.NMEA_SENTENCE_MASK & (1 << sentence)))
+        return false;
+
+    uint32_t interval = 0;
+    switch (sentence) {
+    case LOC_NMEA_GGA: interval = gps_conf.NMEA_GGA_INTERVAL; break;
+    case LOC_NMEA_RMC: interval = gps_conf.NMEA_RMC_INTERVAL; break;
+    case LOC_NMEA_GSA: interval = gps_conf.NMEA_GSA_INTERVAL; break;
+    case LOC_NMEA_VTG: interval = gps_conf.NMEA_VTG_INTERVAL; break;
+    case LOC_NMEA_GSV: interval = gps_conf.NMEA_GSV_INTERVAL; break;
+    default: break;
+    }
+
+    int64_t &lastSent = loc_eng_data_p->nmea_last_sent[sentence];
+    if (interval > 0 && lastSent != 0 &&
+        nowMs - lastSent + LOC_NMEA_INTERVAL_SLACK_MS < (int64_t)interval)
+        return false;
+
+    lastSent = nowMs;
+    return true;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_get_time_ms
+
+DESCRIPTION
+   Time base of the sentence intervals, ms of CLOCK_BOOTTIME
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   ms since boot
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int64_t loc_eng_nmea_get_time_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_put_lat_long
+
+DESCRIPTION
+   Write the latitude / longitude fields shared by $GPRMC and $GPGGA:
+   "ddmm.mmmmmm,N,dddmm.mmmmmm,E,", or ",,,," if there is no position.
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_nmea_put_lat_long(NmeaWriter &writer, const UlpLocation &location)
+{
+    if (location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG)
+    {
+        double latitude = location.gpsLocation.latitude;
+        double longitude = location.gpsLocation.longitude;
+        char latHemisphere;
+        char lonHemisphere;
+        double latMinutes;
+        double lonMinutes;
+
+        if (latitude > 0)
+        {
+            latHemisphere = 'N';
+        }
+        else
+        {
+            latHemisphere = 'S';
+            latitude *= -1.0;
+        }
+
+        if (longitude < 0)
+        {
+            lonHemisphere = 'W';
+            longitude *= -1.0;
+        }
+        else
+        {
+            lonHemisphere = 'E';
+        }
+
+        latMinutes = fmod(latitude * 60.0 , 60.0);
+        lonMinutes = fmod(longitude * 60.0 , 60.0);
+
+        writer.putInt((uint8_t)floor(latitude), 2);
+        writer.putFixed(latMinutes, 6, 9);
+        writer.putChar(',');
+        writer.putChar(latHemisphere);
+        writer.putChar(',');
+        writer.putInt((uint8_t)floor(longitude), 3);
+        writer.putFixed(lonMinutes, 6, 9);
+        writer.putChar(',');
+        writer.putChar(lonHemisphere);
+        writer.putChar(',');
+    }
+    else
+    {
+        writer.putStr(",,,,");
+    }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_put_dops
+
+DESCRIPTION
+   Write the "p.p,h.h,v.v" DOP fields of $GPGSA / $GNGSA, from the position
+   report (QMI) or from the cache of the sv report (RPC); or ",," if neither
+   has them.
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_nmea_put_dops(NmeaWriter &writer,
+                                  loc_eng_data_s_type *loc_eng_data_p,
+                                  const GpsLocationExtended &locationExtended)
+{
+    if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_DOP)
+    {   // dop is in locationExtended, (QMI)
+        writer.putFixed1(locationExtended.pdop);
+        writer.putChar(',');
+        writer.putFixed1(locationExtended.hdop);
+        writer.putChar(',');
+        writer.putFixed1(locationExtended.vdop);
+    }
+    else if (loc_eng_data_p->pdop > 0 && loc_eng_data_p->hdop > 0 && loc_eng_data_p->vdop > 0)
+    {   // dop was cached from sv report (RPC)
+        writer.putFixed1(loc_eng_data_p->pdop);
+        writer.putChar(',');
+        writer.putFixed1(loc_eng_data_p->hdop);
+        writer.putChar(',');
+        writer.putFixed1(loc_eng_data_p->vdop);
+    }
+    else
+    {   // no dop
+        writer.putStr(",,");
+    }
+}
+
+/*===========================================================================
+FUNCTION    loc_eng_nmea_send_blank
+
+DESCRIPTION
+   Send out a sentence with no data to format, after adding its checksum
+
+DEPENDENCIES
+   NONE
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void loc_eng_nmea_send_blank(const char *pNmea, loc_eng_data_s_type *loc_eng_data_p)
+{
+    char sentence[NMEA_SENTENCE_MAX_LENGTH];
+    NmeaWriter writer(sentence, sizeof(sentence));
+    writer.putStr(pNmea);
+    int length = writer.finish();
+    loc_eng_nmea_send(sentence, length, loc_eng_data_p);
+}
+
 /*===========================================================================
 FUNCTION    loc_eng_nmea_generate_pos
 
@@ -132,15 +461,14 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
 {
     ENTRY_LOG();
     time_t utcTime(location.gpsLocation.timestamp/1000);
-    tm * pTm = gmtime(&utcTime);
+    struct tm tmUtc;
+    tm * pTm = gmtime_r(&utcTime, &tmUtc);
     if (NULL == pTm) {
         LOC_LOGE("gmtime failed");
         return;
     }
 
-    char sentence[NMEA_SENTENCE_MAX_LENGTH] = {};
-    char* pMarker = sentence;
-    int lengthRemaining = sizeof(sentence);
+    char sentence[NMEA_SENTENCE_MAX_LENGTH];
     int length = 0;
     int utcYear = pTm->tm_year % 100; // 2 digit year
     int utcMonth = pTm->tm_mon + 1; // tm_mon starts at zero
@@ -148,11 +476,15 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
     int utcHours = pTm->tm_hour;
     int utcMinutes = pTm->tm_min;
     int utcSeconds = pTm->tm_sec;
+    int64_t nowMs = loc_eng_nmea_get_time_ms();
 
     if (generate_nmea) {
         // ------------------
         // ------$GPGSA------
         // ------------------
+        // $GPGSA and $GNGSA go together; the svs used in fix are still
+        // parsed for $GPGGA, and their caches cleared, if they are not due.
+        bool gsaDue = loc_eng_nmea_is_due(loc_eng_data_p, LOC_NMEA_GSA, nowMs);
 
         uint32_t svUsedCount = 0;
         uint32_t svUsedList[32] = {};
@@ -174,54 +506,31 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
         else
             fixType = '3'; // 3D fix
 
-        length = snprintf(pMarker, lengthRemaining, "$GPGSA,A,%c,", fixType);
-
-        if (length < 0 || length >= lengthRemaining)
+        if (gsaDue)
         {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+            NmeaWriter gsa(sentence, sizeof(sentence));
+            gsa.putStr("$GPGSA,A,");
+            gsa.putChar(fixType);
+            gsa.putChar(',');
 
-        for (uint8_t i = 0; i < 12; i++) // only the first 12 sv go in sentence
-        {
-            if (i < svUsedCount)
-                length = snprintf(pMarker, lengthRemaining, "%02d,", svUsedList[i]);
-            else
-                length = snprintf(pMarker, lengthRemaining, ",");
+            for (uint8_t i = 0; i < 12; i++) // only the first 12 sv go in sentence
+            {
+                if (i < svUsedCount)
+                    gsa.putInt(svUsedList[i], 2);
+                gsa.putChar(',');
+            }
+
+            loc_eng_nmea_put_dops(gsa, loc_eng_data_p, locationExtended);
 
-            if (length < 0 || length >= lengthRemaining)
+            length = gsa.finish();
+            if (length < 0)
             {
                 LOC_LOGE("NMEA Error in string formatting");
                 return;
             }
-            pMarker += length;
-            lengthRemaining -= length;
-        }
-
-        if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_DOP)
-        {   // dop is in locationExtended, (QMI)
-            length = snprintf(pMarker, lengthRemaining, "%.1f,%.1f,%.1f",
-                              locationExtended.pdop,
-                              locationExtended.hdop,
-                              locationExtended.vdop);
-        }
-        else if (loc_eng_data_p->pdop > 0 && loc_eng_data_p->hdop > 0 && loc_eng_data_p->vdop > 0)
-        {   // dop was cached from sv report (RPC)
-            length = snprintf(pMarker, lengthRemaining, "%.1f,%.1f,%.1f",
-                              loc_eng_data_p->pdop,
-                              loc_eng_data_p->hdop,
-                              loc_eng_data_p->vdop);
-        }
-        else
-        {   // no dop
-            length = snprintf(pMarker, lengthRemaining, ",,");
+            loc_eng_nmea_send(sentence, length, loc_eng_data_p);
         }
 
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-
         // ------------------
         // ------$GNGSA------
         // ------------------
@@ -229,8 +538,6 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
         uint32_t gloUsedList[32] = {0};
 
         // Reset locals for GNGSA sentence generation
-        pMarker = sentence;
-        lengthRemaining = sizeof(sentence);
         mask = loc_eng_data_p->glo_used_mask;
         fixType = '\0';
 
@@ -254,437 +561,261 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
         else
             fixType = '3'; // 3D fix
 
-        // Start printing the sentence
-        // Format: $--GSA,a,x,xx,xx,xx,xx,xx,xx,xx,xx,xx,xx,xx,xx,p.p,h.h,v.v*cc
-        // GNGSA : for glonass SVs
-        // a : Mode  : A : Automatic, allowed to automatically switch 2D/3D
-        // x : Fixtype : 1 (no fix), 2 (2D fix), 3 (3D fix)
-        // xx : 12 SV ID
-        // p.p : Position DOP (Dilution of Precision)
-        // h.h : Horizontal DOP
-        // v.v : Vertical DOP
-        // cc : Checksum value
-        length = snprintf(pMarker, lengthRemaining, "$GNGSA,A,%c,", fixType);
-
-        if (length < 0 || length >= lengthRemaining)
+        if (gsaDue)
         {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+            // Start printing the sentence
+            // Format: $--GSA,a,x,xx,xx,xx,xx,xx,xx,xx,xx,xx,xx,xx,xx,p.p,h.h,v.v*cc
+            // GNGSA : for glonass SVs
+            // a : Mode  : A : Automatic, allowed to automatically switch 2D/3D
+            // x : Fixtype : 1 (no fix), 2 (2D fix), 3 (3D fix)
+            // xx : 12 SV ID
+            // p.p : Position DOP (Dilution of Precision)
+            // h.h : Horizontal DOP
+            // v.v : Vertical DOP
+            // cc : Checksum value
+            NmeaWriter gngsa(sentence, sizeof(sentence));
+            gngsa.putStr("$GNGSA,A,");
+            gngsa.putChar(fixType);
+            gngsa.putChar(',');
+
+            // Add first 12 GLONASS satellite IDs
+            for (uint8_t i = 0; i < 12; i++)
+            {
+                if (i < gloUsedCount)
+                    gngsa.putInt(gloUsedList[i], 2);
+                gngsa.putChar(',');
+            }
 
-        // Add first 12 GLONASS satellite IDs
-        for (uint8_t i = 0; i < 12; i++)
-        {
-            if (i < gloUsedCount)
-                length = snprintf(pMarker, lengthRemaining, "%02d,", gloUsedList[i]);
-            else
-                length = snprintf(pMarker, lengthRemaining, ",");
+            // Add the position/horizontal/vertical DOP values
+            loc_eng_nmea_put_dops(gngsa, loc_eng_data_p, locationExtended);
 
-            if (length < 0 || length >= lengthRemaining)
+            /* Sentence is ready, add checksum and broadcast */
+            length = gngsa.finish();
+            if (length < 0)
             {
                 LOC_LOGE("NMEA Error in string formatting");
                 return;
             }
-            pMarker += length;
-            lengthRemaining -= length;
-        }
-
-        // Add the position/horizontal/vertical DOP values
-        if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_DOP)
-        {   // dop is in locationExtended, (QMI)
-            length = snprintf(pMarker, lengthRemaining, "%.1f,%.1f,%.1f",
-                              locationExtended.pdop,
-                              locationExtended.hdop,
-                              locationExtended.vdop);
-        }
-        else if (loc_eng_data_p->pdop > 0 && loc_eng_data_p->hdop > 0 && loc_eng_data_p->vdop > 0)
-        {   // dop was cached from sv report (RPC)
-            length = snprintf(pMarker, lengthRemaining, "%.1f,%.1f,%.1f",
-                              loc_eng_data_p->pdop,
-                              loc_eng_data_p->hdop,
-                              loc_eng_data_p->vdop);
-        }
-        else
-        {   // no dop
-            length = snprintf(pMarker, lengthRemaining, ",,");
+            loc_eng_nmea_send(sentence, length, loc_eng_data_p);
         }
 
-        /* Sentence is ready, add checksum and broadcast */
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-
         // ------------------
         // ------$GPVTG------
         // ------------------
 
-        pMarker = sentence;
-        lengthRemaining = sizeof(sentence);
-
-        if (location.gpsLocation.flags & GPS_LOCATION_HAS_BEARING)
-        {
-            float magTrack = location.gpsLocation.bearing;
-            if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_MAG_DEV)
-            {
-                float magTrack = location.gpsLocation.bearing - locationExtended.magneticDeviation;
-                if (magTrack < 0.0)
-                    magTrack += 360.0;
-                else if (magTrack > 360.0)
-                    magTrack -= 360.0;
-            }
-
-            length = snprintf(pMarker, lengthRemaining, "$GPVTG,%.1lf,T,%.1lf,M,", location.gpsLocation.bearing, magTrack);
-        }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining, "$GPVTG,,T,,M,");
-        }
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
-
-        if (location.gpsLocation.flags & GPS_LOCATION_HAS_SPEED)
-        {
-            float speedKnots = location.gpsLocation.speed * (3600.0/1852.0);
-            float speedKmPerHour = location.gpsLocation.speed * 3.6;
-
-            length = snprintf(pMarker, lengthRemaining, "%.1lf,N,%.1lf,K,", speedKnots, speedKmPerHour);
-        }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining, ",N,,K,");
-        }
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
-
-        if (!(location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG))
-            length = snprintf(pMarker, lengthRemaining, "%c", 'N'); // N means no fix
-        else if (LOC_POSITION_MODE_STANDALONE == loc_eng_data_p->adapter->getPositionMode().mode)
-            length = snprintf(pMarker, lengthRemaining, "%c", 'A'); // A means autonomous
-        else
-            length = snprintf(pMarker, lengthRemaining, "%c", 'D'); // D means differential
-
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-
-        // ------------------
-        // ------$GPRMC------
-        // ------------------
-
-        pMarker = sentence;
-        lengthRemaining = sizeof(sentence);
-
-        length = snprintf(pMarker, lengthRemaining, "$GPRMC,%02d%02d%02d,A," ,
-                          utcHours, utcMinutes, utcSeconds);
-
-        if (length < 0 || length >= lengthRemaining)
+        if (loc_eng_nmea_is_due(loc_eng_data_p, LOC_NMEA_VTG, nowMs))
         {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+            NmeaWriter vtg(sentence, sizeof(sentence));
 
-        if (location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG)
-        {
-            double latitude = location.gpsLocation.latitude;
-            double longitude = location.gpsLocation.longitude;
-            char latHemisphere;
-            char lonHemisphere;
-            double latMinutes;
-            double lonMinutes;
-
-            if (latitude > 0)
+            if (location.gpsLocation.flags & GPS_LOCATION_HAS_BEARING)
             {
-                latHemisphere = 'N';
+                float magTrack = location.gpsLocation.bearing;
+                if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_MAG_DEV)
+                {
+                    float magTrack = location.gpsLocation.bearing - locationExtended.magneticDeviation;
+                    if (magTrack < 0.0)
+                        magTrack += 360.0;
+                    else if (magTrack > 360.0)
+                        magTrack -= 360.0;
+                }
+
+                vtg.putStr("$GPVTG,");
+                vtg.putFixed1(location.gpsLocation.bearing);
+                vtg.putStr(",T,");
+                vtg.putFixed1(magTrack);
+                vtg.putStr(",M,");
             }
             else
             {
-                latHemisphere = 'S';
-                latitude *= -1.0;
+                vtg.putStr("$GPVTG,,T,,M,");
             }
 
-            if (longitude < 0)
+            if (location.gpsLocation.flags & GPS_LOCATION_HAS_SPEED)
             {
-                lonHemisphere = 'W';
-                longitude *= -1.0;
+                float speedKnots = location.gpsLocation.speed * (3600.0/1852.0);
+                float speedKmPerHour = location.gpsLocation.speed * 3.6;
+
+                vtg.putFixed1(speedKnots);
+                vtg.putStr(",N,");
+                vtg.putFixed1(speedKmPerHour);
+                vtg.putStr(",K,");
             }
             else
             {
-                lonHemisphere = 'E';
+                vtg.putStr(",N,,K,");
             }
 
-            latMinutes = fmod(latitude * 60.0 , 60.0);
-            lonMinutes = fmod(longitude * 60.0 , 60.0);
-
-            length = snprintf(pMarker, lengthRemaining, "%02d%09.6lf,%c,%03d%09.6lf,%c,",
-                              (uint8_t)floor(latitude), latMinutes, latHemisphere,
-                              (uint8_t)floor(longitude),lonMinutes, lonHemisphere);
-        }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining,",,,,");
-        }
+            if (!(location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG))
+                vtg.putChar('N'); // N means no fix
+            else if (LOC_POSITION_MODE_STANDALONE == loc_eng_data_p->adapter->getPositionMode().mode)
+                vtg.putChar('A'); // A means autonomous
+            else
+                vtg.putChar('D'); // D means differential
 
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
+            length = vtg.finish();
+            if (length < 0)
+            {
+                LOC_LOGE("NMEA Error in string formatting");
+                return;
+            }
+            loc_eng_nmea_send(sentence, length, loc_eng_data_p);
         }
-        pMarker += length;
-        lengthRemaining -= length;
 
-        if (location.gpsLocation.flags & GPS_LOCATION_HAS_SPEED)
-        {
-            float speedKnots = location.gpsLocation.speed * (3600.0/1852.0);
-            length = snprintf(pMarker, lengthRemaining, "%.1lf,", speedKnots);
-        }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining, ",");
-        }
+        // ------------------
+        // ------$GPRMC------
+        // ------------------
 
-        if (length < 0 || length >= lengthRemaining)
+        if (loc_eng_nmea_is_due(loc_eng_data_p, LOC_NMEA_RMC, nowMs))
         {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+            NmeaWriter rmc(sentence, sizeof(sentence));
+            rmc.putStr("$GPRMC,");
+            rmc.putInt(utcHours, 2);
+            rmc.putInt(utcMinutes, 2);
+            rmc.putInt(utcSeconds, 2);
+            rmc.putStr(",A,");
 
-        if (location.gpsLocation.flags & GPS_LOCATION_HAS_BEARING)
-        {
-            length = snprintf(pMarker, lengthRemaining, "%.1lf,", location.gpsLocation.bearing);
-        }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining, ",");
-        }
+            loc_eng_nmea_put_lat_long(rmc, location);
 
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+            if (location.gpsLocation.flags & GPS_LOCATION_HAS_SPEED)
+            {
+                float speedKnots = location.gpsLocation.speed * (3600.0/1852.0);
+                rmc.putFixed1(speedKnots);
+            }
+            rmc.putChar(',');
 
-        length = snprintf(pMarker, lengthRemaining, "%2.2d%2.2d%2.2d,",
-                          utcDay, utcMonth, utcYear);
+            if (location.gpsLocation.flags & GPS_LOCATION_HAS_BEARING)
+            {
+                rmc.putFixed1(location.gpsLocation.bearing);
+            }
+            rmc.putChar(',');
 
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+            rmc.putInt(utcDay, 2);
+            rmc.putInt(utcMonth, 2);
+            rmc.putInt(utcYear, 2);
+            rmc.putChar(',');
 
-        if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_MAG_DEV)
-        {
-            float magneticVariation = locationExtended.magneticDeviation;
-            char direction;
-            if (magneticVariation < 0.0)
+            if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_MAG_DEV)
             {
-                direction = 'W';
-                magneticVariation *= -1.0;
+                float magneticVariation = locationExtended.magneticDeviation;
+                char direction;
+                if (magneticVariation < 0.0)
+                {
+                    direction = 'W';
+                    magneticVariation *= -1.0;
+                }
+                else
+                {
+                    direction = 'E';
+                }
+
+                rmc.putFixed1(magneticVariation);
+                rmc.putChar(',');
+                rmc.putChar(direction);
+                rmc.putChar(',');
             }
             else
             {
-                direction = 'E';
+                rmc.putStr(",,");
             }
 
-            length = snprintf(pMarker, lengthRemaining, "%.1lf,%c,",
-                              magneticVariation, direction);
-        }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining, ",,");
-        }
+            if (!(location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG))
+                rmc.putChar('N'); // N means no fix
+            else if (LOC_POSITION_MODE_STANDALONE == loc_eng_data_p->adapter->getPositionMode().mode)
+                rmc.putChar('A'); // A means autonomous
+            else
+                rmc.putChar('D'); // D means differential
 
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
+            length = rmc.finish();
+            if (length < 0)
+            {
+                LOC_LOGE("NMEA Error in string formatting");
+                return;
+            }
+            loc_eng_nmea_send(sentence, length, loc_eng_data_p);
         }
-        pMarker += length;
-        lengthRemaining -= length;
-
-        if (!(location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG))
-            length = snprintf(pMarker, lengthRemaining, "%c", 'N'); // N means no fix
-        else if (LOC_POSITION_MODE_STANDALONE == loc_eng_data_p->adapter->getPositionMode().mode)
-            length = snprintf(pMarker, lengthRemaining, "%c", 'A'); // A means autonomous
-        else
-            length = snprintf(pMarker, lengthRemaining, "%c", 'D'); // D means differential
-
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
 
         // ------------------
         // ------$GPGGA------
         // ------------------
 
-        pMarker = sentence;
-        lengthRemaining = sizeof(sentence);
-
-        length = snprintf(pMarker, lengthRemaining, "$GPGGA,%02d%02d%02d," ,
-                          utcHours, utcMinutes, utcSeconds);
-
-        if (length < 0 || length >= lengthRemaining)
+        if (loc_eng_nmea_is_due(loc_eng_data_p, LOC_NMEA_GGA, nowMs))
         {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
+            NmeaWriter gga(sentence, sizeof(sentence));
+            gga.putStr("$GPGGA,");
+            gga.putInt(utcHours, 2);
+            gga.putInt(utcMinutes, 2);
+            gga.putInt(utcSeconds, 2);
+            gga.putChar(',');
+
+            loc_eng_nmea_put_lat_long(gga, location);
+
+            char gpsQuality;
+            if (!(location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG))
+                gpsQuality = '0'; // 0 means no fix
+            else if (LOC_POSITION_MODE_STANDALONE == loc_eng_data_p->adapter->getPositionMode().mode)
+                gpsQuality = '1'; // 1 means GPS fix
+            else
+                gpsQuality = '2'; // 2 means DGPS fix
+
+            gga.putChar(gpsQuality);
+            gga.putChar(',');
+            gga.putInt(svUsedCount, 2);
+            gga.putChar(',');
+            if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_DOP)
+            {   // dop is in locationExtended, (QMI)
+                gga.putFixed1(locationExtended.hdop);
+            }
+            else if (loc_eng_data_p->pdop > 0 && loc_eng_data_p->hdop > 0 && loc_eng_data_p->vdop > 0)
+            {   // dop was cached from sv report (RPC)
+                gga.putFixed1(loc_eng_data_p->hdop);
+            }
+            // else no hdop
+            gga.putChar(',');
 
-        if (location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG)
-        {
-            double latitude = location.gpsLocation.latitude;
-            double longitude = location.gpsLocation.longitude;
-            char latHemisphere;
-            char lonHemisphere;
-            double latMinutes;
-            double lonMinutes;
-
-            if (latitude > 0)
+            if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_ALTITUDE_MEAN_SEA_LEVEL)
             {
-                latHemisphere = 'N';
+                gga.putFixed1(locationExtended.altitudeMeanSeaLevel);
+                gga.putStr(",M,");
             }
             else
             {
-                latHemisphere = 'S';
-                latitude *= -1.0;
+                gga.putStr(",,");
             }
 
-            if (longitude < 0)
+            if ((location.gpsLocation.flags & GPS_LOCATION_HAS_ALTITUDE) &&
+                (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_ALTITUDE_MEAN_SEA_LEVEL))
             {
-                lonHemisphere = 'W';
-                longitude *= -1.0;
+                gga.putFixed1(location.gpsLocation.altitude - locationExtended.altitudeMeanSeaLevel);
+                gga.putStr(",M,,");
             }
             else
             {
-                lonHemisphere = 'E';
+                gga.putStr(",,,");
             }
 
-            latMinutes = fmod(latitude * 60.0 , 60.0);
-            lonMinutes = fmod(longitude * 60.0 , 60.0);
-
-            length = snprintf(pMarker, lengthRemaining, "%02d%09.6lf,%c,%03d%09.6lf,%c,",
-                              (uint8_t)floor(latitude), latMinutes, latHemisphere,
-                              (uint8_t)floor(longitude),lonMinutes, lonHemisphere);
-        }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining,",,,,");
-        }
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
-
-        char gpsQuality;
-        if (!(location.gpsLocation.flags & GPS_LOCATION_HAS_LAT_LONG))
-            gpsQuality = '0'; // 0 means no fix
-        else if (LOC_POSITION_MODE_STANDALONE == loc_eng_data_p->adapter->getPositionMode().mode)
-            gpsQuality = '1'; // 1 means GPS fix
-        else
-            gpsQuality = '2'; // 2 means DGPS fix
-
-        if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_DOP)
-        {   // dop is in locationExtended, (QMI)
-            length = snprintf(pMarker, lengthRemaining, "%c,%02d,%.1f,",
-                              gpsQuality, svUsedCount, locationExtended.hdop);
-        }
-        else if (loc_eng_data_p->pdop > 0 && loc_eng_data_p->hdop > 0 && loc_eng_data_p->vdop > 0)
-        {   // dop was cached from sv report (RPC)
-            length = snprintf(pMarker, lengthRemaining, "%c,%02d,%.1f,",
-                              gpsQuality, svUsedCount, loc_eng_data_p->hdop);
-        }
-        else
-        {   // no hdop
-            length = snprintf(pMarker, lengthRemaining, "%c,%02d,,",
-                              gpsQuality, svUsedCount);
-        }
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
-
-        if (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_ALTITUDE_MEAN_SEA_LEVEL)
-        {
-            length = snprintf(pMarker, lengthRemaining, "%.1lf,M,",
-                              locationExtended.altitudeMeanSeaLevel);
-        }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining,",,");
-        }
-
-        if (length < 0 || length >= lengthRemaining)
-        {
-            LOC_LOGE("NMEA Error in string formatting");
-            return;
-        }
-        pMarker += length;
-        lengthRemaining -= length;
-
-        if ((location.gpsLocation.flags & GPS_LOCATION_HAS_ALTITUDE) &&
-            (locationExtended.flags & GPS_LOCATION_EXTENDED_HAS_ALTITUDE_MEAN_SEA_LEVEL))
-        {
-            length = snprintf(pMarker, lengthRemaining, "%.1lf,M,,",
-                              location.gpsLocation.altitude - locationExtended.altitudeMeanSeaLevel);
-        }
-        else
-        {
-            length = snprintf(pMarker, lengthRemaining,",,,");
+            length = gga.finish();
+            if (length < 0)
+            {
+                LOC_LOGE("NMEA Error in string formatting");
+                return;
+            }
+            loc_eng_nmea_send(sentence, length, loc_eng_data_p);
         }
 
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-
     }
     //Send blank NMEA reports for non-final fixes
     else {
-        strlcpy(sentence, "$GPGSA,A,1,,,,,,,,,,,,,,,", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-
-        strlcpy(sentence, "$GNGSA,A,1,,,,,,,,,,,,,,,", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-
-        strlcpy(sentence, "$GPVTG,,T,,M,,N,,K,N", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-
-        strlcpy(sentence, "$GPRMC,,V,,,,,,,,,,N", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-
-        strlcpy(sentence, "$GPGGA,,,,,,0,,,,,,,,", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
+        if (loc_eng_nmea_is_due(loc_eng_data_p, LOC_NMEA_GSA, nowMs))
+        {
+            loc_eng_nmea_send_blank("$GPGSA,A,1,,,,,,,,,,,,,,,", loc_eng_data_p);
+            loc_eng_nmea_send_blank("$GNGSA,A,1,,,,,,,,,,,,,,,", loc_eng_data_p);
+        }
+        if (loc_eng_nmea_is_due(loc_eng_data_p, LOC_NMEA_VTG, nowMs))
+            loc_eng_nmea_send_blank("$GPVTG,,T,,M,,N,,K,N", loc_eng_data_p);
+        if (loc_eng_nmea_is_due(loc_eng_data_p, LOC_NMEA_RMC, nowMs))
+            loc_eng_nmea_send_blank("$GPRMC,,V,,,,,,,,,,N", loc_eng_data_p);
+        if (loc_eng_nmea_is_due(loc_eng_data_p, LOC_NMEA_GGA, nowMs))
+            loc_eng_nmea_send_blank("$GPGGA,,,,,,0,,,,,,,,", loc_eng_data_p);
     }
     // clear the dop cache so they can't be used again
     loc_eng_data_p->pdop = 0;
@@ -694,126 +825,86 @@ void loc_eng_nmea_generate_pos(loc_eng_data_s_type *loc_eng_data_p,
     EXIT_LOG(%d, 0);
 }
 
-
-
 /*===========================================================================
-FUNCTION    loc_eng_nmea_generate_sv
+FUNCTION    loc_eng_nmea_generate_gsv
 
 DESCRIPTION
-   Generate NMEA sentences generated based on sv report
+   Generate the $--GSV sentences of one constellation, for the svs in the
+   sv report whose prn is within [prnStart, prnEnd]
 
 DEPENDENCIES
    NONE
 
 RETURN VALUE
-   0
+   true on success; false if a sentence failed formatting
 
 SIDE EFFECTS
    N/A
 
 ===========================================================================*/
-void loc_eng_nmea_generate_sv(loc_eng_data_s_type *loc_eng_data_p,
-                              const HaxxSvStatus &svStatus, const GpsLocationExtended &locationExtended)
+static bool loc_eng_nmea_generate_gsv(loc_eng_data_s_type *loc_eng_data_p,
+                                      const HaxxSvStatus &svStatus,
+                                      const char *talker, int prnStart, int prnEnd,
+                                      int count)
 {
-    ENTRY_LOG();
-
-    char sentence[NMEA_SENTENCE_MAX_LENGTH] = {};
-    char* pMarker = sentence;
-    int lengthRemaining = sizeof(sentence);
+    char sentence[NMEA_SENTENCE_MAX_LENGTH];
     int length = 0;
     int svCount = svStatus.num_svs;
-    int sentenceCount = 0;
-    int sentenceNumber = 1;
-    int svNumber = 1;
-    int gpsCount = 0;
-    int glnCount = 0;
-
-    //Count GPS SVs for saparating GPS from GLONASS and throw others
 
-    for(svNumber=1; svNumber <= svCount; svNumber++) {
-        if( (svStatus.sv_list[svNumber-1].prn >= GPS_PRN_START)&&
-            (svStatus.sv_list[svNumber-1].prn <= GPS_PRN_END) )
-        {
-            gpsCount++;
-        }
-        else if( (svStatus.sv_list[svNumber-1].prn >= GLONASS_PRN_START) &&
-                 (svStatus.sv_list[svNumber-1].prn <= GLONASS_PRN_END) )
-        {
-            glnCount++;
-        }
-    }
-
-    // ------------------
-    // ------$GPGSV------
-    // ------------------
-
-    if (gpsCount <= 0)
+    if (count <= 0)
     {
-        // no svs in view, so just send a blank $GPGSV sentence
-        strlcpy(sentence, "$GPGSV,1,1,0,", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
+        // no svs in view, so just send a blank sentence
+        NmeaWriter gsv(sentence, sizeof(sentence));
+        gsv.putStr(talker);
+        gsv.putStr(",1,1,0,");
+        length = gsv.finish();
         loc_eng_nmea_send(sentence, length, loc_eng_data_p);
     }
     else
     {
-        svNumber = 1;
-        sentenceNumber = 1;
-        sentenceCount = gpsCount/4 + (gpsCount % 4 != 0);
+        int svNumber = 1;
+        int sentenceNumber = 1;
+        int sentenceCount = count/4 + (count % 4 != 0);
 
         while (sentenceNumber <= sentenceCount)
         {
-            pMarker = sentence;
-            lengthRemaining = sizeof(sentence);
-
-            length = snprintf(pMarker, lengthRemaining, "$GPGSV,%d,%d,%02d",
-                          sentenceCount, sentenceNumber, gpsCount);
-
-            if (length < 0 || length >= lengthRemaining)
-            {
-                LOC_LOGE("NMEA Error in string formatting");
-                return;
-            }
-            pMarker += length;
-            lengthRemaining -= length;
+            NmeaWriter gsv(sentence, sizeof(sentence));
+            gsv.putStr(talker);
+            gsv.putChar(',');
+            gsv.putInt(sentenceCount, 1);
+            gsv.putChar(',');
+            gsv.putInt(sentenceNumber, 1);
+            gsv.putChar(',');
+            gsv.putInt(count, 2);
 
             for (int i=0; (svNumber <= svCount) && (i < 4);  svNumber++)
             {
-                if( (svStatus.sv_list[svNumber-1].prn >= GPS_PRN_START) &&
-                    (svStatus.sv_list[svNumber-1].prn <= GPS_PRN_END) )
+                const GpsSvInfo &sv = svStatus.sv_list[svNumber-1];
+                if ((sv.prn >= prnStart) && (sv.prn <= prnEnd))
                 {
-                    length = snprintf(pMarker, lengthRemaining,",%02d,%02d,%03d,",
-                                  svStatus.sv_list[svNumber-1].prn,
-                                  (int)(0.5 + svStatus.sv_list[svNumber-1].elevation), //float to int
-                                  (int)(0.5 + svStatus.sv_list[svNumber-1].azimuth)); //float to int
-
-                    if (length < 0 || length >= lengthRemaining)
+                    gsv.putChar(',');
+                    gsv.putInt(sv.prn, 2);
+                    gsv.putChar(',');
+                    gsv.putInt((int)(0.5 + sv.elevation), 2); //float to int
+                    gsv.putChar(',');
+                    gsv.putInt((int)(0.5 + sv.azimuth), 3); //float to int
+                    gsv.putChar(',');
+
+                    if (sv.snr > 0)
                     {
-                        LOC_LOGE("NMEA Error in string formatting");
-                        return;
-                    }
-                    pMarker += length;
-                    lengthRemaining -= length;
-
-                    if (svStatus.sv_list[svNumber-1].snr > 0)
-                    {
-                        length = snprintf(pMarker, lengthRemaining,"%02d",
-                                         (int)(0.5 + svStatus.sv_list[svNumber-1].snr)); //float to int
-
-                        if (length < 0 || length >= lengthRemaining)
-                        {
-                            LOC_LOGE("NMEA Error in string formatting");
-                            return;
-                        }
-                        pMarker += length;
-                        lengthRemaining -= length;
+                        gsv.putInt((int)(0.5 + sv.snr), 2); //float to int
                     }
 
                     i++;
-               }
-
+                }
             }
 
-            length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
+            length = gsv.finish();
+            if (length < 0)
+            {
+                LOC_LOGE("NMEA Error in string formatting");
+                return false;
+            }
             loc_eng_nmea_send(sentence, length, loc_eng_data_p);
             sentenceNumber++;
 
@@ -821,83 +912,73 @@ void loc_eng_nmea_generate_sv(loc_eng_data_s_type *loc_eng_data_p,
 
     } //if
 
-    // ------------------
-    // ------$GLGSV------
-    // ------------------
+    return true;
+}
 
-    if (glnCount <= 0)
-    {
-        // no svs in view, so just send a blank $GLGSV sentence
-        strlcpy(sentence, "$GLGSV,1,1,0,", sizeof(sentence));
-        length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-        loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-    }
-    else
-    {
-        svNumber = 1;
-        sentenceNumber = 1;
-        sentenceCount = glnCount/4 + (glnCount % 4 != 0);
+/*===========================================================================
+FUNCTION    loc_eng_nmea_generate_sv
 
-        while (sentenceNumber <= sentenceCount)
-        {
-            pMarker = sentence;
-            lengthRemaining = sizeof(sentence);
+DESCRIPTION
+   Generate NMEA sentences generated based on sv report
 
-            length = snprintf(pMarker, lengthRemaining, "$GLGSV,%d,%d,%02d",
-                          sentenceCount, sentenceNumber, glnCount);
+DEPENDENCIES
+   NONE
 
-            if (length < 0 || length >= lengthRemaining)
-            {
-                LOC_LOGE("NMEA Error in string formatting");
-                return;
-            }
-            pMarker += length;
-            lengthRemaining -= length;
+RETURN VALUE
+   0
 
-            for (int i=0; (svNumber <= svCount) && (i < 4);  svNumber++)
-            {
-                if( (svStatus.sv_list[svNumber-1].prn >= GLONASS_PRN_START) &&
-                    (svStatus.sv_list[svNumber-1].prn <= GLONASS_PRN_END) )      {
+SIDE EFFECTS
+   N/A
 
-                    length = snprintf(pMarker, lengthRemaining,",%02d,%02d,%03d,",
-                                  svStatus.sv_list[svNumber-1].prn,
-                                  (int)(0.5 + svStatus.sv_list[svNumber-1].elevation), //float to int
-                                  (int)(0.5 + svStatus.sv_list[svNumber-1].azimuth)); //float to int
+===========================================================================*/
+void loc_eng_nmea_generate_sv(loc_eng_data_s_type *loc_eng_data_p,
+                              const HaxxSvStatus &svStatus, const GpsLocationExtended &locationExtended)
+{
+    ENTRY_LOG();
 
-                    if (length < 0 || length >= lengthRemaining)
-                    {
-                        LOC_LOGE("NMEA Error in string formatting");
-                        return;
-                    }
-                    pMarker += length;
-                    lengthRemaining -= length;
+    int svCount = svStatus.num_svs;
+    int svNumber = 1;
+    int gpsCount = 0;
+    int glnCount = 0;
 
-                    if (svStatus.sv_list[svNumber-1].snr > 0)
-                    {
-                        length = snprintf(pMarker, lengthRemaining,"%02d",
-                                         (int)(0.5 + svStatus.sv_list[svNumber-1].snr)); //float to int
-
-                        if (length < 0 || length >= lengthRemaining)
-                        {
-                            LOC_LOGE("NMEA Error in string formatting");
-                            return;
-                        }
-                        pMarker += length;
-                        lengthRemaining -= length;
-                    }
+    //Count GPS SVs for saparating GPS from GLONASS and throw others
 
-                    i++;
-               }
+    for(svNumber=1; svNumber <= svCount; svNumber++) {
+        if( (svStatus.sv_list[svNumber-1].prn >= GPS_PRN_START)&&
+            (svStatus.sv_list[svNumber-1].prn <= GPS_PRN_END) )
+        {
+            gpsCount++;
+        }
+        else if( (svStatus.sv_list[svNumber-1].prn >= GLONASS_PRN_START) &&
+                 (svStatus.sv_list[svNumber-1].prn <= GLONASS_PRN_END) )
+        {
+            glnCount++;
+        }
+    }
 
-            }
+    // $GPGSV and $GLGSV go together
+    if (loc_eng_nmea_is_due(loc_eng_data_p, LOC_NMEA_GSV, loc_eng_nmea_get_time_ms()))
+    {
+        // ------------------
+        // ------$GPGSV------
+        // ------------------
 
-            length = loc_eng_nmea_put_checksum(sentence, sizeof(sentence));
-            loc_eng_nmea_send(sentence, length, loc_eng_data_p);
-            sentenceNumber++;
+        if (!loc_eng_nmea_generate_gsv(loc_eng_data_p, svStatus, "$GPGSV",
+                                       GPS_PRN_START, GPS_PRN_END, gpsCount))
+        {
+            return;
+        }
 
-        }  //while
+        // ------------------
+        // ------$GLGSV------
+        // ------------------
 
-    }//if
+        if (!loc_eng_nmea_generate_gsv(loc_eng_data_p, svStatus, "$GLGSV",
+                                       GLONASS_PRN_START, GLONASS_PRN_END, glnCount))
+        {
+            return;
+        }
+    }
 
     // cache the used in fix mask, as it will be needed to send $GPGSA/$GNGSA
     // during the position report
@@ -922,3 +1003,114 @@ void loc_eng_nmea_generate_sv(loc_eng_data_s_type *loc_eng_data_p,
 
     EXIT_LOG(%d, 0);
 }
+
+#ifdef __LOC_DEBUG__
+
+#include <stdlib.h>
+#include <string.h>
+
+// golden sentence, as formatted by snprintf() and loc_eng_nmea_put_checksum()
+static const char sGoldenGga[] =
+    "$GPGGA,221320,3725.319898,N,12205.040000,W,2,10,0.9,5.2,M,27.3,M,,*5B\r\n";
+
+static int formatGga(char* sentence, int size, double latitude, double longitude,
+                     float hdop, float altitudeMsl, double altitude) {
+    NmeaWriter gga(sentence, size);
+    UlpLocation location;
+    memset(&location, 0, sizeof(location));
+    location.gpsLocation.flags = GPS_LOCATION_HAS_LAT_LONG;
+    location.gpsLocation.latitude = latitude;
+    location.gpsLocation.longitude = longitude;
+    gga.putStr("$GPGGA,");
+    gga.putInt(22, 2);
+    gga.putInt(13, 2);
+    gga.putInt(20, 2);
+    gga.putChar(',');
+    loc_eng_nmea_put_lat_long(gga, location);
+    gga.putStr("2,");
+    gga.putInt(10, 2);
+    gga.putChar(',');
+    gga.putFixed1(hdop);
+    gga.putChar(',');
+    gga.putFixed1(altitudeMsl);
+    gga.putStr(",M,");
+    gga.putFixed1(altitude - altitudeMsl);
+    gga.putStr(",M,,");
+    return gga.finish();
+}
+
+static double getDeltaNs(struct timespec from, struct timespec to) {
+    return (to.tv_sec - from.tv_sec) * 1e9 + (to.tv_nsec - from.tv_nsec);
+}
+
+// For Linux command line testing:
+// compilation: g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -I. -I../../core -I../../utils -I../../../../vendor/qcom/proprietary/gps-internal/unit-tests/fakes_for_host -I../../../../system/core/include loc_eng_nmea.cpp
+// run: ./a.out <number of random values>
+int main(int argc, char** argv) {
+    int tries = argc > 1 ? atoi(argv[1]) : 100000;
+    char sentence[NMEA_SENTENCE_MAX_LENGTH];
+    char expected[NMEA_SENTENCE_MAX_LENGTH];
+    int failures = 0;
+
+    int length = formatGga(sentence, sizeof(sentence), 37.4219983, -122.084, 0.9f, 5.2f, 32.5);
+    if (length != (int)strlen(sGoldenGga) || strcmp(sentence, sGoldenGga)) {
+        printf("golden: %s expected: %s", sentence, sGoldenGga);
+        failures++;
+    }
+
+    // every emitter against the printf conversion it replaces, with a
+    // quarter of the values on or next to a rounding tie
+    srand(time(NULL));
+    for (int i = 0; i < tries; i++) {
+        double value = (rand() - RAND_MAX / 2) / 1000.0;
+        if (0 == (i & 3)) {
+            value = floor(value * 10) / 10 + 0.05;
+        }
+        int integer = rand() % 2000 - 1000;
+        double minutes = fmod(fabs(value), 60.0);
+
+        NmeaWriter writer(sentence, sizeof(sentence));
+        writer.putStr("$X,");
+        writer.putFixed1(value);
+        writer.putChar(',');
+        writer.putFixed1((float)value);
+        writer.putChar(',');
+        writer.putFixed(minutes, 6, 9);
+        writer.putChar(',');
+        writer.putInt(integer, 2);
+        writer.putChar(',');
+        writer.putInt(integer, 3);
+        writer.finish();
+
+        snprintf(expected, sizeof(expected), "$X,%.1f,%.1f,%09.6lf,%02d,%03d",
+                 value, (float)value, minutes, integer, integer);
+        loc_eng_nmea_put_checksum(expected, sizeof(expected));
+        if (strcmp(sentence, expected)) {
+            printf("got: %sexpected: %s", sentence, expected);
+            failures++;
+        }
+    }
+    printf("%d values, %d failures\n", tries, failures);
+
+    // per sentence cost, snprintf() + loc_eng_nmea_put_checksum() vs NmeaWriter
+    struct timespec t0, t1, t2;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < tries; i++) {
+        snprintf(expected, sizeof(expected),
+                 "$GPGGA,%02d%02d%02d,%02d%09.6lf,%c,%03d%09.6lf,%c,%c,%02d,%.1f,%.1lf,M,%.1lf,M,,",
+                 22, 13, 20, 37, 25.319898 + i * 1e-9, 'N', 122, 5.04, 'W', '2', 10,
+                 0.9f, 5.2, 27.3);
+        loc_eng_nmea_put_checksum(expected, sizeof(expected));
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    for (int i = 0; i < tries; i++) {
+        formatGga(sentence, sizeof(sentence), 37.4219983 + i * 1e-11, -122.084, 0.9f, 5.2f, 32.5);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t2);
+    printf("$GPGGA: snprintf %.0f ns, NmeaWriter %.0f ns\n",
+           getDeltaNs(t0, t1) / tries, getDeltaNs(t1, t2) / tries);
+
+    return failures;
+}
+
+#endif
@@ -35,6 +35,26 @@
 
 #define NMEA_SENTENCE_MAX_LENGTH 200
 
+// sentences, as selected by NMEA_SENTENCE_MASK and rated by
+// NMEA_<sentence>_INTERVAL in gps.conf
+typedef enum {
+    LOC_NMEA_GGA = 0,
+    LOC_NMEA_RMC,
+    LOC_NMEA_GSA,   // $GPGSA and $GNGSA
+    LOC_NMEA_VTG,
+    LOC_NMEA_GSV,   // $GPGSV and $GLGSV
+    LOC_NMEA_NUM_SENTENCES
+} loc_eng_nmea_sentence_e_type;
+
+#define LOC_NMEA_MASK_GGA (1 << LOC_NMEA_GGA)
+#define LOC_NMEA_MASK_RMC (1 << LOC_NMEA_RMC)
+#define LOC_NMEA_MASK_GSA (1 << LOC_NMEA_GSA)
+#define LOC_NMEA_MASK_VTG (1 << LOC_NMEA_VTG)
+#define LOC_NMEA_MASK_GSV (1 << LOC_NMEA_GSV)
+#define LOC_NMEA_MASK_ALL ((1 << LOC_NMEA_NUM_SENTENCES) - 1)
+
+typedef struct loc_eng_data_s loc_eng_data_s_type;
+
 void loc_eng_nmea_send(char *pNmea, int length, loc_eng_data_s_type *loc_eng_data_p);
 int loc_eng_nmea_put_checksum(char *pNmea, int maxSize);
 void loc_eng_nmea_generate_sv(loc_eng_data_s_type *loc_eng_data_p, const HaxxSvStatus &svStatus, const GpsLocationExtended &locationExtended);
@@ -7,7 +7,8 @@ LOCAL_SHARED_LIBRARIES := \
     libutils \
     libcutils \
     liblog \
-    libprocessgroup
+    libprocessgroup \
+    libdl
 
 LOCAL_SRC_FILES += \
     loc_log.cpp \
@@ -20,6 +21,12 @@ LOCAL_SRC_FILES += \
     LocTimer.cpp \
     LocThread.cpp \
     MsgTask.cpp \
+    LocMsgPool.cpp \
+    LocMsgTrace.cpp \
+    LocRcu.cpp \
+    LocExecutor.cpp \
+    LocConfWatcher.cpp \
+    loc_log_async.cpp \
     loc_misc_utils.cpp
 
 # Flag -std=c++11 is not accepted by compiler when LOCAL_CLANG is set to true
@@ -32,6 +39,13 @@ ifeq ($(TARGET_BUILD_VARIANT),user)
    LOCAL_CFLAGS += -DTARGET_BUILD_VARIANT_USER
 endif
 
+## Logs above this DEBUG_LEVEL are compiled out, see log_util.h;
+## GPS_LOG_MAX_LEVEL_<module> overrides GPS_LOG_MAX_LEVEL for one module
+LOC_LOG_MAX_LEVEL := $(firstword $(GPS_LOG_MAX_LEVEL_$(LOCAL_MODULE)) $(GPS_LOG_MAX_LEVEL))
+ifneq ($(LOC_LOG_MAX_LEVEL),)
+   LOCAL_CFLAGS += -DLOC_LOG_MAX_LEVEL=$(LOC_LOG_MAX_LEVEL)
+endif
+
 LOCAL_LDFLAGS += -Wl,--export-dynamic
 
 ## Includes
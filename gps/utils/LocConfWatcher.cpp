@@ -0,0 +1,140 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_ConfWatcher"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <LocConfWatcher.h>
+#include <log_util.h>
+
+// written in place, or renamed over the old file; only once the file is
+// whole, so not on IN_CREATE, which comes before a new file is written and
+// is followed by IN_CLOSE_WRITE when it is
+#define LOC_CONF_WATCHER_EVENTS (IN_CLOSE_WRITE | IN_MOVED_TO)
+
+LocConfWatcher::LocConfWatcher(LocExecutor& executor, int fd,
+                               tOnChange onChange, void* data) :
+    LocExecutorTask(), mExecutor(executor), mFd(fd),
+    mLock(PTHREAD_MUTEX_INITIALIZER), mOnChange(onChange), mData(data),
+    mNumFiles(0) {
+}
+
+LocConfWatcher::~LocConfWatcher() {
+    close(mFd);
+    pthread_mutex_destroy(&mLock);
+}
+
+LocConfWatcher* LocConfWatcher::create(LocExecutor& executor,
+                                       tOnChange onChange, void* data) {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        LOC_LOGE("%s: inotify_init1 failure - %s", __FUNCTION__, strerror(errno));
+        return NULL;
+    }
+    LocConfWatcher* watcher = new LocConfWatcher(executor, fd, onChange, data);
+    if (!executor.addFd(fd, EPOLLIN, *watcher)) {
+        delete watcher;
+        watcher = NULL;
+    }
+    return watcher;
+}
+
+bool LocConfWatcher::watch(const char* confFile) {
+    pthread_mutex_lock(&mLock);
+    bool success = false;
+    const char* slash = strrchr(confFile, '/');
+
+    if (mNumFiles < LOC_CONF_WATCHER_MAX_FILES && NULL != slash && '\0' != slash[1] &&
+        strlen(confFile) < sizeof(mFiles[0].mPath)) {
+        WatchedFile& file = mFiles[mNumFiles];
+        strlcpy(file.mPath, confFile, sizeof(file.mPath));
+
+        // watch the directory, cut out of the path for inotify_add_watch()
+        size_t dirLen = slash - confFile;
+        file.mPath[dirLen ? dirLen : 1] = '\0';
+        file.mWd = inotify_add_watch(mFd, file.mPath, LOC_CONF_WATCHER_EVENTS);
+        strlcpy(file.mPath, confFile, sizeof(file.mPath));
+        file.mName = file.mPath + dirLen + 1;
+
+        if (file.mWd < 0) {
+            LOC_LOGE("%s: can not watch %s - %s", __FUNCTION__, confFile, strerror(errno));
+        } else {
+            mNumFiles++;
+            success = true;
+        }
+    }
+    pthread_mutex_unlock(&mLock);
+    return success;
+}
+
+void LocConfWatcher::destroy() {
+    // waits out a running execute(), which then no longer polls mFd again
+    pthread_mutex_lock(&mLock);
+    mOnChange = NULL;
+    pthread_mutex_unlock(&mLock);
+    mExecutor.removeFd(mFd);
+    mExecutor.retire(*this);
+}
+
+void LocConfWatcher::execute() {
+    char buf[2048] __attribute__((aligned(__alignof__(struct inotify_event))));
+    uint32_t changed = 0;
+    ssize_t len;
+
+    pthread_mutex_lock(&mLock);
+    while ((len = read(mFd, buf, sizeof(buf))) > 0) {
+        for (char* ptr = buf; ptr < buf + len; ) {
+            const struct inotify_event* event = (const struct inotify_event*)ptr;
+            for (int i = 0; event->len && i < mNumFiles; i++) {
+                if (event->wd == mFiles[i].mWd && 0 == strcmp(event->name, mFiles[i].mName)) {
+                    changed |= (1 << i);
+                }
+            }
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    for (int i = 0; NULL != mOnChange && i < mNumFiles; i++) {
+        if (changed & (1 << i)) {
+            LOC_LOGD("%s: %s changed", __FUNCTION__, mFiles[i].mPath);
+            mOnChange(mFiles[i].mPath, i, mData);
+        }
+    }
+
+    // poll for the next change, unless on our way out
+    if (NULL != mOnChange) {
+        mExecutor.addFd(mFd, EPOLLIN, *this);
+    }
+    pthread_mutex_unlock(&mLock);
+}
@@ -0,0 +1,76 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_CONF_WATCHER_H__
+#define __LOC_CONF_WATCHER_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <LocExecutor.h>
+
+// max number of conf files one watcher watches
+#define LOC_CONF_WATCHER_MAX_FILES 8
+
+// Watches conf files for changes, with inotify on the fd poll of a
+// LocExecutor, and tells its client which of them changed. The directory
+// of each file is watched, so that files replaced by a rename are seen as
+// well as those written in place. A file written more than once before the
+// watcher gets to run is reported once.
+class LocConfWatcher : public LocExecutorTask {
+public:
+    // runs in a worker of the executor, once for each changed file;
+    // index is that of the file in the order it was watch()'ed
+    typedef void (*tOnChange)(const char* confFile, int index, void* data);
+private:
+    struct WatchedFile {
+        char mPath[128];
+        const char* mName;
+        int mWd;
+    };
+    LocExecutor& mExecutor;
+    const int mFd;
+    // guards mOnChange, so that destroy() waits out a running callback
+    pthread_mutex_t mLock;
+    tOnChange mOnChange;
+    void* mData;
+    int mNumFiles;
+    WatchedFile mFiles[LOC_CONF_WATCHER_MAX_FILES];
+    LocConfWatcher(LocExecutor& executor, int fd, tOnChange onChange, void* data);
+    virtual ~LocConfWatcher();
+public:
+    // NULL if inotify is not available
+    static LocConfWatcher* create(LocExecutor& executor, tOnChange onChange, void* data);
+    // starts watching confFile; false if it can not be watched
+    bool watch(const char* confFile);
+    // no callback runs any more once this returns; the object is then
+    // deleted by the executor
+    void destroy();
+    virtual void execute();
+};
+
+#endif //__LOC_CONF_WATCHER_H__
@@ -0,0 +1,522 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_Executor"
+
+#include <cutils/sched_policy.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <LocExecutor.h>
+#include <log_util.h>
+
+// runs the tasks of an executor until it stops
+class LocExecutorWorker : public LocRunnable {
+    LocExecutor& mExecutor;
+public:
+    inline LocExecutorWorker(LocExecutor& executor) :
+        LocRunnable(), mExecutor(executor) {}
+    // make sure we do not run in background scheduling group
+    inline virtual void prerun() { set_sched_policy(gettid(), SP_FOREGROUND); }
+    inline virtual bool run() { return mExecutor.runNext(); }
+};
+
+pthread_mutex_t LocExecutor::mDefaultMutex = PTHREAD_MUTEX_INITIALIZER;
+LocExecutor* LocExecutor::mDefault = NULL;
+
+LocExecutor::LocExecutor(const char* name, unsigned int numWorkers,
+                         LocThread::tCreate creator) :
+    mCreator(creator), mHead(NULL), mTail(NULL),
+    mPollFd(epoll_create(LOC_EXECUTOR_MAX_EVENTS)),
+    mEventFd(eventfd(0, EFD_NONBLOCK)),
+    mIdle(0), mPolling(false), mWoken(false), mStopping(false),
+    mNumWorkers(0), mExecuted(0), mPolls(0) {
+    pthread_mutex_init(&mMutex, NULL);
+    pthread_cond_init(&mCond, NULL);
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    // a NULL task tells the eventfd apart from the fds of clients
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (-1 == mPollFd || -1 == mEventFd ||
+        epoll_ctl(mPollFd, EPOLL_CTL_ADD, mEventFd, &ev)) {
+        LOC_LOGE("%s: epoll / eventfd failure - %s", __FUNCTION__, strerror(errno));
+        return;
+    }
+
+    if (numWorkers > LOC_EXECUTOR_MAX_WORKERS) {
+        numWorkers = LOC_EXECUTOR_MAX_WORKERS;
+    }
+    for (unsigned int i = 0; i < numWorkers; i++) {
+        char threadName[16];
+        snprintf(threadName, sizeof(threadName), "%s%u", name ? name : "LocExecutor", i);
+        LocExecutorWorker* worker = new LocExecutorWorker(*this);
+        if (mWorkers[mNumWorkers].start(creator, threadName, worker)) {
+            mNumWorkers++;
+        } else {
+            LOC_LOGE("%s: failed to start %s", __FUNCTION__, threadName);
+            delete worker;
+        }
+    }
+}
+
+LocExecutor::~LocExecutor() {
+    pthread_mutex_lock(&mMutex);
+    mStopping = true;
+    pthread_cond_broadcast(&mCond);
+    if (mPolling && !mWoken) {
+        uint64_t one = 1;
+        mWoken = true;
+        write(mEventFd, &one, sizeof(one));
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    // joins each of the workers
+    for (unsigned int i = 0; i < mNumWorkers; i++) {
+        mWorkers[i].stop();
+    }
+
+    close(mEventFd);
+    close(mPollFd);
+    pthread_cond_destroy(&mCond);
+    pthread_mutex_destroy(&mMutex);
+}
+
+// true if task got appended to the queue; a task already queued or running
+// is not appended again
+bool LocExecutor::queueLocked(LocExecutorTask& task) {
+    bool queued = false;
+    switch (task.mState) {
+    case LocExecutorTask::IDLE:
+        task.mState = LocExecutorTask::QUEUED;
+        task.mNextQueued = NULL;
+        if (mTail) {
+            mTail->mNextQueued = &task;
+        } else {
+            mHead = &task;
+        }
+        mTail = &task;
+        queued = true;
+        break;
+    case LocExecutorTask::RUNNING:
+        // runNext() queues it again once it returns
+        task.mState = LocExecutorTask::RERUN;
+        break;
+    default:
+        // it is going to run anyway
+        break;
+    }
+    return queued;
+}
+
+// gets a worker to look at the queue: one waiting for work, if any;
+// else the one polling, if any. Busy ones look when they are done.
+void LocExecutor::wakeLocked() {
+    if (mIdle > 0) {
+        pthread_cond_signal(&mCond);
+    } else if (mPolling && !mWoken) {
+        uint64_t one = 1;
+        mWoken = true;
+        write(mEventFd, &one, sizeof(one));
+    }
+}
+
+void LocExecutor::post(LocExecutorTask& task) {
+    pthread_mutex_lock(&mMutex);
+    if (queueLocked(task)) {
+        wakeLocked();
+    }
+    pthread_mutex_unlock(&mMutex);
+}
+
+bool LocExecutor::runNext() {
+    pthread_mutex_lock(&mMutex);
+
+    while (!mStopping && NULL == mHead) {
+        if (mPolling) {
+            // some other worker is polling already, wait for work
+            mIdle++;
+            pthread_cond_wait(&mCond, &mMutex);
+            mIdle--;
+            continue;
+        }
+
+        mPolling = true;
+        mPolls++;
+        pthread_mutex_unlock(&mMutex);
+
+        struct epoll_event ev[LOC_EXECUTOR_MAX_EVENTS];
+        int fds = epoll_wait(mPollFd, ev, LOC_EXECUTOR_MAX_EVENTS, -1);
+        int error = errno;
+
+        pthread_mutex_lock(&mMutex);
+        mPolling = false;
+
+        for (int i = 0; i < fds; i++) {
+            LocExecutorTask* task = (LocExecutorTask*)ev[i].data.ptr;
+            if (task) {
+                queueLocked(*task);
+            } else {
+                uint64_t count;
+                read(mEventFd, &count, sizeof(count));
+                mWoken = false;
+            }
+        }
+
+        // this worker is about to run a task, or to give up; let a waiting
+        // one take over the polling
+        if (mIdle > 0) {
+            pthread_cond_signal(&mCond);
+        }
+
+        if (fds < 0 && EINTR != error) {
+            LOC_LOGE("%s: epoll_wait failure - %s", __FUNCTION__, strerror(error));
+            pthread_mutex_unlock(&mMutex);
+            return false;
+        }
+    }
+
+    if (mStopping) {
+        pthread_mutex_unlock(&mMutex);
+        return false;
+    }
+
+    LocExecutorTask* task = mHead;
+    mHead = task->mNextQueued;
+    if (NULL == mHead) {
+        mTail = NULL;
+    }
+    task->mNextQueued = NULL;
+    task->mState = LocExecutorTask::RUNNING;
+    bool retired = task->mRetired;
+    if (!retired) {
+        mExecuted++;
+    }
+    pthread_mutex_unlock(&mMutex);
+
+    if (!retired) {
+        task->execute();
+
+        pthread_mutex_lock(&mMutex);
+        bool rerun = (LocExecutorTask::RERUN == task->mState);
+        task->mState = LocExecutorTask::IDLE;
+        retired = task->mRetired;
+        if (rerun && !retired) {
+            // goes behind whatever got posted in the meantime
+            queueLocked(*task);
+        }
+        pthread_mutex_unlock(&mMutex);
+    }
+
+    if (retired) {
+        delete task;
+    }
+
+    return true;
+}
+
+void LocExecutor::retire(LocExecutorTask& task) {
+    pthread_mutex_lock(&mMutex);
+    task.mRetired = true;
+    // otherwise the worker that has it queued or running deletes it
+    bool idle = (LocExecutorTask::IDLE == task.mState);
+    pthread_mutex_unlock(&mMutex);
+
+    if (idle) {
+        delete &task;
+    }
+}
+
+bool LocExecutor::addFd(int fd, uint32_t events, LocExecutorTask& task) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events | EPOLLONESHOT;
+    ev.data.ptr = &task;
+
+    int result = epoll_ctl(mPollFd, EPOLL_CTL_ADD, fd, &ev);
+    if (-1 == result && EEXIST == errno) {
+        // still in the poll since its last event, only disabled; rearm it
+        result = epoll_ctl(mPollFd, EPOLL_CTL_MOD, fd, &ev);
+    }
+    if (result) {
+        LOC_LOGE("%s: epoll_ctl failure on fd %d - %s", __FUNCTION__, fd, strerror(errno));
+    }
+    return (0 == result);
+}
+
+// an event that was already taken out of the poll may still post the task
+void LocExecutor::removeFd(int fd) {
+    epoll_ctl(mPollFd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+void LocExecutor::dump() {
+    pthread_mutex_lock(&mMutex);
+    LOC_LOGD("%s: %u workers, %llu tasks run, %llu polls", __FUNCTION__, mNumWorkers,
+             (unsigned long long)mExecuted, (unsigned long long)mPolls);
+    pthread_mutex_unlock(&mMutex);
+}
+
+LocExecutor* LocExecutor::getDefault(LocThread::tCreate creator) {
+    pthread_mutex_lock(&mDefaultMutex);
+    if (NULL == mDefault) {
+        mDefault = new LocExecutor(LOC_EXECUTOR_DEFAULT_NAME, LOC_EXECUTOR_DEFAULT_WORKERS, creator);
+    }
+    LocExecutor* executor = mDefault;
+    pthread_mutex_unlock(&mDefaultMutex);
+
+    if (0 == executor->mNumWorkers ||
+        (NULL != creator && creator != executor->mCreator)) {
+        executor = NULL;
+    }
+    return executor;
+}
+
+#ifdef __LOC_DEBUG__
+
+#include <stdlib.h>
+#include <math.h>
+#include <sys/resource.h>
+#include <MsgTask.h>
+
+// senders and MsgTasks of the test; each MsgTask checks that the msgs of
+// each sender come in order, and that it never runs on two workers at once
+#define TEST_SENDERS 4
+#define TEST_TASKS 4
+
+struct LocExecutorTestRx {
+    uint32_t mLast[TEST_SENDERS];
+    uint64_t mCount;
+    int mRunning;
+    int mErrors;
+};
+
+static LocExecutorTestRx sRx[TEST_TASKS];
+static MsgTask* sTasks[TEST_TASKS];
+static uint32_t sMsgsPerSender = 20000;
+
+struct LocExecutorTestMsg : public LocMsg {
+    int mTask, mSender;
+    uint32_t mSeq;
+    inline LocExecutorTestMsg(int task, int sender, uint32_t seq) :
+        LocMsg(), mTask(task), mSender(sender), mSeq(seq) {}
+    virtual void proc() const {
+        LocExecutorTestRx& rx = sRx[mTask];
+        if (__atomic_exchange_n(&rx.mRunning, 1, __ATOMIC_SEQ_CST)) {
+            rx.mErrors++;
+        }
+        if (mSeq != rx.mLast[mSender] + 1) {
+            rx.mErrors++;
+        }
+        rx.mLast[mSender] = mSeq;
+        rx.mCount++;
+        __atomic_store_n(&rx.mRunning, 0, __ATOMIC_SEQ_CST);
+    }
+};
+
+static void* testSender(void* arg) {
+    int sender = (int)(long)arg;
+    for (uint32_t seq = 1; seq <= sMsgsPerSender; seq++) {
+        for (int task = 0; task < TEST_TASKS; task++) {
+            sTasks[task]->sendMsg(new LocExecutorTestMsg(task, sender, seq));
+        }
+    }
+    return NULL;
+}
+
+// threads, resident memory and context switches of the process so far
+static void testReport(const char* when) {
+    char line[128];
+    long threads = 0, rssKb = 0;
+    FILE* status = fopen("/proc/self/status", "r");
+    while (status && fgets(line, sizeof(line), status)) {
+        sscanf(line, "Threads: %ld", &threads);
+        sscanf(line, "VmRSS: %ld", &rssKb);
+    }
+    if (status) {
+        fclose(status);
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    printf("%-5s threads %ld rss %ld kB context switches %ld voluntary %ld involuntary\n",
+           when, threads, rssKb, usage.ru_nvcsw, usage.ru_nivcsw);
+}
+
+static int testOrdering() {
+    for (int task = 0; task < TEST_TASKS; task++) {
+        sTasks[task] = new MsgTask("LocExecTest", false);
+    }
+    testReport("idle");
+
+    pthread_t senders[TEST_SENDERS];
+    for (int sender = 0; sender < TEST_SENDERS; sender++) {
+        pthread_create(&senders[sender], NULL, testSender, (void*)(long)sender);
+    }
+    for (int sender = 0; sender < TEST_SENDERS; sender++) {
+        pthread_join(senders[sender], NULL);
+    }
+
+    uint64_t expected = (uint64_t)TEST_TASKS * TEST_SENDERS * sMsgsPerSender;
+    uint64_t received = 0;
+    int errors = 0;
+    for (int i = 0; i < 500 && received < expected; i++) {
+        usleep(10000);
+        received = 0;
+        for (int task = 0; task < TEST_TASKS; task++) {
+            received += __atomic_load_n(&sRx[task].mCount, __ATOMIC_RELAXED);
+        }
+    }
+    for (int task = 0; task < TEST_TASKS; task++) {
+        errors += sRx[task].mErrors;
+        sTasks[task]->destroy();
+    }
+    testReport("done");
+    LocExecutor::getDefault()->dump();
+
+    printf("%llu of %llu msgs received, %d out of order or concurrent\n",
+           (unsigned long long)received, (unsigned long long)expected, errors);
+    return (received == expected && 0 == errors) ? 0 : 1;
+}
+
+// latency test: a "modem" thread sends a msg every period, as position
+// reports come in, while load threads keep every cpu busy. Each proc()
+// records how long its msg took from sendMsg to a worker.
+#define TEST_LATENCY_PERIOD_NS 10000000LL
+#define TEST_LATENCY_SAMPLES 500
+
+static uint64_t sLatencyUs[TEST_LATENCY_SAMPLES];
+static uint32_t sLatencyCount = 0;
+static volatile bool sLoadRunning = true;
+
+struct LocLatencyTestMsg : public LocMsg {
+    virtual void proc() const {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        uint64_t now = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+        if (sLatencyCount < TEST_LATENCY_SAMPLES) {
+            sLatencyUs[sLatencyCount++] = (now - mSendTime) / 1000;
+        }
+    }
+    inline virtual LocMsgPriority priority() const {
+        return LOC_MSG_PRIORITY_HIGH;
+    }
+};
+
+static void* testLoad(void*) {
+    volatile uint64_t spin = 0;
+    while (sLoadRunning) {
+        spin++;
+    }
+    return NULL;
+}
+
+static int compareUs(const void* a, const void* b) {
+    uint64_t l = *(const uint64_t*)a, r = *(const uint64_t*)b;
+    return (l > r) - (l < r);
+}
+
+static int testLatency(int loadThreads, const LocThreadSched& sched) {
+    // before the first MsgTask, which starts the shared workers
+    LocThread::setSched(LOC_EXECUTOR_DEFAULT_NAME, sched);
+    MsgTask* task = new MsgTask("LocLatencyTest", false);
+
+    pthread_t* load = new pthread_t[loadThreads];
+    for (int i = 0; i < loadThreads; i++) {
+        pthread_create(&load[i], NULL, testLoad, NULL);
+    }
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (int i = 0; i < TEST_LATENCY_SAMPLES; i++) {
+        next.tv_nsec += TEST_LATENCY_PERIOD_NS;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        task->sendMsg(new LocLatencyTestMsg());
+    }
+    usleep(100000);
+
+    sLoadRunning = false;
+    for (int i = 0; i < loadThreads; i++) {
+        pthread_join(load[i], NULL);
+    }
+    delete[] load;
+    task->destroy();
+
+    uint32_t count = sLatencyCount;
+    if (0 == count) {
+        printf("no msg received\n");
+        return 1;
+    }
+    double sum = 0, sumSq = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        sum += sLatencyUs[i];
+        sumSq += (double)sLatencyUs[i] * sLatencyUs[i];
+    }
+    double mean = sum / count;
+    double var = sumSq / count - mean * mean;
+    qsort(sLatencyUs, count, sizeof(sLatencyUs[0]), compareUs);
+    printf("load %d cpu mask 0x%x nice %d fifo %u: %u msgs, latency us "
+           "min %llu avg %.0f p99 %llu max %llu stddev %.0f\n",
+           loadThreads, sched.mCpuMask, sched.mNice, sched.mFifoPriority, count,
+           (unsigned long long)sLatencyUs[0], mean,
+           (unsigned long long)sLatencyUs[count * 99 / 100],
+           (unsigned long long)sLatencyUs[count - 1], var > 0 ? sqrt(var) : 0);
+    return 0;
+}
+
+// on linux command line:
+// compile: g++ -D__LOC_HOST_DEBUG__ -g -std=c++0x -I. -Iplatform_lib_abstractions -I../../../../system/core/include -c LocThread.cpp MsgTask.cpp LocMsgPool.cpp LocMsgTrace.cpp loc_log.cpp loc_log_async.cpp
+//          gcc -D__LOC_HOST_DEBUG__ -g -I. -Iplatform_lib_abstractions -I../../../../system/core/include -c msg_q.c linked_list.c
+//          g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -std=c++0x -I. -Iplatform_lib_abstractions -I../../../../system/core/include LocExecutor.cpp *.o -lpthread
+// run: ./a.out [msgs per sender]
+//      ./a.out latency [load threads] [fifo priority] [nice] [cpu mask]
+int main(int argc, char** argv) {
+    if (argc > 1 && 0 == strcmp(argv[1], "latency")) {
+        LocThreadSched sched;
+        memset(&sched, 0, sizeof(sched));
+        int loadThreads = (argc > 2) ? atoi(argv[2]) : 4;
+        sched.mFifoPriority = (argc > 3) ? atoi(argv[3]) : 0;
+        sched.mNice = (argc > 4) ? atoi(argv[4]) : 0;
+        sched.mCpuMask = (argc > 5) ? strtoul(argv[5], NULL, 0) : 0;
+        return testLatency(loadThreads, sched);
+    }
+
+    if (argc > 1) {
+        sMsgsPerSender = atoi(argv[1]);
+    }
+    return testOrdering();
+}
+
+#endif
@@ -0,0 +1,123 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_EXECUTOR_H__
+#define __LOC_EXECUTOR_H__
+
+#include <stdint.h>
+#include <pthread.h>
+#include <LocThread.h>
+
+// name and number of workers of the shared executor, see
+// LocExecutor::getDefault(); worker threads are named <name><index>
+#define LOC_EXECUTOR_DEFAULT_NAME "LocWorker"
+#define LOC_EXECUTOR_DEFAULT_WORKERS 2
+#define LOC_EXECUTOR_MAX_WORKERS 8
+// upper bound of fd events taken out of one epoll_wait()
+#define LOC_EXECUTOR_MAX_EVENTS 8
+
+class LocExecutor;
+
+// A unit of work that runs on a LocExecutor. A task is queued at most once
+// at a time, and never runs on two workers at once; posting a task while it
+// runs has it run once more right after. So whatever a task does in
+// execute() is serialized, in the order it was posted for.
+class LocExecutorTask {
+    friend class LocExecutor;
+    enum State { IDLE, QUEUED, RUNNING, RERUN };
+    // all guarded by the mutex of the executor
+    State mState;
+    bool mRetired;
+    LocExecutorTask* mNextQueued;
+public:
+    inline LocExecutorTask() : mState(IDLE), mRetired(false), mNextQueued(NULL) {}
+    inline virtual ~LocExecutorTask() {}
+    // runs in one of the workers of the executor
+    virtual void execute() = 0;
+};
+
+// A fixed number of worker threads that run the posted LocExecutorTasks in
+// FIFO order, in place of a thread per task. An idle worker also polls the
+// fds added with addFd() and posts their tasks when the fds are ready, so
+// no thread has to sit in epoll_wait() on its own behalf.
+class LocExecutor {
+    friend class LocExecutorWorker;
+    const LocThread::tCreate mCreator;
+    pthread_mutex_t mMutex;
+    pthread_cond_t mCond;
+    // FIFO of queued tasks, linked through mNextQueued
+    LocExecutorTask* mHead;
+    LocExecutorTask* mTail;
+    // epoll fd, and the eventfd that interrupts the worker polling it
+    int mPollFd;
+    int mEventFd;
+    // number of workers waiting on mCond
+    unsigned int mIdle;
+    // whether a worker is in epoll_wait(), and whether mEventFd is written
+    bool mPolling;
+    bool mWoken;
+    bool mStopping;
+    unsigned int mNumWorkers;
+    LocThread mWorkers[LOC_EXECUTOR_MAX_WORKERS];
+    uint64_t mExecuted;
+    uint64_t mPolls;
+    static pthread_mutex_t mDefaultMutex;
+    static LocExecutor* mDefault;
+    bool queueLocked(LocExecutorTask& task);
+    void wakeLocked();
+    // worker loop body: runs the next queued task, polling while there is
+    // none. false once the executor stops
+    bool runNext();
+public:
+    // numWorkers is capped to LOC_EXECUTOR_MAX_WORKERS. creator, if not
+    // NULL, creates the worker threads, e.g. so that they can call into the
+    // framework.
+    LocExecutor(const char* name, unsigned int numWorkers,
+                LocThread::tCreate creator = NULL);
+    // stops and joins the workers; queued tasks do not get to run
+    ~LocExecutor();
+    // queues task to run, unless it is already queued
+    void post(LocExecutorTask& task);
+    // deletes task as soon as it is neither queued nor running, without
+    // running it again. It must not be posted any more.
+    void retire(LocExecutorTask& task);
+    // polls fd for events, e.g. EPOLLIN, and posts task once it is ready.
+    // The fd is then not polled again until it is added again.
+    bool addFd(int fd, uint32_t events, LocExecutorTask& task);
+    void removeFd(int fd);
+    inline unsigned int getNumWorkers() const { return mNumWorkers; }
+    // logs the number of workers, tasks run and polls
+    void dump();
+    // the executor shared across the process, created on first call.
+    // A caller passing a creator needs its tasks to run in threads made by
+    // that creator; it gets NULL if the shared executor already runs in
+    // threads made otherwise.
+    static LocExecutor* getDefault(LocThread::tCreate creator = NULL);
+};
+
+#endif //__LOC_EXECUTOR_H__
@@ -27,251 +27,135 @@
  *
  */
 #include <LocHeap.h>
+#include <stdlib.h>
 
-class LocHeapNode {
-    friend class LocHeap;
-
-    // size of of the subtree, excluding self, 1 if no subtree
-    int mSize;
-    LocHeapNode* mLeft;
-    LocHeapNode* mRight;
-    LocRankable* mData;
-public:
-    inline LocHeapNode(LocRankable& data) :
-        mSize(1), mLeft(NULL), mRight(NULL), mData(&data) {}
-    ~LocHeapNode();
-
-    // this only swaps the data of the two nodes, so no
-    // detach / re-attached is necessary
-    void swap(LocHeapNode& node);
-
-    LocRankable* detachData();
-
-    // push a node into the tree stucture, keeping sorted by rank
-    void push(LocHeapNode& node);
-
-    // pop the head node out of the tree stucture. keeping sorted by rank
-    static LocHeapNode* pop(LocHeapNode*& top);
-
-    // remove a specific node from the tree
-    // returns the pointer to the node removed, which would be either the
-    //         same as input (if successfully removed); or NULL (if failed).
-    static LocHeapNode* remove(LocHeapNode*& top, LocRankable& data);
-
-    // convenience method to compare data ranking
-    inline bool outRanks(LocHeapNode& node) { return mData->outRanks(*node.mData); }
-    inline bool outRanks(LocRankable& data) { return mData->outRanks(data); }
-
-    // checks if mSize is correct, AND this node is the highest ranking
-    // of the entire subtree
-    bool checkNodes();
+#define LOC_HEAP_INIT_CAPACITY 16
 
-    inline int getSize() { return mSize; }
-};
+static inline int parentOf(int index) { return (index - 1) / LOC_HEAP_ARITY; }
 
-inline
-LocHeapNode::~LocHeapNode() {
-    if (mLeft) {
-        delete mLeft;
-        mLeft = NULL;
-    }
-    if (mRight) {
-        delete mRight;
-        mRight = NULL;
-    }
-    if (mData) {
-        mData = NULL;
+LocHeap::~LocHeap() {
+    for (int i = 0; i < mSize; i++) {
+        mNodes[i]->mHeapIndex = -1;
     }
+    free(mNodes);
 }
 
 inline
-void LocHeapNode::swap(LocHeapNode& node) {
-    LocRankable* tmpData = node.mData;
-    node.mData = mData;
-    mData = tmpData;
-}
-
-inline
-LocRankable* LocHeapNode::detachData()  {
-    LocRankable* data = mData;
-    mData = NULL;
-    return data;
+void LocHeap::place(LocRankable* node, int index) {
+    mNodes[index] = node;
+    node->mHeapIndex = index;
 }
 
-// push keeps the tree sorted by rank, it also tries to balance the
-// tree by adding the new node to the smaller of the subtrees.
-// The pointer to the tree and internal links never change. If the
-// mData of tree top ranks lower than that of the incoming node,
-// mData will be swapped with that of the incoming node to ensure
-// ranking, no restructuring the container nodes.
-void LocHeapNode::push(LocHeapNode& node) {
-    // ensure the current node ranks higher than in the incoming one
-    if (node.outRanks(*this)) {
-        swap(node);
-    }
-
-    // now drop the new node (ensured lower than *this) into a subtree
-    if (NULL == mLeft) {
-        mLeft = &node;
-    } else if (NULL == mRight) {
-        mRight = &node;
-    } else if (mLeft->mSize <= mRight->mSize) {
-        mLeft->push(node);
-    } else {
-        mRight->push(node);
-    }
-    mSize++;
-}
-
-// pop keeps the tree sorted by rank, but it does not try to balance
-// the tree. It recursively swaps with the higher ranked top of the
-// subtrees.
-// The return is a popped out node from leaf level, that has the data
-// swapped all the way down from the top. The pinter to the tree and
-// internal links will not be changed or restructured, except for the
-// node that is popped out.
-// If the return pointer == this, this the last node in the tree.
-LocHeapNode* LocHeapNode::pop(LocHeapNode*& top) {
-    // we know the top has the highest ranking at this point, else
-    // the tree is broken. This top will be popped out.  But we need
-    // a node from the left or right child, whichever ranks higher,
-    // to replace the current top. This then will need to be done
-    // recursively to the leaf level. So we swap the mData of the
-    // current top node all the way down to the leaf level.
-    LocHeapNode* poppedNode = top;
-    // top is losing a node in its subtree
-    top->mSize--;
-    if (top->mLeft || top->mRight) {
-        // if mLeft is NULL, mRight for sure is NOT NULL, take that;
-        // else if mRight is NULL, mLeft for sure is NOT, take that;
-        // else we take the address of whatever has higher ranking mData
-        LocHeapNode*& subTop = (NULL == top->mLeft) ? top->mRight :
-            ((NULL == top->mRight) ? top->mLeft :
-             (top->mLeft->outRanks(*(top->mRight)) ? top->mLeft : top->mRight));
-        // swap mData, the tree top gets updated with the new data.
-        top->swap(*subTop);
-        // pop out from the subtree
-        poppedNode = pop(subTop);
-    } else {
-        // if the top has only single node
-        // detach the poppedNode from the tree
-        // subTop is the reference of ether mLeft or mRight
-        // NOT a local stack pointer. so it MUST be NULL'ed here.
-        top = NULL;
+// moves the node at index up until its parent ranks no lower than it.
+// Rather than swapping at each level, parents are shifted down into the
+// hole and the node is written once at its final slot.
+void LocHeap::siftUp(int index) {
+    LocRankable* node = mNodes[index];
+    while (index > 0) {
+        int parent = parentOf(index);
+        if (!node->outRanks(*mNodes[parent])) {
+            break;
+        }
+        place(mNodes[parent], index);
+        index = parent;
     }
-
-    return poppedNode;
+    place(node, index);
 }
 
-// navigating through the tree and find the node that hass the input
-// data. Since this is a heap, we do recursive linear search.
-// returns the pointer to the node removed, which would be either the
-//         same as input (if successfully removed); or NULL (if failed).
-LocHeapNode* LocHeapNode::remove(LocHeapNode*& top, LocRankable& data) {
-    LocHeapNode* removedNode = NULL;
-    // this is the node, by address
-    if (&data == (LocRankable*)(top->mData)) {
-        // pop this node out
-        removedNode = pop(top);
-    } else if (!data.outRanks(*top->mData)) {
-        // subtrees might have this node
-        if (top->mLeft) {
-            removedNode = remove(top->mLeft, data);
+// moves the node at index down until none of its children outranks it.
+void LocHeap::siftDown(int index) {
+    LocRankable* node = mNodes[index];
+    for (;;) {
+        int child = firstChildOf(index);
+        if (child >= mSize) {
+            break;
         }
-        // if we did not find in mLeft, and mRight is not empty
-        if (!removedNode && top->mRight) {
-            removedNode = remove(top->mRight, data);
+        // find the highest ranking of the up to 4 children
+        int best = child;
+        int last = child + LOC_HEAP_ARITY;
+        if (last > mSize) {
+            last = mSize;
         }
-
-        // top lost a node in its subtree
-        if (removedNode) {
-            top->mSize--;
+        for (child++; child < last; child++) {
+            if (mNodes[child]->outRanks(*mNodes[best])) {
+                best = child;
+            }
+        }
+        if (!mNodes[best]->outRanks(*node)) {
+            break;
         }
+        place(mNodes[best], index);
+        index = best;
     }
-
-    return removedNode;
+    place(node, index);
 }
 
-// checks if mSize is correct, AND this node is the highest ranking
-// of the entire subtree
-bool LocHeapNode::checkNodes() {
-    // size of the current subtree
-    int totalSize = mSize;
-    if (mLeft) {
-        // check the consistency of left subtree
-        if (mLeft->outRanks(*this) || !mLeft->checkNodes()) {
-            return false;
+LocRankable* LocHeap::removeAt(int index) {
+    LocRankable* node = mNodes[index];
+    node->mHeapIndex = -1;
+    mSize--;
+    if (index < mSize) {
+        // fill the hole with the last node, which may need to go
+        // either up or down from there
+        place(mNodes[mSize], index);
+        if (index > 0 && mNodes[index]->outRanks(*mNodes[parentOf(index)])) {
+            siftUp(index);
+        } else {
+            siftDown(index);
         }
-        // subtract the size of left subtree (with subtree head)
-        totalSize -= mLeft->mSize;
     }
+    mNodes[mSize] = NULL;
+    return node;
+}
 
-    if (mRight) {
-        // check the consistency of right subtree
-        if (mRight->outRanks(*this) || !mRight->checkNodes()) {
+bool LocHeap::push(LocRankable& node) {
+    if (mSize == mCapacity) {
+        int capacity = mCapacity ? mCapacity * 2 : LOC_HEAP_INIT_CAPACITY;
+        LocRankable** nodes =
+            (LocRankable**)realloc(mNodes, capacity * sizeof(LocRankable*));
+        if (NULL == nodes) {
             return false;
         }
-        // subtract the size of right subtree (with subtree head)
-        totalSize -= mRight->mSize;
+        mNodes = nodes;
+        mCapacity = capacity;
     }
-
-    // for the tree nodes to consistent, totalSize must be 1 now
-    return totalSize == 1;
+    place(&node, mSize++);
+    siftUp(mSize - 1);
+    return true;
 }
 
-LocHeap::~LocHeap() {
-    if (mTree) {
-        delete mTree;
-    }
-}
-
-void LocHeap::push(LocRankable& node) {
-    LocHeapNode* heapNode = new LocHeapNode(node);
-    if (!mTree) {
-        mTree = heapNode;
-    } else {
-        mTree->push(*heapNode);
-    }
-}
-
-LocRankable* LocHeap::peek() {
-    LocRankable* top = NULL;
-    if (mTree) {
-        top = mTree->mData;
-    }
-    return top;
+LocRankable* LocHeap::pop() {
+    return (mSize > 0) ? removeAt(0) : NULL;
 }
 
-LocRankable* LocHeap::pop() {
-    LocRankable* locNode = NULL;
-    if (mTree) {
-        // mTree may become NULL after this call
-        LocHeapNode* heapNode = LocHeapNode::pop(mTree);
-        locNode = heapNode->detachData();
-        delete heapNode;
+LocRankable* LocHeap::remove(LocRankable& rankable) {
+    int index = rankable.mHeapIndex;
+    if (index < 0 || index >= mSize || mNodes[index] != &rankable) {
+        return NULL;
     }
-    return locNode;
+    return removeAt(index);
 }
 
-LocRankable* LocHeap::remove(LocRankable& rankable) {
-    LocRankable* locNode = NULL;
-    if (mTree) {
-        // mTree may become NULL after this call
-        LocHeapNode* heapNode = LocHeapNode::remove(mTree, rankable);
-        if (heapNode) {
-            locNode = heapNode->detachData();
-            delete heapNode;
+// checks that every node knows its slot, AND that no node outranks
+// its parent
+bool LocHeap::checkNodes() {
+    for (int i = 0; i < mSize; i++) {
+        if (mNodes[i]->mHeapIndex != i) {
+            return false;
+        }
+        if (i > 0 && mNodes[i]->outRanks(*mNodes[parentOf(i)])) {
+            return false;
         }
     }
-    return locNode;
+    return true;
 }
 
 #ifdef __LOC_UNIT_TEST__
 bool LocHeap::checkTree() {
-    return ((NULL == mTree) || mTree->checkNodes());
+    return checkNodes();
 }
 uint32_t LocHeap::getTreeSize() {
-    return (NULL == mTree) ? 0 : mTree->getSize();
+    return mSize;
 }
 #endif
 
@@ -284,11 +168,15 @@ uint32_t LocHeap::getTreeSize() {
 class LocHeapDebug : public LocHeap {
 public:
     bool checkTree() {
-        return ((NULL == mTree) || mTree->checkNodes());
+        return checkNodes();
     }
 
     uint32_t getTreeSize() {
-        return (NULL == mTree) ? 0 : (mTree->getSize());
+        return getSize();
+    }
+
+    LocRankable* at(int index) {
+        return mNodes[index];
     }
 };
 
@@ -322,6 +210,12 @@ int main(int argc, char** argv) {
             LocHeapDebugData* data = new LocHeapDebugData(r >> 1);
             heap.push(dynamic_cast<LocRankable&>(*data));
             treeSize++;
+        } else if ((r & 2) && treeSize) {
+            LocRankable* rankable = heap.remove(*heap.at((r >> 2) % treeSize));
+            if (rankable) {
+                delete rankable;
+                treeSize--;
+            }
         } else {
             LocRankable* rankable = heap.pop();
             if (rankable) {
@@ -330,7 +224,8 @@ int main(int argc, char** argv) {
             treeSize ? treeSize-- : 0;
         }
 
-        printf("%s: %d == %d\n", (r&1)?"push":"pop", treeSize, heap.getTreeSize());
+        printf("%s: %d == %d\n", (r&1)?"push":((r&2)?"remove":"pop"),
+               treeSize, heap.getTreeSize());
         if (treeSize != heap.getTreeSize()) {
             printf("!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!\n");
             tries = i+1;
@@ -348,6 +243,34 @@ int main(int argc, char** argv) {
         delete data;
     }
 
+    // timing: push tries nodes, then take them all out again with
+    // remove() in random order, the way timers get stopped
+    LocHeapDebugData** nodes = new LocHeapDebugData*[tries];
+    for (int i = 0; i < tries; i++) {
+        nodes[i] = new LocHeapDebugData(rand());
+    }
+    for (int i = tries - 1; i > 0; i--) {
+        int j = rand() % (i + 1);
+        LocHeapDebugData* tmp = nodes[i];
+        nodes[i] = nodes[j];
+        nodes[j] = tmp;
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < tries; i++) {
+        heap.push(*nodes[i]);
+    }
+    for (int i = tries - 1; i >= 0; i--) {
+        heap.remove(*nodes[i]);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    printf("%d push + remove: %.1f ns per pair\n", tries, ns / tries);
+    for (int i = 0; i < tries; i++) {
+        delete nodes[i];
+    }
+    delete[] nodes;
+
     return 0;
 }
 
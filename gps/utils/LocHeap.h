@@ -30,11 +30,19 @@
 #define __LOC_HEAP__
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
+class LocHeap;
+
 // abstract class to be implemented by client to provide a rankable class
 class LocRankable {
+    friend class LocHeap;
+    // slot of this obj in the LocHeap it is in; -1 if not in any.
+    // An obj can only be in one heap at a time.
+    int mHeapIndex;
 public:
+    inline LocRankable() : mHeapIndex(-1) {}
     virtual inline ~LocRankable() {}
 
     // method to rank objects of such type for sorting purposes.
@@ -46,47 +54,62 @@ public:
 
     // convenient method to rank objects of such type for sorting purposes.
     inline bool outRanks(LocRankable& rankable) { return ranks(rankable) > 0; }
+
+    // whether this obj currently sits in a heap
+    inline bool inHeap() const { return mHeapIndex >= 0; }
 };
 
-// opaque class to provide service implementation.
-class LocHeapNode;
+// a 4-ary heap laid out in a flat array. Every parent ranks higher than or
+// equally with its (up to 4) children; siblings are not sorted. Ranking
+// algorithm is implemented in Rankable. Each node remembers its own slot
+// in the array, so remove() does not need to search, and no memory is
+// allocated per node; the array only grows (doubling) when full.
+#define LOC_HEAP_ARITY 4
 
-// a heap whose left and right children are not sorted. It is sorted only vertically,
-// i.e. parent always ranks higher than children, if they exist. Ranking algorithm is
-// implemented in Rankable. The reason that there is no sort between children is to
-// help beter balance the tree with lower cost. When a node is pushed to the tree,
-// it is guaranteed that the subtree that is smaller gets to have the new node.
 class LocHeap {
 protected:
-    LocHeapNode* mTree;
+    LocRankable** mNodes;
+    int mSize;
+    int mCapacity;
+
+    void place(LocRankable* node, int index);
+    void siftUp(int index);
+    void siftDown(int index);
+    LocRankable* removeAt(int index);
+    static inline int firstChildOf(int index) { return index * LOC_HEAP_ARITY + 1; }
+    // checks that every node knows its slot, AND that no node
+    // outranks its parent
+    bool checkNodes();
 public:
-    inline LocHeap() : mTree(NULL) {}
+    inline LocHeap() : mNodes(NULL), mSize(0), mCapacity(0) {}
     ~LocHeap();
 
-    // push keeps the tree sorted by rank, it also tries to balance the
-    // tree by adding the new node to the smaller of the subtrees.
+    // push keeps the heap sorted by rank.
     // node is reference to an obj that is managed by client, that client
     //      creates and destroyes. The destroy should happen after the
     //      node is popped out from the heap.
-    void push(LocRankable& node);
+    // Return - false if the heap could not grow to take the node, which
+    //          then is not in the heap
+    bool push(LocRankable& node);
 
-    // Peeks the node data on tree top, which has currently the highest ranking
-    // There is no change the tree structure with this operation
-    // Returns NULL if the tree is empty, otherwise pointer to the node data of
-    //         the tree top.
-    LocRankable* peek();
+    // Peeks the node data on heap top, which has currently the highest ranking
+    // There is no change the heap structure with this operation
+    // Returns NULL if the heap is empty, otherwise pointer to the node data of
+    //         the heap top.
+    inline LocRankable* peek() { return mSize > 0 ? mNodes[0] : NULL; }
 
-    // pop keeps the tree sorted by rank, but it does not try to balance
-    // the tree.
+    // pop keeps the heap sorted by rank.
     // Return - pointer to the node popped out, or NULL if heap is already empty
     LocRankable* pop();
 
-    // navigating through the tree and find the node that ranks the same
-    // as the input data, then remove it from the tree. Rank is implemented
-    // by rankable obj.
-    // returns the pointer to the node removed; or NULL (if failed).
+    // removes the input node from the heap, in O(log n).
+    // returns the pointer to the node removed; or NULL (if it is not in
+    //         this heap).
     LocRankable* remove(LocRankable& rankable);
 
+    inline bool isEmpty() const { return 0 == mSize; }
+    inline int getSize() const { return mSize; }
+
 #ifdef __LOC_UNIT_TEST__
     bool checkTree();
     uint32_t getTreeSize();
@@ -0,0 +1,175 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_MsgPool"
+
+#include <LocMsgPool.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <new>
+#include <log_util.h>
+
+#define MIN_BLOCK_SHIFT 6
+#define SLAB_SIZE (16 * 1024)
+#define MAX_SLABS_PER_CLASS 8
+#define HEAP_CLASS 0xff
+
+// Every block is prefixed with the index of the class it belongs
+// to, so release() needs neither the size nor a lookup. The header
+// is padded to the maximum alignment to keep the payload aligned.
+union BlockHeader {
+    uint32_t cls;
+    max_align_t align;
+};
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct SizeClass {
+    pthread_mutex_t mutex;
+    FreeBlock* freeList;
+    LocMsgPool::Stats stats;
+};
+
+#define SIZE_CLASS(cls) \
+    { PTHREAD_MUTEX_INITIALIZER, NULL, \
+      { ((size_t)1 << (MIN_BLOCK_SHIFT + cls)) - sizeof(BlockHeader), 0, 0, 0, 0, 0 } }
+
+static SizeClass sClasses[LocMsgPool::NUM_CLASSES] = {
+    SIZE_CLASS(0), SIZE_CLASS(1), SIZE_CLASS(2), SIZE_CLASS(3),
+    SIZE_CLASS(4), SIZE_CLASS(5), SIZE_CLASS(6), SIZE_CLASS(7)
+};
+
+// allocations larger than the biggest class
+static uint64_t sOversized = 0;
+
+static inline int classOf(size_t size) {
+    for (int cls = 0; cls < LocMsgPool::NUM_CLASSES; cls++) {
+        if (size <= sClasses[cls].stats.blockSize) {
+            return cls;
+        }
+    }
+    return -1;
+}
+
+// carves a new slab into the free list of sc. Must be called
+// with sc->mutex held.
+static bool grow(SizeClass* sc, int cls) {
+    if (sc->stats.slabs >= MAX_SLABS_PER_CLASS) {
+        return false;
+    }
+    char* slab = (char*)malloc(SLAB_SIZE);
+    if (NULL == slab) {
+        return false;
+    }
+    size_t blockBytes = (size_t)1 << (MIN_BLOCK_SHIFT + cls);
+    for (size_t off = 0; off + blockBytes <= SLAB_SIZE; off += blockBytes) {
+        FreeBlock* block = (FreeBlock*)(slab + off);
+        block->next = sc->freeList;
+        sc->freeList = block;
+    }
+    sc->stats.slabs++;
+    return true;
+}
+
+void* LocMsgPool::allocate(size_t size) {
+    int cls = classOf(size);
+    BlockHeader* header = NULL;
+
+    if (cls >= 0) {
+        SizeClass* sc = &sClasses[cls];
+        pthread_mutex_lock(&sc->mutex);
+        if (NULL != sc->freeList || grow(sc, cls)) {
+            header = (BlockHeader*)sc->freeList;
+            sc->freeList = sc->freeList->next;
+            sc->stats.hits++;
+            if (++sc->stats.inUse > sc->stats.peak) {
+                sc->stats.peak = sc->stats.inUse;
+            }
+        } else {
+            sc->stats.misses++;
+        }
+        pthread_mutex_unlock(&sc->mutex);
+    } else {
+        __atomic_fetch_add(&sOversized, 1, __ATOMIC_RELAXED);
+    }
+
+    if (NULL != header) {
+        header->cls = cls;
+    } else {
+        header = (BlockHeader*)::operator new(sizeof(BlockHeader) + size);
+        header->cls = HEAP_CLASS;
+    }
+
+    return header + 1;
+}
+
+void LocMsgPool::release(void* ptr) {
+    if (NULL == ptr) {
+        return;
+    }
+
+    BlockHeader* header = (BlockHeader*)ptr - 1;
+    if (HEAP_CLASS == header->cls) {
+        ::operator delete(header);
+        return;
+    }
+
+    SizeClass* sc = &sClasses[header->cls];
+    FreeBlock* block = (FreeBlock*)header;
+    pthread_mutex_lock(&sc->mutex);
+    block->next = sc->freeList;
+    sc->freeList = block;
+    sc->stats.inUse--;
+    pthread_mutex_unlock(&sc->mutex);
+}
+
+bool LocMsgPool::getStats(int cls, Stats& stats) {
+    if (cls < 0 || cls >= NUM_CLASSES) {
+        return false;
+    }
+    SizeClass* sc = &sClasses[cls];
+    pthread_mutex_lock(&sc->mutex);
+    stats = sc->stats;
+    pthread_mutex_unlock(&sc->mutex);
+    return true;
+}
+
+void LocMsgPool::dump() {
+    for (int cls = 0; cls < NUM_CLASSES; cls++) {
+        Stats stats;
+        getStats(cls, stats);
+        LOC_LOGD("%s: block %4zu slabs %u inUse %u peak %u hits %llu misses %llu",
+                 __func__, stats.blockSize, stats.slabs, stats.inUse, stats.peak,
+                 (unsigned long long)stats.hits, (unsigned long long)stats.misses);
+    }
+    LOC_LOGD("%s: oversized %llu", __func__,
+             (unsigned long long)__atomic_load_n(&sOversized, __ATOMIC_RELAXED));
+}
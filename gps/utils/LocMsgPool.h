@@ -0,0 +1,64 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_MSG_POOL__
+#define __LOC_MSG_POOL__
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Process wide fixed-size block pool backing LocMsg allocations.
+// Blocks come in power of 2 size classes carved out of slabs which
+// are never handed back to the heap, so once the pool is warm the
+// steady stream of report messages does not touch malloc at all.
+// Requests arriving when a class has used up its slab budget fall
+// through to the global heap and are counted as misses; requests
+// larger than the biggest class always go to the heap.
+class LocMsgPool {
+public:
+    struct Stats {
+        size_t blockSize;   // usable bytes per block
+        uint32_t slabs;     // slabs carved for this class
+        uint32_t inUse;     // blocks currently handed out
+        uint32_t peak;      // high water mark of inUse
+        uint64_t hits;      // allocations served from the pool
+        uint64_t misses;    // allocations that fell back to the heap
+    };
+
+    static const int NUM_CLASSES = 8;   // 64 bytes .. 8K
+
+    static void* allocate(size_t size);
+    static void release(void* ptr);
+
+    // copies the counters of size class cls; false if cls is invalid
+    static bool getStats(int cls, Stats& stats);
+    // logs the counters of all size classes
+    static void dump();
+};
+
+#endif //__LOC_MSG_POOL__
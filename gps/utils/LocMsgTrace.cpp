@@ -0,0 +1,261 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_MsgTrace"
+#define ATRACE_TAG ATRACE_TAG_HAL
+
+#include <cutils/trace.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <LocMsgTrace.h>
+#include <MsgTask.h>
+#include <log_util.h>
+
+// log-linear buckets, as in HdrHistogram: below 16 ns a bucket per ns,
+// above it every power of 2 split in 8, so a bucket is within 12.5%.
+// The last bucket takes all from 2^40 ns, some 18 minutes, up.
+#define LOC_MSG_TRACE_LINEAR 16
+#define LOC_MSG_TRACE_SUB_BITS 3
+#define LOC_MSG_TRACE_BUCKETS \
+    (LOC_MSG_TRACE_LINEAR + (40 - 4) * (1 << LOC_MSG_TRACE_SUB_BITS))
+
+struct LocMsgTraceHistogram {
+    uint64_t max;
+    uint32_t counts[LOC_MSG_TRACE_BUCKETS];
+};
+
+struct LocMsgTrace::Type {
+    const void* vtable;
+    uint64_t count;
+    LocMsgTraceHistogram wait;
+    LocMsgTraceHistogram proc;
+    char name[48];
+};
+
+bool LocMsgTrace::mEnabled = false;
+// open addressed by vtable; slots are only ever filled, never emptied
+static LocMsgTrace::Type* sTypes[LOC_MSG_TRACE_MAX_TYPES];
+
+static inline unsigned bucketOf(uint64_t ns) {
+    if (ns < LOC_MSG_TRACE_LINEAR) {
+        return ns;
+    }
+    unsigned exp = 63 - __builtin_clzll(ns);
+    unsigned bucket = LOC_MSG_TRACE_LINEAR +
+        (exp - 4) * (1 << LOC_MSG_TRACE_SUB_BITS) +
+        ((ns >> (exp - LOC_MSG_TRACE_SUB_BITS)) & ((1 << LOC_MSG_TRACE_SUB_BITS) - 1));
+    return bucket < LOC_MSG_TRACE_BUCKETS ? bucket : LOC_MSG_TRACE_BUCKETS - 1;
+}
+
+// highest value that falls into bucket
+static inline uint64_t bucketTop(unsigned bucket) {
+    if (bucket < LOC_MSG_TRACE_LINEAR) {
+        return bucket;
+    }
+    unsigned exp = (bucket - LOC_MSG_TRACE_LINEAR) / (1 << LOC_MSG_TRACE_SUB_BITS) + 4;
+    unsigned sub = (bucket - LOC_MSG_TRACE_LINEAR) % (1 << LOC_MSG_TRACE_SUB_BITS);
+    return ((uint64_t)((1 << LOC_MSG_TRACE_SUB_BITS) + sub + 1)
+            << (exp - LOC_MSG_TRACE_SUB_BITS)) - 1;
+}
+
+static inline void record(LocMsgTraceHistogram& histogram, uint64_t ns) {
+    __atomic_add_fetch(&histogram.counts[bucketOf(ns)], 1, __ATOMIC_RELAXED);
+    uint64_t max = __atomic_load_n(&histogram.max, __ATOMIC_RELAXED);
+    while (ns > max &&
+           !__atomic_compare_exchange_n(&histogram.max, &max, ns, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// value at or below which fraction of the count recorded falls
+static uint64_t percentile(const LocMsgTraceHistogram& histogram,
+                           uint64_t count, double fraction) {
+    uint64_t target = (uint64_t)(count * fraction + 0.5);
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < LOC_MSG_TRACE_BUCKETS; i++) {
+        seen += histogram.counts[i];
+        if (seen >= target && seen > 0) {
+            uint64_t top = bucketTop(i);
+            return top < histogram.max ? top : histogram.max;
+        }
+    }
+    return histogram.max;
+}
+
+// names a type after its vtable symbol, e.g. _ZTV20LocEngReportPosition,
+// or _ZTVN2ns4TypeE for ns::Type
+static void nameType(LocMsgTrace::Type* type) {
+    Dl_info info;
+    const char* symbol = NULL;
+    if (dladdr(type->vtable, &info) && NULL != info.dli_sname &&
+        0 == strncmp(info.dli_sname, "_ZTV", 4)) {
+        symbol = info.dli_sname + 4;
+    }
+    if (NULL == symbol) {
+        snprintf(type->name, sizeof(type->name), "LocMsg@%p", type->vtable);
+        return;
+    }
+
+    bool nested = ('N' == *symbol);
+    const char* p = nested ? symbol + 1 : symbol;
+    size_t len = 0;
+    while (*p >= '1' && *p <= '9') {
+        char* rest = NULL;
+        long partLen = strtol(p, &rest, 10);
+        if ((long)strnlen(rest, partLen) < partLen) {
+            break;
+        }
+        len += snprintf(type->name + len, sizeof(type->name) - len, "%s%.*s",
+                        len ? "::" : "", (int)partLen, rest);
+        p = rest + partLen;
+        if (!nested || len >= sizeof(type->name)) {
+            break;
+        }
+    }
+    if (0 == len || (nested ? ('E' != p[0] || '\0' != p[1]) : '\0' != *p)) {
+        // templated or else beyond us; the mangled name has to do
+        snprintf(type->name, sizeof(type->name), "%s", symbol);
+    }
+}
+
+static LocMsgTrace::Type* typeOf(const LocMsg* msg) {
+    const void* vtable = *(const void* const*)msg;
+    unsigned slot = (unsigned)(((uintptr_t)vtable >> 3) * 2654435761u) %
+        LOC_MSG_TRACE_MAX_TYPES;
+    LocMsgTrace::Type* fresh = NULL;
+
+    for (unsigned i = 0; i < LOC_MSG_TRACE_MAX_TYPES; i++) {
+        LocMsgTrace::Type** entry = &sTypes[(slot + i) % LOC_MSG_TRACE_MAX_TYPES];
+        LocMsgTrace::Type* type = __atomic_load_n(entry, __ATOMIC_ACQUIRE);
+        if (NULL == type) {
+            if (NULL == fresh) {
+                fresh = (LocMsgTrace::Type*)calloc(1, sizeof(LocMsgTrace::Type));
+                if (NULL == fresh) {
+                    return NULL;
+                }
+                fresh->vtable = vtable;
+                nameType(fresh);
+            }
+            if (__atomic_compare_exchange_n(entry, &type, fresh, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return fresh;
+            }
+            // type is whoever took the slot first
+        }
+        if (type->vtable == vtable) {
+            free(fresh);
+            return type;
+        }
+    }
+    free(fresh);
+    return NULL;
+}
+
+void LocMsgTrace::enable(bool enable) {
+    if (enable && !enabled()) {
+        for (unsigned i = 0; i < LOC_MSG_TRACE_MAX_TYPES; i++) {
+            Type* type = __atomic_load_n(&sTypes[i], __ATOMIC_ACQUIRE);
+            if (NULL != type) {
+                type->count = 0;
+                memset(&type->wait, 0, sizeof(type->wait));
+                memset(&type->proc, 0, sizeof(type->proc));
+            }
+        }
+    }
+    __atomic_store_n(&mEnabled, enable, __ATOMIC_RELAXED);
+}
+
+void LocMsgTrace::sent(const LocMsg* msg) {
+    Type* type = typeOf(msg);
+    if (NULL != type) {
+        ATRACE_ASYNC_BEGIN(type->name, (int32_t)(uintptr_t)msg);
+    }
+}
+
+LocMsgTrace::Type* LocMsgTrace::dequeued(const LocMsg* msg, uint64_t nowNs) {
+    Type* type = typeOf(msg);
+    if (NULL != type) {
+        ATRACE_ASYNC_END(type->name, (int32_t)(uintptr_t)msg);
+        __atomic_add_fetch(&type->count, 1, __ATOMIC_RELAXED);
+        record(type->wait, nowNs - msg->mSendTime);
+        ATRACE_BEGIN(type->name);
+    }
+    return type;
+}
+
+void LocMsgTrace::procDone(Type* type, uint64_t dequeueNs) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ATRACE_END();
+    record(type->proc, (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec - dequeueNs);
+}
+
+static int compareTails(const void* a, const void* b) {
+    uint64_t tailA = ((const uint64_t*)a)[1];
+    uint64_t tailB = ((const uint64_t*)b)[1];
+    return tailA < tailB ? 1 : (tailA > tailB ? -1 : 0);
+}
+
+void LocMsgTrace::dump() {
+    // {slot, p99 of wait + proc} of each type seen
+    uint64_t order[LOC_MSG_TRACE_MAX_TYPES][2];
+    unsigned num = 0;
+    for (unsigned i = 0; i < LOC_MSG_TRACE_MAX_TYPES; i++) {
+        Type* type = __atomic_load_n(&sTypes[i], __ATOMIC_ACQUIRE);
+        uint64_t count = (NULL == type) ? 0 :
+            __atomic_load_n(&type->count, __ATOMIC_RELAXED);
+        if (count > 0) {
+            order[num][0] = i;
+            order[num][1] = percentile(type->wait, count, 0.99) +
+                percentile(type->proc, count, 0.99);
+            num++;
+        }
+    }
+    qsort(order, num, sizeof(order[0]), compareTails);
+
+    LOC_LOGI("%s: %u msg types, us, wait in queue p50/p90/p99/max | proc() p50/p90/p99/max",
+             __func__, num);
+    for (unsigned i = 0; i < num; i++) {
+        const Type* type = sTypes[order[i][0]];
+        uint64_t count = __atomic_load_n(&type->count, __ATOMIC_RELAXED);
+        LOC_LOGI("%s: %-32s %8llu | %.1f %.1f %.1f %.1f | %.1f %.1f %.1f %.1f",
+                 __func__, type->name, (unsigned long long)count,
+                 percentile(type->wait, count, 0.5) / 1000.0,
+                 percentile(type->wait, count, 0.9) / 1000.0,
+                 percentile(type->wait, count, 0.99) / 1000.0,
+                 type->wait.max / 1000.0,
+                 percentile(type->proc, count, 0.5) / 1000.0,
+                 percentile(type->proc, count, 0.9) / 1000.0,
+                 percentile(type->proc, count, 0.99) / 1000.0,
+                 type->proc.max / 1000.0);
+    }
+}
@@ -0,0 +1,65 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_MSG_TRACE_H__
+#define __LOC_MSG_TRACE_H__
+
+#include <stdint.h>
+
+struct LocMsg;
+
+// distinct LocMsg types traced; msgs of types beyond are not
+#define LOC_MSG_TRACE_MAX_TYPES 128
+
+// Latency tracing of the LocMsgs MsgTask processes, off unless enabled.
+// Per concrete LocMsg type, it keeps histograms of the time msgs wait in
+// the queue and of the time proc() takes, and marks both in atrace: an
+// async slice per queued msg, and a slice per proc(), named after the type.
+// Types are told apart by their vtable, and named from its symbol, so no
+// msg needs to know it is traced.
+class LocMsgTrace {
+    static bool mEnabled;
+public:
+    struct Type;
+    // resets the histograms as tracing goes on
+    static void enable(bool enable);
+    inline static bool enabled() {
+        return __atomic_load_n(&mEnabled, __ATOMIC_RELAXED);
+    }
+    // as msg is queued, its mSendTime already set
+    static void sent(const LocMsg* msg);
+    // as msg is dequeued at nowNs, before its proc(); returns what to hand
+    // to procDone(), NULL if msg is not traced
+    static Type* dequeued(const LocMsg* msg, uint64_t nowNs);
+    // after proc() of a msg dequeued at dequeueNs
+    static void procDone(Type* type, uint64_t dequeueNs);
+    // logs the histograms, the types with the longest tails first
+    static void dump();
+};
+
+#endif //__LOC_MSG_TRACE_H__
@@ -0,0 +1,234 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <LocRcu.h>
+#include <stdlib.h>
+#include <sched.h>
+
+struct LocRcu::Retired {
+    void* mObj;
+    Retired* mNext;
+};
+
+// depth of nested read sections of this thread, of all LocRcu objs
+static __thread uint32_t sReadDepth = 0;
+
+LocRcu::LocRcu() : mGeneration(0), mRetired(NULL) {
+    mReaders[0] = mReaders[1] = 0;
+    pthread_mutex_init(&mMutex, NULL);
+}
+
+LocRcu::~LocRcu() {
+    // no reader is supposed to be around any more
+    reclaim();
+    pthread_mutex_destroy(&mMutex);
+}
+
+uint32_t LocRcu::readLock() {
+    uint32_t token = __atomic_load_n(&mGeneration, __ATOMIC_SEQ_CST) & 1;
+    // counted before the reader loads any pointer this guards
+    __atomic_add_fetch(&mReaders[token], 1, __ATOMIC_SEQ_CST);
+    sReadDepth++;
+    return token;
+}
+
+void LocRcu::readUnlock(uint32_t token) {
+    sReadDepth--;
+    __atomic_sub_fetch(&mReaders[token], 1, __ATOMIC_RELEASE);
+}
+
+bool LocRcu::synchronize() {
+    if (sReadDepth > 0) {
+        return false;
+    }
+    // Any reader that loaded a replaced pointer counted itself in either
+    // count before the pointer got replaced; wait for both to drain.
+    for (int flip = 0; flip < 2; flip++) {
+        uint32_t leaving = __atomic_fetch_add(&mGeneration, 1, __ATOMIC_SEQ_CST) & 1;
+        while (__atomic_load_n(&mReaders[leaving], __ATOMIC_ACQUIRE) != 0) {
+            sched_yield();
+        }
+    }
+    return true;
+}
+
+void LocRcu::reclaim() {
+    while (mRetired) {
+        Retired* retired = mRetired;
+        mRetired = retired->mNext;
+        free(retired->mObj);
+        free(retired);
+    }
+}
+
+void LocRcu::retire(void* obj) {
+    if (synchronize()) {
+        free(obj);
+        // whatever was deferred is past its grace period too
+        reclaim();
+    } else {
+        Retired* retired = (Retired*)malloc(sizeof(Retired));
+        if (retired) {
+            retired->mObj = obj;
+            retired->mNext = mRetired;
+            mRetired = retired;
+        } // else leak obj rather than free it under a reader
+    }
+}
+
+#ifdef __LOC_DEBUG__
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// stress test: writers keep adding / removing items of a snapshot set,
+// the way adapters come and go, while readers walk the set nonstop. An
+// item is marked dead right after the set it is removed from is retired;
+// a reader that ever sees a dead item fails the test; one that walks a
+// freed set crashes, with MALLOC_PERTURB_ set to have free() poison it.
+#define LIVE 0x4c495645
+#define DEAD 0x44454144
+
+struct Item {
+    uint32_t mMagic;
+};
+
+struct ItemSet {
+    int mCount;
+    Item* mItems[1];
+};
+
+static LocRcu sRcu;
+static ItemSet* sSet = NULL;
+static volatile bool sDone = false;
+static uint64_t sReads = 0;
+static uint32_t sFailures = 0;
+
+static ItemSet* newSet(int count) {
+    ItemSet* set = (ItemSet*)malloc(sizeof(ItemSet) + count * sizeof(Item*));
+    set->mCount = count;
+    return set;
+}
+
+static void* reader(void*) {
+    uint64_t reads = 0;
+    while (!sDone) {
+        LocRcuReader guard(sRcu);
+        ItemSet* set = __atomic_load_n(&sSet, __ATOMIC_ACQUIRE);
+        for (int i = 0; i < set->mCount; i++) {
+            if (LIVE != set->mItems[i]->mMagic) {
+                __atomic_add_fetch(&sFailures, 1, __ATOMIC_RELAXED);
+            }
+        }
+        reads++;
+    }
+    __atomic_add_fetch(&sReads, reads, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+static void* writer(void* arg) {
+    int changes = *(int*)arg;
+    unsigned int seed = (unsigned int)(uintptr_t)&seed;
+    Item** dead = new Item*[changes];
+    int deadCount = 0;
+    for (int c = 0; c < changes; c++) {
+        sRcu.writeLock();
+        ItemSet* set = sSet;
+        ItemSet* next;
+        Item* removed = NULL;
+        if (set->mCount > 0 && (rand_r(&seed) & 1)) {
+            int r = rand_r(&seed) % set->mCount;
+            removed = set->mItems[r];
+            next = newSet(set->mCount - 1);
+            for (int i = 0, j = 0; i < set->mCount; i++) {
+                if (i != r) {
+                    next->mItems[j++] = set->mItems[i];
+                }
+            }
+        } else {
+            next = newSet(set->mCount + 1);
+            memcpy(next->mItems, set->mItems, set->mCount * sizeof(Item*));
+            next->mItems[set->mCount] = new Item();
+            next->mItems[set->mCount]->mMagic = LIVE;
+        }
+        __atomic_store_n(&sSet, next, __ATOMIC_RELEASE);
+        sRcu.retire(set);
+        sRcu.writeUnlock();
+        if (removed) {
+            removed->mMagic = DEAD;
+            dead[deadCount++] = removed;
+        }
+    }
+    for (int i = 0; i < deadCount; i++) {
+        delete dead[i];
+    }
+    delete[] dead;
+    return NULL;
+}
+
+// For Linux command line testing:
+// compilation: g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -I. LocRcu.cpp -lpthread
+// run: MALLOC_PERTURB_=165 ./a.out <readers> <writers> <changes per writer>
+int main(int argc, char** argv) {
+    int readers = argc > 1 ? atoi(argv[1]) : 4;
+    int writers = argc > 2 ? atoi(argv[2]) : 2;
+    int changes = argc > 3 ? atoi(argv[3]) : 10000;
+    pthread_t* threads = new pthread_t[readers + writers];
+    struct timespec start, end;
+
+    sSet = newSet(0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < readers; i++) {
+        pthread_create(&threads[i], NULL, reader, NULL);
+    }
+    for (int i = 0; i < writers; i++) {
+        pthread_create(&threads[readers + i], NULL, writer, &changes);
+    }
+    for (int i = 0; i < writers; i++) {
+        pthread_join(threads[readers + i], NULL);
+    }
+    sDone = true;
+    for (int i = 0; i < readers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%d readers, %d writers: %llu reads, %d changes in %lf s, %u failures\n",
+           readers, writers, (unsigned long long)sReads, writers * changes, seconds,
+           sFailures);
+    for (int i = 0; i < sSet->mCount; i++) {
+        delete sSet->mItems[i];
+    }
+    free(sSet);
+    delete[] threads;
+    return sFailures ? 1 : 0;
+}
+
+#endif
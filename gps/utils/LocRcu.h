@@ -0,0 +1,86 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#ifndef __LOC_RCU_H__
+#define __LOC_RCU_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+// Read-copy-update guard for data that is read far more often than it is
+// changed. Readers never block nor spin: they read the current pointer to
+// an immutable obj inside readLock() / readUnlock(). A writer serialized
+// by writeLock() builds a new obj, publishes it, and hands the replaced
+// one to retire(), which frees it once no reader can still be looking at
+// it, i.e. after a grace period.
+//
+// The grace period uses two reader counts, with a generation bit telling
+// readers which one to count themselves in. synchronize() flips the bit
+// twice, each time waiting for the count readers are leaving to drain, so
+// a steady stream of new readers never holds up a writer.
+//
+// Objs given to retire() must have been allocated with malloc().
+class LocRcu {
+    uint32_t mGeneration;
+    uint32_t mReaders[2];
+    pthread_mutex_t mMutex;
+    // objs retired while the writer was itself in a read section
+    struct Retired;
+    Retired* mRetired;
+    void reclaim();
+public:
+    LocRcu();
+    ~LocRcu();
+
+    // wait free. Returns the token to hand back to readUnlock().
+    uint32_t readLock();
+    void readUnlock(uint32_t token);
+
+    inline void writeLock() { pthread_mutex_lock(&mMutex); }
+    inline void writeUnlock() { pthread_mutex_unlock(&mMutex); }
+
+    // waits until all the read sections that started before the call
+    // have ended. Returns false without waiting if the calling thread is
+    // inside a read section itself, which it would otherwise wait for.
+    bool synchronize();
+
+    // frees obj after a grace period; deferred to a later call or the
+    // dtor if the caller is inside a read section. Needs writeLock().
+    void retire(void* obj);
+};
+
+// RAII read section of a LocRcu
+class LocRcuReader {
+    LocRcu& mRcu;
+    uint32_t mToken;
+public:
+    inline LocRcuReader(LocRcu& rcu) : mRcu(rcu), mToken(rcu.readLock()) {}
+    inline ~LocRcuReader() { mRcu.readUnlock(mToken); }
+};
+
+#endif //__LOC_RCU_H__
@@ -26,12 +26,36 @@
  * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
  */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_LocThread"
+
 #include <LocThread.h>
 #include <string.h>
 #include <pthread.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <log_util.h>
+
+// thread name prefix -> sched, as given to LocThread::setSched()
+struct LocThreadSchedEntry {
+    char mPrefix[16];
+    LocThreadSched mSched;
+};
+
+static pthread_mutex_t sSchedLock = PTHREAD_MUTEX_INITIALIZER;
+static LocThreadSchedEntry sScheds[LOC_THREAD_MAX_SCHED];
+static int sSchedCount = 0;
+
+static inline bool isDefaultSched(const LocThreadSched& sched) {
+    return 0 == sched.mCpuMask && 0 == sched.mNice && 0 == sched.mFifoPriority;
+}
 
 class LocThreadDelegate {
     LocRunnable* mRunnable;
+    char mName[16];
     bool mJoinable;
     pthread_t mThandle;
     pthread_mutex_t mMutex;
@@ -50,6 +74,7 @@ public:
     // ahead to destroy()
     inline void bye() { mJoinable ? stop() : destroy(); }
     inline bool isRunning() { return (NULL != mRunnable); }
+    void applySched();
     static void* threadMain(void* arg);
 };
 
@@ -71,6 +96,8 @@ LocThreadDelegate::LocThreadDelegate(LocThread::tCreate creator,
     if (!threadName) {
         threadName = "LocThread";
     }
+    // the spawned thread looks its sched up by this name
+    strlcpy(mName, threadName, sizeof(mName));
 
     // create the thread here, then if successful
     // and a name is given, we set the thread name
@@ -82,11 +109,8 @@ LocThreadDelegate::LocThreadDelegate(LocThread::tCreate creator,
     }
 
     if (mThandle) {
-        // set thread name
-        char lname[16];
-        strlcpy(lname, threadName, sizeof(lname));
         // set the thread name here
-        pthread_setname_np(mThandle, lname);
+        pthread_setname_np(mThandle, mName);
 
         // detach, if not joinable
         if (!joinable) {
@@ -170,6 +194,50 @@ void LocThreadDelegate::destroy() {
     }
 }
 
+// runs on the spawned thread. Applied after prerun(), as the
+// sched policy a runnable may set there can reset its cpuset.
+void LocThreadDelegate::applySched() {
+    LocThreadSched sched;
+    if (!LocThread::getSched(mName, sched)) {
+        return;
+    }
+
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+
+    if (sched.mCpuMask) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int i = 0; i < 32; i++) {
+            if (sched.mCpuMask & (1U << i)) {
+                CPU_SET(i, &cpus);
+            }
+        }
+        if (sched_setaffinity(tid, sizeof(cpus), &cpus)) {
+            LOC_LOGW("%s: %s cpu mask 0x%x failed, errno %d",
+                     __func__, mName, sched.mCpuMask, errno);
+        }
+    }
+
+    if (sched.mFifoPriority) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = sched.mFifoPriority;
+        int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (err) {
+            LOC_LOGW("%s: %s SCHED_FIFO %u failed, err %d",
+                     __func__, mName, sched.mFifoPriority, err);
+        }
+    } else if (sched.mNice) {
+        if (setpriority(PRIO_PROCESS, tid, sched.mNice)) {
+            LOC_LOGW("%s: %s nice %d failed, errno %d",
+                     __func__, mName, sched.mNice, errno);
+        }
+    }
+
+    LOC_LOGD("%s: %s cpu mask 0x%x nice %d fifo %u", __func__, mName,
+             sched.mCpuMask, sched.mNice, sched.mFifoPriority);
+}
+
 void* LocThreadDelegate::threadMain(void* arg) {
     LocThreadDelegate* locThread = (LocThreadDelegate*)(arg);
 
@@ -179,6 +247,7 @@ void* LocThreadDelegate::threadMain(void* arg) {
         if (runnable) {
             if (locThread->isRunning()) {
                 runnable->prerun();
+                locThread->applySched();
             }
 
             while (locThread->isRunning() && runnable->run());
@@ -223,6 +292,54 @@ void LocThread::stop() {
     }
 }
 
+bool LocThread::setSched(const char* namePrefix, const LocThreadSched& sched) {
+    if (NULL == namePrefix || '\0' == namePrefix[0]) {
+        return false;
+    }
+
+    bool success = true;
+    pthread_mutex_lock(&sSchedLock);
+    int i = 0;
+    while (i < sSchedCount && strncmp(sScheds[i].mPrefix, namePrefix,
+                                      sizeof(sScheds[i].mPrefix))) {
+        i++;
+    }
+    if (isDefaultSched(sched)) {
+        // remove, by moving the last one into its slot
+        if (i < sSchedCount) {
+            sScheds[i] = sScheds[--sSchedCount];
+        }
+    } else if (i < sSchedCount) {
+        sScheds[i].mSched = sched;
+    } else if (sSchedCount < LOC_THREAD_MAX_SCHED) {
+        strlcpy(sScheds[i].mPrefix, namePrefix, sizeof(sScheds[i].mPrefix));
+        sScheds[i].mSched = sched;
+        sSchedCount++;
+    } else {
+        success = false;
+    }
+    pthread_mutex_unlock(&sSchedLock);
+
+    if (!success) {
+        LOC_LOGE("%s: no room for %s", __func__, namePrefix);
+    }
+    return success;
+}
+
+bool LocThread::getSched(const char* threadName, LocThreadSched& sched) {
+    size_t longest = 0;
+    pthread_mutex_lock(&sSchedLock);
+    for (int i = 0; i < sSchedCount; i++) {
+        size_t len = strlen(sScheds[i].mPrefix);
+        if (len > longest && 0 == strncmp(sScheds[i].mPrefix, threadName, len)) {
+            sched = sScheds[i].mSched;
+            longest = len;
+        }
+    }
+    pthread_mutex_unlock(&sSchedLock);
+    return longest > 0;
+}
+
 #ifdef __LOC_DEBUG__
 
 #include <stdio.h>
@@ -30,8 +30,22 @@
 #define __LOC_THREAD__
 
 #include <stddef.h>
+#include <stdint.h>
 #include <pthread.h>
 
+// max number of thread name prefixes LocThread::setSched() keeps
+#define LOC_THREAD_MAX_SCHED 8
+
+// scheduling a LocThread applies to itself as it starts
+struct LocThreadSched {
+    // cpus the thread may run on, bit n for cpu n; 0 for any
+    uint32_t mCpuMask;
+    // nice value, -20 to 19, when the thread is SCHED_OTHER
+    int32_t mNice;
+    // 1 to 99 to run SCHED_FIFO at that priority; 0 for SCHED_OTHER
+    uint32_t mFifoPriority;
+};
+
 // abstract class to be implemented by client to provide a runnable class
 // which gets scheduled by LocThread
 class LocRunnable {
@@ -87,6 +101,14 @@ public:
 
     // thread status check
     inline bool isRunning() { return NULL != mThread; }
+
+    // threads started from now on, whose name begins with namePrefix,
+    // apply sched once their runnable's prerun() is done. The longest
+    // matching prefix wins. An all 0 sched removes the prefix.
+    // Returns false if there is no room for another prefix.
+    static bool setSched(const char* namePrefix, const LocThreadSched& sched);
+    // sched for a thread named threadName; false if it has none
+    static bool getSched(const char* threadName, LocThreadSched& sched);
 };
 
 #endif //__LOC_THREAD__
@@ -37,8 +37,7 @@
 #include <LocTimer.h>
 #include <LocHeap.h>
 #include <LocThread.h>
-#include <LocSharedLock.h>
-#include <MsgTask.h>
+#include <LocExecutor.h>
 
 #ifdef __HOST_UNIT_TEST__
 #define EPOLLWAKEUP 0
@@ -62,18 +61,22 @@ LocTimerDelegate - an internal timer entity, which also is a LocRankable obj.
                    is also a LocRankable obj, and LocTimerContainer also is a
                    heap, its ranks() implementation decides where it is placed
                    in the heap.
-LocTimerContainer - core of the timer service. It is a container (derived from
-                    LocHeap) for LocTimerDelegate (implements LocRankable) objs.
-                    There are 2 of such containers, one for sw timers (or Linux
-                    timers) one for hw timers (or Linux alarms). It adds one of
-                    each (those that expire the soonest) to kernel via services
-                    provided by LocTimerPollTask. All the heap management on the
-                    LocTimerDelegate objs are done in the MsgTask context, such
-                    that synchronization is ensured.
-LocTimerPollTask - is a class that wraps timerfd and epoll POXIS APIs. It also
-                   both implements LocRunnalbe with epoll_wait() in the run()
-                   method. It is also a LocThread client, so as to loop the run
-                   method.
+LocTimerContainer - core of the timer service. It is a container for
+                    LocTimerDelegate (implements LocRankable) objs. There are 4
+                    of such containers: precise and coarse ones, each for sw
+                    timers (or Linux timers) and hw timers (or Linux alarms).
+                    Precise containers are LocTimerHeapContainer, a LocHeap;
+                    coarse ones are LocTimerWheelContainer, a hashed timer
+                    wheel. Each arms the soonest time out it holds with the
+                    kernel via services provided by LocTimerPollTask. Each
+                    container has a mutex of its own, which guards all the
+                    management of the LocTimerDelegate objs in it, in the
+                    context of the caller. Timers in different containers
+                    never contend.
+LocTimerPollTask - is a class that has the timerfds polled by the shared
+                   LocExecutor, which also runs the MsgTasks. The container
+                   is the LocExecutorTask an expired timerfd posts, so no
+                   thread is dedicated to timers.
 LocTimerWrapper - a LocTimer client itself, to implement the existing C API with
                   APIs, loc_timer_start() and loc_timer_stop().
 
@@ -81,114 +84,254 @@ LocTimerWrapper - a LocTimer client itself, to implement the existing C API with
 
 class LocTimerPollTask;
 
+// number of LocTimerContainer objs, see LocTimerContainer::get()
+#define LOC_TIMER_CONTAINERS 4
+// granularity of coarse timers, and size of their wheel
+#define LOC_TIMER_WHEEL_TICK_MS 100
+#define LOC_TIMER_WHEEL_SLOTS 256
+
 // This is a multi-functaional class that:
-// * extends the LocHeap class for the detection of head update upon add / remove
-//   events. When that happens, soonest time out changes, so timerfd needs update.
-// * contains the timers, and add / remove them into the heap
-// * provides and maps 2 of such containers, one for timers (or  mSwTimers), one
-//   for alarms (or mHwTimers);
-// * provides a polling thread;
-// * provides a MsgTask thread for synchronized add / remove / timer client callback.
-class LocTimerContainer : public LocHeap {
-    // mutex to synchronize getters of static members
-    static pthread_mutex_t mMutex;
-    // Container of timers
-    static LocTimerContainer* mSwTimers;
-    // Container of alarms
-    static LocTimerContainer* mHwTimers;
-    // Msg task to provider msg Q, sender and reader.
-    static MsgTask* mMsgTask;
-    // Poll task to provide epoll call and threading to poll.
-    static LocTimerPollTask* mPollTask;
+// * keeps the timerfd that the kernel expires the soonest timer with;
+// * provides and maps 4 of such containers, precise / coarse ones, each
+//   for timers and for alarms;
+// * has its timerfd polled by the shared LocExecutor, which runs it as a
+//   LocExecutorTask when the timerfd expires;
+// * has a mutex of its own for synchronized add / remove / expire.
+// How timers are kept and which time out gets armed is up to the subclasses,
+// whose pushTimer() / removeTimer() / expireTimers() are only ever called
+// with the mutex held. Client callbacks are called with it released.
+class LocTimerContainer : public LocExecutorTask {
+    // mutex to create the containers and the poll task on demand
+    static pthread_mutex_t mCreateMutex;
+    // Containers of timers and alarms, indexed by containerIndex()
+    static LocTimerContainer* mContainers[LOC_TIMER_CONTAINERS];
+    static LocTimerPollTask* getPollTaskLocked();
+    static inline int containerIndex(bool wakeOnExpire, bool coarse) {
+        return (coarse ? 2 : 0) + (wakeOnExpire ? 1 : 0);
+    }
+    // guards the timers in this container, and all that follows
+    pthread_mutex_t mMutex;
     // timer / alarm fd
     int mDevFd;
+    // timers expireTimer() took out as due, linked through mNext, whose
+    // callbacks are to be called once the mutex is released
+    LocTimerDelegate* mExpiredHead;
+    LocTimerDelegate* mExpiredTail;
+    // time the timerfd is armed for, 0 if disarmed. Written with the mutex
+    // held, under the seqlock mDeadlineSeq, so that it can be read without
+    // the mutex; see getDeadline()
+    uint32_t mDeadlineSeq;
+    struct timespec mDeadline;
+    // number of timerfd_settime() calls
+    uint32_t mSetTimeCalls;
+    // number of times the timerfd expired
+    uint32_t mWakeups;
+    // number of timers that expired along with an earlier one, each
+    // of which would have otherwise needed an expiration of its own
+    uint32_t mWakeupsAvoided;
+protected:
+    // Poll task to have the timerfds polled by the shared executor.
+    static LocTimerPollTask* mPollTask;
     // ctor
     LocTimerContainer(bool wakeOnExpire);
     // dtor
-    ~LocTimerContainer();
-    static MsgTask* getMsgTaskLocked();
-    static LocTimerPollTask* getPollTaskLocked();
-    // extend LocHeap and pop if the top outRanks input
-    LocTimerDelegate* popIfOutRanks(LocTimerDelegate& timer);
-    // update the timer POSIX calls with updated soonest timer spec
-    void updateSoonestTime(LocTimerDelegate* priorTop);
+    virtual ~LocTimerContainer();
+    // arms the timerfd with an absolute time; zero it_value disarms
+    void setTime(struct itimerspec& delay);
+    // expires timer, as one of the timers due in this expiration;
+    // prior is the one expired right before it, NULL if timer is the first
+    void expireTimer(LocTimerDelegate& timer, LocTimerDelegate* prior);
+    // mutex held only. push a timer into the container; false if
+    // there is no room for it
+    virtual bool pushTimer(LocTimerDelegate& timer) = 0;
+    // mutex held only. take a timer out of the container, if it is in;
+    // returns true if it was
+    virtual bool removeTimer(LocTimerDelegate& timer) = 0;
+    // mutex held only. expire all the timers that are due, and arm
+    // the timerfd for the next one
+    virtual void expireTimers() = 0;
 
 public:
-    // factory method to control the creation of mSwTimers / mHwTimers
-    static LocTimerContainer* get(bool wakeOnExpire);
+    // factory method to control the creation of the 4 containers
+    static LocTimerContainer* get(bool wakeOnExpire, bool coarse);
+    // logs the number of timerfd_settime() calls and expirations
+    static void dump();
 
-    LocTimerDelegate* getSoonestTimer();
     int getTimerFd();
-    // add a timer / alarm obj into the container
-    void add(LocTimerDelegate& timer);
+    // reads the time the timerfd is armed for without taking the mutex,
+    // retrying if a writer got in the way; 0 if disarmed
+    void getDeadline(struct timespec& deadline);
+    // add a timer / alarm obj into the container; false if it could not
+    // be added, in which case the container has released it
+    bool add(LocTimerDelegate& timer);
     // remove a timer / alarm obj from the container
     void remove(LocTimerDelegate& timer);
     // handling of timer / alarm expiration
     void expire();
+    // LocExecutorTask method, runs when the timerfd expires
+    inline virtual void execute() { expire(); }
 };
 
-// This class implements the polling thread that epolls imer / alarm fds.
-// The LocRunnable::run() contains the actual polling.  The other methods
-// will be run in the caller's thread context to add / remove timer / alarm
-// fds the kernel, while the polling is blocked on epoll_wait() call.
-// Since the design is that we have maximally 2 polls, one for all the
-// timers; one for all the alarms, we will poll at most on 2 fds.  But it
-// is possile that all we have are only timers or alarms at one time, so we
-// allow dynamically add / remove fds we poll on. The design decision of
+// Precise container. It extends the LocHeap class, sorted by the time the
+// timers are due. A timer started with a tolerance may expire anywhere
+// between its due time and its latest time; the container arms the timerfd
+// for the earliest latest time of the timers in the heap, so that all the
+// timers whose windows overlap that time expire with one wakeup.
+class LocTimerHeapContainer : public LocTimerContainer, public LocHeap {
+    friend class LocTimerContainer;
+    // time the timerfd is armed for; 0 if disarmed
+    struct timespec mArmedTime;
+    inline LocTimerHeapContainer(bool wakeOnExpire) : LocTimerContainer(wakeOnExpire) {
+        mArmedTime.tv_sec = mArmedTime.tv_nsec = 0;
+    }
+    LocTimerDelegate* getSoonestTimer();
+    // extend LocHeap and pop if the top outRanks input
+    LocTimerDelegate* popIfOutRanks(LocTimerDelegate& timer);
+    // lowers latestTime to the earliest latest time of the timers that are
+    // due by latestTime, in the subheap rooted at index
+    void coalesce(int index, LocTimerDelegate& latestTime);
+    // arms the timerfd for the time the heap should expire next, if that
+    // is sooner than what is armed, or if rearm is true.
+    void updateSoonestTime(bool rearm);
+protected:
+    virtual bool pushTimer(LocTimerDelegate& timer);
+    virtual bool removeTimer(LocTimerDelegate& timer);
+    virtual void expireTimers();
+};
+
+// Coarse container, a hashed timer wheel of LOC_TIMER_WHEEL_SLOTS slots, one
+// per LOC_TIMER_WHEEL_TICK_MS tick. A timer is rounded up to the next tick
+// and linked into the slot of that tick, so all timers due in the same tick
+// share one expiration. The timerfd is armed only when a new timer is due
+// before the tick already armed; removing a timer never re-arms it, unless
+// the wheel becomes empty. A tick armed for timers that have all been
+// stopped since expires for nothing, and the wheel arms the next one then.
+class LocTimerWheelContainer : public LocTimerContainer {
+    friend class LocTimerContainer;
+    LocTimerDelegate* mSlots[LOC_TIMER_WHEEL_SLOTS];
+    // number of timers in the wheel
+    uint32_t mCount;
+    // tick the timerfd is armed for; 0 if disarmed
+    uint64_t mArmedTick;
+    // the last tick that has been expired
+    uint64_t mLastTick;
+    LocTimerWheelContainer(bool wakeOnExpire);
+    static uint64_t toTick(const struct timespec& time, bool roundUp);
+    void link(LocTimerDelegate& timer);
+    void unlink(LocTimerDelegate& timer);
+    // arms the timerfd for tick, and adds it to the poll if it was disarmed
+    void arm(uint64_t tick);
+    // expires the due timers in the slot of tick; prior is the timer
+    // expired last in this expiration
+    void expireSlot(uint64_t tick, uint64_t nowTick, LocTimerDelegate*& prior);
+    // finds the soonest tick any timer is due at; 0 if empty
+    uint64_t nextTick(uint64_t nowTick);
+protected:
+    virtual bool pushTimer(LocTimerDelegate& timer);
+    virtual bool removeTimer(LocTimerDelegate& timer);
+    virtual void expireTimers();
+};
+
+// This class has the timer / alarm fds polled by the shared LocExecutor.
+// Its methods are run in the caller's thread context to add / remove timer /
+// alarm fds, while an idle worker of the executor may be blocked on
+// epoll_wait(). Since the design is that we have maximally 4 polls, one for
+// each of the containers, we will poll at most on 4 fds.  But it is possile
+// that all we have are only timers or alarms at one time, so we allow
+// dynamically add / remove fds we poll on. The design decision of
 // having 1 fd per container of timer / alarm is such that, we may not need
 // to make a system call each time a timer / alarm is added / removed, unless
 // that changes the "soonest" time out of that of all the timers / alarms.
-class LocTimerPollTask : public LocRunnable {
-    // the epoll fd
-    const int mFd;
-    // the thread that calls run() method
-    LocThread* mThread;
-    friend class LocThreadDelegate;
-    // dtor
-    ~LocTimerPollTask();
+class LocTimerPollTask {
+    // the executor that polls the fds, and runs the containers
+    LocExecutor* const mExecutor;
 public:
     // ctor
     LocTimerPollTask();
-    // this obj will be deleted once thread is deleted
-    void destroy();
     // add a container of timers. Each contain has a unique device fd, i.e.
     // either timer or alarm fd, and a heap of timers / alarms. It is expected
     // that container would have written to the device fd with the soonest
     // time out value in the heap at the time of calling this method. So all
-    // this method does is to add the fd of the input container to the poll
-    // and also add the pointer of the container to the event data ptr, such
-    // when poll_wait wakes up on events, we know who is the owner of the fd.
+    // this method does is to add the fd of the input container to the poll,
+    // with the container as the task the executor runs once the fd expires.
+    // The fd is polled for one expiration only, after which expire() takes
+    // it out of the poll.
     void addPoll(LocTimerContainer& timerContainer);
     // remove a fd that is assciated with a container. The expectation is that
     // the atual timer would have been removed from the container.
     void removePoll(LocTimerContainer& timerContainer);
-    // The polling thread context will call this method. This is where
-    // epoll_wait() is blocking and waiting for events..
-    virtual bool run();
 };
 
 // Internal class of timer obj. It gets born when client calls LocTimer::start();
-// and gets deleted when client calls LocTimer::stop() or when the it expire()'s.
+// and gets deleted once neither its client nor its container refers to it,
+// i.e. after LocTimer::stop(), or after it expires and its callback returns.
 // This class implements LocRankable::ranks() so that when an obj is added into
 // the container (of LocHeap), it gets placed in sorted order.
+// Whether a stop() or the expiration gets to the timer first is settled by
+// an atomic state word, so that neither needs a lock of the timer's own.
 class LocTimerDelegate : public LocRankable {
     friend class LocTimerContainer;
+    friend class LocTimerHeapContainer;
+    friend class LocTimerWheelContainer;
     friend class LocTimer;
+    // bits of mState
+    enum {
+        // taken out of the container as due, with the container mutex held
+        EXPIRED = 1 << 0,
+        // stopped by the client
+        STOPPED = 1 << 1,
+        // the callback is about to be called, unless STOPPED came first
+        CALLING = 1 << 2,
+        // referred to by LocTimer::mTimer
+        CLIENT_REF = 1 << 3,
+        // in the container, on its way in, or expired and not yet called back
+        CONTAINER_REF = 1 << 4
+    };
     LocTimer* mClient;
-    LocSharedLock* mLock;
+    uint32_t mState;
     struct timespec mFutureTime;
+    // the latest the timer may expire, mFutureTime + tolerance
+    struct timespec mLatestTime;
     LocTimerContainer* mContainer;
+    // links and tick of the slot in a LocTimerWheelContainer;
+    // mTick is 0 when not in a wheel. Once expired, mNext links the
+    // timer into the expired list of its container instead.
+    LocTimerDelegate* mPrev;
+    LocTimerDelegate* mNext;
+    uint64_t mTick;
     // not a complete obj, just ctor for LocRankable comparisons
     inline LocTimerDelegate(struct timespec& delay)
-        : mClient(NULL), mLock(NULL), mFutureTime(delay), mContainer(NULL) {}
-    inline ~LocTimerDelegate() { if (mLock) { mLock->drop(); mLock = NULL; } }
+        : mClient(NULL), mState(0), mFutureTime(delay), mLatestTime(delay),
+          mContainer(NULL), mPrev(NULL), mNext(NULL), mTick(0) {}
+    inline ~LocTimerDelegate() {}
 public:
-    LocTimerDelegate(LocTimer& client, struct timespec& futureTime, bool wakeOnExpire);
-    void destroyLocked();
+    LocTimerDelegate(LocTimer& client, struct timespec& futureTime,
+                     struct timespec& latestTime, LocTimerContainer& container);
     // LocRankable virtual method
     virtual int ranks(LocRankable& rankable);
+    // marks the timer stopped; returns the state it was in
+    inline uint32_t markStopped() {
+        return __atomic_fetch_or(&mState, STOPPED, __ATOMIC_ACQ_REL);
+    }
+    // container mutex held only. marks the timer expired; false if the
+    // client has stopped it already
+    inline bool markExpired() {
+        return !(__atomic_fetch_or(&mState, EXPIRED, __ATOMIC_ACQ_REL) & STOPPED);
+    }
+    inline bool isStopped() {
+        return __atomic_load_n(&mState, __ATOMIC_ACQUIRE) & STOPPED;
+    }
+    // drops ref, CLIENT_REF or CONTAINER_REF; the last one deletes the obj
+    inline void release(uint32_t ref) {
+        if (!(__atomic_and_fetch(&mState, ~ref, __ATOMIC_ACQ_REL) &
+              (CLIENT_REF | CONTAINER_REF))) {
+            delete this;
+        }
+    }
+    // calls back the client of an expired timer, unless it got stopped
     void expire();
     inline struct timespec getFutureTime() { return mFutureTime; }
+    inline struct timespec getLatestTime() { return mLatestTime; }
 };
 
 /***************************LocTimerContainer methods***************************/
@@ -198,17 +341,20 @@ public:
 // but never use timer, then these resources would never need to be created.
 // For those processes that do use timer, it will likely also need to every
 // once in a while. It might be cheaper keeping them around.
-pthread_mutex_t LocTimerContainer::mMutex = PTHREAD_MUTEX_INITIALIZER;
-LocTimerContainer* LocTimerContainer::mSwTimers = NULL;
-LocTimerContainer* LocTimerContainer::mHwTimers = NULL;
-MsgTask* LocTimerContainer::mMsgTask = NULL;
+pthread_mutex_t LocTimerContainer::mCreateMutex = PTHREAD_MUTEX_INITIALIZER;
+LocTimerContainer* LocTimerContainer::mContainers[LOC_TIMER_CONTAINERS] = {NULL};
 LocTimerPollTask* LocTimerContainer::mPollTask = NULL;
 
 // ctor - initialize timer heaps
 // A container for swTimer (timer) is created, when wakeOnExpire is true; or
 // HwTimer (alarm), when wakeOnExpire is false.
 LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
-    mDevFd(timerfd_create(wakeOnExpire ? CLOCK_BOOTTIME_ALARM : CLOCK_BOOTTIME, 0)) {
+    mDevFd(timerfd_create(wakeOnExpire ? CLOCK_BOOTTIME_ALARM : CLOCK_BOOTTIME, 0)),
+    mExpiredHead(NULL), mExpiredTail(NULL), mDeadlineSeq(0),
+    mSetTimeCalls(0), mWakeups(0), mWakeupsAvoided(0) {
+
+    pthread_mutex_init(&mMutex, NULL);
+    mDeadline.tv_sec = mDeadline.tv_nsec = 0;
 
     if ((-1 == mDevFd) && (errno == EINVAL)) {
         LOC_LOGW("%s: timerfd_create failure, fallback to CLOCK_MONOTONIC - %s",
@@ -219,7 +365,6 @@ LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
     if (-1 != mDevFd) {
         // ensure we have the necessary resources created
         LocTimerContainer::getPollTaskLocked();
-        LocTimerContainer::getMsgTaskLocked();
     } else {
         LOC_LOGE("%s: timerfd_create failure - %s", __FUNCTION__, strerror(errno));
     }
@@ -227,37 +372,100 @@ LocTimerContainer::LocTimerContainer(bool wakeOnExpire) :
 
 // dtor
 // we do not ever destroy the static resources.
-inline
 LocTimerContainer::~LocTimerContainer() {
     close(mDevFd);
+    pthread_mutex_destroy(&mMutex);
 }
 
-LocTimerContainer* LocTimerContainer::get(bool wakeOnExpire) {
-    // get the reference of either mHwTimer or mSwTimers per wakeOnExpire
-    LocTimerContainer*& container = wakeOnExpire ? mHwTimers : mSwTimers;
-    // it is cheap to check pointer first than locking mutext unconditionally
+LocTimerContainer* LocTimerContainer::get(bool wakeOnExpire, bool coarse) {
+    // get the reference of the container per wakeOnExpire and coarse
+    LocTimerContainer*& slot = mContainers[containerIndex(wakeOnExpire, coarse)];
+    // it is cheap to check pointer first than locking mutext unconditionally;
+    // a container is published fully constructed, see below
+    LocTimerContainer* container = __atomic_load_n(&slot, __ATOMIC_ACQUIRE);
     if (!container) {
-        pthread_mutex_lock(&mMutex);
+        pthread_mutex_lock(&mCreateMutex);
         // let's check one more time to be safe
+        container = slot;
         if (!container) {
-            container = new LocTimerContainer(wakeOnExpire);
+            LocTimerContainer* newContainer = coarse ?
+                (LocTimerContainer*)new LocTimerWheelContainer(wakeOnExpire) :
+                (LocTimerContainer*)new LocTimerHeapContainer(wakeOnExpire);
             // timerfd_create failure
-            if (-1 == container->getTimerFd()) {
-                delete container;
-                container = NULL;
+            if (-1 == newContainer->getTimerFd()) {
+                delete newContainer;
+                newContainer = NULL;
             }
+            container = newContainer;
+            __atomic_store_n(&slot, container, __ATOMIC_RELEASE);
         }
-        pthread_mutex_unlock(&mMutex);
+        pthread_mutex_unlock(&mCreateMutex);
     }
     return container;
 }
 
-MsgTask* LocTimerContainer::getMsgTaskLocked() {
-    // it is cheap to check pointer first than locking mutext unconditionally
-    if (!mMsgTask) {
-        mMsgTask = new MsgTask("LocTimerMsgTask", false);
+void LocTimerContainer::dump() {
+    for (int i = 0; i < LOC_TIMER_CONTAINERS; i++) {
+        LocTimerContainer* container = __atomic_load_n(&mContainers[i], __ATOMIC_ACQUIRE);
+        if (container) {
+            struct timespec deadline;
+            container->getDeadline(deadline);
+            LOC_LOGD("%s: %s %s timers: %u timerfd_settime, %u expirations, %u avoided,"
+                     " armed for %ld.%09ld",
+                     __FUNCTION__,
+                     (i & 2) ? "coarse" : "precise", (i & 1) ? "wakeup" : "non-wakeup",
+                     __atomic_load_n(&container->mSetTimeCalls, __ATOMIC_RELAXED),
+                     __atomic_load_n(&container->mWakeups, __ATOMIC_RELAXED),
+                     __atomic_load_n(&container->mWakeupsAvoided, __ATOMIC_RELAXED),
+                     (long)deadline.tv_sec, (long)deadline.tv_nsec);
+        }
+    }
+}
+
+void LocTimerContainer::setTime(struct itimerspec& delay) {
+    // the mutex is held, so this is the only writer; an odd sequence tells
+    // readers that the deadline is being written
+    uint32_t seq = mDeadlineSeq;
+    __atomic_store_n(&mDeadlineSeq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&mDeadline.tv_sec, delay.it_value.tv_sec, __ATOMIC_RELAXED);
+    __atomic_store_n(&mDeadline.tv_nsec, delay.it_value.tv_nsec, __ATOMIC_RELAXED);
+    __atomic_store_n(&mDeadlineSeq, seq + 2, __ATOMIC_RELEASE);
+
+    __atomic_add_fetch(&mSetTimeCalls, 1, __ATOMIC_RELAXED);
+    timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &delay, NULL);
+}
+
+void LocTimerContainer::getDeadline(struct timespec& deadline) {
+    uint32_t seq;
+    do {
+        seq = __atomic_load_n(&mDeadlineSeq, __ATOMIC_ACQUIRE);
+        deadline.tv_sec = __atomic_load_n(&mDeadline.tv_sec, __ATOMIC_RELAXED);
+        deadline.tv_nsec = __atomic_load_n(&mDeadline.tv_nsec, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != __atomic_load_n(&mDeadlineSeq, __ATOMIC_RELAXED));
+}
+
+void LocTimerContainer::expireTimer(LocTimerDelegate& timer, LocTimerDelegate* prior) {
+    // timers due at the very same time would have shared one expiration anyway
+    if (prior && timer.ranks(*prior)) {
+        __atomic_add_fetch(&mWakeupsAvoided, 1, __ATOMIC_RELAXED);
+    }
+    if (timer.markExpired()) {
+        // called back in expire(), once the mutex is released
+        timer.mNext = NULL;
+        if (mExpiredTail) {
+            mExpiredTail->mNext = &timer;
+        } else {
+            mExpiredHead = &timer;
+        }
+        mExpiredTail = &timer;
+    } else {
+        // stopped, and its remove() is waiting on the mutex. It will find
+        // the timer gone, and the stopping client still refers to it, so
+        // this does not delete it yet.
+        timer.release(LocTimerDelegate::CONTAINER_REF);
     }
-    return mMsgTask;
 }
 
 LocTimerPollTask* LocTimerContainer::getPollTaskLocked() {
@@ -268,236 +476,366 @@ LocTimerPollTask* LocTimerContainer::getPollTaskLocked() {
     return mPollTask;
 }
 
-inline
-LocTimerDelegate* LocTimerContainer::getSoonestTimer() {
-    return (LocTimerDelegate*)(peek());
-}
 
 inline
 int LocTimerContainer::getTimerFd() {
     return mDevFd;
 }
 
-void LocTimerContainer::updateSoonestTime(LocTimerDelegate* priorTop) {
-    LocTimerDelegate* curTop = getSoonestTimer();
+/**************************LocTimerHeapContainer methods************************/
 
-    // check if top has changed
-    if (curTop != priorTop) {
-        struct itimerspec delay = {0};
-        bool toSetTime = false;
-        // if tree is empty now, we remove poll and disarm timer
-        if (!curTop) {
-            mPollTask->removePoll(*this);
-            // setting the values to disarm timer
-            delay.it_value.tv_sec = 0;
-            delay.it_value.tv_nsec = 0;
-            toSetTime = true;
-        } else if (!priorTop || curTop->outRanks(*priorTop)) {
-            // do this first to avoid race condition, in case settime is called
-            // with too small an interval
-            mPollTask->addPoll(*this);
-            delay.it_value = curTop->getFutureTime();
-            toSetTime = true;
+inline
+LocTimerDelegate* LocTimerHeapContainer::getSoonestTimer() {
+    return (LocTimerDelegate*)(peek());
+}
+
+void LocTimerHeapContainer::coalesce(int index, LocTimerDelegate& latestTime) {
+    LocTimerDelegate* timer = (LocTimerDelegate*)mNodes[index];
+    // if this timer is due after latestTime, so is its subheap; they
+    // can't lower it any further
+    if (!latestTime.outRanks(*timer)) {
+        struct timespec latest = timer->getLatestTime();
+        LocTimerDelegate timerOfLatest(latest);
+        if (timerOfLatest.outRanks(latestTime)) {
+            latestTime.mFutureTime = latest;
         }
-        if (toSetTime) {
-            timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &delay, NULL);
+        int child = firstChildOf(index);
+        for (int last = child + LOC_HEAP_ARITY; child < last && child < mSize; child++) {
+            coalesce(child, latestTime);
         }
     }
 }
 
-// all the heap management is done in the MsgTask context.
-inline
-void LocTimerContainer::add(LocTimerDelegate& timer) {
-    struct MsgTimerPush : public LocMsg {
-        LocTimerContainer* mTimerContainer;
-        LocHeapNode* mTree;
-        LocTimerDelegate* mTimer;
-        inline MsgTimerPush(LocTimerContainer& container, LocTimerDelegate& timer) :
-            LocMsg(), mTimerContainer(&container), mTimer(&timer) {}
-        inline virtual void proc() const {
-            LocTimerDelegate* priorTop = mTimerContainer->getSoonestTimer();
-            mTimerContainer->push((LocRankable&)(*mTimer));
-            mTimerContainer->updateSoonestTime(priorTop);
+void LocTimerHeapContainer::updateSoonestTime(bool rearm) {
+    LocTimerDelegate* curTop = getSoonestTimer();
+    bool armed = (0 != mArmedTime.tv_sec || 0 != mArmedTime.tv_nsec);
+    struct itimerspec delay = {0};
+
+    // if tree is empty now, we remove poll and disarm timer
+    if (!curTop) {
+        if (armed) {
+            mPollTask->removePoll(*this);
+            mArmedTime = delay.it_value;
+            setTime(delay);
         }
-    };
+    } else {
+        // the top is due the soonest, and its latest time is a bound no other
+        // timer may expire after
+        struct timespec latest = curTop->getLatestTime();
+        LocTimerDelegate timerOfLatest(latest);
+        int child = firstChildOf(0);
+        for (int last = child + LOC_HEAP_ARITY; child < last && child < mSize; child++) {
+            coalesce(child, timerOfLatest);
+        }
+        LocTimerDelegate timerOfArmed(mArmedTime);
+        if (!armed || timerOfLatest.outRanks(timerOfArmed) ||
+            (rearm && timerOfLatest.ranks(timerOfArmed))) {
+            if (!armed) {
+                // do this first to avoid race condition, in case settime is called
+                // with too small an interval
+                mPollTask->addPoll(*this);
+            }
+            delay.it_value = timerOfLatest.getFutureTime();
+            mArmedTime = delay.it_value;
+            setTime(delay);
+        }
+    }
+}
 
-    mMsgTask->sendMsg(new MsgTimerPush(*this, timer));
+bool LocTimerHeapContainer::pushTimer(LocTimerDelegate& timer) {
+    if (!push((LocRankable&)timer)) {
+        return false;
+    }
+    // a new timer may only bring the soonest time to arm sooner
+    updateSoonestTime(false);
+    return true;
 }
 
-// all the heap management is done in the MsgTask context.
-void LocTimerContainer::remove(LocTimerDelegate& timer) {
-    struct MsgTimerRemove : public LocMsg {
-        LocTimerContainer* mTimerContainer;
-        LocTimerDelegate* mTimer;
-        inline MsgTimerRemove(LocTimerContainer& container, LocTimerDelegate& timer) :
-            LocMsg(), mTimerContainer(&container), mTimer(&timer) {}
-        inline virtual void proc() const {
-            LocTimerDelegate* priorTop = mTimerContainer->getSoonestTimer();
-
-            // update soonest timer only if mTimer is actually removed from
-            // mTimerContainer AND mTimer is not priorTop.
-            if (priorTop == ((LocHeap*)mTimerContainer)->remove((LocRankable&)*mTimer)) {
-                // if passing in NULL, we tell updateSoonestTime to update
-                // kernel with the current top timer interval.
-                mTimerContainer->updateSoonestTime(NULL);
-            }
-            // all timers are deleted here, and only here.
-            delete mTimer;
-        }
-    };
+bool LocTimerHeapContainer::removeTimer(LocTimerDelegate& timer) {
+    LocTimerDelegate* priorTop = getSoonestTimer();
+    LocRankable* removed = LocHeap::remove((LocRankable&)timer);
 
-    mMsgTask->sendMsg(new MsgTimerRemove(*this, timer));
+    // the armed time is never earlier than when the top is due. Only when
+    // the top is removed, the new top may be due after the armed time,
+    // so to rearm.
+    if (removed && priorTop == removed) {
+        updateSoonestTime(true);
+    }
+    return (NULL != removed);
 }
 
-// all the heap management is done in the MsgTask context.
 // Upon expire, we check and continuously pop the heap until
 // the top node's timeout is in the future.
-void LocTimerContainer::expire() {
-    struct MsgTimerExpire : public LocMsg {
-        LocTimerContainer* mTimerContainer;
-        inline MsgTimerExpire(LocTimerContainer& container) :
-            LocMsg(), mTimerContainer(&container) {}
-        inline virtual void proc() const {
-            struct timespec now;
-            // get time spec of now
-            clock_gettime(CLOCK_BOOTTIME, &now);
-            LocTimerDelegate timerOfNow(now);
-            // pop everything in the heap that outRanks now, i.e. has time older than now
-            // and then call expire() on that timer.
-            for (LocTimerDelegate* timer = (LocTimerDelegate*)mTimerContainer->pop();
-                 NULL != timer;
-                 timer = mTimerContainer->popIfOutRanks(timerOfNow)) {
-                // the timer delegate obj will be deleted before the return of this call
-                timer->expire();
-            }
-            mTimerContainer->updateSoonestTime(NULL);
-        }
-    };
-
-    struct itimerspec delay = {0};
-    timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &delay, NULL);
-    mPollTask->removePoll(*this);
-    mMsgTask->sendMsg(new MsgTimerExpire(*this));
+void LocTimerHeapContainer::expireTimers() {
+    struct timespec now;
+    // get time spec of now
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    LocTimerDelegate timerOfNow(now);
+    LocTimerDelegate* prior = NULL;
+    // the poll task has disarmed the timerfd before sending us here
+    mArmedTime.tv_sec = mArmedTime.tv_nsec = 0;
+    // pop everything in the heap that outRanks now, i.e. has time older than now
+    // and then call expire() on that timer.
+    for (LocTimerDelegate* timer = popIfOutRanks(timerOfNow);
+         NULL != timer;
+         timer = popIfOutRanks(timerOfNow)) {
+        expireTimer(*timer, prior);
+        prior = timer;
+    }
+    updateSoonestTime(false);
 }
 
-LocTimerDelegate* LocTimerContainer::popIfOutRanks(LocTimerDelegate& timer) {
+LocTimerDelegate* LocTimerHeapContainer::popIfOutRanks(LocTimerDelegate& timer) {
     LocTimerDelegate* poppedNode = NULL;
-    if (mTree && !timer.outRanks(*peek())) {
+    if (!isEmpty() && !timer.outRanks(*peek())) {
         poppedNode = (LocTimerDelegate*)(pop());
     }
 
     return poppedNode;
 }
 
+/**************************LocTimerWheelContainer methods***********************/
 
-/***************************LocTimerPollTask methods***************************/
+LocTimerWheelContainer::LocTimerWheelContainer(bool wakeOnExpire) :
+    LocTimerContainer(wakeOnExpire), mCount(0), mArmedTick(0), mLastTick(0) {
+    struct timespec now;
+    memset(mSlots, 0, sizeof(mSlots));
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    mLastTick = toTick(now, false);
+}
 
 inline
-LocTimerPollTask::LocTimerPollTask()
-    : mFd(epoll_create(2)), mThread(new LocThread()) {
-    // before a next call returens, a thread will be created. The run() method
-    // could already be running in parallel. Also, since each of the objs
-    // creates a thread, the container will make sure that there will be only
-    // one of such obj for our timer implementation.
-    if (!mThread->start("LocTimerPollTask", this)) {
-        delete mThread;
-        mThread = NULL;
-    }
+uint64_t LocTimerWheelContainer::toTick(const struct timespec& time, bool roundUp) {
+    uint64_t ms = (uint64_t)time.tv_sec * 1000 + time.tv_nsec / 1000000;
+    return (ms + (roundUp ? LOC_TIMER_WHEEL_TICK_MS - 1 : 0)) / LOC_TIMER_WHEEL_TICK_MS;
 }
 
 inline
-LocTimerPollTask::~LocTimerPollTask() {
-    // when fs is closed, epoll_wait() should fail run() should return false
-    // and the spawned thread should exit.
-    close(mFd);
+void LocTimerWheelContainer::link(LocTimerDelegate& timer) {
+    LocTimerDelegate*& head = mSlots[timer.mTick % LOC_TIMER_WHEEL_SLOTS];
+    timer.mPrev = NULL;
+    timer.mNext = head;
+    if (head) {
+        head->mPrev = &timer;
+    }
+    head = &timer;
+    mCount++;
 }
 
-void LocTimerPollTask::destroy() {
-    if (mThread) {
-        LocThread* thread = mThread;
-        mThread = NULL;
-        delete thread;
+inline
+void LocTimerWheelContainer::unlink(LocTimerDelegate& timer) {
+    if (timer.mPrev) {
+        timer.mPrev->mNext = timer.mNext;
     } else {
-        delete this;
+        mSlots[timer.mTick % LOC_TIMER_WHEEL_SLOTS] = timer.mNext;
     }
+    if (timer.mNext) {
+        timer.mNext->mPrev = timer.mPrev;
+    }
+    timer.mPrev = timer.mNext = NULL;
+    timer.mTick = 0;
+    mCount--;
 }
 
-void LocTimerPollTask::addPoll(LocTimerContainer& timerContainer) {
-    struct epoll_event ev;
-    memset(&ev, 0, sizeof(ev));
+void LocTimerWheelContainer::arm(uint64_t tick) {
+    struct itimerspec delay = {0};
+    uint64_t ms = tick * LOC_TIMER_WHEEL_TICK_MS;
+    delay.it_value.tv_sec = ms / 1000;
+    delay.it_value.tv_nsec = (ms % 1000) * 1000000;
+    if (!mArmedTick) {
+        // do this first to avoid race condition, in case settime is called
+        // with too small an interval
+        mPollTask->addPoll(*this);
+    }
+    mArmedTick = tick;
+    setTime(delay);
+}
 
-    ev.events = EPOLLIN | EPOLLWAKEUP;
-    ev.data.fd = timerContainer.getTimerFd();
-    // it is important that we set this context pointer with the input
-    // timer container this is how we know which container should handle
-    // which expiration.
-    ev.data.ptr = &timerContainer;
+bool LocTimerWheelContainer::pushTimer(LocTimerDelegate& timer) {
+    uint64_t tick = toTick(timer.getFutureTime(), true);
+    // anything already due goes into the very next tick
+    if (tick <= mLastTick) {
+        tick = mLastTick + 1;
+    }
+    timer.mTick = tick;
+    link(timer);
+    if (!mArmedTick || tick < mArmedTick) {
+        arm(tick);
+    }
+    return true;
+}
+
+bool LocTimerWheelContainer::removeTimer(LocTimerDelegate& timer) {
+    // the timer may have been expired out of the wheel already
+    if (!timer.mTick) {
+        return false;
+    }
+    unlink(timer);
+    if (!mCount && mArmedTick) {
+        struct itimerspec delay = {0};
+        mPollTask->removePoll(*this);
+        mArmedTick = 0;
+        setTime(delay);
+    }
+    return true;
+}
+
+void LocTimerWheelContainer::expireSlot(uint64_t tick, uint64_t nowTick,
+                                        LocTimerDelegate*& prior) {
+    LocTimerDelegate* timer = mSlots[tick % LOC_TIMER_WHEEL_SLOTS];
+    while (timer) {
+        LocTimerDelegate* next = timer->mNext;
+        // the slot also holds timers of later rounds of the wheel
+        if (timer->mTick <= nowTick) {
+            unlink(*timer);
+            expireTimer(*timer, prior);
+            prior = timer;
+        }
+        timer = next;
+    }
+}
+
+uint64_t LocTimerWheelContainer::nextTick(uint64_t nowTick) {
+    uint64_t soonest = 0;
+    if (mCount) {
+        // most likely something is due within one round of the wheel
+        for (uint64_t tick = nowTick + 1;
+             tick <= nowTick + LOC_TIMER_WHEEL_SLOTS; tick++) {
+            for (LocTimerDelegate* timer = mSlots[tick % LOC_TIMER_WHEEL_SLOTS];
+                 NULL != timer; timer = timer->mNext) {
+                if (timer->mTick == tick) {
+                    return tick;
+                }
+            }
+        }
+        // else all the timers are further out, look at every one of them
+        for (int slot = 0; slot < LOC_TIMER_WHEEL_SLOTS; slot++) {
+            for (LocTimerDelegate* timer = mSlots[slot];
+                 NULL != timer; timer = timer->mNext) {
+                if (!soonest || timer->mTick < soonest) {
+                    soonest = timer->mTick;
+                }
+            }
+        }
+    }
+    return soonest;
+}
+
+void LocTimerWheelContainer::expireTimers() {
+    struct timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    uint64_t nowTick = toTick(now, false);
+    // the poll task has disarmed the timerfd before sending us here
+    mArmedTick = 0;
+
+    if (nowTick > mLastTick) {
+        // visit each slot at most once, even if we have been away
+        // for more than a round of the wheel
+        uint64_t first = mLastTick + 1;
+        if (nowTick - mLastTick > LOC_TIMER_WHEEL_SLOTS) {
+            first = nowTick - LOC_TIMER_WHEEL_SLOTS + 1;
+        }
+        LocTimerDelegate* prior = NULL;
+        for (uint64_t tick = first; tick <= nowTick; tick++) {
+            expireSlot(tick, nowTick, prior);
+        }
+        mLastTick = nowTick;
+    }
+
+    uint64_t tick = nextTick(nowTick);
+    if (tick) {
+        arm(tick);
+    } else {
+        mPollTask->removePoll(*this);
+    }
+}
 
-    epoll_ctl(mFd, EPOLL_CTL_ADD, timerContainer.getTimerFd(), &ev);
+// all the container management is done with the container mutex held.
+inline
+bool LocTimerContainer::add(LocTimerDelegate& timer) {
+    bool added = true;
+    pthread_mutex_lock(&mMutex);
+    if (timer.isStopped()) {
+        // a concurrent stop() got to the timer before it got in; its
+        // remove() found nothing to take out
+        timer.release(LocTimerDelegate::CONTAINER_REF);
+    } else if (!pushTimer(timer)) {
+        LOC_LOGE("%s: no room for another timer", __FUNCTION__);
+        timer.release(LocTimerDelegate::CONTAINER_REF);
+        added = false;
+    }
+    pthread_mutex_unlock(&mMutex);
+    return added;
 }
 
+// all the container management is done with the container mutex held.
 inline
-void LocTimerPollTask::removePoll(LocTimerContainer& timerContainer) {
-    epoll_ctl(mFd, EPOLL_CTL_DEL, timerContainer.getTimerFd(), NULL);
+void LocTimerContainer::remove(LocTimerDelegate& timer) {
+    pthread_mutex_lock(&mMutex);
+    // not in the container if it has just expired, or not got in yet;
+    // whoever took it out, or keeps it out, releases it then
+    bool removed = removeTimer(timer);
+    pthread_mutex_unlock(&mMutex);
+    if (removed) {
+        timer.release(LocTimerDelegate::CONTAINER_REF);
+    }
 }
 
-// The polling thread context will call this method. If run() method needs to
-// be repetitvely called, it must return true from the previous call.
-bool LocTimerPollTask::run() {
-    struct epoll_event ev[2];
+// all the container management is done with the container mutex held;
+// the callbacks, which may start / stop timers, are called without it.
+void LocTimerContainer::expire() {
+    struct itimerspec delay = {0};
+    __atomic_add_fetch(&mWakeups, 1, __ATOMIC_RELAXED);
 
-    // we have max 2 descriptors to poll from
-    int fds = epoll_wait(mFd, ev, 2, -1);
+    pthread_mutex_lock(&mMutex);
+    setTime(delay);
+    mPollTask->removePoll(*this);
+    expireTimers();
+    LocTimerDelegate* timer = mExpiredHead;
+    mExpiredHead = mExpiredTail = NULL;
+    pthread_mutex_unlock(&mMutex);
+
+    while (timer) {
+        LocTimerDelegate* next = timer->mNext;
+        // may delete timer
+        timer->expire();
+        timer = next;
+    }
+}
 
-    // we pretty much want to continually poll until the fd is closed
-    bool rerun = (fds > 0) || (errno == EINTR);
 
-    if (fds > 0) {
-        // we may have 2 events
-        for (int i = 0; i < fds; i++) {
-            // each fd has a context pointer associated with the right timer container
-            LocTimerContainer* container = (LocTimerContainer*)(ev[i].data.ptr);
-            if (container) {
-                container->expire();
-            } else {
-                epoll_ctl(mFd, EPOLL_CTL_DEL, ev[i].data.fd, NULL);
-            }
-        }
+/***************************LocTimerPollTask methods***************************/
+
+inline
+LocTimerPollTask::LocTimerPollTask() : mExecutor(LocExecutor::getDefault()) {
+}
+
+void LocTimerPollTask::addPoll(LocTimerContainer& timerContainer) {
+    if (mExecutor) {
+        mExecutor->addFd(timerContainer.getTimerFd(), EPOLLIN | EPOLLWAKEUP,
+                         timerContainer);
     }
+}
 
-    // if rerun is true, we are requesting to be scheduled again
-    return rerun;
+inline
+void LocTimerPollTask::removePoll(LocTimerContainer& timerContainer) {
+    if (mExecutor) {
+        mExecutor->removeFd(timerContainer.getTimerFd());
+    }
 }
 
 /***************************LocTimerDelegate methods***************************/
 
 inline
-LocTimerDelegate::LocTimerDelegate(LocTimer& client, struct timespec& futureTime, bool wakeOnExpire)
+LocTimerDelegate::LocTimerDelegate(LocTimer& client, struct timespec& futureTime,
+                                   struct timespec& latestTime,
+                                   LocTimerContainer& container)
     : mClient(&client),
-      mLock(mClient->mLock->share()),
+      mState(CLIENT_REF | CONTAINER_REF),
       mFutureTime(futureTime),
-      mContainer(LocTimerContainer::get(wakeOnExpire)) {
-    // adding the timer into the container
-    mContainer->add(*this);
-}
-
-inline
-void LocTimerDelegate::destroyLocked() {
-    // client handle will likely be deleted soon after this
-    // method returns. Nulling this handle so that expire()
-    // won't call the callback on the dead handle any more.
-    mClient = NULL;
-
-    if (mContainer) {
-        LocTimerContainer* container = mContainer;
-        mContainer = NULL;
-        if (container) {
-            container->remove(*this);
-        }
-    } // else we do not do anything. No such *this* can be
-      // created and reached here with mContainer ever been
-      // a non NULL. So *this* must have reached the if clause
-      // once, and we want it reach there only once.
+      mLatestTime(latestTime),
+      mContainer(&container),
+      mPrev(NULL), mNext(NULL), mTick(0) {
 }
 
 int LocTimerDelegate::ranks(LocRankable& rankable) {
@@ -518,65 +856,97 @@ int LocTimerDelegate::ranks(LocRankable& rankable) {
 
 inline
 void LocTimerDelegate::expire() {
-    // keeping a copy of client pointer to be safe
-    // when timeOutCallback() is called at the end of this
-    // method, *this* obj may be already deleted.
-    LocTimer* client = mClient;
-    // force a stop, which will lead to delete of this obj
-    if (client && client->stop()) {
-        // calling client callback with a pointer save on the stack
-        // only if stop() returns true, i.e. it hasn't been stopped
-        // already.
+    // from here on, a stop() is too late and returns false
+    if (!(__atomic_fetch_or(&mState, CALLING, __ATOMIC_ACQ_REL) & STOPPED)) {
+        // nothing stopped it, so the client is still there. Unless a stop()
+        // has just taken it, *this* is still the client's timer; leave it
+        // so that the client may start it again from the callback.
+        LocTimer* client = mClient;
+        LocTimerDelegate* self = this;
+        if (__atomic_compare_exchange_n(&client->mTimer, &self, (LocTimerDelegate*)NULL,
+                                        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            release(CLIENT_REF);
+        }
         client->timeOutCallback();
     }
+    // the client may well have deleted itself in the callback
+    release(CONTAINER_REF);
 }
 
 
 /***************************LocTimer methods***************************/
-LocTimer::LocTimer() : mTimer(NULL), mLock(new LocSharedLock()) {
+LocTimer::LocTimer() : mTimer(NULL) {
 }
 
 LocTimer::~LocTimer() {
     stop();
-    if (mLock) {
-        mLock->drop();
-        mLock = NULL;
-    }
-}
-
-bool LocTimer::start(unsigned int timeOutInMs, bool wakeOnExpire) {
-    bool success = false;
-    mLock->lock();
-    if (!mTimer) {
-        struct timespec futureTime;
-        clock_gettime(CLOCK_BOOTTIME, &futureTime);
-        futureTime.tv_sec += timeOutInMs / 1000;
-        futureTime.tv_nsec += (timeOutInMs % 1000) * 1000000;
-        if (futureTime.tv_nsec >= 1000000000) {
-            futureTime.tv_sec += futureTime.tv_nsec / 1000000000;
-            futureTime.tv_nsec %= 1000000000;
+}
+
+static inline void addMs(struct timespec& time, unsigned int ms) {
+    time.tv_sec += ms / 1000;
+    time.tv_nsec += (ms % 1000) * 1000000;
+    if (time.tv_nsec >= 1000000000) {
+        time.tv_sec += time.tv_nsec / 1000000000;
+        time.tv_nsec %= 1000000000;
+    }
+}
+
+bool LocTimer::start(unsigned int timeOutInMs, bool wakeOnExpire, bool coarse,
+                     unsigned int toleranceInMs) {
+    // it is cheap to check pointer first than allocating unconditionally
+    if (__atomic_load_n(&mTimer, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    LocTimerContainer* container = LocTimerContainer::get(wakeOnExpire, coarse);
+    if (!container) {
+        return false;
+    }
+
+    struct timespec futureTime;
+    clock_gettime(CLOCK_BOOTTIME, &futureTime);
+    addMs(futureTime, timeOutInMs);
+    struct timespec latestTime = futureTime;
+    addMs(latestTime, toleranceInMs);
+    LocTimerDelegate* timer = new LocTimerDelegate(*this, futureTime, latestTime, *container);
+
+    // a concurrent start() may have beaten us to it
+    LocTimerDelegate* running = NULL;
+    if (!__atomic_compare_exchange_n(&mTimer, &running, timer,
+                                     false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        delete timer;
+        return false;
+    }
+    // adding the timer into the container
+    if (!container->add(*timer)) {
+        // take the timer back, unless a concurrent stop() already has
+        running = timer;
+        if (__atomic_compare_exchange_n(&mTimer, &running, (LocTimerDelegate*)NULL,
+                                        false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            timer->release(LocTimerDelegate::CLIENT_REF);
         }
-        mTimer = new LocTimerDelegate(*this, futureTime, wakeOnExpire);
-        // if mTimer is non 0, success should be 0; or vice versa
-        success = (NULL != mTimer);
+        return false;
     }
-    mLock->unlock();
-    return success;
+    return true;
+}
+
+void LocTimer::dump() {
+    LocTimerContainer::dump();
 }
 
 bool LocTimer::stop() {
-    bool success = false;
-    mLock->lock();
-    if (mTimer) {
-        LocTimerDelegate* timer = mTimer;
-        mTimer = NULL;
-        if (timer) {
-            timer->destroyLocked();
-            success = true;
-        }
+    LocTimerDelegate* timer = __atomic_exchange_n(&mTimer, (LocTimerDelegate*)NULL,
+                                                  __ATOMIC_ACQ_REL);
+    if (!timer) {
+        return false;
     }
-    mLock->unlock();
-    return success;
+    uint32_t state = timer->markStopped();
+    // if it has expired, the container has taken it out already
+    if (!(state & LocTimerDelegate::EXPIRED)) {
+        timer->mContainer->remove(*timer);
+    }
+    timer->release(LocTimerDelegate::CLIENT_REF);
+    // stopped in time, unless its callback is being called
+    return !(state & LocTimerDelegate::CALLING);
 }
 
 /***************************LocTimerWrapper methods***************************/
@@ -613,7 +983,7 @@ public:
 pthread_mutex_t LocTimerWrapper::mMutex = PTHREAD_MUTEX_INITIALIZER;
 
 void* loc_timer_start(uint64_t msec, loc_timer_callback cb_func,
-                      void *caller_data, bool wake_on_expire)
+                      void *caller_data, bool wake_on_expire, bool coarse)
 {
     LocTimerWrapper* locTimerWrapper = NULL;
 
@@ -621,7 +991,7 @@ void* loc_timer_start(uint64_t msec, loc_timer_callback cb_func,
         locTimerWrapper = new LocTimerWrapper(cb_func, caller_data);
 
         if (locTimerWrapper) {
-            locTimerWrapper->start(msec, wake_on_expire);
+            locTimerWrapper->start(msec, wake_on_expire, coarse);
         }
     }
 
@@ -682,6 +1052,49 @@ public:
     }
 };
 
+class LocTimerCount : public LocTimer {
+public:
+    static int sExpired;
+    inline virtual void timeOutCallback() {
+        __atomic_add_fetch(&sExpired, 1, __ATOMIC_RELAXED);
+    }
+};
+int LocTimerCount::sExpired = 0;
+
+// stress: each thread keeps timers of its own ticking, which never
+// expire, and stops / restarts them; threads are spread over the 4
+// containers by their index
+struct LocTimerStress {
+    int mIndex;
+    int mTimers;
+    int mCycles;
+    int mFailures;
+};
+
+void* stressTimers(void* arg) {
+    LocTimerStress* stress = (LocTimerStress*)arg;
+    bool wakeOnExpire = (stress->mIndex & 1);
+    bool coarse = (stress->mIndex & 2);
+    unsigned int seed = stress->mIndex;
+    LocTimerCount* timers = new LocTimerCount[stress->mTimers];
+    for (int i = 0; i < stress->mTimers; i++) {
+        timers[i].start(60000 + rand_r(&seed) % 10000, wakeOnExpire, coarse);
+    }
+    for (int c = 0; c < stress->mCycles; c++) {
+        for (int i = 0; i < stress->mTimers; i++) {
+            if (!timers[i].stop() ||
+                !timers[i].start(60000 + rand_r(&seed) % 10000, wakeOnExpire, coarse)) {
+                stress->mFailures++;
+            }
+        }
+    }
+    for (int i = 0; i < stress->mTimers; i++) {
+        timers[i].stop();
+    }
+    delete[] timers;
+    return NULL;
+}
+
 // For Linux command line testing:
 // compilation:
 //     g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -I. -I../../../../system/core/include -o LocHeap.o LocHeap.cpp
@@ -693,23 +1106,24 @@ int main(int argc, char** argv) {
     int tries = atoi(argv[1]);
     int checks = tries >> 3;
     LocTimerTest** timerArray = new LocTimerTest*[tries];
-    memset(timerArray, NULL, tries);
+    memset(timerArray, 0, tries * sizeof(LocTimerTest*));
 
     for (int i = 0; i < tries; i++) {
         int r = rand() % tries;
         LocTimerTest* timer = new LocTimerTest(r);
         if (timerArray[r]) {
-            if (!timer->stop()) {
+            if (!timerArray[r]->stop()) {
                 printf("%lf:\n", getDeltaSeconds(timeOfStart, getNow()));
                 printf("ERRER: %dth timer, id %d, not running when it should be\n", i, r);
                 exit(0);
             } else {
                 printf("stop() - %d\n", r);
                 delete timer;
+                delete timerArray[r];
                 timerArray[r] = NULL;
             }
         } else {
-            if (!timer->start(r, false)) {
+            if (!timer->start((r + 1) * 1000, false)) {
                 printf("%lf:\n", getDeltaSeconds(timeOfStart, getNow()));
                 printf("ERRER: %dth timer, id %d, running when it should not be\n", i, r);
                 exit(0);
@@ -736,6 +1150,87 @@ int main(int argc, char** argv) {
 
     delete[] timerArray;
 
+    // timing: keep tries timers ticking at once and stop / restart each
+    // of them a few times, the pattern of retry and response timeouts
+    const int cycles = 4;
+    LocTimerTest** timers = new LocTimerTest*[tries];
+    for (int coarse = 0; coarse < 2; coarse++) {
+        struct timespec timeOfBench = getNow();
+        for (int i = 0; i < tries; i++) {
+            timers[i] = new LocTimerTest(tries + i);
+            timers[i]->start(60000 + i, false, coarse);
+        }
+        for (int c = 0; c < cycles; c++) {
+            for (int i = 0; i < tries; i++) {
+                timers[i]->stop();
+                timers[i]->start(60000 + rand() % tries, false, coarse);
+            }
+        }
+        for (int i = 0; i < tries; i++) {
+            timers[i]->stop();
+            delete timers[i];
+        }
+        printf("%s: %d timers x %d start / stop cycles: %lf s\n",
+               coarse ? "coarse" : "precise", tries, cycles,
+               getDeltaSeconds(timeOfBench, getNow()));
+    }
+    delete[] timers;
+
+    // expirations: 200 timers due over 2 s, precise, coarse, and precise
+    // with 100 ms tolerance (as alarms, so counted apart); compare the
+    // timerfd_settime / expiration counts dumped below
+    const int expiring = 200;
+    const char* modes[] = { "precise", "coarse", "tolerant" };
+    LocTimerCount** counters = new LocTimerCount*[expiring];
+    for (int mode = 0; mode < 3; mode++) {
+        LocTimerCount::sExpired = 0;
+        for (int i = 0; i < expiring; i++) {
+            counters[i] = new LocTimerCount();
+            counters[i]->start(10 + rand() % 2000, 2 == mode, 1 == mode,
+                               2 == mode ? 100 : 0);
+        }
+        sleep(3);
+        printf("%s: %d of %d timers expired\n", modes[mode],
+               LocTimerCount::sExpired, expiring);
+        for (int i = 0; i < expiring; i++) {
+            delete counters[i];
+        }
+    }
+    delete[] counters;
+
+    // concurrent stop / start on independent timers, by 1 to 8 threads;
+    // the time includes expiring one last timer, i.e. until everything
+    // the threads did has been done with
+    const int stressCycles = 20000;
+    for (int threads = 1; threads <= 8; threads <<= 1) {
+        pthread_t tids[8];
+        LocTimerStress stress[8];
+        LocTimerCount last;
+        int failures = 0;
+        LocTimerCount::sExpired = 0;
+        struct timespec timeOfStress = getNow();
+        for (int t = 0; t < threads; t++) {
+            stress[t].mIndex = t;
+            stress[t].mTimers = 16;
+            stress[t].mCycles = stressCycles / threads;
+            stress[t].mFailures = 0;
+            pthread_create(&tids[t], NULL, stressTimers, &stress[t]);
+        }
+        for (int t = 0; t < threads; t++) {
+            pthread_join(tids[t], NULL);
+            failures += stress[t].mFailures;
+        }
+        last.start(0, false);
+        while (!__atomic_load_n(&LocTimerCount::sExpired, __ATOMIC_RELAXED)) {
+            usleep(100);
+        }
+        double seconds = getDeltaSeconds(timeOfStress, getNow());
+        int pairs = threads * (stressCycles / threads) * 16;
+        printf("stress: %d threads, %d stop / start pairs: %.0f ns per pair, %d failures\n",
+               threads, pairs, seconds * 1000000000 / pairs, failures);
+    }
+    LocTimer::dump();
+
     return 0;
 }
 
@@ -35,17 +35,15 @@
 
 // opaque class to provide service implementation.
 class LocTimerDelegate;
-class LocSharedLock;
 
 // LocTimer client must extend this class and implementthe callback.
-// start() / stop() methods are to arm / disarm timer.
+// start() / stop() methods are to arm / disarm timer. They may be called
+// from any thread, and take no lock that other timers would contend for.
 class LocTimer
 {
+    // the running timer, swapped atomically by start() / stop() and by
+    // the expiration, which is why LocTimerDelegate needs to be a friend.
     LocTimerDelegate* mTimer;
-    LocSharedLock* mLock;
-    // don't really want mLock to be manipulated by clients, yet LocTimer
-    // has to have a reference to the lock so that the delete of LocTimer
-    // and LocTimerDelegate can work together on their share resources.
     friend class LocTimerDelegate;
 
 public:
@@ -57,18 +55,37 @@ public:
     //                        expiration and notify the client.
     //               false if to wait until next time CPU wakes up (if
     //                        sleeping) and then notify the client.
+    // coarse:       true if the expiration may be rounded up to the next
+    //                        100 ms tick and share one kernel timer with
+    //                        other coarse timers due in the same tick.
+    //               false if to expire as precisely as the kernel does.
+    // toleranceInMs: how late after timeOutInMs the timer may expire, so
+    //                        that it can expire with other timers whose
+    //                        tolerance windows overlap its, in one wakeup.
+    //                        Coarse timers already share their tick, and
+    //                        ignore it.
     // return:       true on success;
     //               false on failure, e.g. timer is already running.
-    bool start(uint32_t timeOutInMs, bool wakeOnExpire);
+    bool start(uint32_t timeOutInMs, bool wakeOnExpire, bool coarse = false,
+               uint32_t toleranceInMs = 0);
 
     // return:       true on success;
-    //               false on failure, e.g. timer is not running.
+    //               false on failure, e.g. timer is not running, or its
+    //                        timeOutCallback() is being called already.
     bool stop();
 
     //  LocTimer client Should implement this method.
     //  This method is used for timeout calling back to client. This method
     //  should be short enough (eg: send a message to your own thread).
+    //  It is called in a worker thread of the shared LocExecutor, and may
+    //  start() the timer again, or delete it. The client must not be
+    //  deleted by any other thread while it is called.
     virtual void timeOutCallback() = 0;
+
+    // logs, per timer container, the number of kernel timer updates,
+    // expirations, and expirations avoided by coalescing timers so far,
+    // and the time it is armed for
+    static void dump();
 };
 
 #endif //__LOC_DELAY_H__
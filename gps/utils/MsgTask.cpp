@@ -31,7 +31,10 @@
 
 #include <cutils/sched_policy.h>
 #include <unistd.h>
+#include <string.h>
+#include <time.h>
 #include <MsgTask.h>
+#include <LocMsgTrace.h>
 #include <msg_q.h>
 #include <log_util.h>
 #include <loc_log.h>
@@ -40,29 +43,79 @@ static void LocMsgDestroy(void* msg) {
     delete (LocMsg*)msg;
 }
 
+static inline uint64_t nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+template <typename T>
+static inline void atomicMax(T* target, T value) {
+    T cur = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while (value > cur &&
+           !__atomic_compare_exchange_n(target, &cur, value, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+unsigned int MsgTask::sRingCapacity = 0;
+
+void MsgTask::setRingCapacity(unsigned int capacity) {
+    __atomic_store_n(&sRingCapacity, capacity, __ATOMIC_RELAXED);
+}
+
+const void* MsgTask::createQueue() {
+    unsigned int capacity = __atomic_load_n(&sRingCapacity, __ATOMIC_RELAXED);
+    if (0 == capacity) {
+        return msg_q_init2();
+    }
+    void* q = NULL;
+    if (eMSG_Q_SUCCESS != msg_q_init_ex(&q, eMSG_Q_TYPE_RING, capacity)) {
+        LOC_LOGE("%s: no ring of %u slots, using a list", __func__, capacity);
+        q = (void*)msg_q_init2();
+    }
+    return q;
+}
+
 MsgTask::MsgTask(LocThread::tCreate tCreator,
                  const char* threadName, bool joinable) :
-    mQ(msg_q_init2()), mThread(new LocThread()) {
-    if (!mThread->start(tCreator, threadName, this, joinable)) {
-        delete mThread;
-        mThread = NULL;
-    }
+    mQ(createQueue()), mExecutor(NULL), mThread(NULL),
+    mMaxBatch(MSG_TASK_DEFAULT_BATCH) {
+    start(tCreator, threadName, joinable);
 }
 
 MsgTask::MsgTask(const char* threadName, bool joinable) :
-    mQ(msg_q_init2()), mThread(new LocThread()) {
-    if (!mThread->start(threadName, this, joinable)) {
-        delete mThread;
-        mThread = NULL;
+    mQ(createQueue()), mExecutor(NULL), mThread(NULL),
+    mMaxBatch(MSG_TASK_DEFAULT_BATCH) {
+    start(NULL, threadName, joinable);
+}
+
+void MsgTask::start(LocThread::tCreate tCreator, const char* threadName, bool joinable) {
+    memset(mLaneStats, 0, sizeof(mLaneStats));
+    mExecutor = LocExecutor::getDefault(tCreator);
+    if (NULL == mExecutor) {
+        LOC_LOGW("%s: %s needs a thread of its own", __func__,
+                 threadName ? threadName : "MsgTask");
+        mThread = new LocThread();
+        if (!mThread->start(tCreator, threadName, this, joinable)) {
+            delete mThread;
+            mThread = NULL;
+        }
     }
 }
 
 MsgTask::~MsgTask() {
     msg_q_flush((void*)mQ);
     msg_q_destroy((void**)&mQ);
+    dump();
+    LocMsgPool::dump();
 }
 
 void MsgTask::destroy() {
+    if (mExecutor) {
+        mExecutor->retire(*this);
+        return;
+    }
     LocThread* thread = mThread;
     msg_q_unblock((void*)mQ);
     if (thread) {
@@ -74,7 +127,80 @@ void MsgTask::destroy() {
 }
 
 void MsgTask::sendMsg(const LocMsg* msg) const {
-    msg_q_snd((void*)mQ, (void*)msg, LocMsgDestroy);
+    LocMsgPriority priority = msg->priority();
+    if (priority < LOC_MSG_PRIORITY_HIGH || priority >= LOC_MSG_PRIORITY_NUM) {
+        priority = LOC_MSG_PRIORITY_NORMAL;
+    }
+    LaneStats& lane = mLaneStats[priority];
+
+    msg->mSendTime = nowNs();
+    if (LocMsgTrace::enabled()) {
+        LocMsgTrace::sent(msg);
+    }
+    // count it before queueing, the receiver may dequeue it right away
+    uint32_t depth = __atomic_add_fetch(&lane.depth, 1, __ATOMIC_RELAXED);
+    atomicMax(&lane.maxDepth, depth);
+
+    // the queue only takes ownership of msg on success; a ring fails
+    // when the lane is full
+    if (eMSG_Q_SUCCESS != msg_q_snd_prio((void*)mQ, (void*)msg, LocMsgDestroy,
+                                         (msg_q_priority_type)priority)) {
+        LOC_LOGE("%s:%d] fail sending msg\n", __func__, __LINE__);
+        __atomic_sub_fetch(&lane.depth, 1, __ATOMIC_RELAXED);
+        delete msg;
+    } else if (mExecutor) {
+        mExecutor->post(*const_cast<MsgTask*>(this));
+    }
+}
+
+uint64_t MsgTask::accountDequeue(const LocMsg* msg) {
+    LocMsgPriority priority = msg->priority();
+    if (priority < LOC_MSG_PRIORITY_HIGH || priority >= LOC_MSG_PRIORITY_NUM) {
+        priority = LOC_MSG_PRIORITY_NORMAL;
+    }
+    LaneStats& lane = mLaneStats[priority];
+    uint64_t now = nowNs();
+    uint64_t waitNs = now - msg->mSendTime;
+
+    __atomic_sub_fetch(&lane.depth, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&lane.count, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&lane.totalWaitNs, waitNs, __ATOMIC_RELAXED);
+    atomicMax(&lane.maxWaitNs, waitNs);
+    return now;
+}
+
+bool MsgTask::getLaneStats(LocMsgPriority priority, LaneStats& stats) const {
+    if (priority < LOC_MSG_PRIORITY_HIGH || priority >= LOC_MSG_PRIORITY_NUM) {
+        return false;
+    }
+    const LaneStats& lane = mLaneStats[priority];
+    stats.depth = __atomic_load_n(&lane.depth, __ATOMIC_RELAXED);
+    stats.maxDepth = __atomic_load_n(&lane.maxDepth, __ATOMIC_RELAXED);
+    stats.count = __atomic_load_n(&lane.count, __ATOMIC_RELAXED);
+    stats.totalWaitNs = __atomic_load_n(&lane.totalWaitNs, __ATOMIC_RELAXED);
+    stats.maxWaitNs = __atomic_load_n(&lane.maxWaitNs, __ATOMIC_RELAXED);
+    return true;
+}
+
+void MsgTask::dump() const {
+    for (int prio = LOC_MSG_PRIORITY_HIGH; prio < LOC_MSG_PRIORITY_NUM; prio++) {
+        LaneStats stats;
+        getLaneStats((LocMsgPriority)prio, stats);
+        LOC_LOGD("%s: lane %d depth %u maxDepth %u count %llu avgWait %llu us maxWait %llu us",
+                 __func__, prio, stats.depth, stats.maxDepth,
+                 (unsigned long long)stats.count,
+                 (unsigned long long)(stats.count ? stats.totalWaitNs / stats.count / 1000 : 0),
+                 (unsigned long long)(stats.maxWaitNs / 1000));
+    }
+}
+
+void MsgTask::setMaxBatch(unsigned int maxBatch) const {
+    if (maxBatch < 1) {
+        maxBatch = 1;
+    } else if (maxBatch > MSG_TASK_MAX_BATCH) {
+        maxBatch = MSG_TASK_MAX_BATCH;
+    }
+    __atomic_store_n(&mMaxBatch, maxBatch, __ATOMIC_RELAXED);
 }
 
 void MsgTask::prerun() {
@@ -82,21 +208,154 @@ void MsgTask::prerun() {
     set_sched_policy(gettid(), SP_FOREGROUND);
 }
 
-bool MsgTask::run() {
-    LOC_LOGV("MsgTask::loop() listening ...\n");
-    LocMsg* msg;
-    msq_q_err_type result = msg_q_rcv((void*)mQ, (void **)&msg);
+bool MsgTask::procBatch(bool wait, bool& full) {
+    LocMsg* msgs[MSG_TASK_MAX_BATCH];
+    unsigned int count = 0;
+    unsigned int maxBatch = __atomic_load_n(&mMaxBatch, __ATOMIC_RELAXED);
+    msq_q_err_type result = wait ?
+        msg_q_rcv_batch((void*)mQ, (void **)msgs, maxBatch, &count) :
+        msg_q_try_rcv_batch((void*)mQ, (void **)msgs, maxBatch, &count);
     if (eMSG_Q_SUCCESS != result) {
         LOC_LOGE("%s:%d] fail receiving msg: %s\n", __func__, __LINE__,
                  loc_get_msg_q_status(result));
         return false;
     }
 
-    msg->log();
-    // there is where each individual msg handling is invoked
-    msg->proc();
+    for (unsigned int i = 0; i < count; i++) {
+        uint64_t dequeueTime = accountDequeue(msgs[i]);
+        LocMsgTrace::Type* traced = LocMsgTrace::enabled() ?
+            LocMsgTrace::dequeued(msgs[i], dequeueTime) : NULL;
+        IF_LOC_LOGV {
+            msgs[i]->log();
+        }
+        // there is where each individual msg handling is invoked
+        msgs[i]->proc();
+        if (traced) {
+            LocMsgTrace::procDone(traced, dequeueTime);
+        }
 
-    delete msg;
+        delete msgs[i];
+    }
 
+    full = (count == maxBatch);
     return true;
 }
+
+void MsgTask::execute() {
+    bool full = false;
+    // run again, behind the other tasks queued meanwhile, if the batch
+    // may have left msgs behind; those sent later post this task anyway
+    if (procBatch(false, full) && full) {
+        mExecutor->post(*this);
+    }
+}
+
+bool MsgTask::run() {
+    LOC_LOGV("MsgTask::loop() listening ...\n");
+    bool full = false;
+    return procBatch(true, full);
+}
+
+#ifdef __LOC_DEBUG__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// burst test: a "modem" thread sends what a fix epoch brings, a position
+// report, an SV report and a run of NMEA sentences, burst after burst, the
+// way reports pile up after the modem has been held off. Each msg spins
+// for about as long as its loc_eng handler takes. Reported per batch size
+// are the throughput and how long position reports waited in the queue.
+#define TEST_NMEA_PER_BURST 12
+#define TEST_MSGS_PER_BURST (2 + TEST_NMEA_PER_BURST)
+
+enum MsgTaskTestType {
+    TEST_POSITION = 0,
+    TEST_SV,
+    TEST_NMEA
+};
+
+static uint32_t sTestWorkPercent = 100;
+static uint64_t sTestProcessed = 0;
+static uint64_t sTestPositions = 0;
+static uint64_t sTestPositionWaitNs = 0;
+static uint64_t sTestPositionMaxWaitNs = 0;
+
+struct MsgTaskTestMsg : public LocMsg {
+    MsgTaskTestType mType;
+    inline MsgTaskTestMsg(MsgTaskTestType type) : LocMsg(), mType(type) {}
+    virtual void proc() const {
+        // loop counts for about 2 us per fix, 3 us per SV report and
+        // 0.3 us per NMEA sentence
+        static const uint32_t work[] = { 2000, 3000, 300 };
+        uint32_t loops = work[mType] * sTestWorkPercent / 100;
+        volatile uint32_t spin = 0;
+        for (uint32_t i = 0; i < loops; i++) {
+            spin++;
+        }
+        if (TEST_POSITION == mType) {
+            uint64_t waitNs = nowNs() - mSendTime;
+            sTestPositions++;
+            sTestPositionWaitNs += waitNs;
+            if (waitNs > sTestPositionMaxWaitNs) {
+                sTestPositionMaxWaitNs = waitNs;
+            }
+        }
+        __atomic_add_fetch(&sTestProcessed, 1, __ATOMIC_RELEASE);
+    }
+    inline virtual LocMsgPriority priority() const {
+        return LOC_MSG_PRIORITY_HIGH;
+    }
+};
+
+static int testBurst(unsigned int maxBatch, uint32_t bursts) {
+    MsgTask* task = new MsgTask("MsgTaskTest", false);
+    task->setMaxBatch(maxBatch);
+    __atomic_store_n(&sTestProcessed, 0, __ATOMIC_RELAXED);
+    sTestPositions = 0;
+    sTestPositionWaitNs = 0;
+    sTestPositionMaxWaitNs = 0;
+
+    uint64_t expected = (uint64_t)bursts * TEST_MSGS_PER_BURST;
+    uint64_t start = nowNs();
+    for (uint32_t burst = 0; burst < bursts; burst++) {
+        task->sendMsg(new MsgTaskTestMsg(TEST_POSITION));
+        task->sendMsg(new MsgTaskTestMsg(TEST_SV));
+        for (int nmea = 0; nmea < TEST_NMEA_PER_BURST; nmea++) {
+            task->sendMsg(new MsgTaskTestMsg(TEST_NMEA));
+        }
+    }
+    while (__atomic_load_n(&sTestProcessed, __ATOMIC_ACQUIRE) < expected) {
+        usleep(100);
+    }
+    uint64_t elapsed = nowNs() - start;
+    task->destroy();
+
+    printf("batch %2u: %llu msgs %7.1f ns/msg, position wait us avg %llu max %llu\n",
+           maxBatch, (unsigned long long)expected, (double)elapsed / expected,
+           (unsigned long long)(sTestPositionWaitNs / sTestPositions / 1000),
+           (unsigned long long)(sTestPositionMaxWaitNs / 1000));
+    return 0;
+}
+
+// For Linux command line testing:
+// compile: g++ -D__LOC_HOST_DEBUG__ -O2 -std=c++0x -I. -Iplatform_lib_abstractions -I../../../../system/core/include -c LocExecutor.cpp LocThread.cpp LocMsgPool.cpp LocMsgTrace.cpp loc_log.cpp loc_log_async.cpp
+//          gcc -D__LOC_HOST_DEBUG__ -O2 -I. -Iplatform_lib_abstractions -I../../../../system/core/include -c msg_q.c linked_list.c
+//          g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -O2 -std=c++0x -I. -Iplatform_lib_abstractions -I../../../../system/core/include MsgTask.cpp *.o -lpthread
+// run: ./a.out [bursts [handler work in percent, 0 to time the queue alone]]
+int main(int argc, char** argv) {
+    static const unsigned int batches[] = { 1, 4, MSG_TASK_DEFAULT_BATCH, MSG_TASK_MAX_BATCH };
+    uint32_t bursts = (argc > 1) ? atoi(argv[1]) : 20000;
+    if (0 == bursts) {
+        bursts = 20000;
+    }
+    if (argc > 2) {
+        sTestWorkPercent = atoi(argv[2]);
+    }
+    for (unsigned int i = 0; i < sizeof(batches) / sizeof(batches[0]); i++) {
+        testBurst(batches[i], bursts);
+    }
+    return 0;
+}
+
+#endif // __LOC_DEBUG__
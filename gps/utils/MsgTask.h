@@ -29,28 +29,102 @@
 #ifndef __MSG_TASK__
 #define __MSG_TASK__
 
+#include <stdint.h>
 #include <LocThread.h>
+#include <LocExecutor.h>
+#include <LocMsgPool.h>
+
+// lanes of a MsgTask queue. A message is only dequeued once
+// no message of a higher priority is pending.
+enum LocMsgPriority {
+    LOC_MSG_PRIORITY_HIGH = 0,  // fix, SV, NMEA and engine status delivery
+    LOC_MSG_PRIORITY_NORMAL,    // control messages, the default
+    LOC_MSG_PRIORITY_LOW,       // bulk diagnostic traffic, measurements
+    LOC_MSG_PRIORITY_NUM
+};
 
 struct LocMsg {
-    inline LocMsg() {}
+    // set by MsgTask::sendMsg, in nanoseconds of CLOCK_MONOTONIC
+    mutable uint64_t mSendTime;
+    inline LocMsg() : mSendTime(0) {}
     inline virtual ~LocMsg() {}
     virtual void proc() const = 0;
+    // verbose trace of the msg, only called as LOC_LOGV is on
     inline virtual void log() const {}
+    inline virtual LocMsgPriority priority() const { return LOC_MSG_PRIORITY_NORMAL; }
+    // messages are created and deleted per event; keep them off the heap
+    inline static void* operator new(size_t size) {
+        return LocMsgPool::allocate(size);
+    }
+    inline static void operator delete(void* ptr) {
+        LocMsgPool::release(ptr);
+    }
 };
 
-class MsgTask : public LocRunnable {
+// upper bound of messages run() dequeues in one go
+#define MSG_TASK_MAX_BATCH 32
+#define MSG_TASK_DEFAULT_BATCH 16
+
+// A queue of LocMsgs, proc()'ed one at a time in the order they are sent.
+// MsgTasks run as tasks of the shared LocExecutor, so they do not cost a
+// thread each; one falls back to a thread of its own only when it needs
+// threads from a creator the shared executor was not started with.
+class MsgTask : public LocRunnable, public LocExecutorTask {
+public:
+    struct LaneStats {
+        uint32_t depth;         // messages currently queued
+        uint32_t maxDepth;      // high water mark of depth
+        uint64_t count;         // messages dequeued
+        uint64_t totalWaitNs;   // sum of time spent queued
+        uint64_t maxWaitNs;     // longest time spent queued
+    };
+private:
     const void* mQ;
+    LocExecutor* mExecutor;
     LocThread* mThread;
+    mutable unsigned int mMaxBatch;
+    mutable LaneStats mLaneStats[LOC_MSG_PRIORITY_NUM];
+    static unsigned int sRingCapacity;
+    static const void* createQueue();
+    void start(LocThread::tCreate tCreator, const char* threadName, bool joinable);
+    // returns the time of dequeue
+    uint64_t accountDequeue(const LocMsg* msg);
+    // procs the msgs of one batch; full tells if the batch was full, i.e.
+    // if there may be more msgs queued. false if the batch could not be
+    // received, e.g. because the queue is unblocked
+    bool procBatch(bool wait, bool& full);
     friend class LocThreadDelegate;
 protected:
     virtual ~MsgTask();
 public:
     MsgTask(LocThread::tCreate tCreator, const char* threadName = NULL, bool joinable = true);
     MsgTask(const char* threadName = NULL, bool joinable = true);
-    // this obj will be deleted once thread is deleted
+    // this obj will be deleted once its thread, or the executor, is done
+    // with it; msgs still queued are dropped
     void destroy();
+    // queue storage of the MsgTasks created from now on. 0, the default,
+    // keeps each lane in a locked list; else each lane is a lock-free
+    // ring of this many slots, rounded up to a power of 2, and a msg sent
+    // to a full lane is dropped.
+    static void setRingCapacity(unsigned int capacity);
     void sendMsg(const LocMsg* msg) const;
-    // Overrides of LocRunnable methods
+    // number of queued messages taken out of the queue per lock
+    // round trip, 1 to MSG_TASK_MAX_BATCH. Messages are still
+    // processed one by one in FIFO order; a smaller batch only
+    // bounds how long a freshly sent message waits behind ones
+    // already claimed by run().
+    void setMaxBatch(unsigned int maxBatch) const;
+    // copies the queue statistics of one priority lane;
+    // false if priority is invalid
+    bool getLaneStats(LocMsgPriority priority, LaneStats& stats) const;
+    // logs the queue statistics of all lanes
+    void dump() const;
+    // Override of LocExecutorTask method
+    // procs up to a batch of the msgs queued, and posts itself again if
+    // there may be more
+    virtual void execute();
+
+    // Overrides of LocRunnable methods, when running in a thread of its own
     // This method will be repeated called until it returns false; or
     // until thread is stopped.
     virtual bool run();
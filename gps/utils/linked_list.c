@@ -43,11 +43,42 @@ typedef struct list_element {
    void (*dealloc_func)(void*);
 }list_element;
 
+/* elements of removed data are kept for reuse, up to this many per list */
+#define LINKED_LIST_MAX_FREE 16
+
 typedef struct list_state {
    list_element* p_head;
    list_element* p_tail;
+   list_element* p_free;
+   unsigned int free_count;
 } list_state;
 
+static list_element* element_alloc(list_state* p_list)
+{
+   list_element* elem = p_list->p_free;
+   if( elem != NULL )
+   {
+      p_list->p_free = elem->next;
+      p_list->free_count--;
+      return elem;
+   }
+   return (list_element*)malloc(sizeof(list_element));
+}
+
+static void element_free(list_state* p_list, list_element* elem)
+{
+   if( p_list->free_count < LINKED_LIST_MAX_FREE )
+   {
+      elem->next = p_list->p_free;
+      p_list->p_free = elem;
+      p_list->free_count++;
+   }
+   else
+   {
+      free(elem);
+   }
+}
+
 /* ----------------------- END INTERNAL FUNCTIONS ---------------------------------------- */
 
 /*===========================================================================
@@ -95,6 +126,12 @@ linked_list_err_type linked_list_destroy(void** list_data)
    list_state* p_list = (list_state*)*list_data;
 
    linked_list_flush(p_list);
+   while( p_list->p_free != NULL )
+   {
+      list_element* tmp = p_list->p_free->next;
+      free(p_list->p_free);
+      p_list->p_free = tmp;
+   }
 
    free(*list_data);
    *list_data = NULL;
@@ -109,7 +146,7 @@ linked_list_err_type linked_list_destroy(void** list_data)
   ===========================================================================*/
 linked_list_err_type linked_list_add(void* list_data, void *data_obj, void (*dealloc)(void*))
 {
-   LOC_LOGV("%s: Adding to list data_obj = 0x%08X\n", __FUNCTION__, data_obj);
+   LOC_LOGV("%s: Adding to list data_obj = %p\n", __FUNCTION__, data_obj);
    if( list_data == NULL )
    {
       LOC_LOGE("%s: Invalid list parameter!\n", __FUNCTION__);
@@ -123,7 +160,7 @@ linked_list_err_type linked_list_add(void* list_data, void *data_obj, void (*dea
    }
 
    list_state* p_list = (list_state*)list_data;
-   list_element* elem = (list_element*)malloc(sizeof(list_element));
+   list_element* elem = element_alloc(p_list);
    if( elem == NULL )
    {
       LOC_LOGE("%s: Memory allocation failed\n", __FUNCTION__);
@@ -198,7 +235,7 @@ linked_list_err_type linked_list_remove(void* list_data, void **data_obj)
    *data_obj = tmp->data_ptr;
 
    /* Free allocated list element */
-   free(tmp);
+   element_free(p_list, tmp);
 
    return eLINKED_LIST_SUCCESS;
 }
@@ -249,7 +286,7 @@ linked_list_err_type linked_list_flush(void* list_data)
       }
 
       /* Free list element */
-      free(p_list->p_head);
+      element_free(p_list, p_list->p_head);
 
       p_list->p_head = tmp;
    }
@@ -314,7 +351,7 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
          if (NULL == data_p && NULL != tmp->dealloc_func) {
              tmp->dealloc_func(tmp->data_ptr);
          }
-         free(tmp);
+         element_free(p_list, tmp);
        }
 
        tmp = NULL;
@@ -326,3 +363,376 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
    return eLINKED_LIST_SUCCESS;
 }
 
+
+/* ----------------------- INTRUSIVE LINKED LIST ----------------------------------------- */
+
+static inline uint32_t key_bucket(const linked_list_intrusive* list, uintptr_t key)
+{
+   uint32_t hash = (uint32_t)key ^ (uint32_t)((uint64_t)key >> 32);
+   hash *= 2654435761u;
+   return (hash ^ (hash >> 16)) & list->index_mask;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_intrusive_init
+
+  ===========================================================================*/
+linked_list_err_type linked_list_intrusive_init(linked_list_intrusive* list,
+                                                uint32_t index_buckets)
+{
+   if( list == NULL )
+   {
+      LOC_LOGE("%s: Invalid list parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_PARAMETER;
+   }
+
+   memset(list, 0, sizeof(*list));
+   list->head.next = list->head.prev = &list->head;
+
+   if( index_buckets > 0 )
+   {
+      uint32_t buckets = 1;
+      while( buckets < index_buckets && buckets < 0x80000000u )
+      {
+         buckets <<= 1;
+      }
+      list->index = (linked_list_node**)calloc(buckets, sizeof(linked_list_node*));
+      if( list->index == NULL )
+      {
+         LOC_LOGE("%s: Unable to allocate space for index!\n", __FUNCTION__);
+         return eLINKED_LIST_FAILURE_GENERAL;
+      }
+      list->index_mask = buckets - 1;
+   }
+
+   return eLINKED_LIST_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_intrusive_destroy
+
+  ===========================================================================*/
+linked_list_err_type linked_list_intrusive_destroy(linked_list_intrusive* list)
+{
+   if( list == NULL )
+   {
+      LOC_LOGE("%s: Invalid list parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_HANDLE;
+   }
+
+   free(list->index);
+   list->index = NULL;
+   list->index_mask = 0;
+   list->head.next = list->head.prev = &list->head;
+   list->count = 0;
+
+   return eLINKED_LIST_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_intrusive_add
+
+  ===========================================================================*/
+linked_list_err_type linked_list_intrusive_add(linked_list_intrusive* list,
+                                               linked_list_node* node,
+                                               uintptr_t key)
+{
+   if( list == NULL )
+   {
+      LOC_LOGE("%s: Invalid list parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_HANDLE;
+   }
+
+   if( node == NULL )
+   {
+      LOC_LOGE("%s: Invalid input parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_PARAMETER;
+   }
+
+   node->key = key;
+   node->prev = &list->head;
+   node->next = list->head.next;
+   list->head.next->prev = node;
+   list->head.next = node;
+
+   if( list->index != NULL )
+   {
+      linked_list_node** bucket = &list->index[key_bucket(list, key)];
+      node->hash_next = *bucket;
+      if( *bucket != NULL )
+      {
+         (*bucket)->hash_pprev = &node->hash_next;
+      }
+      *bucket = node;
+      node->hash_pprev = bucket;
+   }
+   else
+   {
+      node->hash_next = NULL;
+      node->hash_pprev = NULL;
+   }
+   list->count++;
+
+   return eLINKED_LIST_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_intrusive_remove
+
+  ===========================================================================*/
+linked_list_err_type linked_list_intrusive_remove(linked_list_intrusive* list,
+                                                  linked_list_node* node)
+{
+   if( list == NULL )
+   {
+      LOC_LOGE("%s: Invalid list parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_HANDLE;
+   }
+
+   if( node == NULL || node->next == NULL || node == &list->head )
+   {
+      LOC_LOGE("%s: Invalid input parameter!\n", __FUNCTION__);
+      return eLINKED_LIST_INVALID_PARAMETER;
+   }
+
+   node->prev->next = node->next;
+   node->next->prev = node->prev;
+
+   if( node->hash_pprev != NULL )
+   {
+      *node->hash_pprev = node->hash_next;
+      if( node->hash_next != NULL )
+      {
+         node->hash_next->hash_pprev = node->hash_pprev;
+      }
+   }
+
+   node->next = node->prev = node->hash_next = NULL;
+   node->hash_pprev = NULL;
+   list->count--;
+
+   return eLINKED_LIST_SUCCESS;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_intrusive_find
+
+  ===========================================================================*/
+linked_list_node* linked_list_intrusive_find(const linked_list_intrusive* list,
+                                             uintptr_t key,
+                                             bool (*equal)(void* data_0, linked_list_node* node),
+                                             void* data_0)
+{
+   if( list == NULL )
+   {
+      LOC_LOGE("%s: Invalid list parameter!\n", __FUNCTION__);
+      return NULL;
+   }
+
+   if( list->index != NULL )
+   {
+      /* a bucket chain has the newest first, as the list does */
+      linked_list_node* node;
+      for( node = list->index[key_bucket(list, key)]; node != NULL; node = node->hash_next )
+      {
+         if( node->key == key && (equal == NULL || equal(data_0, node)) )
+         {
+            return node;
+         }
+      }
+   }
+   else
+   {
+      linked_list_node* node;
+      for( node = list->head.next; node != &list->head; node = node->next )
+      {
+         if( node->key == key && (equal == NULL || equal(data_0, node)) )
+         {
+            return node;
+         }
+      }
+   }
+
+   return NULL;
+}
+
+/*===========================================================================
+
+  FUNCTION:   linked_list_intrusive_search
+
+  ===========================================================================*/
+linked_list_node* linked_list_intrusive_search(const linked_list_intrusive* list,
+                                               bool (*equal)(void* data_0, linked_list_node* node),
+                                               void* data_0)
+{
+   if( list == NULL || equal == NULL )
+   {
+      LOC_LOGE("%s: Invalid list parameter! list %p equal %p\n",
+               __FUNCTION__, list, equal);
+      return NULL;
+   }
+
+   linked_list_node* node;
+   for( node = list->head.next; node != &list->head; node = node->next )
+   {
+      if( equal(data_0, node) )
+      {
+         return node;
+      }
+   }
+
+   return NULL;
+}
+
+#ifdef __LOC_LINKED_LIST_DEBUG__
+
+/* Microbenchmark of add, search by key and remove, for lists of 1 to 1000
+   elements: linked_list, which allocates per add and scans to search and
+   to remove, against the intrusive list, without and with an index */
+#include <time.h>
+
+typedef struct bench_item {
+   linked_list_node node;
+   uintptr_t id;
+} bench_item;
+
+static uint64_t bench_now(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* cost of a bench_now() pair, taken out of each timing */
+static uint64_t bench_overhead;
+
+static void bench_calibrate(void)
+{
+   uint64_t best = ~0ULL;
+   int i;
+   for( i = 0; i < 1000; i++ )
+   {
+      uint64_t start = bench_now();
+      uint64_t cost = bench_now() - start;
+      best = cost < best ? cost : best;
+   }
+   bench_overhead = best;
+}
+
+static bool bench_equal(void* data_0, void* data)
+{
+   return ((bench_item*)data)->id == (uintptr_t)data_0;
+}
+
+/* ns per op of add, search and remove, over reps rounds of n elements.
+   (i * 7) % n visits all n elements, but not in the order of adding,
+   as long as 7 does not divide n */
+static void bench_legacy(bench_item* items, int n, int reps, double ns[3])
+{
+   void* list = NULL;
+   uint64_t t[3] = {0, 0, 0};
+   int r, i;
+   linked_list_init(&list);
+   for( r = 0; r < reps; r++ )
+   {
+      uint64_t start = bench_now();
+      for( i = 0; i < n; i++ )
+      {
+         linked_list_add(list, &items[i], NULL);
+      }
+      uint64_t added = bench_now();
+      for( i = 0; i < n; i++ )
+      {
+         void* found = NULL;
+         linked_list_search(list, &found, bench_equal, (void*)items[(i * 7) % n].id, false);
+      }
+      uint64_t searched = bench_now();
+      for( i = 0; i < n; i++ )
+      {
+         void* found = NULL;
+         linked_list_search(list, &found, bench_equal, (void*)items[(i * 7) % n].id, true);
+      }
+      uint64_t removed = bench_now();
+      t[0] += added - start - bench_overhead;
+      t[1] += searched - added - bench_overhead;
+      t[2] += removed - searched - bench_overhead;
+   }
+   linked_list_destroy(&list);
+   for( i = 0; i < 3; i++ )
+   {
+      ns[i] = (double)t[i] / ((uint64_t)reps * n);
+   }
+}
+
+static void bench_intrusive(bench_item* items, int n, int reps, uint32_t buckets, double ns[3])
+{
+   linked_list_intrusive list;
+   uint64_t t[3] = {0, 0, 0};
+   int r, i;
+   linked_list_intrusive_init(&list, buckets);
+   for( r = 0; r < reps; r++ )
+   {
+      uint64_t start = bench_now();
+      for( i = 0; i < n; i++ )
+      {
+         linked_list_intrusive_add(&list, &items[i].node, items[i].id);
+      }
+      uint64_t added = bench_now();
+      for( i = 0; i < n; i++ )
+      {
+         linked_list_intrusive_find(&list, items[(i * 7) % n].id, NULL, NULL);
+      }
+      uint64_t searched = bench_now();
+      for( i = 0; i < n; i++ )
+      {
+         /* an element in hand is removed without a search */
+         linked_list_intrusive_remove(&list, &items[(i * 7) % n].node);
+      }
+      uint64_t removed = bench_now();
+      t[0] += added - start - bench_overhead;
+      t[1] += searched - added - bench_overhead;
+      t[2] += removed - searched - bench_overhead;
+   }
+   linked_list_intrusive_destroy(&list);
+   for( i = 0; i < 3; i++ )
+   {
+      ns[i] = (double)t[i] / ((uint64_t)reps * n);
+   }
+}
+
+// compile: gcc -D__LOC_HOST_DEBUG__ -D__LOC_LINKED_LIST_DEBUG__ -O2 -I. -Iplatform_lib_abstractions -I../../../../system/core/include linked_list.c loc_log.cpp loc_log_async.cpp LocThread.cpp -lstdc++ -lpthread
+int main(void)
+{
+   static const int sizes[] = {1, 10, 100, 1000};
+   unsigned int s;
+   int i;
+
+   bench_calibrate();
+   printf("ns per op      add: list intr index | search: list intr index | remove: list intr index\n");
+   for( s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++ )
+   {
+      int n = sizes[s];
+      int reps = 2000000 / (n * (n < 100 ? 1 : n / 10)) + 1;
+      bench_item* items = (bench_item*)calloc(n, sizeof(bench_item));
+      double legacy[3], intrusive[3], indexed[3];
+      for( i = 0; i < n; i++ )
+      {
+         items[i].id = 1000 + i * 3;
+      }
+      bench_legacy(items, n, reps, legacy);
+      bench_intrusive(items, n, reps, 0, intrusive);
+      bench_intrusive(items, n, reps, n, indexed);
+      printf("n=%-4d     %8.1f %5.1f %5.1f | %8.1f %5.1f %5.1f | %8.1f %5.1f %5.1f\n", n,
+             legacy[0], intrusive[0], indexed[0], legacy[1], intrusive[1], indexed[1],
+             legacy[2], intrusive[2], indexed[2]);
+      free(items);
+   }
+   return 0;
+}
+
+#endif /* __LOC_LINKED_LIST_DEBUG__ */
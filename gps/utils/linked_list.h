@@ -34,6 +34,8 @@ extern "C" {
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 
 /** Linked List Return Codes */
 typedef enum
@@ -210,6 +212,195 @@ linked_list_err_type linked_list_search(void* list_data, void **data_p,
                                         bool (*equal)(void* data_0, void* data),
                                         void* data_0, bool rm_if_found);
 
+/*=============================================================================
+ *
+ *                          INTRUSIVE LINKED LIST
+ *
+ * The element embeds a linked_list_node, so add and remove never allocate,
+ * and an element in hand is removed in O(1). With an index, elements are
+ * also found by their key in O(1) on average, instead of a scan.
+ *
+ *============================================================================*/
+typedef struct linked_list_node
+{
+   struct linked_list_node* next;
+   struct linked_list_node* prev;
+   /* chain of the index bucket of key */
+   struct linked_list_node* hash_next;
+   struct linked_list_node** hash_pprev;
+   uintptr_t key;
+} linked_list_node;
+
+typedef struct linked_list_intrusive
+{
+   /* sentinel, head.next is the first element and head.prev the last */
+   linked_list_node head;
+   linked_list_node** index;
+   uint32_t index_mask;
+   uint32_t count;
+} linked_list_intrusive;
+
+/* the element a node is embedded in */
+#define LINKED_LIST_CONTAINER_OF(node, type, member) \
+   ((type*)((char*)(node) - offsetof(type, member)))
+
+/*===========================================================================
+FUNCTION    linked_list_intrusive_init
+
+DESCRIPTION
+   Initializes an intrusive list.
+
+   list:          List to be initialized.
+   index_buckets: Buckets of the key index, rounded up to a power of 2;
+                  0 for no index, linked_list_intrusive_find() scans then.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+linked_list_err_type linked_list_intrusive_init(linked_list_intrusive* list,
+                                                uint32_t index_buckets);
+
+/*===========================================================================
+FUNCTION    linked_list_intrusive_destroy
+
+DESCRIPTION
+   Frees the index of an intrusive list. The elements still in the list
+   are the caller's, and are left as they are.
+
+   list:  List to be destroyed.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+linked_list_err_type linked_list_intrusive_destroy(linked_list_intrusive* list);
+
+/*===========================================================================
+FUNCTION    linked_list_intrusive_add
+
+DESCRIPTION
+   Adds an element to the head of the list. The node must not be in any
+   list already; it stays the caller's.
+
+   list:  List to add to.
+   node:  Node embedded in the element.
+   key:   Key to find the element by; need not be unique.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+linked_list_err_type linked_list_intrusive_add(linked_list_intrusive* list,
+                                               linked_list_node* node,
+                                               uintptr_t key);
+
+/*===========================================================================
+FUNCTION    linked_list_intrusive_remove
+
+DESCRIPTION
+   Removes an element from the list, in O(1). The element is not freed.
+
+   list:  List the node is in.
+   node:  Node embedded in the element.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+linked_list_err_type linked_list_intrusive_remove(linked_list_intrusive* list,
+                                                  linked_list_node* node);
+
+/*===========================================================================
+FUNCTION    linked_list_intrusive_find
+
+DESCRIPTION
+   Finds the first element, from the head, with key and for which equal,
+   if not NULL, returns true.
+
+   list:    List handle.
+   key:     Key the element was added with.
+   equal:   Function ptr takes in a list element, and returns
+            indication if this the one looking for; NULL to match any.
+   data_0:  The data being compared against.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   The node found, NULL if none
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+linked_list_node* linked_list_intrusive_find(const linked_list_intrusive* list,
+                                             uintptr_t key,
+                                             bool (*equal)(void* data_0, linked_list_node* node),
+                                             void* data_0);
+
+/*===========================================================================
+FUNCTION    linked_list_intrusive_search
+
+DESCRIPTION
+   Scans the list, from the head, for the first element for which equal
+   returns true, regardless of keys.
+
+   list:    List handle.
+   equal:   Function ptr takes in a list element, and returns
+            indication if this the one looking for.
+   data_0:  The data being compared against.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   The node found, NULL if none
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+linked_list_node* linked_list_intrusive_search(const linked_list_intrusive* list,
+                                               bool (*equal)(void* data_0, linked_list_node* node),
+                                               void* data_0);
+
+/* iteration from the head; NULL past the last element. The next node of an
+   element is to be read before the element is removed. */
+static inline linked_list_node* linked_list_intrusive_first(const linked_list_intrusive* list)
+{
+   return list->head.next == &list->head ? NULL : list->head.next;
+}
+
+static inline linked_list_node* linked_list_intrusive_next(const linked_list_intrusive* list,
+                                                           const linked_list_node* node)
+{
+   return node->next == &list->head ? NULL : node->next;
+}
+
+static inline bool linked_list_intrusive_empty(const linked_list_intrusive* list)
+{
+   return 0 == list->count;
+}
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -37,6 +37,10 @@
 #include <ctype.h>
 #include <unistd.h>
 #include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <loc_cfg.h>
 #include <log_util.h>
 #include <loc_misc_utils.h>
@@ -54,45 +58,194 @@
 /* Parameter data */
 static uint32_t DEBUG_LEVEL = 0xff;
 static uint32_t TIMESTAMP = 0;
+static uint32_t ASYNC_LOGGING = 0;
 
 /* Parameter spec table */
 static const loc_param_s_type loc_param_table[] =
 {
     {"DEBUG_LEVEL",    &DEBUG_LEVEL, NULL,    'n'},
     {"TIMESTAMP",      &TIMESTAMP,   NULL,    'n'},
+    {"ASYNC_LOGGING",  &ASYNC_LOGGING, NULL,  'n'},
 };
 static const int loc_param_num = sizeof(loc_param_table) / sizeof(loc_param_s_type);
 
 typedef struct loc_param_v_type
 {
-    char* param_name;
-    char* param_str_value;
+    const char* param_name;
+    const char* param_str_value;
+    /* set if the values below are parsed already, as in a snapshot */
+    uint8_t param_parsed;
     int param_int_value;
     double param_double_value;
 }loc_param_v_type;
 
+/* Entries of a config table sorted by name, built once per table read,
+   so that each line of a file costs one binary search of the table */
+typedef struct loc_param_index_type
+{
+    const loc_param_s_type** entries;
+    uint32_t length;
+}loc_param_index_type;
+
+static int loc_param_index_compare(const void* a, const void* b)
+{
+    return strcmp((*(const loc_param_s_type**)a)->param_name,
+                  (*(const loc_param_s_type**)b)->param_name);
+}
+
+/*===========================================================================
+FUNCTION loc_param_index_init
+
+DESCRIPTION
+   Builds the name index of a config table. Entries without a name or a
+   place to store the value are left out.
+
+PARAMETERS:
+   index: index to build
+   config_table: table definition of strings to places to store information
+   table_length: length of the configuration table
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: success
+  -1: out of memory, index is empty
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static int loc_param_index_init(loc_param_index_type* index,
+                                const loc_param_s_type* config_table,
+                                uint32_t table_length)
+{
+    index->entries = NULL;
+    index->length = 0;
+
+    if (NULL == config_table || 0 == table_length) {
+        return 0;
+    }
+
+    index->entries = (const loc_param_s_type**)
+        malloc(table_length * sizeof(index->entries[0]));
+    if (NULL == index->entries) {
+        LOC_LOGE("%s: out of memory", __FUNCTION__);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < table_length; i++) {
+        if (NULL != config_table[i].param_name && NULL != config_table[i].param_ptr) {
+            index->entries[index->length++] = &config_table[i];
+        }
+    }
+    qsort(index->entries, index->length, sizeof(index->entries[0]),
+          loc_param_index_compare);
+    return 0;
+}
+
+static void loc_param_index_free(loc_param_index_type* index)
+{
+    free(index->entries);
+    index->entries = NULL;
+    index->length = 0;
+}
+
+/*===========================================================================
+FUNCTION loc_param_index_find
+
+DESCRIPTION
+   Looks a parameter name up in the index. A name may be given more than
+   once in a table; all of its entries are next to each other.
+
+PARAMETERS:
+   index: index of the configuration table
+   name: parameter name from the configuration file
+   count: set to the number of entries with this name
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   first entry with this name, NULL if there is none
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static const loc_param_s_type** loc_param_index_find(const loc_param_index_type* index,
+                                                     const char* name, uint32_t* count)
+{
+    /* lower bound, i.e. the first entry not less than name */
+    uint32_t lo = 0, hi = index->length;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (strcmp(index->entries[mid]->param_name, name) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    uint32_t first = lo;
+    while (lo < index->length && 0 == strcmp(index->entries[lo]->param_name, name)) {
+        lo++;
+    }
+    *count = lo - first;
+    return (lo > first) ? &index->entries[first] : NULL;
+}
+
+/*===========================================================================
+FUNCTION loc_parse_conf_int
+
+DESCRIPTION
+   Parses a number value, in hex if it starts with 0x, in decimal otherwise.
+
+PARAMETERS:
+   str_value: value string from the configuration file
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   the parsed value
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static int loc_parse_conf_int(const char* str_value)
+{
+    if ((str_value[0] == '0') && (tolower(str_value[1]) == 'x') &&
+        (str_value[2] != '\0'))
+    {
+        /* hex */
+        return (int) strtol(&str_value[2], (char**) NULL, 16);
+    }
+    return atoi(str_value); /* dec */
+}
+
 /*===========================================================================
 FUNCTION loc_set_config_entry
 
 DESCRIPTION
-   Potentially sets a given configuration table entry based on the passed in
-   configuration value. This is done by using a string comparison of the
-   parameter names and those found in the configuration file.
+   Sets a given configuration table entry from the configuration value
+   found for its name in the configuration file. The value string is
+   parsed as the type the entry declares.
 
 PARAMETERS:
-   config_entry: configuration entry in the table to possibly set
-   config_value: value to store in the entry if the parameter names match
+   config_entry: configuration entry in the table to set
+   config_value: value to store in the entry
 
 DEPENDENCIES
    N/A
 
 RETURN VALUE
-   None
+   0: entry set
+  -1: invalid entry
 
 SIDE EFFECTS
    N/A
 ===========================================================================*/
-int loc_set_config_entry(const loc_param_s_type* config_entry, loc_param_v_type* config_value)
+static int loc_set_config_entry(const loc_param_s_type* config_entry,
+                                const loc_param_v_type* config_value)
 {
     int ret=-1;
     if(NULL == config_entry || NULL == config_value)
@@ -101,9 +254,11 @@ int loc_set_config_entry(const loc_param_s_type* config_entry, loc_param_v_type*
         return ret;
     }
 
-    if (strcmp(config_entry->param_name, config_value->param_name) == 0 &&
-        config_entry->param_ptr)
+    if (config_entry->param_ptr)
     {
+        int int_value;
+        double double_value;
+
         switch (config_entry->param_type)
         {
         case 's':
@@ -127,10 +282,12 @@ int loc_set_config_entry(const loc_param_s_type* config_entry, loc_param_v_type*
             ret = 0;
             break;
         case 'n':
-            *((int *)config_entry->param_ptr) = config_value->param_int_value;
+            int_value = config_value->param_parsed ? config_value->param_int_value :
+                        loc_parse_conf_int(config_value->param_str_value);
+            *((int *)config_entry->param_ptr) = int_value;
             /* Log INI values */
             LOC_LOGD("%s: PARAM %s = %d", __FUNCTION__,
-                     config_entry->param_name, config_value->param_int_value);
+                     config_entry->param_name, int_value);
 
             if(NULL != config_entry->param_set)
             {
@@ -139,10 +296,12 @@ int loc_set_config_entry(const loc_param_s_type* config_entry, loc_param_v_type*
             ret = 0;
             break;
         case 'f':
-            *((double *)config_entry->param_ptr) = config_value->param_double_value;
+            double_value = config_value->param_parsed ? config_value->param_double_value :
+                           atof(config_value->param_str_value);
+            *((double *)config_entry->param_ptr) = double_value;
             /* Log INI values */
             LOC_LOGD("%s: PARAM %s = %f", __FUNCTION__,
-                     config_entry->param_name, config_value->param_double_value);
+                     config_entry->param_name, double_value);
 
             if(NULL != config_entry->param_set)
             {
@@ -158,18 +317,102 @@ int loc_set_config_entry(const loc_param_s_type* config_entry, loc_param_v_type*
     return ret;
 }
 
+/*===========================================================================
+FUNCTION loc_split_conf_item
+
+DESCRIPTION
+   Splits a line of configuration item, in place, into its parameter name
+   and value string, with leading and trailing spaces trimmed.
+
+PARAMETERS:
+   input_buf : buffer contanis config item
+   config_value: set to the name and value string found
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   1: the line has a name and a value
+   0: the line is to be skipped
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static int loc_split_conf_item(char* input_buf, loc_param_v_type* config_value)
+{
+    char *lasts;
+    char *name, *str_value;
+    memset(config_value, 0, sizeof(*config_value));
+
+    /* Separate variable and value */
+    name = strtok_r(input_buf, "=", &lasts);
+    /* skip lines that do not contain "=" */
+    if (NULL == name) {
+        return 0;
+    }
+    str_value = strtok_r(NULL, "=", &lasts);
+    /* skip lines that do not contain two operands */
+    if (NULL == str_value) {
+        return 0;
+    }
+
+    /* Trim leading and trailing spaces */
+    loc_util_trim_space(name);
+    loc_util_trim_space(str_value);
+    config_value->param_name = name;
+    config_value->param_str_value = str_value;
+    return 1;
+}
+
+/*===========================================================================
+FUNCTION loc_apply_conf_value
+
+DESCRIPTION
+   Sets the entries of a configuration table that a name and value found
+   in a configuration file go to.
+
+PARAMETERS:
+   index: name index of the configuration table, see loc_param_index_init
+   config_value: name and value found in the configuration file
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Number of records in the config_table set
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static int loc_apply_conf_value(const loc_param_index_type* index,
+                                const loc_param_v_type* config_value)
+{
+    int ret = 0;
+    uint32_t count = 0;
+    const loc_param_s_type** entries =
+        loc_param_index_find(index, config_value->param_name, &count);
+
+    /* values are only parsed for the entries they go to */
+    for(uint32_t i = 0; i < count; i++)
+    {
+        if(!loc_set_config_entry(entries[i], config_value)) {
+            ret += 1;
+        }
+    }
+    return ret;
+}
+
 /*===========================================================================
 FUNCTION loc_fill_conf_item
 
 DESCRIPTION
    Takes a line of configuration item and sets defined values based on
-   the passed in configuration table. This table maps strings to values to
-   set along with the type of each of these values.
+   the passed in configuration table index. The table maps strings to values
+   to set along with the type of each of these values.
 
 PARAMETERS:
    input_buf : buffer contanis config item
-   config_table: table definition of strings to places to store information
-   table_length: length of the configuration table
+   index: name index of the configuration table, see loc_param_index_init
 
 DEPENDENCIES
    N/A
@@ -180,50 +423,14 @@ RETURN VALUE
 SIDE EFFECTS
    N/A
 ===========================================================================*/
-int loc_fill_conf_item(char* input_buf,
-                       const loc_param_s_type* config_table, uint32_t table_length)
+static int loc_fill_conf_item(char* input_buf, const loc_param_index_type* index)
 {
     int ret = 0;
+    loc_param_v_type config_value;
 
-    if (input_buf && config_table) {
-        char *lasts;
-        loc_param_v_type config_value;
-        memset(&config_value, 0, sizeof(config_value));
-
-        /* Separate variable and value */
-        config_value.param_name = strtok_r(input_buf, "=", &lasts);
-        /* skip lines that do not contain "=" */
-        if (config_value.param_name) {
-            config_value.param_str_value = strtok_r(NULL, "=", &lasts);
-
-            /* skip lines that do not contain two operands */
-            if (config_value.param_str_value) {
-                /* Trim leading and trailing spaces */
-                loc_util_trim_space(config_value.param_name);
-                loc_util_trim_space(config_value.param_str_value);
-
-                /* Parse numerical value */
-                if ((strlen(config_value.param_str_value) >=3) &&
-                    (config_value.param_str_value[0] == '0') &&
-                    (tolower(config_value.param_str_value[1]) == 'x'))
-                {
-                    /* hex */
-                    config_value.param_int_value = (int) strtol(&config_value.param_str_value[2],
-                                                                (char**) NULL, 16);
-                }
-                else {
-                    config_value.param_double_value = (double) atof(config_value.param_str_value); /* float */
-                    config_value.param_int_value = atoi(config_value.param_str_value); /* dec */
-                }
-
-                for(uint32_t i = 0; NULL != config_table && i < table_length; i++)
-                {
-                    if(!loc_set_config_entry(&config_table[i], &config_value)) {
-                        ret += 1;
-                    }
-                }
-            }
-        }
+    if (input_buf && index->length &&
+        loc_split_conf_item(input_buf, &config_value)) {
+        ret = loc_apply_conf_value(index, &config_value);
     }
 
     return ret;
@@ -279,6 +486,11 @@ int loc_read_conf_r(FILE *conf_fp, const loc_param_s_type* config_table, uint32_
     }
 
     char input_buf[LOC_MAX_PARAM_LINE];  /* declare a char array */
+    loc_param_index_type index;
+    if (loc_param_index_init(&index, config_table, table_length)) {
+        ret = -1;
+        goto err;
+    }
 
     LOC_LOGD("%s:%d]: num_params: %d\n", __func__, __LINE__, num_params);
     while(num_params)
@@ -288,8 +500,9 @@ int loc_read_conf_r(FILE *conf_fp, const loc_param_s_type* config_table, uint32_
             break;
         }
 
-        num_params -= loc_fill_conf_item(input_buf, config_table, table_length);
+        num_params -= loc_fill_conf_item(input_buf, &index);
     }
+    loc_param_index_free(&index);
 
 err:
     return ret;
@@ -329,8 +542,10 @@ int loc_update_conf(const char* conf_data, int32_t length,
     if (conf_data && length && config_table && table_length) {
         // make a copy, so we do not tokenize the original data
         char* conf_copy = (char*)malloc(length+1);
+        loc_param_index_type index;
 
-        if (conf_copy != NULL)
+        if (conf_copy != NULL &&
+            0 == loc_param_index_init(&index, config_table, table_length))
         {
             memcpy(conf_copy, conf_data, length);
             // we hard NULL the end of string to be safe
@@ -345,16 +560,341 @@ int loc_update_conf(const char* conf_data, int32_t length,
             LOC_LOGD("%s:%d]: num_params: %d\n", __func__, __LINE__, num_params);
             while(num_params && input_buf) {
                 ret++;
-                num_params -= loc_fill_conf_item(input_buf, config_table, table_length);
+                num_params -= loc_fill_conf_item(input_buf, &index);
                 input_buf = strtok_r(NULL, "\n", &saveptr);
             }
-            free(conf_copy);
+            loc_param_index_free(&index);
         }
+        free(conf_copy);
     }
 
     return ret;
 }
 
+/*=============================================================================
+ *
+ *                        PARSED CONFIG SNAPSHOTS
+ *
+ * loc_read_conf() keeps what it parses out of a conf file in a snapshot
+ * file, and on later reads maps the snapshot and applies it, as long as the
+ * conf file has the same inode, size and mtime it was taken from. A snapshot
+ * holds every name = value line of the file in order, each value parsed as
+ * both number and float, so that applying it is the same walk over the lines
+ * loc_read_conf_r() does, without reading or tokenizing any text.
+ *
+ *============================================================================*/
+
+#ifndef LOC_CFG_SNAPSHOT_DIR
+#define LOC_CFG_SNAPSHOT_DIR "/data/misc/location/"
+#endif
+#define LOC_CFG_SNAPSHOT_MAGIC    0x4c434653 /* "LCFS" */
+#define LOC_CFG_SNAPSHOT_VERSION  1
+#define LOC_CFG_SNAPSHOT_PATH_LEN 128
+
+static const char* loc_cfg_snapshot_dir = LOC_CFG_SNAPSHOT_DIR;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    /* of the conf file the snapshot was taken from */
+    uint64_t src_ino;
+    uint64_t src_size;
+    int64_t  src_mtime;
+    char     src_path[LOC_CFG_SNAPSHOT_PATH_LEN];
+    uint32_t rec_count;
+    /* bytes of NUL terminated names and values, after the records */
+    uint32_t pool_size;
+} loc_cfg_snapshot_hdr;
+
+typedef struct
+{
+    uint32_t name_off;
+    uint32_t str_off;
+    int32_t  int_value;
+    uint32_t reserved;
+    double   double_value;
+} loc_cfg_snapshot_rec;
+
+/*===========================================================================
+FUNCTION loc_cfg_snapshot_path
+
+DESCRIPTION
+   Names the snapshot of a conf file, after its path with '/' as '_', e.g.
+   /etc/gps.conf goes to LOC_CFG_SNAPSHOT_DIR/loc_cfg_etc_gps.conf.snap
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   0: success
+  -1: path too long
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static int loc_cfg_snapshot_path(const char* conf_file_name, char* path, size_t size)
+{
+    int len = snprintf(path, size, "%sloc_cfg%s%s.snap", loc_cfg_snapshot_dir,
+                       ('/' == conf_file_name[0]) ? "" : "_", conf_file_name);
+    if (len < 0 || (size_t)len >= size) {
+        return -1;
+    }
+    for (char* c = path + strlen(loc_cfg_snapshot_dir); *c; c++) {
+        if ('/' == *c) {
+            *c = '_';
+        }
+    }
+    return 0;
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_snapshot_valid
+
+DESCRIPTION
+   Checks that a snapshot is well formed and was taken from the conf file
+   as it is now.
+
+PARAMETERS:
+   data, size: the snapshot
+   conf_file_name: path of the conf file
+   st: stat of the conf file
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   1: valid
+   0: stale or corrupt
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static int loc_cfg_snapshot_valid(const void* data, size_t size,
+                                  const char* conf_file_name, const struct stat* st)
+{
+    const loc_cfg_snapshot_hdr* hdr = (const loc_cfg_snapshot_hdr*)data;
+
+    if (size < sizeof(*hdr) ||
+        LOC_CFG_SNAPSHOT_MAGIC != hdr->magic ||
+        LOC_CFG_SNAPSHOT_VERSION != hdr->version ||
+        (uint64_t)st->st_ino != hdr->src_ino ||
+        (uint64_t)st->st_size != hdr->src_size ||
+        (int64_t)st->st_mtime != hdr->src_mtime ||
+        strncmp(hdr->src_path, conf_file_name, sizeof(hdr->src_path)) ||
+        0 == hdr->pool_size ||
+        (uint64_t)size != sizeof(*hdr) +
+                          (uint64_t)hdr->rec_count * sizeof(loc_cfg_snapshot_rec) +
+                          hdr->pool_size) {
+        return 0;
+    }
+
+    /* every string must end inside the pool */
+    const loc_cfg_snapshot_rec* recs = (const loc_cfg_snapshot_rec*)(hdr + 1);
+    const char* pool = (const char*)(recs + hdr->rec_count);
+    if ('\0' != pool[hdr->pool_size - 1]) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < hdr->rec_count; i++) {
+        if (recs[i].name_off >= hdr->pool_size || recs[i].str_off >= hdr->pool_size) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_snapshot_build
+
+DESCRIPTION
+   Reads a conf file, line by line as loc_read_conf_r() does, into a
+   snapshot. Commented out lines are left out, as no parameter has a
+   name that starts with '#'.
+
+PARAMETERS:
+   conf_fp: the conf file, at its beginning
+   conf_file_name: path of the conf file
+   st: stat of the conf file
+   size: set to the size of the snapshot
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   the snapshot, to be free()'d; NULL if out of memory
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static void* loc_cfg_snapshot_build(FILE* conf_fp, const char* conf_file_name,
+                                    const struct stat* st, size_t* size)
+{
+    char input_buf[LOC_MAX_PARAM_LINE];
+    loc_param_v_type config_value;
+    loc_cfg_snapshot_rec* recs = NULL;
+    char* pool = NULL;
+    uint32_t rec_count = 0, rec_max = 0, pool_size = 0, pool_max = 0;
+    char* data = NULL;
+
+    while (fgets(input_buf, LOC_MAX_PARAM_LINE, conf_fp)) {
+        if (!loc_split_conf_item(input_buf, &config_value) ||
+            '#' == config_value.param_name[0]) {
+            continue;
+        }
+
+        uint32_t name_len = strlen(config_value.param_name) + 1;
+        uint32_t str_len = strlen(config_value.param_str_value) + 1;
+        if (rec_count == rec_max) {
+            rec_max = rec_max ? rec_max * 2 : 32;
+            void* grown = realloc(recs, rec_max * sizeof(recs[0]));
+            if (NULL == grown) {
+                goto err;
+            }
+            recs = (loc_cfg_snapshot_rec*)grown;
+        }
+        if (pool_size + name_len + str_len > pool_max) {
+            pool_max = (pool_max ? pool_max * 2 : 1024) + name_len + str_len;
+            void* grown = realloc(pool, pool_max);
+            if (NULL == grown) {
+                goto err;
+            }
+            pool = (char*)grown;
+        }
+
+        loc_cfg_snapshot_rec* rec = &recs[rec_count++];
+        rec->name_off = pool_size;
+        memcpy(pool + pool_size, config_value.param_name, name_len);
+        pool_size += name_len;
+        rec->str_off = pool_size;
+        memcpy(pool + pool_size, config_value.param_str_value, str_len);
+        pool_size += str_len;
+        rec->int_value = loc_parse_conf_int(config_value.param_str_value);
+        rec->reserved = 0;
+        rec->double_value = atof(config_value.param_str_value);
+    }
+
+    /* keep the pool non-empty, so that it always ends with a NUL */
+    if (0 == pool_size) {
+        pool = (char*)calloc(1, 1);
+        if (NULL == pool) {
+            goto err;
+        }
+        pool_size = 1;
+    }
+
+    *size = sizeof(loc_cfg_snapshot_hdr) + rec_count * sizeof(recs[0]) + pool_size;
+    data = (char*)malloc(*size);
+    if (NULL != data) {
+        loc_cfg_snapshot_hdr* hdr = (loc_cfg_snapshot_hdr*)data;
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->magic = LOC_CFG_SNAPSHOT_MAGIC;
+        hdr->version = LOC_CFG_SNAPSHOT_VERSION;
+        hdr->src_ino = st->st_ino;
+        hdr->src_size = st->st_size;
+        hdr->src_mtime = st->st_mtime;
+        strlcpy(hdr->src_path, conf_file_name, sizeof(hdr->src_path));
+        hdr->rec_count = rec_count;
+        hdr->pool_size = pool_size;
+        if (rec_count) {
+            memcpy(hdr + 1, recs, rec_count * sizeof(recs[0]));
+        }
+        memcpy(data + sizeof(*hdr) + rec_count * sizeof(recs[0]), pool, pool_size);
+    }
+
+err:
+    if (NULL == data) {
+        LOC_LOGE("%s: out of memory", __FUNCTION__);
+    }
+    free(recs);
+    free(pool);
+    return data;
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_snapshot_write
+
+DESCRIPTION
+   Writes a snapshot out, into a temporary file renamed over the snapshot
+   path, so that readers in other processes never map half of one.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static void loc_cfg_snapshot_write(const char* path, const void* data, size_t size)
+{
+    char tmp_path[LOC_CFG_SNAPSHOT_PATH_LEN + 32];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", path, (int)getpid());
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOC_LOGD("%s: can not create %s, errno %d", __FUNCTION__, tmp_path, errno);
+        return;
+    }
+    ssize_t written = write(fd, data, size);
+    close(fd);
+
+    if (written != (ssize_t)size || rename(tmp_path, path)) {
+        LOC_LOGW("%s: can not write %s, errno %d", __FUNCTION__, path, errno);
+        unlink(tmp_path);
+    }
+}
+
+/*===========================================================================
+FUNCTION loc_cfg_snapshot_apply
+
+DESCRIPTION
+   Sets a configuration table from a snapshot, the way loc_read_conf_r()
+   sets it from the lines of the conf file.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+static void loc_cfg_snapshot_apply(const void* data, const loc_param_s_type* config_table,
+                                   uint32_t table_length)
+{
+    const loc_cfg_snapshot_hdr* hdr = (const loc_cfg_snapshot_hdr*)data;
+    const loc_cfg_snapshot_rec* recs = (const loc_cfg_snapshot_rec*)(hdr + 1);
+    const char* pool = (const char*)(recs + hdr->rec_count);
+    unsigned int num_params = table_length;
+    loc_param_index_type index;
+    loc_param_v_type config_value;
+
+    /* Clear all validity bits */
+    for(uint32_t i = 0; NULL != config_table && i < table_length; i++)
+    {
+        if(NULL != config_table[i].param_set)
+        {
+            *(config_table[i].param_set) = 0;
+        }
+    }
+
+    if (loc_param_index_init(&index, config_table, table_length)) {
+        return;
+    }
+
+    config_value.param_parsed = 1;
+    for (uint32_t i = 0; num_params && index.length && i < hdr->rec_count; i++) {
+        config_value.param_name = pool + recs[i].name_off;
+        config_value.param_str_value = pool + recs[i].str_off;
+        config_value.param_int_value = recs[i].int_value;
+        config_value.param_double_value = recs[i].double_value;
+        num_params -= loc_apply_conf_value(&index, &config_value);
+    }
+    loc_param_index_free(&index);
+}
+
 /*===========================================================================
 FUNCTION loc_read_conf
 
@@ -362,11 +902,15 @@ DESCRIPTION
    Reads the specified configuration file and sets defined values based on
    the passed in configuration table. This table maps strings to values to
    set along with the type of each of these values.
+   The values come from the snapshot of the file, if it is current and
+   use_snapshot is set, or else from the text of the file, of which a new
+   snapshot is then taken.
 
 PARAMETERS:
    conf_file_name: configuration file to read
    config_table: table definition of strings to places to store information
    table_length: length of the configuration table
+   use_snapshot: whether the snapshot may be used
 
 DEPENDENCIES
    N/A
@@ -375,26 +919,273 @@ RETURN VALUE
    None
 
 SIDE EFFECTS
-   N/A
+   Writes the snapshot of the file into LOC_CFG_SNAPSHOT_DIR
 ===========================================================================*/
-void loc_read_conf(const char* conf_file_name, const loc_param_s_type* config_table,
-                   uint32_t table_length)
+static void loc_read_conf_snapshot(const char* conf_file_name,
+                                   const loc_param_s_type* config_table,
+                                   uint32_t table_length, int use_snapshot)
 {
     FILE *conf_fp = NULL;
-    char *lasts;
-    loc_param_v_type config_value;
-    uint32_t i;
+    struct stat st;
+    char snapshot_path[LOC_CFG_SNAPSHOT_PATH_LEN];
+    int has_path = 0;
+    void* snapshot = NULL;
+    size_t snapshot_size = 0;
+    int mapped = 0;
 
-    if((conf_fp = fopen(conf_file_name, "r")) != NULL)
+    if (0 == stat(conf_file_name, &st) &&
+        0 == loc_cfg_snapshot_path(conf_file_name, snapshot_path, sizeof(snapshot_path)))
+    {
+        has_path = 1;
+        int fd = use_snapshot ? open(snapshot_path, O_RDONLY) : -1;
+        if (fd >= 0) {
+            struct stat snapshot_st;
+            if (0 == fstat(fd, &snapshot_st) && snapshot_st.st_size > 0) {
+                snapshot_size = snapshot_st.st_size;
+                snapshot = mmap(NULL, snapshot_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (MAP_FAILED == snapshot) {
+                    snapshot = NULL;
+                } else if (loc_cfg_snapshot_valid(snapshot, snapshot_size,
+                                                  conf_file_name, &st)) {
+                    mapped = 1;
+                } else {
+                    munmap(snapshot, snapshot_size);
+                    snapshot = NULL;
+                }
+            }
+            close(fd);
+        }
+    }
+
+    /* stale or no snapshot, take one from the text */
+    if (!mapped && (conf_fp = fopen(conf_file_name, "r")) != NULL)
+    {
+        if (0 == fstat(fileno(conf_fp), &st)) {
+            snapshot = loc_cfg_snapshot_build(conf_fp, conf_file_name, &st, &snapshot_size);
+        }
+        if (snapshot && has_path) {
+            loc_cfg_snapshot_write(snapshot_path, snapshot, snapshot_size);
+        }
+    }
+
+    if (snapshot)
+    {
+        LOC_LOGD("%s: using %s%s", __FUNCTION__, conf_file_name,
+                 mapped ? " snapshot" : "");
+        if(table_length && config_table) {
+            loc_cfg_snapshot_apply(snapshot, config_table, table_length);
+        }
+        loc_cfg_snapshot_apply(snapshot, loc_param_table, loc_param_num);
+        if (mapped) {
+            munmap(snapshot, snapshot_size);
+        } else {
+            free(snapshot);
+        }
+    }
+    else if (conf_fp != NULL)
     {
         LOC_LOGD("%s: using %s", __FUNCTION__, conf_file_name);
+        rewind(conf_fp);
         if(table_length && config_table) {
             loc_read_conf_r(conf_fp, config_table, table_length);
             rewind(conf_fp);
         }
         loc_read_conf_r(conf_fp, loc_param_table, loc_param_num);
+    }
+
+    if (conf_fp != NULL) {
         fclose(conf_fp);
     }
     /* Initialize logging mechanism with parsed data */
-    loc_logger_init(DEBUG_LEVEL, TIMESTAMP);
+    loc_logger_init(DEBUG_LEVEL, TIMESTAMP, ASYNC_LOGGING);
+}
+
+/*===========================================================================
+FUNCTION loc_read_conf
+
+DESCRIPTION
+   Reads the specified configuration file and sets defined values based on
+   the passed in configuration table. This table maps strings to values to
+   set along with the type of each of these values.
+   The values come from the snapshot of the file, if it is current.
+
+PARAMETERS:
+   conf_file_name: configuration file to read
+   config_table: table definition of strings to places to store information
+   table_length: length of the configuration table
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+void loc_read_conf(const char* conf_file_name, const loc_param_s_type* config_table,
+                   uint32_t table_length)
+{
+    loc_read_conf_snapshot(conf_file_name, config_table, table_length, 1);
+}
+
+/*===========================================================================
+FUNCTION loc_reload_conf
+
+DESCRIPTION
+   Same as loc_read_conf, except that the text of the file is always read,
+   for a file just seen to change. Its snapshot may not tell the change,
+   e.g. if the file was written in place, in the same second, to the same
+   size.
+
+PARAMETERS:
+   conf_file_name: configuration file to read
+   config_table: table definition of strings to places to store information
+   table_length: length of the configuration table
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+void loc_reload_conf(const char* conf_file_name, const loc_param_s_type* config_table,
+                     uint32_t table_length)
+{
+    loc_read_conf_snapshot(conf_file_name, config_table, table_length, 0);
 }
+
+#ifdef __LOC_DEBUG__
+
+/* Startup benchmark: reads each conf file into a table with an entry for
+   every parameter the file sets, as the HAL does with its own tables at
+   start, and reports the time loc_read_conf() takes per file:
+     cold: no snapshot yet, the text is parsed and a snapshot written
+     warm: the snapshot is current and mapped
+   It also checks that the values from the snapshot are those that
+   loc_read_conf_r() gets from the text.
+   The type of each entry is taken from the look of its value. */
+typedef struct
+{
+    char name[LOC_MAX_PARAM_NAME];
+    char value[LOC_MAX_PARAM_STRING + 1];
+    uint8_t set;
+} loc_cfg_test_param;
+
+static uint32_t loc_cfg_test_table(const char* file_name, loc_param_s_type* table,
+                                   loc_cfg_test_param* params, uint32_t max)
+{
+    uint32_t count = 0;
+    char line[LOC_MAX_PARAM_LINE];
+    FILE* fp = fopen(file_name, "r");
+
+    while (fp && count < max && fgets(line, sizeof(line), fp)) {
+        char *lasts;
+        char* name = strtok_r(line, "=", &lasts);
+        char* value = name ? strtok_r(NULL, "=", &lasts) : NULL;
+        if (NULL == value) {
+            continue;
+        }
+        loc_util_trim_space(name);
+        loc_util_trim_space(value);
+        if ('#' == name[0]) {
+            continue;
+        }
+        strlcpy(params[count].name, name, sizeof(params[count].name));
+        table[count].param_name = params[count].name;
+        table[count].param_ptr = params[count].value;
+        memset(params[count].value, 0, sizeof(params[count].value));
+        table[count].param_set = &params[count].set;
+        table[count].param_type = isdigit(value[0]) || '-' == value[0] ?
+            (strchr(value, '.') ? 'f' : 'n') : 's';
+        count++;
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    return count;
+}
+
+static double loc_cfg_test_us(const struct timespec* start, const struct timespec* end,
+                              int iterations)
+{
+    return ((end->tv_sec - start->tv_sec) * 1e6 +
+            (end->tv_nsec - start->tv_nsec) / 1e3) / iterations;
+}
+
+// on linux command line:
+// compile: g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -g -O2 -I. -Iplatform_lib_abstractions loc_cfg.cpp loc_log.cpp loc_log_async.cpp LocThread.cpp loc_misc_utils.cpp platform_lib_abstractions/elapsed_millis_since_boot.cpp -lpthread
+// run: ./a.out [iterations] [conf files ...], by default the files in ../etc;
+//      snapshots go to /tmp
+int main(int argc, char** argv)
+{
+    static const char* default_files[] = {
+        "../etc/gps.conf", "../etc/izat.conf", "../etc/sap.conf", "../etc/flp.conf"
+    };
+    int iterations = argc > 1 ? atoi(argv[1]) : 1000;
+    const char** files = argc > 2 ? (const char**)&argv[2] : default_files;
+    int file_count = argc > 2 ? argc - 2 :
+        (int)(sizeof(default_files) / sizeof(default_files[0]));
+    static loc_param_s_type table[256];
+    static loc_cfg_test_param params[256];
+    static loc_cfg_test_param text_params[256];
+    char snapshot_path[LOC_CFG_SNAPSHOT_PATH_LEN];
+    int failures = 0;
+    double total_cold_us = 0, total_warm_us = 0;
+
+    loc_cfg_snapshot_dir = "/tmp/";
+    for (int f = 0; f < file_count; f++) {
+        uint32_t length = loc_cfg_test_table(files[f], table, params, 256);
+        struct timespec start, end;
+
+        /* reference values, from the text */
+        FILE* fp = fopen(files[f], "r");
+        if (fp) {
+            loc_read_conf_r(fp, table, length);
+            fclose(fp);
+        }
+        memcpy(text_params, params, sizeof(params));
+
+        loc_cfg_snapshot_path(files[f], snapshot_path, sizeof(snapshot_path));
+        double cold_us = 0;
+        for (int i = 0; i < iterations; i++) {
+            unlink(snapshot_path);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            loc_read_conf(files[f], table, length);
+            clock_gettime(CLOCK_MONOTONIC, &end);
+            cold_us += loc_cfg_test_us(&start, &end, iterations);
+        }
+
+        for (uint32_t i = 0; i < length; i++) {
+            memset(params[i].value, 0, sizeof(params[i].value));
+            params[i].set = 0;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int i = 0; i < iterations; i++) {
+            loc_read_conf(files[f], table, length);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double warm_us = loc_cfg_test_us(&start, &end, iterations);
+
+        uint32_t set = 0;
+        int same = (0 == memcmp(params, text_params, sizeof(params)));
+        for (uint32_t i = 0; i < length; i++) {
+            set += params[i].set;
+        }
+        total_cold_us += cold_us;
+        total_warm_us += warm_us;
+        printf("%-20s %3u params, %3u set, %s, cold %8.1f us, warm %8.1f us\n",
+               files[f], length, set, same ? "same as text" : "DIFFERENT",
+               cold_us, warm_us);
+        failures += (set != length) || !same;
+        unlink(snapshot_path);
+    }
+    printf("%-20s cold %8.1f us, warm %8.1f us\n", "total",
+           total_cold_us, total_warm_us);
+    return failures ? 1 : 0;
+}
+
+#endif
@@ -47,6 +47,9 @@
 #define UTIL_READ_CONF(filename, config_table) \
     loc_read_conf((filename), (config_table), sizeof(config_table) / sizeof(config_table[0]))
 
+#define UTIL_RELOAD_CONF(filename, config_table) \
+    loc_reload_conf((filename), (config_table), sizeof(config_table) / sizeof(config_table[0]))
+
 /*=============================================================================
  *
  *                        MODULE TYPE DECLARATION
@@ -80,6 +83,9 @@ extern "C" {
 void loc_read_conf(const char* conf_file_name,
                    const loc_param_s_type* config_table,
                    uint32_t table_length);
+void loc_reload_conf(const char* conf_file_name,
+                     const loc_param_s_type* config_table,
+                     uint32_t table_length);
 int loc_read_conf_r(FILE *conf_fp, const loc_param_s_type* config_table,
                     uint32_t table_length);
 int loc_update_conf(const char* conf_data, int32_t length,
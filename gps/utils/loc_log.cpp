@@ -189,7 +189,7 @@ char *loc_get_time(char *time_string, size_t buf_size)
 FUNCTION loc_logger_init
 
 DESCRIPTION
-   Initializes the state of DEBUG_LEVEL and TIMESTAMP
+   Initializes the state of DEBUG_LEVEL, TIMESTAMP and ASYNC
 
 DEPENDENCIES
    N/A
@@ -200,7 +200,8 @@ RETURN VALUE
 SIDE EFFECTS
    N/A
 ===========================================================================*/
-void loc_logger_init(unsigned long debug, unsigned long timestamp)
+void loc_logger_init(unsigned long debug, unsigned long timestamp,
+                     unsigned long async)
 {
    loc_logger.DEBUG_LEVEL = debug;
 #ifdef TARGET_BUILD_VARIANT_USER
@@ -210,6 +211,11 @@ void loc_logger_init(unsigned long debug, unsigned long timestamp)
    }
 #endif
    loc_logger.TIMESTAMP   = timestamp;
+   if (loc_logger.ASYNC && !async) {
+       /* lines captured so far come out before the sync ones */
+       loc_log_async_flush();
+   }
+   loc_logger.ASYNC       = async;
 }
 
 
@@ -0,0 +1,682 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *     * Neither the name of The Linux Foundation, nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#define LOG_NDDEBUG 0
+#define LOG_TAG "LocSvc_LogAsync"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <LocThread.h>
+#include <log_util.h>
+#ifndef USE_GLIB
+#include <android/log.h>
+#endif /* USE_GLIB */
+
+/* every thread that logs asynchronously owns one ring; a single drainer
+   thread formats and writes out the records of all rings, in time order */
+#define LOC_LOG_RING_SIZE   (16 * 1024)     /* power of 2 */
+#define LOC_LOG_MAX_RECORD  1024            /* header and args */
+#define LOC_LOG_MAX_STR     256             /* %s args are cut to this */
+#define LOC_LOG_MAX_LINE    1024
+#define LOC_LOG_DRAIN_MS    50
+#define LOC_LOG_ALIGN(n)    (((n) + 7) & ~7)
+
+// raw record as the logging thread captured it. args follow the header,
+// one 8 byte slot per int, double or pointer; a string is a 4 byte length
+// followed by the chars, padded to 8. There is no type info, the drainer
+// walks fmt again the same way to know what comes next.
+struct LocLogRecord {
+    uint32_t size;      // header and args, a multiple of 8
+    uint16_t prio;      // 0 pads up to the end of the ring
+    uint16_t convs;     // conversions captured, fewer than fmt has if cut
+    const char* tag;
+    const char* fmt;
+    uint64_t ts;        // CLOCK_MONOTONIC, in ns
+};
+
+struct LocLogRing {
+    uint32_t mHead;                             // owner thread only
+    uint32_t mTail __attribute__((aligned(64)));// drainer only
+    uint32_t mLimit;                            // head, as of this drain
+    uint32_t mDropped;                          // owner, read by drainer
+    uint32_t mReported;                         // drainer
+    int mExited;
+    pid_t mTid;
+    LocLogRing* mNext;
+    char mBuf[LOC_LOG_RING_SIZE] __attribute__((aligned(8)));
+};
+
+// one conversion spec of a printf format
+struct LocLogConv {
+    const char* start;  // at the '%'
+    const char* end;    // past the conversion char
+    int stars;          // '*' width and / or precision, an int arg each
+    char length;        // 'H' for hh, 'h', 'l', 'q' for ll, 'j', 'z', 't', 'L' or 0
+    char conv;
+};
+
+enum { LOC_LOG_ARG_NONE, LOC_LOG_ARG_INT, LOC_LOG_ARG_DOUBLE,
+       LOC_LOG_ARG_STR, LOC_LOG_ARG_PTR, LOC_LOG_ARG_SKIP };
+
+static pthread_once_t sOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t sRingKey;
+// guards the ring list and serializes the drain passes
+static pthread_mutex_t sLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sCond = PTHREAD_COND_INITIALIZER;
+static LocLogRing* sRings = NULL;
+static LocThread* sDrainThread = NULL;
+
+static uint64_t loc_log_now_ns(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// finds the next conversion at or after fmt, NULL if there is none.
+// "%%" counts as a conversion that takes no arg.
+static const char* loc_log_next_conv(const char* fmt, LocLogConv& c)
+{
+    const char* p = strchr(fmt, '%');
+    if (NULL == p) {
+        return NULL;
+    }
+    c.start = p++;
+    c.stars = 0;
+    c.length = 0;
+    while (*p && NULL != strchr("-+ #0'", *p)) p++;
+    if ('*' == *p) {
+        c.stars++;
+        p++;
+    } else {
+        while (isdigit(*p)) p++;
+    }
+    if ('.' == *p) {
+        p++;
+        if ('*' == *p) {
+            c.stars++;
+            p++;
+        } else {
+            while (isdigit(*p)) p++;
+        }
+    }
+    switch (*p) {
+    case 'h':
+        c.length = ('h' == *++p) ? (p++, 'H') : 'h';
+        break;
+    case 'l':
+        c.length = ('l' == *++p) ? (p++, 'q') : 'l';
+        break;
+    case 'q': case 'j': case 'z': case 't': case 'L':
+        c.length = *p++;
+        break;
+    }
+    c.conv = *p;
+    c.end = *p ? p + 1 : p;
+    return c.start;
+}
+
+static int loc_log_arg_kind(char conv)
+{
+    switch (conv) {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+        return LOC_LOG_ARG_INT;
+    case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        return LOC_LOG_ARG_DOUBLE;
+    case 's':
+        return LOC_LOG_ARG_STR;
+    case 'p':
+        return LOC_LOG_ARG_PTR;
+    case 'n':
+        // the pointer is taken off the args but never written through
+        return LOC_LOG_ARG_SKIP;
+    default:
+        return LOC_LOG_ARG_NONE;
+    }
+}
+
+static void loc_log_ring_exit(void* ring)
+{
+    __atomic_store_n(&((LocLogRing*)ring)->mExited, 1, __ATOMIC_RELEASE);
+}
+
+// sets the drainer to a low priority, unless LocThread::setSched says otherwise
+class LocLogDrainer : public LocRunnable {
+public:
+    inline virtual void prerun() { setpriority(PRIO_PROCESS, 0, 10); }
+    virtual bool run();
+};
+
+static void loc_log_async_init()
+{
+    pthread_key_create(&sRingKey, loc_log_ring_exit);
+    sDrainThread = new LocThread();
+    if (!sDrainThread->start("LocLogDrain", new LocLogDrainer(), false)) {
+        delete sDrainThread;
+        sDrainThread = NULL;
+    }
+    atexit(loc_log_async_flush);
+}
+
+static LocLogRing* loc_log_get_ring()
+{
+    pthread_once(&sOnce, loc_log_async_init);
+    LocLogRing* ring = (LocLogRing*)pthread_getspecific(sRingKey);
+    if (NULL == ring) {
+        ring = (LocLogRing*)calloc(1, sizeof(LocLogRing));
+        if (NULL != ring) {
+            ring->mTid = gettid();
+            pthread_setspecific(sRingKey, ring);
+            pthread_mutex_lock(&sLock);
+            ring->mNext = sRings;
+            sRings = ring;
+            pthread_mutex_unlock(&sLock);
+        }
+    }
+    return ring;
+}
+
+static void loc_log_ring_put(LocLogRing* ring, const LocLogRecord* rec)
+{
+    uint32_t head = ring->mHead;
+    uint32_t tail = __atomic_load_n(&ring->mTail, __ATOMIC_ACQUIRE);
+    uint32_t offset = head & (LOC_LOG_RING_SIZE - 1);
+    // a record never wraps; pad to the end of the ring instead
+    uint32_t pad = (offset + rec->size > LOC_LOG_RING_SIZE) ?
+        LOC_LOG_RING_SIZE - offset : 0;
+
+    if (head - tail + pad + rec->size > LOC_LOG_RING_SIZE) {
+        __atomic_store_n(&ring->mDropped, ring->mDropped + 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (pad) {
+        LocLogRecord* padRec = (LocLogRecord*)(ring->mBuf + offset);
+        padRec->size = pad;
+        padRec->prio = 0;
+        offset = 0;
+    }
+    memcpy(ring->mBuf + offset, rec, rec->size);
+    __atomic_store_n(&ring->mHead, head + pad + rec->size, __ATOMIC_RELEASE);
+
+    // wake the drainer up early only as the ring crosses half full
+    if (head - tail <= LOC_LOG_RING_SIZE / 2 &&
+        head + pad + rec->size - tail > LOC_LOG_RING_SIZE / 2) {
+        pthread_cond_signal(&sCond);
+    }
+}
+
+// serializes a log line into rec, which is size bytes
+static void loc_log_capture(LocLogRecord* rec, size_t size, int prio,
+                            const char* tag, const char* fmt, va_list ap)
+{
+    char* arg = (char*)(rec + 1);
+    char* const end = (char*)rec + size;
+    rec->prio = prio;
+    rec->convs = 0;
+    rec->tag = tag;
+    rec->fmt = fmt;
+    rec->ts = loc_log_now_ns(CLOCK_MONOTONIC);
+
+    LocLogConv c;
+    for (const char* f = fmt; NULL != loc_log_next_conv(f, c); f = c.end) {
+        int kind = loc_log_arg_kind(c.conv);
+        // largest arg slot, a string is sized below
+        if (arg + (c.stars + 1) * sizeof(uint64_t) > end) {
+            break;
+        }
+        for (int i = 0; i < c.stars; i++) {
+            *(int64_t*)arg = va_arg(ap, int);
+            arg += sizeof(int64_t);
+        }
+        if (LOC_LOG_ARG_INT == kind) {
+            int64_t v;
+            bool isSigned = ('d' == c.conv || 'i' == c.conv);
+            switch (c.length) {
+            case 'l': v = isSigned ? (int64_t)va_arg(ap, long) :
+                                     (int64_t)va_arg(ap, unsigned long); break;
+            case 'q': v = va_arg(ap, long long); break;
+            case 'j': v = va_arg(ap, intmax_t); break;
+            case 'z': v = isSigned ? (int64_t)va_arg(ap, ssize_t) :
+                                     (int64_t)va_arg(ap, size_t); break;
+            case 't': v = va_arg(ap, ptrdiff_t); break;
+            default:  v = isSigned ? (int64_t)va_arg(ap, int) :
+                                     (int64_t)va_arg(ap, unsigned int); break;
+            }
+            *(int64_t*)arg = v;
+            arg += sizeof(int64_t);
+        } else if (LOC_LOG_ARG_DOUBLE == kind) {
+            *(double*)arg = ('L' == c.length) ?
+                (double)va_arg(ap, long double) : va_arg(ap, double);
+            arg += sizeof(double);
+        } else if (LOC_LOG_ARG_PTR == kind || LOC_LOG_ARG_SKIP == kind) {
+            *(uint64_t*)arg = (uintptr_t)va_arg(ap, void*);
+            arg += sizeof(uint64_t);
+        } else if (LOC_LOG_ARG_STR == kind) {
+            const char* s = va_arg(ap, const char*);
+            uint32_t len = (NULL == s) ? 0 : strnlen(s, LOC_LOG_MAX_STR);
+            if (arg + LOC_LOG_ALIGN(sizeof(uint32_t) + len + 1) > end) {
+                break;
+            }
+            // UINT32_MAX stands for a NULL string
+            *(uint32_t*)arg = (NULL == s) ? UINT32_MAX : len;
+            memcpy(arg + sizeof(uint32_t), s, len);
+            arg[sizeof(uint32_t) + len] = '\0';
+            arg += LOC_LOG_ALIGN(sizeof(uint32_t) + len + 1);
+        }
+        rec->convs++;
+    }
+    rec->size = arg - (char*)rec;
+}
+
+/*===========================================================================
+FUNCTION loc_log_async
+
+DESCRIPTION
+   Captures a log line into the calling thread's ring, to be formatted and
+   written out later by the drainer thread. Only the tag and fmt pointers,
+   a timestamp and the raw args are copied; %s args are copied too, and cut
+   to LOC_LOG_MAX_STR chars. tag and fmt must stay valid for the life of the
+   process, as string literals do.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   The line is dropped, and counted, if the ring is full
+===========================================================================*/
+void loc_log_async(int prio, const char* tag, const char* fmt, ...)
+{
+    LocLogRing* ring = loc_log_get_ring();
+    if (NULL == ring || NULL == fmt) {
+        return;
+    }
+
+    uint64_t scratch[LOC_LOG_MAX_RECORD / sizeof(uint64_t)];
+    va_list ap;
+    va_start(ap, fmt);
+    loc_log_capture((LocLogRecord*)scratch, sizeof(scratch), prio, tag, fmt, ap);
+    va_end(ap);
+    loc_log_ring_put(ring, (LocLogRecord*)scratch);
+}
+
+template <typename T>
+static int loc_log_format_arg(char* out, size_t size, const char* spec,
+                              int stars, const int64_t* starArgs, T v)
+{
+    switch (stars) {
+    case 0:
+        return snprintf(out, size, spec, v);
+    case 1:
+        return snprintf(out, size, spec, (int)starArgs[0], v);
+    default:
+        return snprintf(out, size, spec, (int)starArgs[0], (int)starArgs[1], v);
+    }
+}
+
+// formats a record the way vsnprintf would have, had it run at capture time
+static void loc_log_format(const LocLogRecord* rec, char* out, size_t size)
+{
+    const char* arg = (const char*)(rec + 1);
+    const char* f = rec->fmt;
+    size_t len = strlen(out);
+    LocLogConv c;
+
+    for (int n = 0; len < size - 1 && NULL != loc_log_next_conv(f, c); n++) {
+        int literal = c.start - f;
+        len += snprintf(out + len, size - len, "%.*s", literal, f);
+        if (len >= size - 1) {
+            break;
+        }
+        if (n >= rec->convs) {
+            // ran out of record space at capture time
+            snprintf(out + len, size - len, "...");
+            return;
+        }
+
+        int64_t starArgs[2];
+        for (int i = 0; i < c.stars; i++) {
+            starArgs[i] = *(const int64_t*)arg;
+            arg += sizeof(int64_t);
+        }
+        char spec[32];
+        int specLen = c.end - c.start;
+        if (specLen >= (int)sizeof(spec)) {
+            specLen = sizeof(spec) - 1;
+        }
+        memcpy(spec, c.start, specLen);
+        spec[specLen] = '\0';
+
+        int written = 0;
+        switch (loc_log_arg_kind(c.conv)) {
+        case LOC_LOG_ARG_INT: {
+            int64_t v = *(const int64_t*)arg;
+            arg += sizeof(int64_t);
+            switch (c.length) {
+            case 'l': written = loc_log_format_arg(out + len, size - len, spec, c.stars, starArgs, (long)v); break;
+            case 'q': written = loc_log_format_arg(out + len, size - len, spec, c.stars, starArgs, (long long)v); break;
+            case 'j': written = loc_log_format_arg(out + len, size - len, spec, c.stars, starArgs, (intmax_t)v); break;
+            case 'z': written = loc_log_format_arg(out + len, size - len, spec, c.stars, starArgs, (ssize_t)v); break;
+            case 't': written = loc_log_format_arg(out + len, size - len, spec, c.stars, starArgs, (ptrdiff_t)v); break;
+            default:  written = loc_log_format_arg(out + len, size - len, spec, c.stars, starArgs, (int)v); break;
+            }
+            break;
+        }
+        case LOC_LOG_ARG_DOUBLE: {
+            double v = *(const double*)arg;
+            arg += sizeof(double);
+            if ('L' == c.length) {
+                written = loc_log_format_arg(out + len, size - len, spec, c.stars, starArgs, (long double)v);
+            } else {
+                written = loc_log_format_arg(out + len, size - len, spec, c.stars, starArgs, v);
+            }
+            break;
+        }
+        case LOC_LOG_ARG_PTR:
+            written = loc_log_format_arg(out + len, size - len, spec, c.stars, starArgs,
+                                         (void*)(uintptr_t)*(const uint64_t*)arg);
+            arg += sizeof(uint64_t);
+            break;
+        case LOC_LOG_ARG_SKIP:
+            arg += sizeof(uint64_t);
+            break;
+        case LOC_LOG_ARG_STR: {
+            uint32_t strLen = *(const uint32_t*)arg;
+            const char* s = arg + sizeof(uint32_t);
+            if (UINT32_MAX == strLen) {
+                s = "(null)";
+                strLen = 0;
+            }
+            written = loc_log_format_arg(out + len, size - len, spec, c.stars, starArgs, s);
+            arg += LOC_LOG_ALIGN(sizeof(uint32_t) + strLen + 1);
+            break;
+        }
+        default:
+            // "%%" and anything we do not know of
+            written = snprintf(out + len, size - len, "%s",
+                               ('%' == c.conv) ? "%" : spec);
+            break;
+        }
+        if (written > 0) {
+            len += written;
+        }
+        f = c.end;
+    }
+    if (len < size - 1) {
+        snprintf(out + len, size - len, "%s", f);
+    }
+}
+
+static void loc_log_write(int prio, const char* tag, const char* text)
+{
+#ifdef USE_GLIB
+    fprintf(stdout, "%s: %s\n", (NULL != tag) ? tag : "", text);
+#else
+    __android_log_write(prio, tag, text);
+#endif /* USE_GLIB */
+}
+
+// next record of a ring, up to the head as of the start of this drain
+static const LocLogRecord* loc_log_ring_peek(LocLogRing* ring)
+{
+    while (ring->mTail != ring->mLimit) {
+        const LocLogRecord* rec = (const LocLogRecord*)
+            (ring->mBuf + (ring->mTail & (LOC_LOG_RING_SIZE - 1)));
+        if (0 != rec->prio) {
+            return rec;
+        }
+        __atomic_store_n(&ring->mTail, ring->mTail + rec->size, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+// writes out the records of all rings, in time order. sLock must be held.
+static void loc_log_drain_l()
+{
+    // records carry CLOCK_MONOTONIC time, TIMESTAMP prints wall clock time
+    uint64_t offset = loc_log_now_ns(CLOCK_REALTIME) - loc_log_now_ns(CLOCK_MONOTONIC);
+    char line[LOC_LOG_MAX_LINE];
+
+    for (LocLogRing* ring = sRings; NULL != ring; ring = ring->mNext) {
+        ring->mLimit = __atomic_load_n(&ring->mHead, __ATOMIC_ACQUIRE);
+    }
+
+    while (true) {
+        LocLogRing* next = NULL;
+        const LocLogRecord* nextRec = NULL;
+        for (LocLogRing* ring = sRings; NULL != ring; ring = ring->mNext) {
+            const LocLogRecord* rec = loc_log_ring_peek(ring);
+            if (NULL != rec && (NULL == nextRec || rec->ts < nextRec->ts)) {
+                next = ring;
+                nextRec = rec;
+            }
+        }
+        if (NULL == next) {
+            break;
+        }
+
+        line[0] = '\0';
+        if (loc_logger.TIMESTAMP) {
+            uint64_t ts = nextRec->ts + offset;
+            time_t sec = ts / 1000000000ULL;
+            snprintf(line, sizeof(line), "[%02d:%02d:%02d.%06d] ",
+                     (int)(sec / 3600 % 24), (int)(sec % 3600 / 60), (int)(sec % 60),
+                     (int)(ts % 1000000000ULL / 1000));
+        }
+        loc_log_format(nextRec, line, sizeof(line));
+        loc_log_write(nextRec->prio, nextRec->tag, line);
+        __atomic_store_n(&next->mTail, next->mTail + nextRec->size, __ATOMIC_RELEASE);
+    }
+
+    for (LocLogRing** link = &sRings; NULL != *link; ) {
+        LocLogRing* ring = *link;
+        uint32_t dropped = __atomic_load_n(&ring->mDropped, __ATOMIC_RELAXED);
+        if (dropped != ring->mReported) {
+            snprintf(line, sizeof(line), "tid %d dropped %u log lines, ring full",
+                     ring->mTid, dropped - ring->mReported);
+            loc_log_write(LOC_LOG_PRIO_WARN, LOG_TAG, line);
+            ring->mReported = dropped;
+        }
+        // the thread is gone, and so are the records it left
+        if (__atomic_load_n(&ring->mExited, __ATOMIC_ACQUIRE) &&
+            ring->mTail == __atomic_load_n(&ring->mHead, __ATOMIC_ACQUIRE)) {
+            *link = ring->mNext;
+            free(ring);
+        } else {
+            link = &ring->mNext;
+        }
+    }
+}
+
+bool LocLogDrainer::run()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += LOC_LOG_DRAIN_MS * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    pthread_mutex_lock(&sLock);
+    pthread_cond_timedwait(&sCond, &sLock, &ts);
+    loc_log_drain_l();
+    pthread_mutex_unlock(&sLock);
+    return true;
+}
+
+/*===========================================================================
+FUNCTION loc_log_async_flush
+
+DESCRIPTION
+   Writes out all the lines captured by loc_log_async so far, on the
+   calling thread, without waiting for the drainer
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   None
+
+SIDE EFFECTS
+   N/A
+===========================================================================*/
+void loc_log_async_flush(void)
+{
+    pthread_mutex_lock(&sLock);
+    loc_log_drain_l();
+    pthread_mutex_unlock(&sLock);
+}
+
+#ifdef __LOC_LOG_ASYNC_DEBUG__
+
+/* Checks that the drainer formats as vsnprintf does, then measures the cost
+   of the logging calls on the calling thread, sync and async, at each
+   DEBUG_LEVEL. Lines go out in bursts, as the HAL logs around a fix, with
+   a flush between bursts outside of the timing. Send stderr to /dev/null. */
+#include <math.h>
+
+#define TEST_BURST 64
+
+static int sFailed = 0;
+
+// formats fmt through a record, as the drainer would, and vsnprintf
+static void testFormat(const char* fmt, ...)
+{
+    char expected[LOC_LOG_MAX_LINE];
+    char line[LOC_LOG_MAX_LINE];
+    uint64_t scratch[LOC_LOG_MAX_RECORD / sizeof(uint64_t)];
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(expected, sizeof(expected), fmt, ap);
+    va_end(ap);
+    va_start(ap, fmt);
+    loc_log_capture((LocLogRecord*)scratch, sizeof(scratch), LOC_LOG_PRIO_DEBUG,
+                    LOG_TAG, fmt, ap);
+    va_end(ap);
+    line[0] = '\0';
+    loc_log_format((LocLogRecord*)scratch, line, sizeof(line));
+
+    // lines with more args than a record holds are cut, and end in "..."
+    size_t len = strlen(line);
+    bool cut = (len > 3 && 0 == strcmp(line + len - 3, "...") &&
+                0 != strcmp(line, expected));
+    if (cut ? 0 != strncmp(line, expected, len - 3) : 0 != strcmp(line, expected)) {
+        fprintf(stdout, "FAIL \"%s\": \"%s\" != \"%s\"\n", fmt, line, expected);
+        sFailed++;
+    }
+}
+
+static void testFormats()
+{
+    char longStr[LOC_LOG_MAX_STR + 1];
+    memset(longStr, 'x', LOC_LOG_MAX_STR);
+    longStr[LOC_LOG_MAX_STR] = '\0';
+
+    testFormat("no args");
+    testFormat("100%% %d%%", 42);
+    testFormat("%d %i %u %x %X %o %c", -1, 2, 3u, 0xbeef, 0xcafe, 8, 'z');
+    testFormat("%hhd %hd %ld %lu %lld %llx %zu %zd %td %jd",
+                (signed char)-3, (short)-300, -5L, 6UL, -7LL, 0x123456789abcLL,
+                (size_t)9, (ssize_t)-10, (ptrdiff_t)-11, (intmax_t)-12);
+    testFormat("%f %.3f %e %g %10.2f %-8.1f| %Lf", 1.5, -2.25, 3e10, 0.0001,
+                4.125, 5.5, (long double)6.75);
+    testFormat("[%s] [%10s] [%-6s] [%.2s] [%s]", "abc", "right", "left",
+                "cut", (const char*)NULL);
+    testFormat("%*d|%-*d|%.*f|%*.*s", 6, 1, 4, 2, 2, 3.14159, 8, 3, "abcdef");
+    testFormat("%p %p", (void*)&sFailed, (void*)NULL);
+    testFormat("%s", LOG_TAG);
+    testFormat("%s: state %d lat %f lon %f acc %.1f flags 0x%04X", __FUNCTION__,
+                3, 37.3861, -122.0839, 12.5, 0x1f);
+
+    // strings are cut at LOC_LOG_MAX_STR, records at LOC_LOG_MAX_RECORD
+    testFormat("%s!", longStr);
+    testFormat("%s%s%s%s%s", longStr, longStr, longStr, longStr, longStr);
+}
+
+static uint64_t testNow()
+{
+    return loc_log_now_ns(CLOCK_MONOTONIC);
+}
+
+// the kind of lines the HAL logs around each fix
+static void testBurst(int i)
+{
+    ENTRY_LOG();
+    LOC_LOGD("%s: session %d status %s lat %f lon %f acc %.1f", __FUNCTION__,
+             i, "ENGINE_ON", 37.3861, -122.0839, 12.5);
+    LOC_LOGV("%s: flags 0x%04X sv %d/%d", __FUNCTION__, 0x1f, i % 32, 32);
+    LOC_LOGI("%s: fix %d reported", __FUNCTION__, i);
+    EXIT_LOG(%d, i);
+}
+
+static void testBench(int bursts)
+{
+    fprintf(stdout, "level  sync ns/call  async ns/call  (%d bursts of %d)\n",
+            bursts, TEST_BURST);
+    for (unsigned long level = 1; level <= 5; level++) {
+        double nsPerCall[2];
+        for (int async = 0; async < 2; async++) {
+            loc_logger_init(level, 0, async);
+            uint64_t total = 0;
+            for (int b = 0; b < bursts; b++) {
+                uint64_t start = testNow();
+                for (int i = 0; i < TEST_BURST / 5; i++) {
+                    testBurst(i);
+                }
+                total += testNow() - start;
+                loc_log_async_flush();
+            }
+            nsPerCall[async] = (double)total / (bursts * (TEST_BURST / 5) * 5);
+        }
+        fprintf(stdout, "%5lu  %12.1f  %13.1f\n", level, nsPerCall[0], nsPerCall[1]);
+    }
+    loc_logger_init(0, 0, 0);
+}
+
+// compile: g++ -D__LOC_HOST_DEBUG__ -D__LOC_LOG_ASYNC_DEBUG__ -g -O2 -I. -I../../../../system/core/include loc_log_async.cpp loc_log.cpp LocThread.cpp -lpthread
+// run: ./a.out [bursts] 2>/dev/null
+int main(int argc, char** argv)
+{
+    testFormats();
+    fprintf(stdout, "format: %s\n", sFailed ? "FAILED" : "OK");
+    testBench((argc > 1) ? atoi(argv[1]) : 2000);
+    return sFailed;
+}
+
+#endif /* __LOC_LOG_ASYNC_DEBUG__ */
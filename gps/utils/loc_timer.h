@@ -53,13 +53,18 @@ typedef void (*loc_timer_callback)(void *user_data, int32_t result);
                                 expiration and notify the client.
                         false if to wait until next time CPU wakes up (if
                                  sleeping) and then notify the client.
+    coarse:             true if the timeout may be rounded up to the next
+                                100 ms tick, sharing one kernel timer with
+                                other coarse timers. Suits retries and
+                                guard timers.
     Returns the handle, which can be used to stop the timer
                         NULL, if timer start fails (e.g. if cb_func is NULL).
 */
 void* loc_timer_start(uint64_t delay_msec,
                       loc_timer_callback cb_func,
                       void *user_data,
-                      bool wake_on_expire=false);
+                      bool wake_on_expire=false,
+                      bool coarse=false);
 
 /*
     handle becomes invalid upon the return of the callback
@@ -61,6 +61,7 @@ typedef struct loc_logger_s
 {
   unsigned long  DEBUG_LEVEL;
   unsigned long  TIMESTAMP;
+  unsigned long  ASYNC;
 } loc_logger_s_type;
 
 /*=============================================================================
@@ -88,9 +89,21 @@ extern const char EXIT_ERROR_TAG[];
  *                        MODULE EXPORTED FUNCTIONS
  *
  *============================================================================*/
-extern void loc_logger_init(unsigned long debug, unsigned long timestamp);
+extern void loc_logger_init(unsigned long debug, unsigned long timestamp,
+                            unsigned long async);
 extern char* get_timestamp(char* str, unsigned long buf_size);
 
+/* same values as android_LogPriority */
+#define LOC_LOG_PRIO_VERBOSE 2
+#define LOC_LOG_PRIO_DEBUG   3
+#define LOC_LOG_PRIO_INFO    4
+#define LOC_LOG_PRIO_WARN    5
+#define LOC_LOG_PRIO_ERROR   6
+
+extern void loc_log_async(int prio, const char* tag, const char* fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+extern void loc_log_async_flush(void);
+
 #ifndef DEBUG_DMN_LOC_API
 
 /* LOGGING MACROS */
@@ -98,17 +111,40 @@ extern char* get_timestamp(char* str, unsigned long buf_size);
   if that value remains unchanged, it means gps.conf did not
   provide a value and we default to the initial value to use
   Android's logging levels*/
-#define IF_LOC_LOGE if((loc_logger.DEBUG_LEVEL >= 1) && (loc_logger.DEBUG_LEVEL <= 5))
-#define IF_LOC_LOGW if((loc_logger.DEBUG_LEVEL >= 2) && (loc_logger.DEBUG_LEVEL <= 5))
-#define IF_LOC_LOGI if((loc_logger.DEBUG_LEVEL >= 3) && (loc_logger.DEBUG_LEVEL <= 5))
-#define IF_LOC_LOGD if((loc_logger.DEBUG_LEVEL >= 4) && (loc_logger.DEBUG_LEVEL <= 5))
-#define IF_LOC_LOGV if((loc_logger.DEBUG_LEVEL >= 5) && (loc_logger.DEBUG_LEVEL <= 5))
-
-#define LOC_LOGE(...) IF_LOC_LOGE { ALOGE(__VA_ARGS__); }
-#define LOC_LOGW(...) IF_LOC_LOGW { ALOGW(__VA_ARGS__); }
-#define LOC_LOGI(...) IF_LOC_LOGI { ALOGI(__VA_ARGS__); }
-#define LOC_LOGD(...) IF_LOC_LOGD { ALOGD(__VA_ARGS__); }
+/*LOC_LOG_MAX_LEVEL is the highest DEBUG_LEVEL compiled in. Lines above it
+  fold to if(0) and are compiled out, args and all, whatever gps.conf says.
+  The makefiles set it per module, from GPS_LOG_MAX_LEVEL_<module> or
+  GPS_LOG_MAX_LEVEL; user builds, which cap DEBUG_LEVEL at 2, default to 2*/
+#ifndef LOC_LOG_MAX_LEVEL
+#ifdef TARGET_BUILD_VARIANT_USER
+#define LOC_LOG_MAX_LEVEL 2
+#else
+#define LOC_LOG_MAX_LEVEL 5
+#endif
+#endif /* LOC_LOG_MAX_LEVEL */
+
+#define IF_LOC_LOGE if((LOC_LOG_MAX_LEVEL >= 1) && (loc_logger.DEBUG_LEVEL >= 1) && (loc_logger.DEBUG_LEVEL <= 5))
+#define IF_LOC_LOGW if((LOC_LOG_MAX_LEVEL >= 2) && (loc_logger.DEBUG_LEVEL >= 2) && (loc_logger.DEBUG_LEVEL <= 5))
+#define IF_LOC_LOGI if((LOC_LOG_MAX_LEVEL >= 3) && (loc_logger.DEBUG_LEVEL >= 3) && (loc_logger.DEBUG_LEVEL <= 5))
+#define IF_LOC_LOGD if((LOC_LOG_MAX_LEVEL >= 4) && (loc_logger.DEBUG_LEVEL >= 4) && (loc_logger.DEBUG_LEVEL <= 5))
+#define IF_LOC_LOGV if((LOC_LOG_MAX_LEVEL >= 5) && (loc_logger.DEBUG_LEVEL >= 5) && (loc_logger.DEBUG_LEVEL <= 5))
+
+/* with ASYNC_LOGGING set in gps.conf, the line is only captured here and
+   formatted and written out later by a drainer thread, see loc_log_async */
+#define LOC_LOG_(PRIO, ALOG, ...)                                             \
+    if (loc_logger.ASYNC) { loc_log_async(PRIO, LOG_TAG, __VA_ARGS__); }      \
+    else { ALOG(__VA_ARGS__); }
+
+#define LOC_LOGE(...) IF_LOC_LOGE { LOC_LOG_(LOC_LOG_PRIO_ERROR, ALOGE, __VA_ARGS__) }
+#define LOC_LOGW(...) IF_LOC_LOGW { LOC_LOG_(LOC_LOG_PRIO_WARN, ALOGW, __VA_ARGS__) }
+#define LOC_LOGI(...) IF_LOC_LOGI { LOC_LOG_(LOC_LOG_PRIO_INFO, ALOGI, __VA_ARGS__) }
+#define LOC_LOGD(...) IF_LOC_LOGD { LOC_LOG_(LOC_LOG_PRIO_DEBUG, ALOGD, __VA_ARGS__) }
+#if !defined(USE_GLIB) && defined(LOG_NDEBUG) && LOG_NDEBUG
+/* ALOGV is compiled out, so are verbose lines in async mode */
 #define LOC_LOGV(...) IF_LOC_LOGV { ALOGV(__VA_ARGS__); }
+#else
+#define LOC_LOGV(...) IF_LOC_LOGV { LOC_LOG_(LOC_LOG_PRIO_VERBOSE, ALOGV, __VA_ARGS__) }
+#endif
 
 #else /* DEBUG_DMN_LOC_API */
 
@@ -127,7 +163,8 @@ extern char* get_timestamp(char* str, unsigned long buf_size);
  *============================================================================*/
 #define LOG_(LOC_LOG, ID, WHAT, SPEC, VAL)                                    \
     do {                                                                      \
-        if (loc_logger.TIMESTAMP) {                                           \
+        /* the drainer stamps async lines with their capture time */          \
+        if (loc_logger.TIMESTAMP && !loc_logger.ASYNC) {                      \
             char ts[32];                                                      \
             LOC_LOG("[%s] %s %s line %d " #SPEC,                              \
                      get_timestamp(ts, sizeof(ts)), ID, WHAT, __LINE__, VAL); \
@@ -34,13 +34,40 @@
 #include "linked_list.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define MSG_Q_RING_MAX_CAPACITY (1U << 20)
+#define MSG_Q_CACHE_LINE 64
+
+typedef struct msg_q_cell {
+   uint32_t seq;                    /* Position this cell is ready for */
+   void* msg_obj;                   /* Message stored in this cell */
+   void (*dealloc)(void*);          /* Deallocator used on flush */
+} msg_q_cell;
+
+typedef struct msg_q_ring {
+   msg_q_cell* cells;               /* Power of 2 sized array of cells */
+   uint32_t mask;                   /* Number of cells - 1 */
+   /* Producers and consumer work on separate cache lines */
+   uint32_t head __attribute__((aligned(MSG_Q_CACHE_LINE)));  /* Next position to send */
+   uint32_t tail __attribute__((aligned(MSG_Q_CACHE_LINE)));  /* Next position to receive */
+} msg_q_ring;
 
 typedef struct msg_q {
-   void* msg_list;                  /* Linked list to store information */
+   msg_q_type type;                 /* Storage type of this message queue */
+   void* msg_list[eMSG_Q_NUM_PRIORITIES]; /* Linked lists to store information, one per priority */
    pthread_cond_t  list_cond;       /* Condition variable for waiting on msg queue */
    pthread_mutex_t list_mutex;      /* Mutex for exclusive access to message queue */
+   msg_q_ring* ring[eMSG_Q_NUM_PRIORITIES]; /* Ring buffers used instead of the lists */
    int unblocked;                   /* Has this message queue been unblocked? */
+   uint32_t wake_seq __attribute__((aligned(MSG_Q_CACHE_LINE))); /* Futex word of the rings */
+   uint32_t waiters;                /* Number of receivers sleeping on wake_seq */
 } msg_q;
 
 /*===========================================================================
@@ -82,6 +109,407 @@ static msq_q_err_type convert_linked_list_err_type(linked_list_err_type linked_l
    }
 }
 
+/*===========================================================================
+FUNCTION    msg_q_ring_create
+
+DESCRIPTION
+   Allocates a ring with at least capacity cells, rounded up to a power of 2.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Pointer to the ring; NULL if allocation fails.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static msg_q_ring* msg_q_ring_create(unsigned int capacity)
+{
+   uint32_t size = 2;
+   uint32_t i;
+   msg_q_ring* ring;
+
+   if( capacity == 0 )
+   {
+      capacity = MSG_Q_RING_DEFAULT_CAPACITY;
+   }
+   if( capacity > MSG_Q_RING_MAX_CAPACITY )
+   {
+      capacity = MSG_Q_RING_MAX_CAPACITY;
+   }
+   while( size < capacity )
+   {
+      size <<= 1;
+   }
+
+   if( posix_memalign((void**)&ring, MSG_Q_CACHE_LINE, sizeof(msg_q_ring)) != 0 )
+   {
+      return NULL;
+   }
+   memset(ring, 0, sizeof(msg_q_ring));
+
+   ring->cells = (msg_q_cell*)calloc(size, sizeof(msg_q_cell));
+   if( ring->cells == NULL )
+   {
+      free(ring);
+      return NULL;
+   }
+
+   for( i = 0; i < size; i++ )
+   {
+      ring->cells[i].seq = i;
+   }
+   ring->mask = size - 1;
+
+   return ring;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_push
+
+DESCRIPTION
+   Claims the next free cell with a CAS on head and publishes msg_obj in it.
+   Safe to be called from any number of threads concurrently.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   eMSG_Q_SUCCESS, or eMSG_Q_UNAVAILABLE_RESOURCE if the ring is full.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static msq_q_err_type msg_q_ring_push(msg_q_ring* ring, void* msg_obj, void (*dealloc)(void*))
+{
+   uint32_t pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+
+   for( ;; )
+   {
+      msg_q_cell* cell = &ring->cells[pos & ring->mask];
+      uint32_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+      int32_t diff = (int32_t)(seq - pos);
+
+      if( diff == 0 )
+      {
+         if( __atomic_compare_exchange_n(&ring->head, &pos, pos + 1, 1,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+         {
+            cell->msg_obj = msg_obj;
+            cell->dealloc = dealloc;
+            __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+            return eMSG_Q_SUCCESS;
+         }
+         /* pos has been reloaded by the failed CAS */
+      }
+      else if( diff < 0 )
+      {
+         /* The consumer has not yet released this cell from the last lap */
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+      else
+      {
+         pos = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+      }
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_pop
+
+DESCRIPTION
+   Takes the oldest published message out of the ring, if any.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   1 if a message was returned in msg_obj (and dealloc, if not NULL); 0 if
+   the ring is empty.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int msg_q_ring_pop(msg_q_ring* ring, void** msg_obj, void (**dealloc)(void*))
+{
+   uint32_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+
+   for( ;; )
+   {
+      msg_q_cell* cell = &ring->cells[pos & ring->mask];
+      uint32_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+      int32_t diff = (int32_t)(seq - (pos + 1));
+
+      if( diff == 0 )
+      {
+         if( __atomic_compare_exchange_n(&ring->tail, &pos, pos + 1, 1,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+         {
+            *msg_obj = cell->msg_obj;
+            if( dealloc != NULL )
+            {
+               *dealloc = cell->dealloc;
+            }
+            /* Hand the cell back to producers for the next lap */
+            __atomic_store_n(&cell->seq, pos + ring->mask + 1, __ATOMIC_RELEASE);
+            return 1;
+         }
+      }
+      else if( diff < 0 )
+      {
+         return 0;
+      }
+      else
+      {
+         pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+      }
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_destroy
+
+DESCRIPTION
+   Frees a ring allocated by msg_q_ring_create, and the messages still in
+   it with their deallocators, as linked_list_destroy does. NULL is ignored.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void msg_q_ring_destroy(msg_q_ring* ring)
+{
+   if( ring != NULL )
+   {
+      void* msg_obj;
+      void (*dealloc)(void*);
+
+      while( msg_q_ring_pop(ring, &msg_obj, &dealloc) )
+      {
+         if( dealloc != NULL )
+         {
+            dealloc(msg_obj);
+         }
+      }
+      free(ring->cells);
+      free(ring);
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_pop_any
+
+DESCRIPTION
+   Takes the oldest message of the highest priority non-empty ring, if any.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   1 if a message was returned in msg_obj; 0 if all rings are empty.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int msg_q_ring_pop_any(msg_q* p_msg_q, void** msg_obj, void (**dealloc)(void*))
+{
+   int prio;
+
+   for( prio = 0; prio < eMSG_Q_NUM_PRIORITIES; prio++ )
+   {
+      if( msg_q_ring_pop(p_msg_q->ring[prio], msg_obj, dealloc) )
+      {
+         return 1;
+      }
+   }
+
+   return 0;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_wake
+
+DESCRIPTION
+   Wakes up every receiver sleeping in msg_q_ring_rcv.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void msg_q_ring_wake(msg_q* p_msg_q)
+{
+   __atomic_fetch_add(&p_msg_q->wake_seq, 1, __ATOMIC_SEQ_CST);
+   syscall(__NR_futex, &p_msg_q->wake_seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+/*===========================================================================
+FUNCTION    msg_q_ring_rcv
+
+DESCRIPTION
+   Spins on msg_q_ring_pop_any and parks the caller on the wake_seq futex
+   while the rings stay empty. Producers only enter the kernel when waiters
+   is non-zero, i.e. when the receiver is idle.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   eMSG_Q_SUCCESS, or eMSG_Q_UNAVAILABLE_RESOURCE once the queue is unblocked.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static msq_q_err_type msg_q_ring_rcv(msg_q* p_msg_q, void** msg_obj)
+{
+   for( ;; )
+   {
+      uint32_t wake_seq;
+
+      if( msg_q_ring_pop_any(p_msg_q, msg_obj, NULL) )
+      {
+         return eMSG_Q_SUCCESS;
+      }
+      if( __atomic_load_n(&p_msg_q->unblocked, __ATOMIC_ACQUIRE) )
+      {
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+
+      /* Announce ourselves before the final check, so that a producer
+         publishing after that check is guaranteed to see us and bump
+         wake_seq, which makes the futex wait below return right away. */
+      wake_seq = __atomic_load_n(&p_msg_q->wake_seq, __ATOMIC_ACQUIRE);
+      __atomic_fetch_add(&p_msg_q->waiters, 1, __ATOMIC_SEQ_CST);
+
+      if( msg_q_ring_pop_any(p_msg_q, msg_obj, NULL) )
+      {
+         __atomic_fetch_sub(&p_msg_q->waiters, 1, __ATOMIC_RELAXED);
+         return eMSG_Q_SUCCESS;
+      }
+      if( !__atomic_load_n(&p_msg_q->unblocked, __ATOMIC_ACQUIRE) )
+      {
+         syscall(__NR_futex, &p_msg_q->wake_seq, FUTEX_WAIT_PRIVATE, wake_seq, NULL, NULL, 0);
+      }
+
+      __atomic_fetch_sub(&p_msg_q->waiters, 1, __ATOMIC_RELAXED);
+   }
+}
+
+/*===========================================================================
+FUNCTION    msg_q_list_empty
+
+DESCRIPTION
+   Checks whether the lists of all priorities are empty. Must be called with
+   list_mutex held.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   1 if all lists are empty; 0 otherwise.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static int msg_q_list_empty(msg_q* p_msg_q)
+{
+   int prio;
+
+   for( prio = 0; prio < eMSG_Q_NUM_PRIORITIES; prio++ )
+   {
+      if( !linked_list_empty(p_msg_q->msg_list[prio]) )
+      {
+         return 0;
+      }
+   }
+
+   return 1;
+}
+
+/*===========================================================================
+FUNCTION    msg_q_list_remove
+
+DESCRIPTION
+   Removes the oldest message of the highest priority non-empty list. Must be
+   called with list_mutex held.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static msq_q_err_type msg_q_list_remove(msg_q* p_msg_q, void** msg_obj)
+{
+   int prio;
+
+   for( prio = 0; prio < eMSG_Q_NUM_PRIORITIES; prio++ )
+   {
+      if( !linked_list_empty(p_msg_q->msg_list[prio]) )
+      {
+         return convert_linked_list_err_type(linked_list_remove(p_msg_q->msg_list[prio], msg_obj));
+      }
+   }
+
+   /* Let the empty list report the failure, as a single list would */
+   return convert_linked_list_err_type(linked_list_remove(p_msg_q->msg_list[0], msg_obj));
+}
+
+/*===========================================================================
+FUNCTION    msg_q_release
+
+DESCRIPTION
+   Frees the storage of a message queue, whatever part of it was set up.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   N/A
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+static void msg_q_release(msg_q* p_msg_q)
+{
+   int prio;
+
+   for( prio = 0; prio < eMSG_Q_NUM_PRIORITIES; prio++ )
+   {
+      msg_q_ring_destroy(p_msg_q->ring[prio]);
+      p_msg_q->ring[prio] = NULL;
+      if( p_msg_q->msg_list[prio] != NULL )
+      {
+         linked_list_destroy(&p_msg_q->msg_list[prio]);
+      }
+   }
+
+   free(p_msg_q);
+}
+
 /* ----------------------- END INTERNAL FUNCTIONS ---------------------------------------- */
 
 /*===========================================================================
@@ -90,6 +518,16 @@ static msq_q_err_type convert_linked_list_err_type(linked_list_err_type linked_l
 
   ===========================================================================*/
 msq_q_err_type msg_q_init(void** msg_q_data)
+{
+   return msg_q_init_ex(msg_q_data, eMSG_Q_TYPE_LIST, 0);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_init_ex
+
+  ===========================================================================*/
+msq_q_err_type msg_q_init_ex(void** msg_q_data, msg_q_type type, unsigned int capacity)
 {
    if( msg_q_data == NULL )
    {
@@ -98,34 +536,63 @@ msq_q_err_type msg_q_init(void** msg_q_data)
    }
 
    msg_q* tmp_msg_q;
-   tmp_msg_q = (msg_q*)calloc(1, sizeof(msg_q));
+   int prio;
+   if( posix_memalign((void**)&tmp_msg_q, MSG_Q_CACHE_LINE, sizeof(msg_q)) == 0 )
+   {
+      memset(tmp_msg_q, 0, sizeof(msg_q));
+   }
+   else
+   {
+      tmp_msg_q = NULL;
+   }
    if( tmp_msg_q == NULL )
    {
       LOC_LOGE("%s: Unable to allocate space for message queue!\n", __FUNCTION__);
       return eMSG_Q_FAILURE_GENERAL;
    }
 
-   if( linked_list_init(&tmp_msg_q->msg_list) != 0 )
+   tmp_msg_q->type = type;
+
+   if( type == eMSG_Q_TYPE_RING )
    {
-      LOC_LOGE("%s: Unable to initialize storage list!\n", __FUNCTION__);
-      free(tmp_msg_q);
-      return eMSG_Q_FAILURE_GENERAL;
+      for( prio = 0; prio < eMSG_Q_NUM_PRIORITIES; prio++ )
+      {
+         tmp_msg_q->ring[prio] = msg_q_ring_create(capacity);
+         if( tmp_msg_q->ring[prio] == NULL )
+         {
+            LOC_LOGE("%s: Unable to allocate message ring!\n", __FUNCTION__);
+            msg_q_release(tmp_msg_q);
+            return eMSG_Q_FAILURE_GENERAL;
+         }
+      }
+
+      *msg_q_data = tmp_msg_q;
+
+      return eMSG_Q_SUCCESS;
+   }
+
+   for( prio = 0; prio < eMSG_Q_NUM_PRIORITIES; prio++ )
+   {
+      if( linked_list_init(&tmp_msg_q->msg_list[prio]) != 0 )
+      {
+         LOC_LOGE("%s: Unable to initialize storage list!\n", __FUNCTION__);
+         msg_q_release(tmp_msg_q);
+         return eMSG_Q_FAILURE_GENERAL;
+      }
    }
 
    if( pthread_mutex_init(&tmp_msg_q->list_mutex, NULL) != 0 )
    {
       LOC_LOGE("%s: Unable to initialize list mutex!\n", __FUNCTION__);
-      linked_list_destroy(&tmp_msg_q->msg_list);
-      free(tmp_msg_q);
+      msg_q_release(tmp_msg_q);
       return eMSG_Q_FAILURE_GENERAL;
    }
 
    if( pthread_cond_init(&tmp_msg_q->list_cond, NULL) != 0 )
    {
       LOC_LOGE("%s: Unable to initialize msg q cond var!\n", __FUNCTION__);
-      linked_list_destroy(&tmp_msg_q->msg_list);
       pthread_mutex_destroy(&tmp_msg_q->list_mutex);
-      free(tmp_msg_q);
+      msg_q_release(tmp_msg_q);
       return eMSG_Q_FAILURE_GENERAL;
    }
 
@@ -165,13 +632,15 @@ msq_q_err_type msg_q_destroy(void** msg_q_data)
 
    msg_q* p_msg_q = (msg_q*)*msg_q_data;
 
-   linked_list_destroy(&p_msg_q->msg_list);
-   pthread_mutex_destroy(&p_msg_q->list_mutex);
-   pthread_cond_destroy(&p_msg_q->list_cond);
+   if( p_msg_q->type != eMSG_Q_TYPE_RING )
+   {
+      pthread_mutex_destroy(&p_msg_q->list_mutex);
+      pthread_cond_destroy(&p_msg_q->list_cond);
+   }
 
    p_msg_q->unblocked = 0;
 
-   free(*msg_q_data);
+   msg_q_release(p_msg_q);
    *msg_q_data = NULL;
 
    return eMSG_Q_SUCCESS;
@@ -183,6 +652,17 @@ msq_q_err_type msg_q_destroy(void** msg_q_data)
 
   ===========================================================================*/
 msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*))
+{
+   return msg_q_snd_prio(msg_q_data, msg_obj, dealloc, eMSG_Q_PRIORITY_NORMAL);
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_snd_prio
+
+  ===========================================================================*/
+msq_q_err_type msg_q_snd_prio(void* msg_q_data, void* msg_obj, void (*dealloc)(void*),
+                              msg_q_priority_type priority)
 {
    msq_q_err_type rv;
    if( msg_q_data == NULL )
@@ -195,9 +675,39 @@ msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*)
       LOC_LOGE("%s: Invalid msg_obj parameter!\n", __FUNCTION__);
       return eMSG_Q_INVALID_PARAMETER;
    }
+   if( (unsigned int)priority >= eMSG_Q_NUM_PRIORITIES )
+   {
+      LOC_LOGE("%s: Invalid priority parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
 
    msg_q* p_msg_q = (msg_q*)msg_q_data;
 
+   if( p_msg_q->type == eMSG_Q_TYPE_RING )
+   {
+      if( __atomic_load_n(&p_msg_q->unblocked, __ATOMIC_ACQUIRE) )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+
+      rv = msg_q_ring_push(p_msg_q->ring[priority], msg_obj, dealloc);
+      if( rv != eMSG_Q_SUCCESS )
+      {
+         LOC_LOGE("%s: Message ring is full.\n", __FUNCTION__);
+         return rv;
+      }
+
+      /* Pairs with the waiters increment in msg_q_ring_rcv */
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      if( __atomic_load_n(&p_msg_q->waiters, __ATOMIC_RELAXED) != 0 )
+      {
+         msg_q_ring_wake(p_msg_q);
+      }
+
+      return eMSG_Q_SUCCESS;
+   }
+
    pthread_mutex_lock(&p_msg_q->list_mutex);
    LOC_LOGV("%s: Sending message with handle = 0x%08X\n", __FUNCTION__, msg_obj);
 
@@ -208,7 +718,7 @@ msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*)
       return eMSG_Q_UNAVAILABLE_RESOURCE;
    }
 
-   rv = convert_linked_list_err_type(linked_list_add(p_msg_q->msg_list, msg_obj, dealloc));
+   rv = convert_linked_list_err_type(linked_list_add(p_msg_q->msg_list[priority], msg_obj, dealloc));
 
    /* Show data is in the message queue. */
    pthread_cond_signal(&p_msg_q->list_cond);
@@ -244,6 +754,21 @@ msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
 
    LOC_LOGV("%s: Waiting on message\n", __FUNCTION__);
 
+   if( p_msg_q->type == eMSG_Q_TYPE_RING )
+   {
+      if( __atomic_load_n(&p_msg_q->unblocked, __ATOMIC_ACQUIRE) )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+
+      rv = msg_q_ring_rcv(p_msg_q, msg_obj);
+
+      LOC_LOGV("%s: Received message 0x%08X rv = %d\n", __FUNCTION__, *msg_obj, rv);
+
+      return rv;
+   }
+
    pthread_mutex_lock(&p_msg_q->list_mutex);
 
    if( p_msg_q->unblocked )
@@ -254,12 +779,12 @@ msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
    }
 
    /* Wait for data in the message queue */
-   while( linked_list_empty(p_msg_q->msg_list) && !p_msg_q->unblocked )
+   while( msg_q_list_empty(p_msg_q) && !p_msg_q->unblocked )
    {
       pthread_cond_wait(&p_msg_q->list_cond, &p_msg_q->list_mutex);
    }
 
-   rv = convert_linked_list_err_type(linked_list_remove(p_msg_q->msg_list, msg_obj));
+   rv = msg_q_list_remove(p_msg_q, msg_obj);
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
@@ -268,6 +793,160 @@ msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
    return rv;
 }
 
+/*===========================================================================
+
+  FUNCTION:   msg_q_rcv_batch
+
+  ===========================================================================*/
+msq_q_err_type msg_q_rcv_batch(void* msg_q_data, void** msg_objs,
+                               unsigned int max_count, unsigned int* count)
+{
+   msq_q_err_type rv;
+   if( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   if( msg_objs == NULL || count == NULL || max_count == 0 )
+   {
+      LOC_LOGE("%s: Invalid msg_objs parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+   *count = 0;
+
+   LOC_LOGV("%s: Waiting on messages\n", __FUNCTION__);
+
+   if( p_msg_q->type == eMSG_Q_TYPE_RING )
+   {
+      if( __atomic_load_n(&p_msg_q->unblocked, __ATOMIC_ACQUIRE) )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+
+      rv = msg_q_ring_rcv(p_msg_q, &msg_objs[0]);
+      if( rv == eMSG_Q_SUCCESS )
+      {
+         *count = 1;
+         while( *count < max_count &&
+                msg_q_ring_pop_any(p_msg_q, &msg_objs[*count], NULL) )
+         {
+            (*count)++;
+         }
+      }
+
+      LOC_LOGV("%s: Received %u messages rv = %d\n", __FUNCTION__, *count, rv);
+
+      return rv;
+   }
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+
+   if( p_msg_q->unblocked )
+   {
+      LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+      pthread_mutex_unlock(&p_msg_q->list_mutex);
+      return eMSG_Q_UNAVAILABLE_RESOURCE;
+   }
+
+   /* Wait for data in the message queue */
+   while( msg_q_list_empty(p_msg_q) && !p_msg_q->unblocked )
+   {
+      pthread_cond_wait(&p_msg_q->list_cond, &p_msg_q->list_mutex);
+   }
+
+   rv = msg_q_list_remove(p_msg_q, &msg_objs[0]);
+   if( rv == eMSG_Q_SUCCESS )
+   {
+      *count = 1;
+      /* Drain whatever else is pending without giving up the lock */
+      while( *count < max_count && !msg_q_list_empty(p_msg_q) &&
+             msg_q_list_remove(p_msg_q, &msg_objs[*count]) == eMSG_Q_SUCCESS )
+      {
+         (*count)++;
+      }
+   }
+
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
+   LOC_LOGV("%s: Received %u messages rv = %d\n", __FUNCTION__, *count, rv);
+
+   return rv;
+}
+
+/*===========================================================================
+
+  FUNCTION:   msg_q_try_rcv_batch
+
+  ===========================================================================*/
+msq_q_err_type msg_q_try_rcv_batch(void* msg_q_data, void** msg_objs,
+                                   unsigned int max_count, unsigned int* count)
+{
+   msq_q_err_type rv = eMSG_Q_SUCCESS;
+   if( msg_q_data == NULL )
+   {
+      LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_HANDLE;
+   }
+
+   if( msg_objs == NULL || count == NULL || max_count == 0 )
+   {
+      LOC_LOGE("%s: Invalid msg_objs parameter!\n", __FUNCTION__);
+      return eMSG_Q_INVALID_PARAMETER;
+   }
+
+   msg_q* p_msg_q = (msg_q*)msg_q_data;
+   *count = 0;
+
+   if( p_msg_q->type == eMSG_Q_TYPE_RING )
+   {
+      if( __atomic_load_n(&p_msg_q->unblocked, __ATOMIC_ACQUIRE) )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+
+      while( *count < max_count &&
+             msg_q_ring_pop_any(p_msg_q, &msg_objs[*count], NULL) )
+      {
+         (*count)++;
+      }
+
+      LOC_LOGV("%s: Received %u messages\n", __FUNCTION__, *count);
+
+      return eMSG_Q_SUCCESS;
+   }
+
+   pthread_mutex_lock(&p_msg_q->list_mutex);
+
+   if( p_msg_q->unblocked )
+   {
+      LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+      pthread_mutex_unlock(&p_msg_q->list_mutex);
+      return eMSG_Q_UNAVAILABLE_RESOURCE;
+   }
+
+   while( *count < max_count && !msg_q_list_empty(p_msg_q) )
+   {
+      rv = msg_q_list_remove(p_msg_q, &msg_objs[*count]);
+      if( rv != eMSG_Q_SUCCESS )
+      {
+         break;
+      }
+      (*count)++;
+   }
+
+   pthread_mutex_unlock(&p_msg_q->list_mutex);
+
+   LOC_LOGV("%s: Received %u messages rv = %d\n", __FUNCTION__, *count, rv);
+
+   /* whatever was taken out before a failure belongs to the caller now */
+   return *count > 0 ? eMSG_Q_SUCCESS : rv;
+}
+
 /*===========================================================================
 
   FUNCTION:   msg_q_flush
@@ -276,6 +955,7 @@ msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj)
 msq_q_err_type msg_q_flush(void* msg_q_data)
 {
    msq_q_err_type rv;
+   int prio;
    if ( msg_q_data == NULL )
    {
       LOC_LOGE("%s: Invalid msg_q_data parameter!\n", __FUNCTION__);
@@ -286,10 +966,37 @@ msq_q_err_type msg_q_flush(void* msg_q_data)
 
    LOC_LOGD("%s: Flushing Message Queue\n", __FUNCTION__);
 
+   if( p_msg_q->type == eMSG_Q_TYPE_RING )
+   {
+      void* msg_obj;
+      void (*dealloc)(void*);
+
+      while( msg_q_ring_pop_any(p_msg_q, &msg_obj, &dealloc) )
+      {
+         if( dealloc != NULL )
+         {
+            dealloc(msg_obj);
+         }
+      }
+
+      LOC_LOGD("%s: Message Queue flushed\n", __FUNCTION__);
+
+      return eMSG_Q_SUCCESS;
+   }
+
    pthread_mutex_lock(&p_msg_q->list_mutex);
 
    /* Remove all elements from the list */
-   rv = convert_linked_list_err_type(linked_list_flush(p_msg_q->msg_list));
+   rv = eMSG_Q_SUCCESS;
+   for( prio = 0; prio < eMSG_Q_NUM_PRIORITIES; prio++ )
+   {
+      msq_q_err_type lane_rv =
+         convert_linked_list_err_type(linked_list_flush(p_msg_q->msg_list[prio]));
+      if( lane_rv != eMSG_Q_SUCCESS )
+      {
+         rv = lane_rv;
+      }
+   }
 
    pthread_mutex_unlock(&p_msg_q->list_mutex);
 
@@ -312,6 +1019,22 @@ msq_q_err_type msg_q_unblock(void* msg_q_data)
    }
 
    msg_q* p_msg_q = (msg_q*)msg_q_data;
+
+   if( p_msg_q->type == eMSG_Q_TYPE_RING )
+   {
+      if( __atomic_exchange_n(&p_msg_q->unblocked, 1, __ATOMIC_ACQ_REL) )
+      {
+         LOC_LOGE("%s: Message queue has been unblocked.\n", __FUNCTION__);
+         return eMSG_Q_UNAVAILABLE_RESOURCE;
+      }
+
+      LOC_LOGD("%s: Unblocking Message Queue\n", __FUNCTION__);
+      msg_q_ring_wake(p_msg_q);
+      LOC_LOGD("%s: Message Queue unblocked\n", __FUNCTION__);
+
+      return eMSG_Q_SUCCESS;
+   }
+
    pthread_mutex_lock(&p_msg_q->list_mutex);
 
    if( p_msg_q->unblocked )
@@ -334,3 +1057,157 @@ msq_q_err_type msg_q_unblock(void* msg_q_data)
 
    return eMSG_Q_SUCCESS;
 }
+
+#ifdef __LOC_DEBUG__
+
+#include <time.h>
+#include <sched.h>
+
+/* MPSC benchmark: producers send sequence numbers tagged with their index,
+   a single consumer takes them out in batches and checks that the messages
+   of each producer come in order. A full ring makes its producer yield and
+   retry, as a sender would have to. */
+#define TEST_MAX_PRODUCERS 16
+#define TEST_BATCH 16
+
+typedef struct test_ctx {
+   void* q;
+   int producers;
+   uint32_t msgs;
+   uint64_t retries;
+} test_ctx;
+
+typedef struct test_producer {
+   test_ctx* ctx;
+   int index;
+} test_producer;
+
+static uint64_t test_now_ns(void)
+{
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void* test_produce(void* arg)
+{
+   test_producer* producer = (test_producer*)arg;
+   test_ctx* ctx = producer->ctx;
+   uint64_t retries = 0;
+   uint32_t seq;
+
+   for( seq = 1; seq <= ctx->msgs; seq++ )
+   {
+      /* never NULL: the producer index lives in the top byte */
+      void* msg_obj = (void*)(((uintptr_t)producer->index << 24) | seq);
+      while( msg_q_snd(ctx->q, msg_obj, NULL) == eMSG_Q_UNAVAILABLE_RESOURCE )
+      {
+         retries++;
+         sched_yield();
+      }
+   }
+
+   __atomic_add_fetch(&ctx->retries, retries, __ATOMIC_RELAXED);
+   return NULL;
+}
+
+static int test_run(msg_q_type type, int producers, uint32_t msgs)
+{
+   test_ctx ctx;
+   test_producer producer[TEST_MAX_PRODUCERS];
+   pthread_t threads[TEST_MAX_PRODUCERS];
+   uint32_t last[TEST_MAX_PRODUCERS];
+   uint64_t expected = (uint64_t)producers * msgs;
+   uint64_t received = 0;
+   uint64_t batches = 0;
+   uint64_t start, elapsed;
+   int errors = 0;
+   int i;
+
+   memset(&ctx, 0, sizeof(ctx));
+   memset(last, 0, sizeof(last));
+   ctx.producers = producers;
+   ctx.msgs = msgs;
+   if( msg_q_init_ex(&ctx.q, type, 0) != eMSG_Q_SUCCESS )
+   {
+      printf("msg_q_init_ex failed\n");
+      return 1;
+   }
+
+   start = test_now_ns();
+   for( i = 0; i < producers; i++ )
+   {
+      producer[i].ctx = &ctx;
+      producer[i].index = i;
+      pthread_create(&threads[i], NULL, test_produce, &producer[i]);
+   }
+
+   while( received < expected )
+   {
+      void* msg_objs[TEST_BATCH];
+      unsigned int count = 0;
+      unsigned int n;
+
+      if( msg_q_rcv_batch(ctx.q, msg_objs, TEST_BATCH, &count) != eMSG_Q_SUCCESS )
+      {
+         errors++;
+         break;
+      }
+      for( n = 0; n < count; n++ )
+      {
+         uintptr_t value = (uintptr_t)msg_objs[n];
+         int index = (int)(value >> 24);
+         uint32_t seq = (uint32_t)(value & 0xFFFFFF);
+         if( index >= producers || seq != last[index] + 1 )
+         {
+            errors++;
+         }
+         else
+         {
+            last[index] = seq;
+         }
+      }
+      received += count;
+      batches++;
+   }
+   elapsed = test_now_ns() - start;
+
+   for( i = 0; i < producers; i++ )
+   {
+      pthread_join(threads[i], NULL);
+   }
+   msg_q_destroy(&ctx.q);
+
+   printf("%-4s producers %2d: %8.1f ns/msg %6.2f Mmsg/s avg batch %5.2f "
+          "full ring retries %llu errors %d\n",
+          type == eMSG_Q_TYPE_RING ? "ring" : "list", producers,
+          (double)elapsed / expected, expected * 1000.0 / elapsed,
+          batches ? (double)received / batches : 0.0,
+          (unsigned long long)ctx.retries, errors);
+   return (received == expected && errors == 0) ? 0 : 1;
+}
+
+// For Linux command line testing:
+// compile: g++ -D__LOC_HOST_DEBUG__ -O2 -I. -Iplatform_lib_abstractions -I../../../../system/core/include -c linked_list.c loc_log.cpp loc_log_async.cpp LocThread.cpp
+//          g++ -D__LOC_HOST_DEBUG__ -D__LOC_DEBUG__ -O2 -I. -Iplatform_lib_abstractions -I../../../../system/core/include msg_q.c linked_list.o loc_log.o loc_log_async.o LocThread.o -lpthread
+// run: ./a.out [msgs per producer]
+int main(int argc, char** argv)
+{
+   static const int producers[] = { 1, 2, 4, 8 };
+   uint32_t msgs = (argc > 1) ? (uint32_t)atoi(argv[1]) : 1000000;
+   unsigned int i;
+   int rv = 0;
+
+   if( msgs == 0 || msgs > 0xFFFFFF )
+   {
+      msgs = 1000000;
+   }
+   for( i = 0; i < sizeof(producers) / sizeof(producers[0]); i++ )
+   {
+      rv |= test_run(eMSG_Q_TYPE_LIST, producers[i], msgs);
+      rv |= test_run(eMSG_Q_TYPE_RING, producers[i], msgs);
+   }
+   return rv;
+}
+
+#endif /* __LOC_DEBUG__ */
@@ -52,6 +52,30 @@ typedef enum
      /**< Failed because an the supplied buffer was too small. */
 }msq_q_err_type;
 
+/** Message Queue Storage Types */
+typedef enum
+{
+  eMSG_Q_TYPE_LIST                           = 0,
+     /**< Unbounded linked list guarded by a mutex and condition variable. */
+  eMSG_Q_TYPE_RING                           = 1,
+     /**< Bounded lock-free multi-producer/single-consumer ring buffer. */
+}msg_q_type;
+
+/** Message Queue Priorities, highest first */
+typedef enum
+{
+  eMSG_Q_PRIORITY_HIGH                       = 0,
+     /**< Always received ahead of the other priorities. */
+  eMSG_Q_PRIORITY_NORMAL                     = 1,
+     /**< Priority of messages sent with msg_q_snd. */
+  eMSG_Q_PRIORITY_LOW                        = 2,
+     /**< Received only when nothing else is pending. */
+  eMSG_Q_NUM_PRIORITIES
+}msg_q_priority_type;
+
+/** Default number of slots per priority of a eMSG_Q_TYPE_RING queue */
+#define MSG_Q_RING_DEFAULT_CAPACITY 256
+
 /*===========================================================================
 FUNCTION    msg_q_init
 
@@ -72,6 +96,37 @@ SIDE EFFECTS
 ===========================================================================*/
 msq_q_err_type msg_q_init(void** msg_q_data);
 
+/*===========================================================================
+FUNCTION    msg_q_init_ex
+
+DESCRIPTION
+   Initializes internal structures for message queue with the given storage
+   type. msg_q_init() is equivalent to msg_q_init_ex() with eMSG_Q_TYPE_LIST.
+
+   A eMSG_Q_TYPE_RING queue never takes a lock and never allocates on
+   msg_q_snd; the receiver is only woken through a futex when it is idle.
+   It holds at most capacity messages and msg_q_snd fails with
+   eMSG_Q_UNAVAILABLE_RESOURCE when it is full, in which case the caller
+   keeps ownership of msg_obj. Only one thread may receive from it at a time.
+
+   msg_q_data: pointer to an opaque Q handle to be returned; NULL if fails
+   type:       storage type of the queue
+   capacity:   number of slots per priority for eMSG_Q_TYPE_RING, rounded up
+               to a power of 2; 0 selects MSG_Q_RING_DEFAULT_CAPACITY. Ignored for
+               eMSG_Q_TYPE_LIST.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_init_ex(void** msg_q_data, msg_q_type type, unsigned int capacity);
+
 /*===========================================================================
 FUNCTION    msg_q_init2
 
@@ -135,12 +190,41 @@ SIDE EFFECTS
 ===========================================================================*/
 msq_q_err_type msg_q_snd(void* msg_q_data, void* msg_obj, void (*dealloc)(void*));
 
+/*===========================================================================
+FUNCTION    msg_q_snd_prio
+
+DESCRIPTION
+   Same as msg_q_snd, but queues the message with the given priority.
+   Messages are received in FIFO order within a priority, and a message is
+   only received once no message of a higher priority is pending.
+   msg_q_snd queues with eMSG_Q_PRIORITY_NORMAL.
+
+   msg_q_data: Message Queue to add the element to.
+   msgp:       Pointer to data to add into message queue.
+   dealloc:    Function used to deallocate memory for this element. Pass NULL
+               if you do not want data deallocated during a flush operation
+   priority:   Priority of the message.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_snd_prio(void* msg_q_data, void* msg_obj, void (*dealloc)(void*),
+                              msg_q_priority_type priority);
+
 /*===========================================================================
 FUNCTION    msg_q_rcv
 
 DESCRIPTION
    Retrieves data from the message queue. msg_obj is the oldest message received
-   and pointer is simply removed from message queue.
+   of the highest pending priority and pointer is simply removed from message
+   queue.
 
    msg_q_data: Message Queue to copy data from into msgp.
    msg_obj:    Pointer to space to copy msg_q contents to.
@@ -157,6 +241,58 @@ SIDE EFFECTS
 ===========================================================================*/
 msq_q_err_type msg_q_rcv(void* msg_q_data, void** msg_obj);
 
+/*===========================================================================
+FUNCTION    msg_q_rcv_batch
+
+DESCRIPTION
+   Retrieves up to max_count of the oldest messages from the message queue
+   in one go. Blocks like msg_q_rcv until at least one message is available,
+   then takes everything pending, up to max_count, under a single critical
+   section. Messages are returned in the order msg_q_rcv would return them.
+
+   msg_q_data: Message Queue to copy data from into msg_objs.
+   msg_objs:   Array of at least max_count pointers to copy msg_q contents to.
+   max_count:  Maximum number of messages to retrieve; must not be 0.
+   count:      Number of messages returned in msg_objs.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_rcv_batch(void* msg_q_data, void** msg_objs,
+                               unsigned int max_count, unsigned int* count);
+
+/*===========================================================================
+FUNCTION    msg_q_try_rcv_batch
+
+DESCRIPTION
+   Same as msg_q_rcv_batch, but never blocks. Takes whatever is pending, up
+   to max_count, and returns right away; count is 0 if nothing is pending.
+
+   msg_q_data: Message Queue to copy data from into msg_objs.
+   msg_objs:   Array of at least max_count pointers to copy msg_q contents to.
+   max_count:  Maximum number of messages to retrieve; must not be 0.
+   count:      Number of messages returned in msg_objs.
+
+DEPENDENCIES
+   N/A
+
+RETURN VALUE
+   Look at error codes above. eMSG_Q_SUCCESS if the queue is empty.
+
+SIDE EFFECTS
+   N/A
+
+===========================================================================*/
+msq_q_err_type msg_q_try_rcv_batch(void* msg_q_data, void** msg_objs,
+                                   unsigned int max_count, unsigned int* count);
+
 /*===========================================================================
 FUNCTION    msg_q_flush
 